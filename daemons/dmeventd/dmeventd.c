@@ -33,6 +33,7 @@
 #include <signal.h>
 #include <arpa/inet.h>		/* for htonl, ntohl */
 #include <fcntl.h>		/* for musl libc */
+#include <poll.h>
 
 #ifdef __linux__
 /*
@@ -58,6 +59,10 @@
 #  define SD_FD_FIFO_SERVER SD_LISTEN_FDS_START
 #  define SD_FD_FIFO_CLIENT (SD_LISTEN_FDS_START + 1)
 
+#  include "kdev_t.h"
+#else
+#  define MAJOR(x) major((x))
+#  define MINOR(x) minor((x))
 #endif
 
 #include <syslog.h>
@@ -90,6 +95,9 @@ static const size_t THREAD_STACK_SIZE = 300 * 1024;
 /* Default idle exit timeout 1 hour (in seconds) */
 static const time_t DMEVENTD_IDLE_EXIT_TIMEOUT = 60 * 60;
 
+/* Worker threads calling plugins for the event loop */
+static const unsigned DMEVENTD_WORKER_THREADS = 4;
+
 static int _debug_level = 0;
 static int _use_syslog = 1;
 static int _systemd_activation = 0;
@@ -125,6 +133,7 @@ static const char *decode_cmd(uint32_t cmd)
 	case DM_EVENT_CMD_DIE:				return "DIE";
 	case DM_EVENT_CMD_GET_STATUS:			return "GET_STATUS";
 	case DM_EVENT_CMD_GET_PARAMETERS:		return "GET_PARAMETERS";
+	case DM_EVENT_CMD_GET_DEVICE_INFO:		return "GET_DEVICE_INFO";
 	default:					return "unknown";
 	}
 }
@@ -176,6 +185,18 @@ struct dso_data {
 	 */
 	int (*unregister_device)(const char *device, const char *uuid,
 				 int major, int minor, void **user);
+
+	/*
+	 * Device information (optional).
+	 *
+	 * Lets the DSO describe what it knows about a monitored device
+	 * as space separated key=value pairs (eg, projections derived
+	 * from the history of events). Called with the registry locked
+	 * and never while an event for the device is being processed,
+	 * so it must not block.
+	 */
+	int (*device_info)(const char *device, char *buffer, size_t size,
+			   void **user);
 };
 static DM_LIST_INIT(_dso_registry);
 
@@ -229,6 +250,14 @@ struct thread_status {
 	struct dm_list timeout_list;
 	void *dso_private; /* dso per-thread status variable */
 	/* TODO per-thread mutex */
+
+	/* Event loop only */
+	uint32_t event_nr;	/* Last event number seen for the device */
+	unsigned round;		/* Last event loop round listing the device */
+	unsigned missed;	/* Consecutive rounds not listing the device */
+	int work;		/* See DM_WORK_{REGISTER,EVENT,UNREGISTER} */
+	struct dm_list work_list;
+	struct dm_task *status_task;	/* Owned by _status_batch */
 };
 
 static DM_LIST_INIT(_thread_registry);
@@ -239,6 +268,31 @@ static DM_LIST_INIT(_timeout_registry);
 static pthread_mutex_t _timeout_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t _timeout_cond = PTHREAD_COND_INITIALIZER;
 
+/*
+ * Event loop (driver 4.37.0 and later).
+ *
+ * Instead of a monitoring thread per device blocked in DM_DEV_WAIT,
+ * a single thread polls the control device, which becomes readable
+ * when any device raises an event. One DM_DEVICE_LIST then returns
+ * the event numbers of all devices and those that changed for
+ * monitored devices are queued for a small pool of worker threads
+ * that call the plugins. Timeouts are handled by the same thread.
+ * The status of all devices queued in one round is read in a single
+ * pass before the workers are woken.
+ */
+enum {
+	DM_WORK_REGISTER,	/* Fill device data and register with DSO */
+	DM_WORK_EVENT,		/* Pass current_events to the DSO */
+	DM_WORK_UNREGISTER	/* Unregister with DSO and mark as DONE */
+};
+
+static int _event_loop = -1;	/* Unknown until the first registration */
+static int _event_loop_pipe[2] = { -1, -1 };	/* Wakes up the event loop */
+static DM_LIST_INIT(_work_queue);
+static pthread_cond_t _work_cond = PTHREAD_COND_INITIALIZER;
+static struct dm_status_batch *_status_batch;
+static pthread_mutex_t _status_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 /**********
  *   DSO
@@ -314,12 +368,18 @@ static int _lookup_symbol(void *dl, void **symbol, const char *name)
 
 static int _lookup_symbols(void *dl, struct dso_data *data)
 {
-	return _lookup_symbol(dl, (void *) &data->process_event,
-			     "process_event") &&
-	    _lookup_symbol(dl, (void *) &data->register_device,
-			  "register_device") &&
-	    _lookup_symbol(dl, (void *) &data->unregister_device,
-			  "unregister_device");
+	if (!_lookup_symbol(dl, (void *) &data->process_event,
+			    "process_event") ||
+	    !_lookup_symbol(dl, (void *) &data->register_device,
+			    "register_device") ||
+	    !_lookup_symbol(dl, (void *) &data->unregister_device,
+			    "unregister_device"))
+		return 0;
+
+	/* Optional */
+	data->device_info = dlsym(dl, "device_info");
+
+	return 1;
 }
 
 /* Load an application specific DSO. */
@@ -600,6 +660,7 @@ static int _fill_device_data(struct thread_status *ts)
 
 	ts->device.major = dmi.major;
 	ts->device.minor = dmi.minor;
+	ts->event_nr = dmi.event_nr;
 	dm_task_set_event_nr(ts->wait_task, dmi.event_nr);
 
 	ret = 1;
@@ -702,13 +763,26 @@ static int _get_status(struct message_data *message_data)
 
 static int _get_parameters(struct message_data *message_data) {
 	struct dm_event_daemon_message *msg = message_data->msg;
+	struct dm_status_batch_counters counters = { 0 };
 	int size;
 
+	if (_event_loop > 0) {
+		pthread_mutex_lock(&_status_mutex);
+		dm_status_batch_get_counters(_status_batch, &counters);
+		pthread_mutex_unlock(&_status_mutex);
+	}
+
 	dm_free(msg->data);
-	if ((size = dm_asprintf(&msg->data, "%s pid=%d daemon=%s exec_method=%s",
+	if ((size = dm_asprintf(&msg->data, "%s pid=%d daemon=%s exec_method=%s "
+				"event_loop=%s status_passes=" FMTu64
+				" status_ioctls=" FMTu64 " status_failures=" FMTu64
+				" status_ioctl_us=" FMTu64,
 				message_data->id, getpid(),
 				_foreground ? "no" : "yes",
-				_systemd_activation ? "systemd" : "direct")) < 0) {
+				_systemd_activation ? "systemd" : "direct",
+				(_event_loop > 0) ? "yes" : "no",
+				counters.passes, counters.ioctls,
+				counters.failures, counters.ioctl_ns / 1000)) < 0) {
 		stack;
 		return -ENOMEM;
 	}
@@ -777,6 +851,16 @@ static void *_timeout_thread(void *unused __attribute__((unused)))
 	return NULL;
 }
 
+/* Interrupt the event loop to rescan devices and timeouts. */
+static void _event_loop_wakeup(void)
+{
+	char c = 0;
+
+	if ((_event_loop_pipe[1] >= 0) &&
+	    (write(_event_loop_pipe[1], &c, 1) < 0) && (errno != EAGAIN))
+		log_sys_error("write", "event loop pipe");
+}
+
 static int _register_for_timeout(struct thread_status *thread)
 {
 	int ret = 0;
@@ -790,8 +874,11 @@ static int _register_for_timeout(struct thread_status *thread)
 			pthread_cond_signal(&_timeout_cond);
 	}
 
-	if (!_timeout_running &&
-	    !(ret = _pthread_create_smallstack(NULL, _timeout_thread, NULL)))
+	/* Event loop checks the timeout registry itself */
+	if (_event_loop > 0)
+		_event_loop_wakeup();
+	else if (!_timeout_running &&
+		 !(ret = _pthread_create_smallstack(NULL, _timeout_thread, NULL)))
 		_timeout_running = 1;
 
 	pthread_mutex_unlock(&_timeout_mutex);
@@ -916,17 +1003,20 @@ static int _do_unregister_device(struct thread_status *thread)
 /* Process an event in the DSO. */
 static void _do_process_event(struct thread_status *thread)
 {
-	struct dm_task *task;
+	struct dm_task *task, *batch_task;
 
-	/* NOTE: timeout event gets status */
-	task = (thread->current_events & DM_EVENT_TIMEOUT)
-		? _get_device_status(thread) : thread->wait_task;
+	/* NOTE: timeout event and event loop get status */
+	if ((task = batch_task = thread->status_task))
+		thread->status_task = NULL;
+	else
+		task = ((thread->current_events & DM_EVENT_TIMEOUT) || (_event_loop > 0))
+			? _get_device_status(thread) : thread->wait_task;
 
 	if (!task)
 		log_error("Lost event in Thr %x.", (int)thread->thread);
 	else {
 		thread->dso_data->process_event(task, thread->current_events, &(thread->dso_private));
-		if (task != thread->wait_task)
+		if ((task != thread->wait_task) && (task != batch_task))
 			dm_task_destroy(task);
 	}
 }
@@ -1057,6 +1147,365 @@ static int _create_thread(struct thread_status *thread)
 	return _pthread_create_smallstack(&thread->thread, _monitor_thread, thread);
 }
 
+/* Hand device to the worker pool - needs to be locked */
+static void _queue_work(struct thread_status *thread, int work)
+{
+	thread->processing = 1;	/* Cannot be queued twice */
+	thread->work = work;
+	dm_list_add(&_work_queue, &thread->work_list);
+	pthread_cond_signal(&_work_cond);
+}
+
+/*
+ * Queue device for the status batch of this round - needs to be locked.
+ * Falls back to the worker reading the status itself.
+ */
+static void _queue_status(struct thread_status *thread)
+{
+	thread->processing = 1;	/* Cannot be queued twice */
+	if (!dm_status_batch_add(_status_batch, thread->device.uuid, thread))
+		_queue_work(thread, DM_WORK_EVENT);
+}
+
+/* Status read by the batch - hand device to the worker pool */
+static int _status_ready(struct dm_task *dmt, void *context,
+			 void *data __attribute__((unused)))
+{
+	struct thread_status *thread = context;
+
+	_lock_mutex();
+	thread->status_task = dmt;
+	_queue_work(thread, DM_WORK_EVENT);
+	_unlock_mutex();
+
+	return 1;
+}
+
+/*
+ * Drop the status task of a finished device unless a new registration
+ * of the same device is using it already.
+ */
+static void _release_status(struct thread_status *thread)
+{
+	struct thread_status *thread_iter;
+
+	_lock_mutex();
+	dm_list_iterate_items(thread_iter, &_thread_registry)
+		if (!strcmp(thread_iter->device.uuid, thread->device.uuid)) {
+			_unlock_mutex();
+			return;
+		}
+	_unlock_mutex();
+
+	pthread_mutex_lock(&_status_mutex);
+	dm_status_batch_remove(_status_batch, thread->device.uuid);
+	pthread_mutex_unlock(&_status_mutex);
+}
+
+/*
+ * Plugin asked to stop monitoring by sending SIGALRM to its thread
+ * (blocked in workers). Consume the signal so it does not leak into
+ * the next device processed by this worker.
+ */
+static int _worker_sigalrm_pending(void)
+{
+	struct timespec zero = { 0 };
+	sigset_t pendmask, alrm;
+
+	if (sigpending(&pendmask) < 0) {
+		log_sys_error("sigpending", "");
+		return 0;
+	}
+
+	if (!sigismember(&pendmask, SIGALRM))
+		return 0;
+
+	sigemptyset(&alrm);
+	sigaddset(&alrm, SIGALRM);
+	(void) sigtimedwait(&alrm, NULL, &zero);
+
+	return 1;
+}
+
+/* Event loop worker calling DSO functions. */
+static void *_worker_thread(void *unused __attribute__((unused)))
+{
+	struct thread_status *thread;
+	int r;
+
+	_lock_mutex();
+	for (;;) {
+		while (dm_list_empty(&_work_queue))
+			pthread_cond_wait(&_work_cond, &_global_mutex);
+
+		thread = dm_list_item(dm_list_first(&_work_queue), struct thread_status);
+		dm_list_del(&thread->work_list);
+		_unlock_mutex();
+
+		switch (thread->work) {
+		case DM_WORK_REGISTER:
+			if (!(r = _fill_device_data(thread)))
+				log_error("Failed to fill device data for %s.",
+					  thread->device.uuid);
+			else if (!(r = _do_register_device(thread)))
+				log_error("Failed to register device %s.",
+					  thread->device.name);
+			_lock_mutex();
+			if (r) {
+				thread->status = DM_THREAD_RUNNING;
+				thread->pending = 0;
+			}
+			break;
+		case DM_WORK_EVENT:
+			_do_process_event(thread);
+			r = !_worker_sigalrm_pending();
+			_lock_mutex();
+			thread->current_events = 0; /* Current events processed */
+			break;
+		default:
+			_lock_mutex();
+			r = 0;
+		}
+
+		if (r && thread->events) {
+			thread->processing = 0;
+			_unlock_mutex();
+			_event_loop_wakeup();
+		} else
+			_monitor_unregister(thread); /* Unlocks */
+
+		_lock_mutex();
+	}
+
+	return NULL;
+}
+
+/* Rescan interval while the control device cannot be armed */
+#define DM_EVENT_LOOP_RETRY_MS 1000
+
+/*
+ * One pass of the event loop: queue monitored devices whose event
+ * number changed since the last pass or whose timeout expired.
+ * Returns the time of the next timeout or 0 for none.
+ * Sets armed when the control device will signal the next event.
+ */
+static time_t _event_loop_scan(struct dm_hash_table *devs, unsigned round,
+			       int *armed)
+{
+	struct thread_status *thread;
+	struct dm_task *dmt = NULL;
+	struct dm_names *names = NULL;
+	time_t now, next_time = 0;
+	uint32_t event_nr;
+	unsigned next = 0;
+	int devno[2], listed;
+
+	pthread_mutex_lock(&_status_mutex);
+
+	/* Arm before listing so events raised after the list wake poll */
+	if (!(*armed = (dmt = dm_task_create(DM_DEVICE_ARM_POLL)) && dm_task_run(dmt)))
+		log_error("Failed to arm event polling.");
+	if (dmt)
+		dm_task_destroy(dmt);
+
+	if (!(dmt = dm_task_create(DM_DEVICE_LIST))) {
+		pthread_mutex_unlock(&_status_mutex);
+		return_0;
+	}
+
+	if ((listed = dm_task_run(dmt)) &&
+	    (!(names = dm_task_get_names(dmt)) || !names->dev))
+		names = NULL; /* No devices */
+
+	pthread_mutex_lock(&_timeout_mutex);
+	_lock_mutex();
+
+	dm_list_iterate_items(thread, &_thread_registry) {
+		if (thread->status != DM_THREAD_RUNNING || thread->processing)
+			continue;
+		thread->pending = 0; /* Event is no longer pending...  */
+		devno[0] = thread->device.major;
+		devno[1] = thread->device.minor;
+		if (!dm_hash_insert_binary(devs, devno, sizeof(devno), thread))
+			log_error("Failed to track %s.", thread->device.name);
+	}
+
+	if (names)
+		do {
+			names = (struct dm_names *)((char *) names + next);
+			next = names->next;
+			devno[0] = (int) MAJOR(names->dev);
+			devno[1] = (int) MINOR(names->dev);
+			if (!(thread = dm_hash_lookup_binary(devs, devno, sizeof(devno))))
+				continue;
+			thread->round = round;
+			thread->missed = 0;
+			if (!dm_task_get_names_event_nr(dmt, names, &event_nr) ||
+			    (event_nr == thread->event_nr))
+				continue;
+			DEBUGLOG("Event %u on %s.", event_nr, thread->device.name);
+			thread->event_nr = event_nr;
+			thread->current_events |= DM_EVENT_DEVICE_ERROR;
+			if (thread->events & thread->current_events)
+				_queue_status(thread);
+		} while (next);
+
+	now = time(NULL);
+	dm_list_iterate_items_gen(thread, &_timeout_registry, timeout_list) {
+		if (thread->next_time <= now) {
+			thread->next_time = now + thread->timeout;
+			if (thread->status == DM_THREAD_RUNNING && !thread->processing) {
+				thread->current_events |= DM_EVENT_TIMEOUT;
+				if (thread->events & thread->current_events)
+					_queue_status(thread);
+			}
+		}
+		if (thread->next_time < next_time || !next_time)
+			next_time = thread->next_time;
+	}
+
+	/*
+	 * Device missing from two successful lists in a row has gone.
+	 * Once is not enough: it may have registered after the list.
+	 */
+	if (listed)
+		dm_list_iterate_items(thread, &_thread_registry)
+			if (thread->status == DM_THREAD_RUNNING &&
+			    !thread->processing && thread->round != round &&
+			    ++thread->missed > 1) {
+				log_error("%s disappeared, detaching.",
+					  thread->device.name);
+				_queue_work(thread, DM_WORK_UNREGISTER);
+			}
+
+	_unlock_mutex();
+	pthread_mutex_unlock(&_timeout_mutex);
+
+	if (!dm_status_batch_run(_status_batch, _status_ready, NULL))
+		stack;
+
+	pthread_mutex_unlock(&_status_mutex);
+
+	dm_hash_wipe(devs);
+	dm_task_destroy(dmt);
+
+	return next_time;
+}
+
+static void *_event_loop_thread(void *unused __attribute__((unused)))
+{
+	struct dm_hash_table *devs;
+	struct pollfd fds[2];
+	unsigned round = 0;
+	time_t next_time;
+	char buf[64];
+	int timeout, armed;
+
+	if (!(devs = dm_hash_create(1024))) {
+		log_error("Failed to allocate event loop device table.");
+		return NULL;
+	}
+
+	DEBUGLOG("Event loop starting.");
+
+	for (;;) {
+		fds[0].fd = _event_loop_pipe[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = -1;
+		fds[1].events = POLLIN;
+		timeout = -1;
+
+		_lock_mutex();
+		if (!dm_list_empty(&_thread_registry)) {
+			_unlock_mutex();
+			if ((next_time = _event_loop_scan(devs, ++round, &armed)))
+				timeout = (next_time > time(NULL)) ?
+					1000 * (int) (next_time - time(NULL)) : 0;
+			if (armed)
+				/* Control device stays open while any DSO is loaded */
+				fds[1].fd = dm_get_control_fd();
+			else if (timeout < 0 || timeout > DM_EVENT_LOOP_RETRY_MS)
+				/* Unarmed it stays readable: rescan periodically */
+				timeout = DM_EVENT_LOOP_RETRY_MS;
+		} else
+			_unlock_mutex();
+
+		if (poll(fds, 2, timeout) < 0 && errno != EINTR)
+			log_sys_error("poll", "event loop");
+
+		if (fds[0].revents & POLLIN)
+			while (read(_event_loop_pipe[0], buf, sizeof(buf)) > 0)
+				;
+	}
+
+	dm_hash_destroy(devs);
+
+	return NULL;
+}
+
+/*
+ * Select event loop on first registration when the driver supports
+ * polling the control device, otherwise fall back to one thread per
+ * device.
+ */
+static int _use_event_loop(void)
+{
+	char version[80];
+	unsigned major = 0, minor = 0, i, workers = 0;
+
+	if (_event_loop >= 0)
+		return _event_loop;
+
+	_event_loop = 0;
+
+	if (!dm_driver_version(version, sizeof(version)) ||
+	    (sscanf(version, "%u.%u", &major, &minor) != 2) ||
+	    (major < 4) || ((major == 4) && (minor < 37))) {
+		log_debug("Using monitoring thread per device.");
+		return 0;
+	}
+
+	if (!(_status_batch = dm_status_batch_create())) {
+		log_error("Failed to create status batch for event loop.");
+		return 0;
+	}
+
+	if (pipe(_event_loop_pipe)) {
+		log_sys_error("pipe", "event loop");
+		goto bad_batch;
+	}
+
+	if (fcntl(_event_loop_pipe[0], F_SETFL, O_NONBLOCK) ||
+	    fcntl(_event_loop_pipe[1], F_SETFL, O_NONBLOCK)) {
+		log_sys_error("fcntl", "event loop pipe");
+		goto bad;
+	}
+
+	for (i = 0; i < DMEVENTD_WORKER_THREADS; i++)
+		if (!_pthread_create_smallstack(NULL, _worker_thread, NULL))
+			workers++;
+
+	if (!workers || _pthread_create_smallstack(NULL, _event_loop_thread, NULL)) {
+		/* Workers without work just stay asleep */
+		log_error("Failed to start event loop.");
+		goto bad;
+	}
+
+	log_info("Monitoring devices with event loop and %u workers.", workers);
+	_event_loop = 1;
+
+	return 1;
+bad:
+	if (close(_event_loop_pipe[0]) || close(_event_loop_pipe[1]))
+		log_sys_error("close", "event loop pipe");
+	_event_loop_pipe[0] = _event_loop_pipe[1] = -1;
+bad_batch:
+	dm_status_batch_destroy(_status_batch);
+	_status_batch = NULL;
+
+	return 0;
+}
+
 /* Update events - needs to be locked */
 static int _update_events(struct thread_status *thread, int events)
 {
@@ -1069,7 +1518,9 @@ static int _update_events(struct thread_status *thread, int events)
 	thread->pending = DM_EVENT_REGISTRATION_PENDING;
 
 	/* Only non-processing threads can be notified */
-	if (!thread->processing) {
+	if (_event_loop > 0)
+		; /* No thread to wake, picked up on the next round */
+	else if (!thread->processing) {
 		DEBUGLOG("Sending SIGALRM to wakeup Thr %x.", (int)thread->thread);
 
 		/* Notify thread waiting in ioctl (to speed-up) */
@@ -1169,15 +1620,21 @@ static int _register_for_event(struct message_data *message_data)
 			return -ENOMEM;
 		}
 
-		if ((ret = _create_thread(thread))) {
-			stack;
-			_free_thread_status(thread);
-			return -ret;
-		}
+		if (_use_event_loop()) {
+			_lock_mutex();
+			LINK_THREAD(thread);
+			_queue_work(thread, DM_WORK_REGISTER);
+		} else {
+			if ((ret = _create_thread(thread))) {
+				stack;
+				_free_thread_status(thread);
+				return -ret;
+			}
 
-		_lock_mutex();
-		/* Note: same uuid can't be added in parallel */
-		LINK_THREAD(thread);
+			_lock_mutex();
+			/* Note: same uuid can't be added in parallel */
+			LINK_THREAD(thread);
+		}
 	}
 
 	_unlock_mutex();
@@ -1355,6 +1812,36 @@ static int _get_timeout(struct message_data *message_data)
 	return (msg->data && msg->size) ? 0 : -ENOMEM;
 }
 
+static int _get_device_info(struct message_data *message_data)
+{
+	struct thread_status *thread;
+	struct dm_event_daemon_message *msg = message_data->msg;
+	char buffer[256];
+	int ret = 0;
+
+	_lock_mutex();
+	if (!(thread = _lookup_thread_status(message_data)))
+		ret = -ENODEV;
+	else if (!thread->dso_data->device_info)
+		ret = -EINVAL;
+	else if ((thread->status != DM_THREAD_RUNNING) || thread->processing)
+		ret = -EBUSY;
+	else if (!thread->dso_data->device_info(thread->device.name,
+						buffer, sizeof(buffer),
+						&thread->dso_private))
+		ret = -EIO;
+	_unlock_mutex();
+
+	if (ret)
+		return ret;
+
+	dm_free(msg->data);
+	msg->size = dm_asprintf(&(msg->data), "%s %s",
+				message_data->id, buffer);
+
+	return (msg->data && msg->size) ? 0 : -ENOMEM;
+}
+
 static int _open_fifo(const char *path)
 {
 	struct stat st;
@@ -1577,14 +2064,20 @@ static int _handle_request(struct dm_event_daemon_message *msg,
 	case DM_EVENT_CMD_GET_STATUS:
 		return _get_status(message_data);
 	/* dmeventd parameters of running dmeventd,
-	 * returns 'pid=<pid> daemon=<no/yes> exec_method=<direct/systemd>'
+	 * returns 'pid=<pid> daemon=<no/yes> exec_method=<direct/systemd>
+	 *	    event_loop=<no/yes> status_...=<counter>'
 	 * 	pid - pidfile of running dmeventd
 	 * 	daemon - running as a daemon or not (foreground)?
 	 * 	exec_method - "direct" if executed directly or
 	 * 		      "systemd" if executed via systemd
+	 *	event_loop - devices monitored from one event loop?
+	 *	status_* - cost of status reads of the event loop
 	 */
 	case DM_EVENT_CMD_GET_PARAMETERS:
 		return _get_parameters(message_data);
+	/* DSO provided key=value information about a monitored device */
+	case DM_EVENT_CMD_GET_DEVICE_INFO:
+		return _get_device_info(message_data);
 	default:
 		return -EINVAL;
 	}
@@ -1671,12 +2164,46 @@ static void _process_initial_registrations(void)
 	}
 }
 
+/*
+ * Event loop: unregistration runs in a worker, so queue the unused
+ * devices and free the ones that are done.
+ */
+static void _cleanup_unused_devices(void)
+{
+	struct thread_status *thread, *tmp;
+	struct dm_list done;
+
+	dm_list_init(&done);
+
+	_lock_mutex();
+	dm_list_iterate_items_safe(thread, tmp, &_thread_registry_unused) {
+		if (thread->status == DM_THREAD_DONE) {
+			dm_list_del(&thread->list);
+			dm_list_add(&done, &thread->list);
+		} else if (!thread->processing)
+			_queue_work(thread, DM_WORK_UNREGISTER);
+	}
+	_unlock_mutex();
+
+	dm_list_iterate_items_safe(thread, tmp, &done) {
+		DEBUGLOG("Destroying monitor for %s.", thread->device.name);
+		dm_list_del(&thread->list);
+		_release_status(thread);
+		_free_thread_status(thread);
+	}
+}
+
 static void _cleanup_unused_threads(void)
 {
 	struct dm_list *l;
 	struct thread_status *thread;
 	int ret;
 
+	if (_event_loop > 0) {
+		_cleanup_unused_devices();
+		return;
+	}
+
 	_lock_mutex();
 
 	while ((l = dm_list_first(&_thread_registry_unused))) {
@@ -35,6 +35,7 @@ enum dm_event_command {
 	DM_EVENT_CMD_DIE,
 	DM_EVENT_CMD_GET_STATUS,
 	DM_EVENT_CMD_GET_PARAMETERS,
+	DM_EVENT_CMD_GET_DEVICE_INFO,
 };
 
 /* Message passed between client and daemon. */
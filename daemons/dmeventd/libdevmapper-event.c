@@ -402,9 +402,12 @@ int daemon_talk(struct dm_event_fifos *fifos,
  * Perhaps there is an even quicker/better way (no, checking the
  * lock file is _not_ a better way).
  *
+ * With start unset, a daemon that is not running is left alone.
+ *
  * Returns: 1 on success, 0 otherwise
  */
-static int _start_daemon(char *dmeventd_path, struct dm_event_fifos *fifos)
+static int _start_daemon(char *dmeventd_path, struct dm_event_fifos *fifos,
+			 int start)
 {
 	int pid, ret = 0;
 	int status;
@@ -463,6 +466,11 @@ static int _start_daemon(char *dmeventd_path, struct dm_event_fifos *fifos)
 start_server:
 	/* server is not running */
 
+	if (!start) {
+		log_debug("dmeventd is not running.");
+		return 0;
+	}
+
 	if ((args[0][0] == '/') && stat(args[0], &statbuf)) {
 		log_sys_error("stat", args[0]);
 		return 0;
@@ -523,9 +531,10 @@ bad:
 }
 
 /* Initialize client. */
-static int _init_client(char *dmeventd_path, struct dm_event_fifos *fifos)
+static int _init_client(char *dmeventd_path, struct dm_event_fifos *fifos,
+			int start)
 {
-	if (!_start_daemon(dmeventd_path, fifos))
+	if (!_start_daemon(dmeventd_path, fifos, start))
 		return_0;
 
 	return init_fifos(fifos);
@@ -599,10 +608,13 @@ static struct dm_task *_get_device_info(const struct dm_event_handler *dmevh)
 	return NULL;
 }
 
-/* Handle the event (de)registration call and return negative error codes. */
+/*
+ * Handle the event (de)registration call and return negative error codes.
+ * dmeventd is started if it is not running only when start is set.
+ */
 static int _do_event(int cmd, char *dmeventd_path, struct dm_event_daemon_message *msg,
 		     const char *dso_name, const char *dev_name,
-		     enum dm_event_mask evmask, uint32_t timeout)
+		     enum dm_event_mask evmask, uint32_t timeout, int start)
 {
 	int ret;
 	struct dm_event_fifos fifos = {
@@ -613,7 +625,7 @@ static int _do_event(int cmd, char *dmeventd_path, struct dm_event_daemon_messag
 		.server_path = DM_EVENT_FIFO_SERVER
 	};
 
-	if (!_init_client(dmeventd_path, &fifos)) {
+	if (!_init_client(dmeventd_path, &fifos, start)) {
 		ret = -ESRCH;
 		goto_out;
 	}
@@ -653,7 +665,7 @@ int dm_event_register_handler(const struct dm_event_handler *dmevh)
 
 
 	if ((err = _do_event(DM_EVENT_CMD_REGISTER_FOR_EVENT, dmevh->dmeventd_path, &msg,
-			     dmevh->dso, uuid, dmevh->mask, dmevh->timeout)) < 0) {
+			     dmevh->dso, uuid, dmevh->mask, dmevh->timeout, 1)) < 0) {
 		log_error("%s: event registration failed: %s.",
 			  dm_task_get_name(dmt),
 			  msg.data ? msg.data : strerror(-err));
@@ -680,7 +692,7 @@ int dm_event_unregister_handler(const struct dm_event_handler *dmevh)
 	uuid = dm_task_get_uuid(dmt);
 
 	if ((err = _do_event(DM_EVENT_CMD_UNREGISTER_FOR_EVENT, dmevh->dmeventd_path, &msg,
-			    dmevh->dso, uuid, dmevh->mask, dmevh->timeout)) < 0) {
+			    dmevh->dso, uuid, dmevh->mask, dmevh->timeout, 1)) < 0) {
 		log_error("%s: event deregistration failed: %s.",
 			  dm_task_get_name(dmt),
 			  msg.data ? msg.data : strerror(-err));
@@ -757,7 +769,7 @@ int dm_event_get_registered_device(struct dm_event_handler *dmevh, int next)
 	/* FIXME Distinguish errors connecting to daemon */
 	if (_do_event(next ? DM_EVENT_CMD_GET_NEXT_REGISTERED_DEVICE :
 		      DM_EVENT_CMD_GET_REGISTERED_DEVICE, dmevh->dmeventd_path,
-		      &msg, dmevh->dso, uuid, dmevh->mask, 0)) {
+		      &msg, dmevh->dso, uuid, dmevh->mask, 0, 1)) {
 		log_debug("%s: device not registered.", dm_task_get_name(dmt));
 		ret = -ENOENT;
 		goto fail;
@@ -825,6 +837,32 @@ int dm_event_get_registered_device(struct dm_event_handler *dmevh, int next)
 	return ret;
 }
 
+int dm_event_get_device_info(const struct dm_event_handler *dmevh, char **info)
+{
+	int ret;
+	const char *p;
+	struct dm_task *dmt;
+	struct dm_event_daemon_message msg = { 0 };
+
+	if (!(dmt = _get_device_info(dmevh)))
+		return -ENODEV;
+
+	if (!(ret = _do_event(DM_EVENT_CMD_GET_DEVICE_INFO, dmevh->dmeventd_path,
+			      &msg, dmevh->dso, dm_task_get_uuid(dmt), 0, 0, 0))) {
+		if (!msg.data || !(p = strchr(msg.data, ' '))) {
+			log_error("Malformed reply from dmeventd '%s'.",
+				  msg.data ? : "");
+			ret = -EIO;
+		} else if (!(*info = dm_strdup(p + 1)))
+			ret = -ENOMEM;
+	}
+
+	dm_free(msg.data);
+	dm_task_destroy(dmt);
+
+	return ret;
+}
+
 /*
  * You can (and have to) call this at the stage of the protocol where
  *     daemon_talk(fifos, &msg, DM_EVENT_CMD_HELLO, NULL, NULL, 0, 0)
@@ -99,6 +99,14 @@ enum dm_event_mask dm_event_handler_get_event_mask(const struct dm_event_handler
 /* FIXME Review interface (what about this next thing?) */
 int dm_event_get_registered_device(struct dm_event_handler *dmevh, int next);
 
+/*
+ * Get information the DSO keeps about the monitored device as space
+ * separated key=value pairs. The string must be released with dm_free().
+ * Only a dmeventd that is already running is asked, -ESRCH otherwise.
+ * Returns 0 on success, negative errno otherwise.
+ */
+int dm_event_get_device_info(const struct dm_event_handler *dmevh, char **info);
+
 /*
  * Initiate monitoring using dmeventd.
  */
@@ -131,5 +139,7 @@ void process_event(struct dm_task *dmt, enum dm_event_mask evmask, void **user);
 int register_device(const char *device_name, const char *uuid, int major, int minor, void **user);
 int unregister_device(const char *device_name, const char *uuid, int major,
 		      int minor, void **user);
+/* Optional */
+int device_info(const char *device_name, char *buffer, size_t size, void **user);
 
 #endif
@@ -118,6 +118,12 @@ int dmeventd_lvm2_run(const char *cmdline)
 	return (lvm2_run(_lvm_handle, cmdline) == LVM2_COMMAND_SUCCEEDED);
 }
 
+/* Needs dmeventd_lvm2_lock() like dmeventd_lvm2_run() */
+int dmeventd_lvm2_config_int(const char *path, int fail)
+{
+	return lvm2_config_find_int(_lvm_handle, path, fail);
+}
+
 int dmeventd_lvm2_command(struct dm_pool *mem, char *buffer, size_t size,
 			  const char *cmd, const char *device)
 {
@@ -15,6 +15,7 @@
 #include "lib.h"	/* using here lvm log */
 #include "dmeventd_lvm.h"
 #include "libdevmapper-event.h"
+#include "defaults.h"
 
 #include <sys/wait.h>
 #include <stdarg.h>
@@ -42,6 +43,11 @@
 
 #define MAX_FAILS	(10)
 
+/* Usage samples kept to project when the pool fills up. */
+#define HISTORY_SIZE	(8)
+
+#define NOT_FILLING	UINT64_MAX
+
 #define THIN_DEBUG 0
 
 struct dso_state {
@@ -51,6 +57,26 @@ struct dso_state {
 	uint64_t known_metadata_size;
 	uint64_t known_data_size;
 	unsigned fails;
+	/* Latency of policy runs, measured from the event that triggered them */
+	struct dm_timestamp *ts_event;
+	struct dm_timestamp *ts_locked;
+	struct dm_timestamp *ts_done;
+	unsigned policy_runs;
+	uint64_t policy_total_ns;
+	uint64_t policy_max_ns;
+	/* Usage history to extend early when the pool fills up fast */
+	struct dm_timestamp *ts_base;
+	struct usage_sample {
+		uint64_t ns;		/* Since monitoring started */
+		uint64_t used_data_blocks;
+		uint64_t used_metadata_blocks;
+	} history[HISTORY_SIZE];
+	unsigned history_count;
+	unsigned history_next;
+	uint64_t horizon;		/* Seconds, 0 disables early extension */
+	int threshold;			/* Percent, 0 when autoextend is off */
+	uint64_t time_to_full;		/* Seconds, NOT_FILLING when unknown */
+	int early_tried;		/* Early extension done for this size */
 	char cmd_str[1024];
 };
 
@@ -298,12 +324,51 @@ out:
 		dm_bitset_destroy(data.minors);
 }
 
-static int _use_policy(struct dm_task *dmt, struct dso_state *state)
+/*
+ * The lvm2 handle shared by all plugins stays initialised between
+ * events, so the command below runs in-process against an already
+ * populated device and label cache.  What is left on the critical
+ * path is waiting for other plugins to release the handle and the
+ * command itself (VG read under lock, table reload and resume).
+ * Report both, measured from the event that triggered the policy.
+ */
+static void _policy_latency(struct dm_task *dmt, struct dso_state *state, int r)
 {
+	uint64_t wait_ns, total_ns;
+
+	if (!dm_timestamp_get(state->ts_done))
+		return;
+
+	wait_ns = dm_timestamp_delta(state->ts_locked, state->ts_event);
+	total_ns = dm_timestamp_delta(state->ts_done, state->ts_event);
+
+	state->policy_runs++;
+	state->policy_total_ns += total_ns;
+	if (total_ns > state->policy_max_ns)
+		state->policy_max_ns = total_ns;
+
+	log_info("%s thin pool %s policy in %.3f ms (%.3f ms waiting for lvm2 lock).",
+		 r ? "Applied" : "Failed to apply", dm_task_get_name(dmt),
+		 (double) total_ns / 1000000, (double) wait_ns / 1000000);
+}
+
+static int _use_policy(struct dm_task *dmt, struct dso_state *state,
+		       const char *cmd_str)
+{
+	int r;
+
 #if THIN_DEBUG
-	log_info("dmeventd executes: %s.", state->cmd_str);
+	log_info("dmeventd executes: %s.", cmd_str);
 #endif
-	if (!dmeventd_lvm2_run_with_lock(state->cmd_str)) {
+	dmeventd_lvm2_lock();
+	if (!dm_timestamp_get(state->ts_locked))
+		dm_timestamp_copy(state->ts_locked, state->ts_event);
+	r = dmeventd_lvm2_run(cmd_str);
+	dmeventd_lvm2_unlock();
+
+	_policy_latency(dmt, state, r);
+
+	if (!r) {
 		log_error("Failed to extend thin pool %s.",
 			  dm_task_get_name(dmt));
 		state->fails++;
@@ -314,6 +379,173 @@ static int _use_policy(struct dm_task *dmt, struct dso_state *state)
 	return 1;
 }
 
+/*
+ * Autoextend threshold lvm2 applied with the pool's profile when it loaded
+ * the table: the low water mark is the number of data blocks still free
+ * at the threshold and 0 when autoextend is off.
+ */
+static int _get_threshold(const char *device, int *threshold)
+{
+	struct dm_task *dmt;
+	void *next = NULL;
+	uint64_t start, length, blocks, low_water_mark;
+	uint32_t block_size;
+	char *target_type = NULL;
+	char *params;
+	int r = 0;
+
+	if (!(dmt = dm_task_create(DM_DEVICE_TABLE)))
+		return_0;
+
+	if (!dm_task_set_name(dmt, device) ||
+	    !dm_task_no_flush(dmt) ||
+	    !dm_task_run(dmt))
+		goto_out;
+
+	dm_get_next_target(dmt, next, &start, &length, &target_type, &params);
+
+	if (!target_type || strcmp(target_type, "thin-pool") || !params ||
+	    (sscanf(params, "%*s %*s %u " FMTu64, &block_size, &low_water_mark) != 2) ||
+	    !block_size || !(blocks = length / block_size)) {
+		log_error("Failed to parse thin pool table of %s.", device);
+		goto out;
+	}
+
+	/* The highest threshold lvm2 rounds down to this mark */
+	*threshold = low_water_mark ?
+		100 - (int) ((low_water_mark * 100 + blocks - 1) / blocks) : 0;
+
+	r = 1;
+out:
+	dm_task_destroy(dmt);
+
+	return r;
+}
+
+/* Seconds until used reaches limit at the rate seen since the old sample */
+static uint64_t _seconds_to(uint64_t old_used, uint64_t used, uint64_t ns,
+			    uint64_t limit)
+{
+	if (used >= limit)
+		return 0;
+
+	if ((used <= old_used) || !ns)
+		return NOT_FILLING;
+
+	return (uint64_t) ((double) (limit - used) * ns / (used - old_used) / 1000000000);
+}
+
+/*
+ * Record usage and project when the pool fills up at the rate seen
+ * over the kept history. Discards or a replaced pool make usage drop,
+ * start over then.
+ */
+static void _add_sample(struct dso_state *state,
+			const struct dm_status_thin_pool *tps)
+{
+	const struct usage_sample *oldest, *newest;
+	struct usage_sample *sample;
+	uint64_t ns, meta_time;
+
+	state->time_to_full = NOT_FILLING;
+
+	if (!dm_timestamp_get(state->ts_event))
+		return;
+
+	ns = dm_timestamp_delta(state->ts_event, state->ts_base);
+
+	if (state->history_count) {
+		newest = &state->history[(state->history_next + HISTORY_SIZE - 1) % HISTORY_SIZE];
+		if ((tps->used_data_blocks < newest->used_data_blocks) ||
+		    (tps->used_metadata_blocks < newest->used_metadata_blocks))
+			state->history_count = 0;
+	}
+
+	sample = &state->history[state->history_next];
+	sample->ns = ns;
+	sample->used_data_blocks = tps->used_data_blocks;
+	sample->used_metadata_blocks = tps->used_metadata_blocks;
+	state->history_next = (state->history_next + 1) % HISTORY_SIZE;
+	if (state->history_count < HISTORY_SIZE)
+		state->history_count++;
+
+	if (state->history_count < 2)
+		return;
+
+	oldest = &state->history[(state->history_next + HISTORY_SIZE - state->history_count) % HISTORY_SIZE];
+	state->time_to_full = _seconds_to(oldest->used_data_blocks, tps->used_data_blocks,
+					  ns - oldest->ns, tps->total_data_blocks);
+	meta_time = _seconds_to(oldest->used_metadata_blocks, tps->used_metadata_blocks,
+				ns - oldest->ns, tps->total_metadata_blocks);
+	if (meta_time < state->time_to_full)
+		state->time_to_full = meta_time;
+}
+
+/*
+ * Extend the pool before it crosses the autoextend threshold when the
+ * fill rate says that happens within the configured horizon. lvextend
+ * only extends above the threshold, so run it with the threshold
+ * lowered just below the current usage.
+ */
+static void _extend_early(struct dm_task *dmt, struct dso_state *state,
+			  const struct dm_status_thin_pool *tps)
+{
+	const struct usage_sample *oldest;
+	char cmd_str[1024], policy[128];
+	uint64_t ns, data_limit, meta_limit, data_time, meta_time;
+	int percent = DM_PERCENT_100, threshold;
+
+	if (!state->horizon || !state->threshold || state->early_tried ||
+	    (state->history_count < 2))
+		return;
+
+	oldest = &state->history[(state->history_next + HISTORY_SIZE - state->history_count) % HISTORY_SIZE];
+	ns = dm_timestamp_delta(state->ts_event, state->ts_base) - oldest->ns;
+
+	/*
+	 * Project against the threshold read when monitoring started, not
+	 * the current low water mark: an early extension reloads the table
+	 * with the lowered mark, so each next extension would start earlier.
+	 */
+	data_limit = tps->total_data_blocks * state->threshold / 100;
+	meta_limit = tps->total_metadata_blocks * state->threshold / 100;
+
+	data_time = _seconds_to(oldest->used_data_blocks, tps->used_data_blocks,
+				ns, data_limit);
+	meta_time = _seconds_to(oldest->used_metadata_blocks, tps->used_metadata_blocks,
+				ns, meta_limit);
+
+	if ((data_time >= state->horizon) && (meta_time >= state->horizon))
+		return;
+
+	if (data_time < state->horizon)
+		percent = dm_make_percent(tps->used_data_blocks, tps->total_data_blocks);
+	if ((meta_time < state->horizon) &&
+	    (dm_make_percent(tps->used_metadata_blocks, tps->total_metadata_blocks) < percent))
+		percent = dm_make_percent(tps->used_metadata_blocks, tps->total_metadata_blocks);
+
+	/* lvextend does not accept a threshold below 50% */
+	if ((threshold = (percent - 1) / DM_PERCENT_1) < 50)
+		return;
+
+	state->early_tried = 1;
+
+	log_info("Thin pool %s is projected to reach autoextend threshold in "
+		 FMTu64 " seconds, extending early.", dm_task_get_name(dmt),
+		 (data_time < meta_time) ? data_time : meta_time);
+
+	if ((dm_snprintf(policy, sizeof(policy), "lvextend --use-policies --config "
+			 "activation{thin_pool_autoextend_threshold=%d}", threshold) < 0) ||
+	    !dmeventd_lvm2_command(state->mem, cmd_str, sizeof(cmd_str),
+				   policy, dm_task_get_name(dmt))) {
+		log_error("Failed to prepare early extension of %s.",
+			  dm_task_get_name(dmt));
+		return;
+	}
+
+	(void) _use_policy(dmt, state, cmd_str);
+}
+
 void process_event(struct dm_task *dmt,
 		   enum dm_event_mask event __attribute__((unused)),
 		   void **user)
@@ -329,6 +561,9 @@ void process_event(struct dm_task *dmt,
 	int needs_policy = 0;
 	int needs_umount = 0;
 
+	if (!dm_timestamp_get(state->ts_event))
+		stack;
+
 #if THIN_DEBUG
 	log_debug("Watch for tp-data:%.2f%%  tp-metadata:%.2f%%.",
 		  dm_percent_to_float(state->data_percent_check),
@@ -342,7 +577,7 @@ void process_event(struct dm_task *dmt,
 #endif
 	if (event & DM_EVENT_DEVICE_ERROR) {
 		/* Error -> no need to check and do instant resize */
-		if (_use_policy(dmt, state))
+		if (_use_policy(dmt, state, state->cmd_str))
 			goto out;
 
 		stack;
@@ -377,8 +612,11 @@ void process_event(struct dm_task *dmt,
 	if (state->known_data_size != tps->total_data_blocks) {
 		state->data_percent_check = CHECK_MINIMUM;
 		state->known_data_size = tps->total_data_blocks;
+		state->early_tried = 0;
 	}
 
+	_add_sample(state, tps);
+
 	percent = dm_make_percent(tps->used_metadata_blocks, tps->total_metadata_blocks);
 	if (percent >= state->metadata_percent_check) {
 		/*
@@ -415,8 +653,10 @@ void process_event(struct dm_task *dmt,
 	}
 
 	if (needs_policy &&
-	    _use_policy(dmt, state))
+	    _use_policy(dmt, state, state->cmd_str))
 		needs_umount = 0; /* No umount when command was successful */
+	else if (!needs_policy)
+		_extend_early(dmt, state, tps);
 out:
 	if (needs_umount) {
 		_umount(dmt);
@@ -435,6 +675,18 @@ out:
 	}
 }
 
+static void _destroy_timestamps(struct dso_state *state)
+{
+	if (state->ts_event)
+		dm_timestamp_destroy(state->ts_event);
+	if (state->ts_locked)
+		dm_timestamp_destroy(state->ts_locked);
+	if (state->ts_done)
+		dm_timestamp_destroy(state->ts_done);
+	if (state->ts_base)
+		dm_timestamp_destroy(state->ts_base);
+}
+
 int register_device(const char *device,
 		    const char *uuid __attribute__((unused)),
 		    int major __attribute__((unused)),
@@ -449,10 +701,29 @@ int register_device(const char *device,
 	if (!dmeventd_lvm2_command(state->mem, state->cmd_str,
 				   sizeof(state->cmd_str),
 				   "lvextend --use-policies",
-				   device)) {
-		dmeventd_lvm2_exit_with_pool(state);
-		goto_bad;
-	}
+				   device))
+		goto bad_state;
+
+	if (!(state->ts_event = dm_timestamp_alloc()) ||
+	    !(state->ts_locked = dm_timestamp_alloc()) ||
+	    !(state->ts_done = dm_timestamp_alloc()) ||
+	    !(state->ts_base = dm_timestamp_alloc()) ||
+	    !dm_timestamp_get(state->ts_base))
+		goto bad_state;
+
+	dmeventd_lvm2_lock();
+	state->horizon = dmeventd_lvm2_config_int("activation/thin_pool_autoextend_horizon",
+						  DEFAULT_THIN_POOL_AUTOEXTEND_HORIZON);
+	dmeventd_lvm2_unlock();
+
+	/*
+	 * Monitoring starts once lvm2 activated the pool, so the table has
+	 * the threshold of the pool's profile. Early extensions reload it
+	 * with a lowered one, hence it is read only here.
+	 */
+	if (!_get_threshold(device, &state->threshold))
+		goto bad_state;
+	state->time_to_full = NOT_FILLING;
 
 	state->metadata_percent_check = CHECK_MINIMUM;
 	state->data_percent_check = CHECK_MINIMUM;
@@ -461,12 +732,30 @@ int register_device(const char *device,
 	log_info("Monitoring thin %s.", device);
 
 	return 1;
+bad_state:
+	stack;
+	_destroy_timestamps(state);
+	dmeventd_lvm2_exit_with_pool(state);
 bad:
 	log_error("Failed to monitor thin %s.", device);
 
 	return 0;
 }
 
+int device_info(const char *device __attribute__((unused)),
+		char *buffer, size_t size, void **user)
+{
+	struct dso_state *state = *user;
+
+	if (state->time_to_full == NOT_FILLING)
+		*buffer = '\0';
+	else if (dm_snprintf(buffer, size, "time_to_full=" FMTu64,
+			     state->time_to_full) < 0)
+		return_0;
+
+	return 1;
+}
+
 int unregister_device(const char *device,
 		      const char *uuid __attribute__((unused)),
 		      int major __attribute__((unused)),
@@ -475,6 +764,14 @@ int unregister_device(const char *device,
 {
 	struct dso_state *state = *user;
 
+	if (state->policy_runs)
+		log_info("Thin pool %s policy applied %u times, "
+			 "latency avg %.3f ms max %.3f ms.", device,
+			 state->policy_runs,
+			 (double) state->policy_total_ns / state->policy_runs / 1000000,
+			 (double) state->policy_max_ns / 1000000);
+
+	_destroy_timestamps(state);
 	dmeventd_lvm2_exit_with_pool(state);
 	log_info("No longer monitoring thin %s.", device);
 
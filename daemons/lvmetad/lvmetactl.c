@@ -14,6 +14,21 @@
 
 daemon_handle h;
 
+static int print_line(const char *line, void *baton)
+{
+	printf("%s\n", line);
+	return 1;
+}
+
+/* Replies carrying a config tree may come binary encoded. */
+static void print_raw(daemon_reply reply)
+{
+	if (!buffer_is_binary(&reply.buffer))
+		printf("%s\n", reply.buffer.mem);
+	else if (reply.cft)
+		dm_config_write_node(reply.cft->root, print_line, NULL);
+}
+
 static void print_reply(daemon_reply reply)
 {
 	const char *a = daemon_reply_str(reply, "response", NULL);
@@ -58,7 +73,7 @@ int main(int argc, char **argv)
 					   "pid = " FMTd64, (int64_t)getpid(),
 					   "cmd = %s", "lvmetactl",
 					   NULL);
-		printf("%s\n", reply.buffer.mem);
+		print_raw(reply);
 
 	} else if (!strcmp(cmd, "pv_list")) {
 		reply = daemon_send_simple(h, "pv_list",
@@ -66,7 +81,7 @@ int main(int argc, char **argv)
 					   "pid = " FMTd64, (int64_t)getpid(),
 					   "cmd = %s", "lvmetactl",
 					   NULL);
-		printf("%s\n", reply.buffer.mem);
+		print_raw(reply);
 
 	} else if (!strcmp(cmd, "vg_list")) {
 		reply = daemon_send_simple(h, "vg_list",
@@ -74,7 +89,7 @@ int main(int argc, char **argv)
 					   "pid = " FMTd64, (int64_t)getpid(),
 					   "cmd = %s", "lvmetactl",
 					   NULL);
-		printf("%s\n", reply.buffer.mem);
+		print_raw(reply);
 
 	} else if (!strcmp(cmd, "get_global_info")) {
 		reply = daemon_send_simple(h, "get_global_info",
@@ -82,7 +97,7 @@ int main(int argc, char **argv)
 					   "pid = " FMTd64, (int64_t)getpid(),
 					   "cmd = %s", "lvmetactl",
 					   NULL);
-		printf("%s\n", reply.buffer.mem);
+		print_raw(reply);
 
 	} else if (!strcmp(cmd, "set_global_invalid")) {
 		if (argc < 3) {
@@ -174,7 +189,7 @@ int main(int argc, char **argv)
 					   "pid = " FMTd64, (int64_t)getpid(),
 					   "cmd = %s", "lvmetactl",
 					   NULL);
-		printf("%s\n", reply.buffer.mem);
+		print_raw(reply);
 
 	} else if (!strcmp(cmd, "vg_lookup_uuid")) {
 		if (argc < 3) {
@@ -189,7 +204,7 @@ int main(int argc, char **argv)
 					   "pid = " FMTd64, (int64_t)getpid(),
 					   "cmd = %s", "lvmetactl",
 					   NULL);
-		printf("%s\n", reply.buffer.mem);
+		print_raw(reply);
 
 	} else if (!strcmp(cmd, "vg_lock_type")) {
 		struct dm_config_node *metadata;
@@ -235,7 +250,7 @@ int main(int argc, char **argv)
 					   "pid = " FMTd64, (int64_t)getpid(),
 					   "cmd = %s", "lvmetactl",
 					   NULL);
-		printf("%s\n", reply.buffer.mem);
+		print_raw(reply);
 
 	} else {
 		printf("unknown command\n");
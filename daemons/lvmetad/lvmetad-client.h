@@ -76,7 +76,8 @@ static inline daemon_handle lvmetad_open(const char *socket)
 		.socket = socket ?: LVMETAD_SOCKET,
 		.protocol = "lvmetad",
 		.protocol_version = 1,
-		.autostart = 0
+		.autostart = 0,
+		.binary = 1
 	};
 
 	return daemon_open(lvmetad_info);
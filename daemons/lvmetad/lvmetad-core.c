@@ -210,6 +210,24 @@ struct vg_info {
 
 #define CMD_NAME_SIZE 32
 
+/*
+ * Cached VG metadata is sharded by vgid over VG_LOCK_SHARDS rwlocks.
+ * vg_lookup holds only the shard lock of its VG while copying the
+ * (potentially large) metadata, so the cache_lock is held briefly and
+ * writers to unrelated VGs do not stall readers, or the other way round.
+ *
+ * A metadata tree removed from vgid_to_metadata by a writer is retired
+ * rather than destroyed; it is freed once the cache_lock is released
+ * and the shard lock can be taken for writing.
+ */
+#define VG_LOCK_SHARDS 64
+
+struct retired_metadata {
+	struct dm_list list;
+	struct dm_config_tree *cft;
+	pthread_rwlock_t *vg_lock;
+};
+
 typedef struct {
 	daemon_idle *idle;
 	log_state *log; /* convenience */
@@ -233,6 +251,8 @@ typedef struct {
 	pthread_mutex_t token_lock;
 	pthread_mutex_t info_lock;
 	pthread_rwlock_t cache_lock;
+	pthread_rwlock_t vg_lock[VG_LOCK_SHARDS];
+	struct dm_list retired_metadata; /* protected by cache_lock */
 } lvmetad_state;
 
 static uint64_t _monotonic_seconds(void)
@@ -244,12 +264,71 @@ static uint64_t _monotonic_seconds(void)
 	return ts.tv_sec;
 }
 
+static pthread_rwlock_t *_vg_lock(lvmetad_state *s, const char *vgid)
+{
+	unsigned h = 2166136261U;
+
+	while (*vgid)
+		h = (h ^ (unsigned char) *vgid++) * 16777619U;
+
+	return &s->vg_lock[h % VG_LOCK_SHARDS];
+}
+
+/*
+ * Called with cache_lock held for writing, in place of dm_config_destroy,
+ * for a tree that has just been removed from vgid_to_metadata.
+ */
+static void _retire_metadata(lvmetad_state *s, const char *vgid, struct dm_config_tree *cft)
+{
+	pthread_rwlock_t *vg_lock = _vg_lock(s, vgid);
+	struct retired_metadata *rm;
+
+	/* The list entry lives in the pool it is going to release. */
+	if (!(rm = dm_pool_alloc(cft->mem, sizeof(*rm)))) {
+		pthread_rwlock_wrlock(vg_lock);
+		dm_config_destroy(cft);
+		pthread_rwlock_unlock(vg_lock);
+		return;
+	}
+
+	rm->cft = cft;
+	rm->vg_lock = vg_lock;
+	dm_list_add(&s->retired_metadata, &rm->list);
+}
+
+static void _destroy_retired(struct dm_list *retired)
+{
+	struct retired_metadata *rm, *tmp;
+	pthread_rwlock_t *vg_lock;
+
+	dm_list_iterate_items_safe(rm, tmp, retired) {
+		vg_lock = rm->vg_lock;
+		/* Wait for vg_lookup copying from this tree. */
+		pthread_rwlock_wrlock(vg_lock);
+		dm_config_destroy(rm->cft);
+		pthread_rwlock_unlock(vg_lock);
+	}
+}
+
+/* Drop cache_lock held for writing and free what the writer retired. */
+static void _cache_unlock_write(lvmetad_state *s)
+{
+	struct dm_list retired;
+
+	dm_list_init(&retired);
+	dm_list_splice(&retired, &s->retired_metadata);
+	pthread_rwlock_unlock(&s->cache_lock);
+
+	_destroy_retired(&retired);
+}
+
 static void destroy_metadata_hashes(lvmetad_state *s)
 {
 	struct dm_hash_node *n = NULL;
 
 	dm_hash_iterate(n, s->vgid_to_metadata)
-		dm_config_destroy(dm_hash_get_data(s->vgid_to_metadata, n));
+		_retire_metadata(s, dm_hash_get_key(s->vgid_to_metadata, n),
+				 dm_hash_get_data(s->vgid_to_metadata, n));
 
 	dm_hash_iterate(n, s->vgid_to_outdated_pvs)
 		dm_config_destroy(dm_hash_get_data(s->vgid_to_outdated_pvs, n));
@@ -425,14 +504,25 @@ static struct dm_config_node *make_pv_node(lvmetad_state *s, const char *pvid,
 	if (parent && !parent->child)
 		parent->child = pv;
 	pv->parent = parent;
-	pv->key = pvid;
+	if (!(pv->key = dm_pool_strdup(cft->mem, pvid)))
+		return NULL;
 
-	/* Add the "variable" bits to it. */
+	/*
+	 * Add the "variable" bits to it.  The response is written out
+	 * after the cache is unlocked, so it must not share any strings
+	 * with the hash tables.
+	 */
 
-	if (vgid && strcmp(vgid, "#orphan"))
+	if (vgid && strcmp(vgid, "#orphan")) {
+		if (!(vgid = dm_pool_strdup(cft->mem, vgid)))
+			return NULL;
 		cn = make_text_node(cft, "vgid", vgid, pv, cn);
-	if (vgname)
+	}
+	if (vgname) {
+		if (!(vgname = dm_pool_strdup(cft->mem, vgname)))
+			return NULL;
 		cn = make_text_node(cft, "vgname", vgname, pv, cn);
+	}
 
 	return pv;
 }
@@ -568,7 +658,8 @@ static response vg_list(lvmetad_state *s, request r)
 			goto bad; /* FIXME */
 
 		cn->child->v->type = DM_CFG_STRING;
-		cn->child->v->v.str = name;
+		if (!(cn->child->v->v.str = dm_pool_strdup(res.cft->mem, name)))
+			goto bad; /* FIXME */
 
 		if (!cn_vgs->child)
 			cn_vgs->child = cn;
@@ -648,11 +739,16 @@ static void chain_outdated_pvs(lvmetad_state *s, const char *vgid, struct dm_con
 	}
 }
 
+/*
+ * Takes its own locks: the cache_lock is only held to find the VG and
+ * to add PV status, the metadata itself is copied under the VG lock.
+ */
 static response vg_lookup(lvmetad_state *s, request r)
 {
 	struct dm_config_tree *cft;
 	struct dm_config_node *metadata, *n;
 	struct vg_info *info;
+	pthread_rwlock_t *vg_lock;
 	response res = { 0 };
 	const char *uuid = daemon_request_str(r, "uuid", NULL);
 	const char *name = daemon_request_str(r, "name", NULL);
@@ -663,8 +759,11 @@ static response vg_lookup(lvmetad_state *s, request r)
 	if (!uuid && !name) {
 		ERROR(s, "vg_lookup with no uuid or name");
 		return reply_unknown("VG not found");
+	}
+
+	pthread_rwlock_rdlock(&s->cache_lock);
 
-	} else if (!uuid || !name) {
+	if (!uuid || !name) {
 		DEBUGLOG(s, "vg_lookup vgid %s name %s needs lookup",
 			 uuid ?: "none", name ?: "none");
 
@@ -676,11 +775,14 @@ static response vg_lookup(lvmetad_state *s, request r)
 		if (name && uuid && (count > 1)) {
 			DEBUGLOG(s, "vg_lookup name %s vgid %s found %d vgids",
 				 name, uuid, count);
+			pthread_rwlock_unlock(&s->cache_lock);
 			return daemon_reply_simple("multiple", "reason = %s", "Multiple VGs found with same name", NULL);
 		}
 
-		if (!uuid || !name)
+		if (!uuid || !name) {
+			pthread_rwlock_unlock(&s->cache_lock);
 			return reply_unknown("VG not found");
+		}
 
 	} else {
 		char *name_lookup = dm_hash_lookup(s->vgid_to_vgname, uuid);
@@ -691,10 +793,12 @@ static response vg_lookup(lvmetad_state *s, request r)
 		if (!name_lookup || !uuid_lookup) {
 			ERROR(s, "vg_lookup vgid %s name %s found incomplete mapping uuid %s name %s",
 			      uuid, name, uuid_lookup ?: "none", name_lookup ?: "none");
+			pthread_rwlock_unlock(&s->cache_lock);
 			return reply_unknown("VG mapping incomplete");
 		} else if (strcmp(name_lookup, name) || strcmp(uuid_lookup, uuid)) {
 			ERROR(s, "vg_lookup vgid %s name %s found inconsistent mapping uuid %s name %s",
 			      uuid, name, uuid_lookup, name_lookup);
+			pthread_rwlock_unlock(&s->cache_lock);
 			return reply_unknown("VG mapping inconsistent");
 		}
 	}
@@ -703,29 +807,40 @@ static response vg_lookup(lvmetad_state *s, request r)
 
 	cft = dm_hash_lookup(s->vgid_to_metadata, uuid);
 	if (!cft || !cft->root) {
+		pthread_rwlock_unlock(&s->cache_lock);
 		return reply_unknown("UUID not found");
 	}
 
 	metadata = cft->root;
 	if (!(res.cft = dm_config_create()))
-		goto nomem_un;
+		goto nomem;
+
+	/* uuid and name may belong to the hash tables */
+	if (!(uuid = dm_pool_strdup(res.cft->mem, uuid)) ||
+	    !(name = dm_pool_strdup(res.cft->mem, name)))
+		goto nomem;
+
+	/* cft stays valid while its VG lock is held, see _retire_metadata */
+	vg_lock = _vg_lock(s, uuid);
+	pthread_rwlock_rdlock(vg_lock);
+	pthread_rwlock_unlock(&s->cache_lock);
 
 	/* The response field */
 	if (!(res.cft->root = n = dm_config_create_node(res.cft, "response")))
-		goto nomem_un;
+		goto nomem;
 
-	if (!(n->v = dm_config_create_value(cft)))
-		goto nomem_un;
+	if (!(n->v = dm_config_create_value(res.cft)))
+		goto nomem;
 
 	n->parent = res.cft->root;
 	n->v->type = DM_CFG_STRING;
 	n->v->v.str = "OK";
 
 	if (!(n = n->sib = dm_config_create_node(res.cft, "name")))
-		goto nomem_un;
+		goto nomem;
 
 	if (!(n->v = dm_config_create_value(res.cft)))
-		goto nomem_un;
+		goto nomem;
 
 	n->parent = res.cft->root;
 	n->v->type = DM_CFG_STRING;
@@ -733,9 +848,13 @@ static response vg_lookup(lvmetad_state *s, request r)
 
 	/* The metadata section */
 	if (!(n = n->sib = dm_config_clone_node(res.cft, metadata, 1)))
-		goto nomem_un;
+		goto nomem;
 	n->parent = res.cft->root;
 
+	pthread_rwlock_unlock(vg_lock);
+
+	pthread_rwlock_rdlock(&s->cache_lock);
+
 	if (!update_pv_status(s, res.cft, n))
 		goto nomem;
 	chain_outdated_pvs(s, uuid, res.cft, n);
@@ -749,9 +868,10 @@ static response vg_lookup(lvmetad_state *s, request r)
 			goto nomem;
 	}
 
+	pthread_rwlock_unlock(&s->cache_lock);
+
 	return res;
 
-nomem_un:
 nomem:
 	reply_fail("out of memory");
 	ERROR(s, "vg_lookup vgid %s name %s out of memory.", uuid ?: "none", name ?: "none");
@@ -871,7 +991,7 @@ static int remove_metadata(lvmetad_state *s, const char *vgid, int update_pvids)
 	if (info_lookup)
 		dm_free(info_lookup);
 	if (meta_lookup)
-		dm_config_destroy(meta_lookup);
+		_retire_metadata(s, vgid, meta_lookup);
 	if (name_lookup)
 		dm_free(name_lookup);
 	if (outdated_pvs_lookup)
@@ -994,7 +1114,7 @@ static int _update_metadata_new_vgid(lvmetad_state *s,
 	}
 
 	dm_hash_remove(s->vgid_to_metadata, old_vgid);
-	dm_config_destroy(old_meta);
+	_retire_metadata(s, old_vgid, old_meta);
 	old_meta = NULL;
 
 	dm_hash_remove_with_val(s->vgname_to_vgid, arg_name, old_vgid, strlen(old_vgid) + 1);
@@ -1101,7 +1221,7 @@ static int _update_metadata_new_name(lvmetad_state *s,
 	}
 
 	dm_hash_remove(s->vgid_to_metadata, arg_vgid);
-	dm_config_destroy(old_meta);
+	_retire_metadata(s, arg_vgid, old_meta);
 	old_meta = NULL;
 
 	dm_hash_remove(s->vgid_to_vgname, arg_vgid);
@@ -1222,6 +1342,9 @@ out_free:
  * this function, so they can be safely destroyed after update_metadata returns
  * (anything that might have been retained is copied).
  *
+ * new_meta, when not NULL, is the already filtered copy of new_metadata made
+ * by the caller before taking the cache_lock; it is consumed in any case.
+ *
  * When this is called from pv_found, the metadata was read from a single
  * PV specified by the pvid arg and ret_old_seq is not NULL.  The metadata
  * should match the existing metadata (matching seqno).  If the metadata
@@ -1237,11 +1360,11 @@ out_free:
  */
 
 static int _update_metadata(lvmetad_state *s, const char *arg_name, const char *arg_vgid,
-			    struct dm_config_node *new_metadata, int *ret_old_seq,
+			    struct dm_config_node *new_metadata,
+			    struct dm_config_tree *new_meta, int *ret_old_seq,
 			    const char *pvid)
 {
 	struct dm_config_tree *old_meta = NULL;
-	struct dm_config_tree *new_meta = NULL;
 	const char *arg_name_lookup; /* name lookup result from arg_vgid */
 	const char *arg_vgid_lookup; /* vgid lookup result from arg_name */
 	const char *old_name = NULL;
@@ -1259,7 +1382,7 @@ static int _update_metadata(lvmetad_state *s, const char *arg_name, const char *
 	if (!arg_vgid || !arg_name) {
 		ERROR(s, "update_metadata missing args arg_vgid %s arg_name %s pvid %s",
 		      arg_vgid ?: "none", arg_name ?: "none", pvid ?: "none");
-		return 0;
+		goto out;
 	}
 
 	DEBUGLOG(s, "update_metadata begin arg_vgid %s arg_name %s pvid %s",
@@ -1429,15 +1552,17 @@ static int _update_metadata(lvmetad_state *s, const char *arg_name, const char *
 	}
 
  update:
-	filter_metadata(new_metadata); /* sanitize */
-
 	/*
 	 * FIXME: verify that there's at least one PV in common between
 	 * the old and new metadata?
 	 */
 
-	if (!(new_meta = dm_config_create()) ||
-	    !(new_meta->root = dm_config_clone_node(new_meta, new_metadata, 0))) {
+	if (!new_meta)
+		filter_metadata(new_metadata); /* sanitize */
+
+	if (!new_meta &&
+	    (!(new_meta = dm_config_create()) ||
+	     !(new_meta->root = dm_config_clone_node(new_meta, new_metadata, 0)))) {
 		ERROR(s, "update_metadata out of memory for new metadata for %s %s",
 		      arg_name, arg_vgid);
 		/* FIXME: should we purge the old metadata here? */
@@ -1707,7 +1832,7 @@ static int _update_metadata(lvmetad_state *s, const char *arg_name, const char *
 	 */
 
 	dm_hash_remove(s->vgid_to_metadata, arg_vgid);
-	dm_config_destroy(old_meta);
+	_retire_metadata(s, arg_vgid, old_meta);
 	old_meta = NULL;
 
 	if (!dm_hash_insert(s->vgid_to_metadata, arg_vgid, new_meta)) {
@@ -2150,7 +2275,7 @@ static response pv_found(lvmetad_state *s, request r)
 	if (arg_vgmeta) {
 		DEBUGLOG(s, "pv_found pvid %s has VG %s %s seqno %d", arg_pvid, arg_name, arg_vgid, arg_seqno);
 
-		if (!_update_metadata(s, arg_name, arg_vgid, arg_vgmeta, &old_seqno, arg_pvid)) {
+		if (!_update_metadata(s, arg_name, arg_vgid, arg_vgmeta, NULL, &old_seqno, arg_pvid)) {
 			ERROR(s, "Cannot use VG metadata for %s %s from PV %s on %" PRIu64,
 			      arg_name, arg_vgid, arg_pvid, arg_device);
 		}
@@ -2278,9 +2403,14 @@ static void vg_info_update(lvmetad_state *s, const char *uuid,
 		info->flags &= ~VGFL_INVALID;
 }
 
+/*
+ * Takes the cache_lock itself, only after the new metadata has been
+ * filtered and copied, which for a large VG is most of the work.
+ */
 static response vg_update(lvmetad_state *s, request r)
 {
 	struct dm_config_node *metadata = dm_config_find_node(r.cft->root, "metadata");
+	struct dm_config_tree *new_meta;
 	const char *vgid = daemon_request_str(r, "metadata/id", NULL);
 	const char *vgname = daemon_request_str(r, "vgname", NULL);
 
@@ -2303,16 +2433,29 @@ static response vg_update(lvmetad_state *s, request r)
 			goto fail;
 		}
 
+		filter_metadata(metadata); /* sanitize */
+
+		if (!(new_meta = dm_config_create()) ||
+		    !(new_meta->root = dm_config_clone_node(new_meta, metadata, 0))) {
+			ERROR(s, "vg_update failed: out of memory for new metadata");
+			reply_fail("vg_update: out of memory");
+			goto fail;
+		}
+
 		/* TODO defer metadata update here; add a separate vg_commit
 		 * call; if client does not commit, die */
 
-		if (!_update_metadata(s, vgname, vgid, metadata, NULL, NULL)) {
+		pthread_rwlock_wrlock(&s->cache_lock);
+
+		if (!_update_metadata(s, vgname, vgid, metadata, new_meta, NULL, NULL)) {
 			ERROR(s, "vg_update failed: metadata update failed");
 			reply_fail("vg_update: failed metadata update");
 			goto fail;
 		}
 
 		vg_info_update(s, vgid, metadata);
+
+		_cache_unlock_write(s);
 	}
 	return daemon_reply_simple("OK", NULL);
 
@@ -2666,7 +2809,7 @@ static response handler(daemon_state s, client_handle h, request r)
 	int prev_in_progress, this_in_progress;
 	int update_timeout;
 	int pid;
-	int cache_lock = 0;
+	int cache_lock = 0; /* 1 read, 2 write */
 	int info_lock = 0;
 
 	rq = daemon_request_str(r, "request", "NONE");
@@ -2745,7 +2888,8 @@ static response handler(daemon_state s, client_handle h, request r)
 							   "expected = %s", state->token,
 							   "received = %s", token,
 							   "update_pid = " FMTd64, (int64_t)state->update_pid,
-							   "reason = %s", "another command has populated the cache");
+							   "reason = %s", "another command has populated the cache",
+							   NULL);
 			}
 
 			DEBUGLOG(state, "token_update end len %d pid %d new token %s",
@@ -2778,7 +2922,8 @@ static response handler(daemon_state s, client_handle h, request r)
 					   "expected = %s", state->token,
 					   "received = %s", token,
 					   "update_pid = " FMTd64, (int64_t)state->update_pid,
-					   "reason = %s", "another command has populated the cache");
+					   "reason = %s", "another command has populated the cache",
+					   NULL);
 	}
 
 	/* If a pid doing update was cancelled, ignore its update messages. */
@@ -2793,26 +2938,26 @@ static response handler(daemon_state s, client_handle h, request r)
 					   "expected = %s", state->token,
 					   "received = %s", token,
 					   "update_pid = " FMTd64, (int64_t)state->update_pid,
-					   "reason = %s", "another command has populated the lvmetad cache");
+					   "reason = %s", "another command has populated the lvmetad cache",
+					   NULL);
 	}
 
 	pthread_mutex_unlock(&state->token_lock);
 
 
+	/* vg_update and vg_lookup do their own locking. */
 	if (!strcmp(rq, "pv_found") ||
 	    !strcmp(rq, "pv_gone") ||
-	    !strcmp(rq, "vg_update") ||
 	    !strcmp(rq, "vg_remove") ||
 	    !strcmp(rq, "set_vg_info") ||
 	    !strcmp(rq, "pv_clear_all") ||
 	    !strcmp(rq, "vg_clear_outdated_pvs")) {
 		pthread_rwlock_wrlock(&state->cache_lock);
-		cache_lock = 1;
+		cache_lock = 2;
 		goto do_rq;
 	}
 
 	if (!strcmp(rq, "pv_lookup") ||
-	    !strcmp(rq, "vg_lookup") ||
 	    !strcmp(rq, "pv_list") ||
 	    !strcmp(rq, "vg_list") ||
 	    !strcmp(rq, "dump")) {
@@ -2875,7 +3020,9 @@ static response handler(daemon_state s, client_handle h, request r)
 	else
 		res = reply_fail("request not implemented");
 
-	if (cache_lock)
+	if (cache_lock == 2)
+		_cache_unlock_write(state);
+	else if (cache_lock)
 		pthread_rwlock_unlock(&state->cache_lock);
 	if (info_lock)
 		pthread_mutex_unlock(&state->info_lock);
@@ -2886,11 +3033,15 @@ static response handler(daemon_state s, client_handle h, request r)
 static int init(daemon_state *s)
 {
 	lvmetad_state *ls = s->private;
+	unsigned i;
 	ls->log = s->log;
 
 	pthread_mutex_init(&ls->token_lock, NULL);
 	pthread_mutex_init(&ls->info_lock, NULL);
 	pthread_rwlock_init(&ls->cache_lock, NULL);
+	for (i = 0; i < VG_LOCK_SHARDS; i++)
+		pthread_rwlock_init(&ls->vg_lock[i], NULL);
+	dm_list_init(&ls->retired_metadata);
 	create_metadata_hashes(ls);
 
 	ls->token[0] = 0;
@@ -2918,6 +3069,7 @@ static int fini(daemon_state *s)
 
 	DEBUGLOG(s, "fini");
 	destroy_metadata_hashes(ls);
+	_destroy_retired(&ls->retired_metadata);
 	return 1;
 }
 
@@ -2939,19 +3091,21 @@ static int process_timeout_arg(const char *str, unsigned *max_timeouts)
 static void usage(const char *prog, FILE *file)
 {
 	fprintf(file, "Usage:\n"
-		"%s [-V] [-h] [-f] [-l level[,level ...]] [-s path] [-t secs]\n\n"
+		"%s [-V] [-h] [-f] [-l level[,level ...]] [-s path] [-t secs] [-w threads]\n\n"
 		"   -V       Show version of lvmetad\n"
 		"   -h       Show this help information\n"
 		"   -f       Don't fork, run in the foreground\n"
 		"   -l       Logging message levels (all,fatal,error,warn,info,wire,debug)\n"
 		"   -p       Set path to the pidfile\n"
 		"   -s       Set path to the socket to listen on\n"
-		"   -t       Time to wait in seconds before shutdown on idle (missing or 0 = inifinite)\n\n", prog);
+		"   -t       Time to wait in seconds before shutdown on idle (missing or 0 = inifinite)\n"
+		"   -w       Serve clients with a pool of worker threads (missing or 0 = thread per client)\n\n", prog);
 }
 
 int main(int argc, char *argv[])
 {
 	signed char opt;
+	unsigned workers;
 	struct timeval timeout;
 	daemon_idle di = { .ptimeout = &timeout };
 	lvmetad_state ls = { .log_config = "" };
@@ -2968,7 +3122,7 @@ int main(int argc, char *argv[])
 	};
 
 	// use getopt_long
-	while ((opt = getopt(argc, argv, "?fhVl:p:s:t:")) != EOF) {
+	while ((opt = getopt(argc, argv, "?fhVl:p:s:t:w:")) != EOF) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0], stdout);
@@ -2997,6 +3151,13 @@ int main(int argc, char *argv[])
 			if (di.max_timeouts)
 				s.idle = ls.idle = &di;
 			break;
+		case 'w':
+			if (!process_timeout_arg(optarg, &workers) || workers > 1024) {
+				fprintf(stderr, "Invalid number of worker threads.\n");
+				exit(EXIT_FAILURE);
+			}
+			s.worker_threads = (int) workers;
+			break;
 		case 'V':
 			printf("lvmetad version: " LVM_VERSION "\n");
 			exit(1);
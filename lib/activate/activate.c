@@ -307,6 +307,10 @@ int lv_thin_device_id(const struct logical_volume *lv, uint32_t *device_id)
 {
 	return 0;
 }
+int lv_thin_pool_time_to_full(const struct logical_volume *lv, uint64_t *seconds)
+{
+	return 0;
+}
 int lvs_in_vg_activated(const struct volume_group *vg)
 {
 	return 0;
@@ -1657,6 +1661,45 @@ int target_register_events(struct cmd_context *cmd, const char *dso, const struc
 
 #endif
 
+/*
+ * Returns 1 if seconds has been set to the time the thin pool plugin
+ * of dmeventd projects until the pool fills up, else 0.
+ */
+int lv_thin_pool_time_to_full(const struct logical_volume *lv, uint64_t *seconds)
+{
+#ifdef DMEVENTD
+	struct cmd_context *cmd = lv->vg->cmd;
+	struct dm_event_handler *dmevh;
+	const char *dso, *value;
+	char *uuid, *info = NULL;
+	int r = 0;
+
+	if (!lv_is_thin_pool(lv) || (dmeventd_monitor_mode() != 1) ||
+	    !lv_info(cmd, lv, 1, NULL, 0, 0))
+		return 0;
+
+	if (!(dso = get_monitor_dso_path(cmd, find_config_tree_str(cmd, dmeventd_thin_library_CFG, NULL))) ||
+	    !(uuid = _build_target_uuid(cmd, lv)))
+		return_0;
+
+	if (!(dmevh = _create_dm_event_handler(cmd, uuid, dso, 0, DM_EVENT_ALL_ERRORS)))
+		return_0;
+
+	/* Not monitored, no dmeventd or no projection yet is not an error */
+	if (!dm_event_get_device_info(dmevh, &info) &&
+	    (value = strstr(info, "time_to_full=")) &&
+	    (sscanf(value + 13, FMTu64, seconds) == 1))
+		r = 1;
+
+	dm_free(info);
+	dm_event_handler_destroy(dmevh);
+
+	return r;
+#else
+	return 0;
+#endif
+}
+
 /*
  * Returns 0 if an attempt to (un)monitor the device failed.
  * Returns 1 otherwise.
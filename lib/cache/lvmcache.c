@@ -174,7 +174,7 @@ static void _store_metadata(struct volume_group *vg, unsigned precommitted)
 		return;
 	}
 
-	if (!(size = export_vg_to_buffer(vg, &data))) {
+	if (!(size = export_vg_written_to_buffer(vg, &data))) {
 		stack;
 		_free_cached_vgmetadata(vginfo);
 		return;
@@ -285,6 +285,9 @@ void lvmcache_commit_metadata(const char *vgname)
 {
 	struct lvmcache_vginfo *vginfo;
 
+	/* The metadata on disk changed under any blocks still cached */
+	dev_drop_cached_blocks();
+
 	if (!(vginfo = lvmcache_vginfo_from_vgname(vgname, NULL)))
 		return;
 
@@ -297,6 +300,9 @@ void lvmcache_commit_metadata(const char *vgname)
 
 void lvmcache_drop_metadata(const char *vgname, int drop_precommitted)
 {
+	/* Blocks cached before a remote change, e.g. clvmd, are stale too */
+	dev_drop_cached_blocks();
+
 	if (lvmcache_vgname_is_locked(VG_GLOBAL))
 		return;
 
@@ -420,6 +426,7 @@ void lvmcache_unlock_vgname(const char *vgname)
 	if (strcmp(vgname, VG_GLOBAL) && !--_vgs_locked) {
 		dev_close_all();
 		dev_size_seqno_inc(); /* invalidate all cached dev sizes */
+		dev_drop_cached_blocks();
 	}
 }
 
@@ -1099,6 +1106,7 @@ int lvmcache_label_scan(struct cmd_context *cmd)
 {
 	struct dm_list del_cache_devs;
 	struct dm_list add_cache_devs;
+	struct dm_list scan_devs;
 	struct lvmcache_info *info;
 	struct device_list *devl;
 	struct label *label;
@@ -1143,12 +1151,26 @@ int lvmcache_label_scan(struct cmd_context *cmd)
 	 */
 	_destroy_duplicate_device_list(&_found_duplicate_devs);
 
-	while ((dev = dev_iter_get(iter))) {
-		(void) label_read(dev, &label, UINT64_C(0));
-		dev_count++;
-	}
+	if (find_config_tree_bool(cmd, devices_async_label_scan_CFG, NULL)) {
+		dm_list_init(&scan_devs);
+
+		if (!dev_iter_get_list(iter, cmd->mem, &scan_devs)) {
+			dev_iter_destroy(iter);
+			goto_out;
+		}
 
-	dev_iter_destroy(iter);
+		dev_iter_destroy(iter);
+
+		dev_count = dm_list_size(&scan_devs);
+		label_read_devs(&scan_devs);
+	} else {
+		while ((dev = dev_iter_get(iter))) {
+			(void) label_read(dev, &label, UINT64_C(0));
+			dev_count++;
+		}
+
+		dev_iter_destroy(iter);
+	}
 
 	log_very_verbose("Scanned %d device labels", dev_count);
 
@@ -1231,7 +1231,7 @@ int lvmetad_vg_update_finish(struct volume_group *vg)
 
 	vgu = vg->vg_committed ? vg->vg_committed : vg;
 
-	if (!(vgmeta = export_vg_to_config_tree(vgu))) {
+	if (!(vgmeta = export_vg_written_to_config_tree(vgu))) {
 		log_error("Failed to export VG to config tree.");
 		return 0;
 	}
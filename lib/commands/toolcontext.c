@@ -968,6 +968,33 @@ static void _destroy_config(struct cmd_context *cmd)
 			  "cmd config tree not destroyed fully");
 }
 
+/*
+ * The device index is kept next to the persistent filter cache file,
+ * replacing its .cache suffix with .devindex.
+ */
+static int _init_dev_cache_index(struct cmd_context *cmd)
+{
+	char index_file[PATH_MAX];
+	const char *dev_cache;
+	size_t len;
+
+	if (!(dev_cache = find_config_tree_str(cmd, devices_cache_CFG, NULL)))
+		return_0;
+
+	len = strlen(dev_cache);
+	if (len > 6 && !strcmp(dev_cache + len - 6, ".cache"))
+		len -= 6;
+
+	if (dm_snprintf(index_file, sizeof(index_file), "%.*s.devindex",
+			(int) len, dev_cache) < 0) {
+		log_error("Device index filename too long.");
+		return 0;
+	}
+
+	return dev_cache_set_index_file(index_file,
+					find_config_tree_bool(cmd, devices_write_cache_state_CFG, NULL));
+}
+
 static int _init_dev_cache(struct cmd_context *cmd)
 {
 	const struct dm_config_node *cn;
@@ -1035,6 +1062,11 @@ static int _init_dev_cache(struct cmd_context *cmd)
 		}
 	}
 
+	if (*cmd->system_dir &&
+	    find_config_tree_bool(cmd, devices_device_index_CFG, NULL) &&
+	    !_init_dev_cache_index(cmd))
+		return_0;
+
 	if (!(cn = find_config_tree_array(cmd, devices_loopfiles_CFG, NULL)))
 		return 1;
 
@@ -269,6 +269,9 @@ struct dm_config_tree *config_file_open_and_read(const char *config_file,
 		return NULL;
 	}
 
+	/* Settings are looked up by path for the rest of the command */
+	dm_config_tree_set_indexed(cft, 1);
+
 	/* Is there a config file? */
 	if (stat(config_file, &info) == -1) {
 		/* Profile file must be present! */
@@ -527,7 +530,15 @@ int config_file_read_fd(struct dm_config_tree *cft, struct device *dev,
 		}
 		fb = fb + mmap_offset;
 	} else {
-		if (!(buf = dm_malloc(size + size2))) {
+		/*
+		 * A buffer that is going to be parsed is kept by the tree
+		 * so strings need not be copied out of it.
+		 */
+		if (!checksum_only)
+			buf = dm_pool_alloc(cft->mem, size + size2 + 1);
+		else
+			buf = dm_malloc(size + size2);
+		if (!buf) {
 			log_error("Failed to allocate circular buffer.");
 			return 0;
 		}
@@ -547,16 +558,20 @@ int config_file_read_fd(struct dm_config_tree *cft, struct device *dev,
 
 	if (!checksum_only) {
 		fe = fb + size + size2;
-		if (!dm_config_parse(cft, fb, fe))
+		if (buf) {
+			if (!dm_config_parse_in_place(cft, fb, fe))
+				goto_out;
+		} else if (!dm_config_parse(cft, fb, fe))
 			goto_out;
 	}
 
 	r = 1;
 
       out:
-	if (!use_mmap)
-		dm_free(buf);
-	else {
+	if (!use_mmap) {
+		if (checksum_only)
+			dm_free(buf);
+	} else {
 		/* unmap the file */
 		if (munmap(fb - mmap_offset, size + mmap_offset)) {
 			log_sys_error("munmap", dev_name(dev));
@@ -567,6 +582,38 @@ int config_file_read_fd(struct dm_config_tree *cft, struct device *dev,
 	return r;
 }
 
+/*
+ * As config_file_read_fd() but for content the caller already read.
+ */
+int config_file_read_buf(struct dm_config_tree *cft, const char *buf, size_t size,
+			 checksum_fn_t checksum_fn, uint32_t checksum,
+			 int checksum_only)
+{
+	char *fb;
+
+	if (checksum_fn && checksum !=
+	    checksum_fn(INITIAL_CRC, (const uint8_t *)buf, size)) {
+		log_error("Checksum error in config buffer.");
+		return 0;
+	}
+
+	if (checksum_only)
+		return 1;
+
+	/* Parsed in place like config_file_read_fd() does */
+	if (!(fb = dm_pool_alloc(cft->mem, size + 1))) {
+		log_error("Failed to allocate config buffer.");
+		return 0;
+	}
+
+	memcpy(fb, buf, size);
+
+	if (!dm_config_parse_in_place(cft, fb, fb + size))
+		return_0;
+
+	return 1;
+}
+
 int config_file_read(struct dm_config_tree *cft)
 {
 	const char *filename = NULL;
@@ -1584,6 +1631,10 @@ int merge_config_tree(struct cmd_context *cmd, struct dm_config_tree *cft,
 	const struct dm_config_node *tn;
 	struct config_source *cs, *csn;
 
+	/* Nodes of both trees get relinked behind their indexes */
+	dm_config_tree_set_indexed(cft, 1);
+	dm_config_tree_set_indexed(newdata, 0);
+
 	for (cn = newdata->root; cn; cn = nextn) {
 		nextn = cn->sib;
 		if (merge_type == CONFIG_MERGE_TYPE_TAGS) {
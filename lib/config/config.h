@@ -240,6 +240,9 @@ int config_file_read_fd(struct dm_config_tree *cft, struct device *dev,
 			off_t offset, size_t size, off_t offset2, size_t size2,
 			checksum_fn_t checksum_fn, uint32_t checksum,
 			int skip_parse);
+int config_file_read_buf(struct dm_config_tree *cft, const char *buf, size_t size,
+			 checksum_fn_t checksum_fn, uint32_t checksum,
+			 int skip_parse);
 int config_file_read(struct dm_config_tree *cft);
 struct dm_config_tree *config_file_open_and_read(const char *config_file, config_source_t source,
 						 struct cmd_context *cmd);
@@ -287,6 +287,14 @@ cfg(devices_cache_file_prefix_CFG, "cache_file_prefix", devices_CFG_SECTION, CFG
 cfg(devices_write_cache_state_CFG, "write_cache_state", devices_CFG_SECTION, 0, CFG_TYPE_BOOL, 1, vsn(1, 0, 0), NULL, 0, NULL,
 	"Enable/disable writing the cache file. See devices/cache_dir.\n")
 
+cfg(devices_device_index_CFG, "device_index", devices_CFG_SECTION, 0, CFG_TYPE_BOOL, DEFAULT_DEVICE_INDEX, vsn(2, 2, 165), NULL, 0, NULL,
+	"Keep a persistent index of the devices found in devices/scan.\n"
+	"The list of devices found when scanning is saved in a file named\n"
+	".devindex in devices/cache_dir and reused by later commands\n"
+	"instead of scanning the directories again. Only directories that\n"
+	"changed since the index was written are scanned again. The index\n"
+	"is not written if devices/write_cache_state is disabled.\n")
+
 cfg_array(devices_types_CFG, "types", devices_CFG_SECTION, CFG_DEFAULT_UNDEFINED | CFG_ADVANCED, CFG_TYPE_INT | CFG_TYPE_STRING, NULL, vsn(1, 0, 0), NULL, 0, NULL,
 	"List of additional acceptable block device types.\n"
 	"These are of device type names from /proc/devices, followed by the\n"
@@ -301,6 +309,16 @@ cfg(devices_sysfs_scan_CFG, "sysfs_scan", devices_CFG_SECTION, 0, CFG_TYPE_BOOL,
 	"This is a quick way of filtering out block devices that are not\n"
 	"present on the system. sysfs must be part of the kernel and mounted.)\n")
 
+cfg(devices_async_label_scan_CFG, "async_label_scan", devices_CFG_SECTION, 0, CFG_TYPE_BOOL, DEFAULT_ASYNC_LABEL_SCAN, vsn(2, 2, 165), NULL, 0, NULL,
+	"Read device labels in batches using asynchronous io.\n"
+	"When scanning, the label areas of many devices are read together\n"
+	"rather than one device at a time, which greatly reduces scanning\n"
+	"time on systems with many devices or high latency storage.\n"
+	"Device filters are also applied to all devices together so that\n"
+	"the data read by the partition and md component filters is read\n"
+	"in the same way.\n"
+	"If asynchronous io is not available, devices are read one by one.\n")
+
 cfg(devices_multipath_component_detection_CFG, "multipath_component_detection", devices_CFG_SECTION, 0, CFG_TYPE_BOOL, DEFAULT_MULTIPATH_COMPONENT_DETECTION, vsn(2, 2, 89), NULL, 0, NULL,
 	"Ignore devices that are components of DM multipath devices.\n")
 
@@ -924,6 +942,16 @@ cfg(global_lvmetad_update_wait_time_CFG, "lvmetad_update_wait_time", global_CFG_
 	"After waiting for this period, a command will not use lvmetad, and\n"
 	"will revert to disk scanning.\n")
 
+cfg(global_metadata_read_ahead_CFG, "metadata_read_ahead", global_CFG_SECTION, CFG_DEFAULT_COMMENTED, CFG_TYPE_INT, DEFAULT_METADATA_READ_AHEAD, vsn(2, 2, 165), NULL, 0, NULL,
+	"Read the metadata of this many VGs together when processing VGs.\n"
+	"Commands that process many VGs, such as vgs and lvs, otherwise read\n"
+	"each VG from disk only once they hold its lock, so their latency is\n"
+	"the sum of all the VG reads. With this set, the metadata of the next\n"
+	"VGs to process is read with asynchronous io in one batch. Each VG is\n"
+	"still locked and processed in turn, and uses what was read ahead only\n"
+	"if the metadata area header it reads under the lock still points to\n"
+	"the same metadata. Not used with lvmetad. Set to 0 to disable.\n")
+
 cfg(global_use_lvmlockd_CFG, "use_lvmlockd", global_CFG_SECTION, 0, CFG_TYPE_BOOL, 0, vsn(2, 2, 124), NULL, 0, NULL,
 	"Use lvmlockd for locking among hosts using LVM on shared storage.\n"
 	"Applicable only if LVM is compiled with lockd support in which\n"
@@ -1361,6 +1389,15 @@ cfg(activation_thin_pool_autoextend_percent_CFG, "thin_pool_autoextend_percent",
 	"thin_pool_autoextend_percent = 20\n"
 	"#\n")
 
+cfg(activation_thin_pool_autoextend_horizon_CFG, "thin_pool_autoextend_horizon", activation_CFG_SECTION, 0, CFG_TYPE_INT, DEFAULT_THIN_POOL_AUTOEXTEND_HORIZON, vsn(2, 2, 165), NULL, 0, NULL,
+	"Extend a thin pool early when it is projected to fill up soon.\n"
+	"dmeventd keeps a short history of thin pool usage and projects\n"
+	"when the pool will reach thin_pool_autoextend_threshold at the\n"
+	"current fill rate. When that is less than this many seconds away,\n"
+	"the pool is extended by thin_pool_autoextend_percent right away\n"
+	"instead of waiting for the threshold to be crossed. Has no effect\n"
+	"while autoextend is disabled. Set to 0 to disable early extension.\n")
+
 cfg_array(activation_mlock_filter_CFG, "mlock_filter", activation_CFG_SECTION, CFG_DEFAULT_UNDEFINED | CFG_ADVANCED, CFG_TYPE_STRING, NULL, vsn(2, 2, 62), NULL, 0, NULL,
 	"Do not mlock these memory areas.\n"
 	"While activating devices, I/O to devices being (re)configured is\n"
@@ -19,6 +19,7 @@
 #include "toolcontext.h"
 #include "dm-ioctl.h" /* for DM_UUID_LEN */
 #include "lvm-string.h" /* for LVM's UUID_PREFIX */
+#include "lvm-file.h"
 
 #ifdef UDEV_SYNC_SUPPORT
 #include <libudev.h>
@@ -26,6 +27,7 @@
 #include <unistd.h>
 #include <sys/param.h>
 #include <dirent.h>
+#include <time.h>
 
 struct dev_iter {
 	struct btree_iter *current;
@@ -46,6 +48,10 @@ static struct {
 	struct btree *devices;
 	struct dm_regex *preferred_names_matcher;
 	const char *dev_dir;
+	const char *index_file;
+	int index_write;
+	/* Directories whose devices are in or go into the index */
+	struct dm_hash_table *index_dirs;
 
 	int has_scanned;
 	struct dm_list dirs;
@@ -762,6 +768,9 @@ static int _insert_dir(const char *dir)
 	struct dirent **dirent;
 	char *path;
 
+	if (_cache.index_dirs && !dm_hash_insert(_cache.index_dirs, dir, (void *) 1))
+		return_0;
+
 	dirent_count = scandir(dir, &dirent, NULL, alphasort);
 	if (dirent_count > 0) {
 		for (n = 0; n < dirent_count; n++) {
@@ -1053,7 +1062,9 @@ static int _insert(const char *path, const struct stat *info,
 			return 1;
 		}
 
-		if (rec && !_insert_dir(path))
+		/* Devices of an unchanged directory came from the index */
+		if (rec && !(_cache.index_dirs && dm_hash_lookup(_cache.index_dirs, path)) &&
+		    !_insert_dir(path))
 			return_0;
 	} else {		/* add a device */
 		if (!S_ISBLK(info->st_mode)) {
@@ -1068,14 +1079,349 @@ static int _insert(const char *path, const struct stat *info,
 	return 1;
 }
 
+/*
+ * Persistent device index.
+ *
+ * The list of block devices found under the scan directories is
+ * saved in index_file together with the ctime of every directory
+ * walked or holding a device.  A later scan takes the devices of each
+ * unchanged directory from the index and walks only the directories
+ * that changed.  Adding, removing or renaming a device node or link
+ * changes the ctime of its directory, so other devices stay indexed
+ * whatever uevents are generated for them.
+ *
+ * Devices listed from the udev database are not walked by directory:
+ * any changed directory makes that list be read from udev again.
+ *
+ * The holders of each device read from sysfs by dev_cache_index_devs()
+ * change with table reloads that leave all directories untouched, so
+ * they are not part of the index.
+ */
+#define DEV_INDEX_VERSION 2
+
+/* ctime this close to now could still be shared with a later change */
+#define DEV_INDEX_RACY_SECONDS 2
+
+/* Returns -1 for an invalid entry */
+static int _index_dir_matches(const char *str, const char **dir)
+{
+	struct timespec ts, ts_now;
+	struct stat info;
+	long sec, nsec;
+	int pos;
+
+	if (sscanf(str, "%ld.%ld:%n", &sec, &nsec, &pos) != 2)
+		return -1;
+
+	*dir = str + pos;
+
+	if (stat(*dir, &info)) {
+		log_debug_devs("%s: Device index directory missing.", *dir);
+		return 0;
+	}
+
+	ts.tv_sec = sec;
+	ts.tv_nsec = nsec;
+	lvm_stat_ctim(&ts_now, &info);
+
+	if (timespeccmp(&ts, &ts_now, !=)) {
+		log_debug_devs("%s: Directory changed since device index was written.",
+			       *dir);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Take devices of unchanged directories from the index and walk the
+ * changed ones.  Returns 0 if the index cannot be used at all, and
+ * sets *changed if it needs to be written again.
+ */
+static int _load_index(int *changed)
+{
+	struct dm_config_tree *cft;
+	const struct dm_config_node *cn;
+	const struct dm_config_value *cv;
+	struct dm_str_list *sl;
+	struct dm_list walk;
+	struct dir_list *dl;
+	struct stat info;
+	const char *dir;
+	char path[PATH_MAX], *slash;
+	unsigned major, minor;
+	int pos, m, r = 0;
+
+	*changed = 0;
+	dm_list_init(&walk);
+
+	if (stat(_cache.index_file, &info))
+		return 0;
+
+	if (!(cft = config_open(CONFIG_FILE_SPECIAL, _cache.index_file, 1)))
+		return_0;
+
+	if (!config_file_read(cft))
+		goto_out;
+
+	if (dm_config_find_int(cft->root, "device_index/version", 0) != DEV_INDEX_VERSION ||
+	    dm_config_find_int(cft->root, "device_index/udev", -1) != obtain_device_list_from_udev())
+		goto out;
+
+	/* Scan directories must be the same and in the same order */
+	cv = (cn = dm_config_find_node(cft->root, "device_index/scan")) ? cn->v : NULL;
+	dm_list_iterate_items(dl, &_cache.dirs) {
+		if (!cv || cv->type != DM_CFG_STRING || strcmp(cv->v.str, dl->dir))
+			goto out;
+		cv = cv->next;
+	}
+	if (cv)
+		goto out;
+
+	if (!(cn = dm_config_find_node(cft->root, "device_index/dirs")))
+		goto out;
+	for (cv = cn->v; cv; cv = cv->next) {
+		if (cv->type != DM_CFG_STRING ||
+		    (m = _index_dir_matches(cv->v.str, &dir)) < 0)
+			goto out;
+		if (m) {
+			if (!dm_hash_insert(_cache.index_dirs, dir, (void *) 1))
+				goto_out;
+			continue;
+		}
+		if (obtain_device_list_from_udev())
+			goto out;
+		/* Walked below, once all unchanged directories are known */
+		if (!(sl = dm_pool_alloc(cft->mem, sizeof(*sl))))
+			goto_out;
+		sl->str = dir;
+		dm_list_add(&walk, &sl->list);
+	}
+
+	if (!(cn = dm_config_find_node(cft->root, "device_index/devices")))
+		goto out;
+	for (cv = cn->v; cv; cv = cv->next) {
+		if (cv->type != DM_CFG_STRING ||
+		    sscanf(cv->v.str, "%u:%u:%n", &major, &minor, &pos) != 2 ||
+		    !dm_strncpy(path, cv->v.str + pos, sizeof(path))) {
+			log_debug_devs("Invalid entry in device index %s.", _cache.index_file);
+			goto out;
+		}
+		if ((slash = strrchr(path, '/')))
+			*slash = '\0';
+		if (!slash || !dm_hash_lookup(_cache.index_dirs, path))
+			continue;
+		if (!_insert_dev(cv->v.str + pos, MKDEV((dev_t)major, (dev_t)minor)))
+			goto_out;
+	}
+
+	dm_list_iterate_items(sl, &walk) {
+		if (stat(sl->str, &info) || !S_ISDIR(info.st_mode)) {
+			log_debug_devs("%s: Device index directory gone.", sl->str);
+			*changed = 1;
+			continue;
+		}
+		if (!_insert_dir(sl->str))
+			log_debug_devs("%s: Failed to insert devices to "
+				       "device cache fully", sl->str);
+		*changed = 1;
+	}
+
+	log_very_verbose("Loaded device list from index %s%s", _cache.index_file,
+			 *changed ? " and changed directories" : "");
+	r = 1;
+out:
+	config_destroy(cft);
+
+	return r;
+}
+
+/* Returns -1 if the directory changed too recently to be trusted */
+static int _write_index_dir(FILE *fp, struct dm_hash_table *seen,
+			    const char *dir, int *first)
+{
+	char buf[2 * PATH_MAX];
+	struct stat info;
+	struct timespec ts;
+
+	if (dm_hash_lookup(seen, dir))
+		return 1;
+
+	if (!dm_hash_insert(seen, dir, (void *) 1))
+		return_0;
+
+	if (stat(dir, &info)) {
+		log_sys_debug("stat", dir);
+		return 0;
+	}
+
+	lvm_stat_ctim(&ts, &info);
+	if (ts.tv_sec + DEV_INDEX_RACY_SECONDS > time(NULL)) {
+		log_debug_devs("%s: Directory changed just now - not writing device index.",
+			       dir);
+		return -1;
+	}
+
+	dm_escape_double_quotes(buf, dir);
+	fprintf(fp, "%s\t\t\"%ld.%09ld:%s\"", *first ? "" : ",\n",
+		(long) ts.tv_sec, (long) ts.tv_nsec, buf);
+	*first = 0;
+
+	return 1;
+}
+
+static int _write_index(void)
+{
+	char path[PATH_MAX], buf[2 * PATH_MAX];
+	struct dm_hash_table *seen = NULL;
+	struct dm_hash_node *n;
+	struct device *dev;
+	struct dir_list *dl;
+	const char *name;
+	char *tmp_file, *slash;
+	FILE *fp;
+	int lockfd, first, w = 0;
+	int r = 0;
+
+	if (!udev_is_settled()) {
+		log_debug_devs("Udev events pending - not writing device index.");
+		return 1;
+	}
+
+	if ((lockfd = fcntl_lock_file(_cache.index_file, F_WRLCK, 0)) < 0)
+		return_0;
+
+	tmp_file = alloca(strlen(_cache.index_file) + 5);
+	sprintf(tmp_file, "%s.tmp", _cache.index_file);
+
+	if (!(fp = fopen(tmp_file, "w"))) {
+		/* EACCES has been reported over NFS */
+		if (errno != EROFS && errno != EACCES)
+			log_sys_error("fopen", tmp_file);
+		goto out;
+	}
+
+	if (!(seen = dm_hash_create(32)))
+		goto_bad;
+
+	fprintf(fp, "# This file is automatically maintained by lvm.\n\n");
+	fprintf(fp, "device_index {\n");
+	fprintf(fp, "\tversion = %d\n", DEV_INDEX_VERSION);
+	fprintf(fp, "\tudev = %d\n", obtain_device_list_from_udev());
+
+	fprintf(fp, "\tscan = [\n");
+	first = 1;
+	dm_list_iterate_items(dl, &_cache.dirs) {
+		dm_escape_double_quotes(buf, dl->dir);
+		fprintf(fp, "%s\t\t\"%s\"", first ? "" : ",\n", buf);
+		first = 0;
+	}
+	fprintf(fp, "\n\t]\n");
+
+	fprintf(fp, "\tdirs = [\n");
+	first = 1;
+	dm_list_iterate_items(dl, &_cache.dirs)
+		if ((w = _write_index_dir(fp, seen, dl->dir, &first)) <= 0)
+			goto bad;
+
+	/* Every directory walked, including those without devices */
+	for (n = dm_hash_get_first(_cache.index_dirs); n;
+	     n = dm_hash_get_next(_cache.index_dirs, n))
+		if ((w = _write_index_dir(fp, seen, dm_hash_get_key(_cache.index_dirs, n),
+					  &first)) <= 0)
+			goto bad;
+
+	/* Directories of devices listed from udev, up to a scan directory */
+	for (n = dm_hash_get_first(_cache.names); n;
+	     n = dm_hash_get_next(_cache.names, n)) {
+		dev = dm_hash_get_data(_cache.names, n);
+		if (dev->flags & DEV_REGULAR)
+			continue;
+		name = dm_hash_get_key(_cache.names, n);
+		if (!dm_strncpy(path, name, sizeof(path)))
+			goto_bad;
+		while ((slash = strrchr(path, '/')) && slash != path) {
+			*slash = '\0';
+			if (dm_hash_lookup(seen, path))
+				break;
+			if ((w = _write_index_dir(fp, seen, path, &first)) <= 0)
+				goto bad;
+		}
+	}
+	fprintf(fp, "\n\t]\n");
+
+	fprintf(fp, "\tdevices = [\n");
+	first = 1;
+	for (n = dm_hash_get_first(_cache.names); n;
+	     n = dm_hash_get_next(_cache.names, n)) {
+		dev = dm_hash_get_data(_cache.names, n);
+		if (dev->flags & DEV_REGULAR)
+			continue;
+		dm_escape_double_quotes(buf, dm_hash_get_key(_cache.names, n));
+		fprintf(fp, "%s\t\t\"%d:%d:%s\"", first ? "" : ",\n",
+			(int) MAJOR(dev->dev), (int) MINOR(dev->dev), buf);
+		first = 0;
+	}
+	fprintf(fp, "\n\t]\n}\n");
+
+	if (lvm_fclose(fp, tmp_file))
+		goto_out;
+
+	if (rename(tmp_file, _cache.index_file))
+		log_error("%s: rename to %s failed: %s", tmp_file,
+			  _cache.index_file, strerror(errno));
+	else {
+		log_very_verbose("Wrote device index %s", _cache.index_file);
+		r = 1;
+	}
+
+	goto out;
+bad:
+	if (fclose(fp))
+		log_sys_debug("fclose", tmp_file);
+	if (unlink(tmp_file))
+		log_sys_debug("unlink", tmp_file);
+	/* Too recent a change is not a failure, the next scan writes it */
+	if (w < 0)
+		r = 1;
+out:
+	if (seen)
+		dm_hash_destroy(seen);
+	fcntl_unlock_file(lockfd);
+
+	return r;
+}
+
 static void _full_scan(int dev_scan)
 {
 	struct dir_list *dl;
+	int changed = 0;
 
 	if (_cache.has_scanned && !dev_scan)
 		return;
 
-	_insert_dirs(&_cache.dirs);
+	if (_cache.index_file) {
+		if (_cache.index_dirs)
+			dm_hash_destroy(_cache.index_dirs);
+		if (!(_cache.index_dirs = dm_hash_create(32)))
+			stack;
+	}
+
+	if (!_cache.index_dirs)
+		_insert_dirs(&_cache.dirs);
+	else if (!_load_index(&changed)) {
+		/* Nothing taken from an unusable index */
+		dm_hash_destroy(_cache.index_dirs);
+		if (!(_cache.index_dirs = dm_hash_create(32)))
+			stack;
+		_insert_dirs(&_cache.dirs);
+		changed = 1;
+	}
+
+	if (_cache.index_dirs && changed && _cache.index_write &&
+	    !_write_index())
+		log_debug_devs("Failed to write device index %s.",
+			       _cache.index_file);
 
 	(void) dev_cache_index_devs();
 
@@ -1162,6 +1508,7 @@ out:
 int dev_cache_init(struct cmd_context *cmd)
 {
 	_cache.names = NULL;
+	_cache.index_file = NULL;
 	_cache.has_scanned = 0;
 
 	if (!(_cache.mem = dm_pool_create("dev_cache", 10 * 1024)))
@@ -1242,6 +1589,9 @@ int dev_cache_exit(void)
 		if ((num_open = _check_for_open_devices(1)) > 0)
 			log_error(INTERNAL_ERROR "%d device(s) were left open and have been closed.", num_open);
 
+	/* Cached blocks refer to the devices freed below */
+	dev_drop_cached_blocks();
+
 	if (_cache.mem)
 		dm_pool_destroy(_cache.mem);
 
@@ -1254,6 +1604,9 @@ int dev_cache_exit(void)
 	if (_cache.lvid_index)
 		dm_hash_destroy(_cache.lvid_index);
 
+	if (_cache.index_dirs)
+		dm_hash_destroy(_cache.index_dirs);
+
 	memset(&_cache, 0, sizeof(_cache));
 
 	return (!num_open);
@@ -1285,6 +1638,18 @@ int dev_cache_add_dir(const char *path)
 	return 1;
 }
 
+int dev_cache_set_index_file(const char *path, int write)
+{
+	if (!(_cache.index_file = _strdup(path))) {
+		log_error("Failed to allocate device index file name.");
+		return 0;
+	}
+
+	_cache.index_write = write;
+
+	return 1;
+}
+
 int dev_cache_add_loopfile(const char *path)
 {
 	struct dir_list *dl;
@@ -1517,6 +1882,77 @@ struct device *dev_iter_get(struct dev_iter *iter)
 	return NULL;
 }
 
+void dev_filter_batch(struct dev_filter *f, struct device **devs,
+		      char *passes, unsigned count)
+{
+	unsigned i;
+
+	if (f->passes_filter_batch) {
+		f->passes_filter_batch(f, devs, passes, count);
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		if (passes[i] && !f->passes_filter(f, devs[i]))
+			passes[i] = 0;
+}
+
+/*
+ * Add all remaining devices that pass the filter to devs.
+ * Unlike dev_iter_get(), the filter is applied to all the devices
+ * together, so filters can batch the device io they need.
+ */
+int dev_iter_get_list(struct dev_iter *iter, struct dm_pool *mem,
+		      struct dm_list *devs)
+{
+	struct btree_iter *current;
+	struct device_list *devl;
+	struct device **candidates;
+	char *passes;
+	unsigned count = 0, i;
+	int r = 0;
+
+	for (current = iter->current; current; current = btree_next(current))
+		count++;
+
+	if (!count)
+		return 1;
+
+	if (!(candidates = dm_malloc(count * sizeof(*candidates))))
+		return_0;
+
+	if (!(passes = dm_malloc(count))) {
+		dm_free(candidates);
+		return_0;
+	}
+
+	/* Regular files bypass the filter as in dev_iter_get(). */
+	for (i = 0; i < count; i++) {
+		candidates[i] = _iter_next(iter);
+		passes[i] = (candidates[i]->flags & DEV_REGULAR) ? 0 : 1;
+	}
+
+	if (iter->filter)
+		dev_filter_batch(iter->filter, candidates, passes, count);
+
+	for (i = 0; i < count; i++) {
+		if (!passes[i] && iter->filter && !(candidates[i]->flags & DEV_REGULAR))
+			continue;
+		if (!(devl = dm_pool_alloc(mem, sizeof(*devl))))
+			goto_out;
+		devl->dev = candidates[i];
+		dm_list_add(devs, &devl->list);
+		log_debug_devs("Using %s", dev_name(candidates[i]));
+	}
+
+	r = 1;
+out:
+	dm_free(passes);
+	dm_free(candidates);
+
+	return r;
+}
+
 void dev_reset_error_count(struct cmd_context *cmd)
 {
 	struct dev_iter iter;
@@ -24,13 +24,23 @@
  */
 struct dev_filter {
 	int (*passes_filter) (struct dev_filter * f, struct device * dev);
+	/*
+	 * Optional: filter count devices at once, clearing passes[i] for
+	 * each devs[i] rejected.  Devices with passes[i] clear are skipped.
+	 */
+	void (*passes_filter_batch) (struct dev_filter * f, struct device ** devs,
+				     char *passes, unsigned count);
 	void (*destroy) (struct dev_filter * f);
 	void (*wipe) (struct dev_filter * f);
 	int (*dump) (struct dev_filter * f, int merge_existing);
 	void *private;
 	unsigned use_count;
+	unsigned reads_devices;	/* Filter reads device contents */
 };
 
+void dev_filter_batch(struct dev_filter *f, struct device **devs,
+		      char *passes, unsigned count);
+
 int dev_cache_index_devs(void);
 struct dm_list *dev_cache_get_dev_list_for_vgid(const char *vgid);
 struct dm_list *dev_cache_get_dev_list_for_lvid(const char *lvid);
@@ -52,6 +62,7 @@ int dev_cache_has_scanned(void);
 void dev_cache_full_scan(struct dev_filter *f);
 
 int dev_cache_add_dir(const char *path);
+int dev_cache_set_index_file(const char *path, int write);
 int dev_cache_add_loopfile(const char *path);
 __attribute__((nonnull(1)))
 struct device *dev_cache_get(const char *name, struct dev_filter *f);
@@ -68,6 +79,8 @@ struct dev_iter;
 struct dev_iter *dev_iter_create(struct dev_filter *f, int dev_scan);
 void dev_iter_destroy(struct dev_iter *iter);
 struct device *dev_iter_get(struct dev_iter *iter);
+int dev_iter_get_list(struct dev_iter *iter, struct dm_pool *mem,
+		      struct dm_list *devs);
 
 void dev_reset_error_count(struct cmd_context *cmd);
 
@@ -38,6 +38,12 @@
 #  ifndef BLKDISCARD
 #    define BLKDISCARD	_IO(0x12,119)
 #  endif
+#  include <sys/syscall.h>
+#  include <linux/aio_abi.h>	/* For native asynchronous io */
+#  if defined(__NR_io_setup) && defined(__NR_io_submit) && \
+      defined(__NR_io_getevents) && defined(__NR_io_destroy)
+#    define DEV_ASYNC_IO_SUPPORT
+#  endif
 #else
 #  include <sys/disk.h>
 #  define BLKBSZGET DKIOCGETBLOCKSIZE
@@ -272,6 +278,170 @@ out:
 	return r;
 }
 
+/*-----------------------------------------------------------------
+ * Block cache.  Data read from devices is kept in memory in
+ * DEV_BLOCK_CACHE_SIZE blocks so that labels, metadata area
+ * headers and metadata read repeatedly within a command are
+ * only read from disk once.  Blocks are dropped when written
+ * or discarded, and the whole cache is dropped whenever VG
+ * locks change as data read before taking a lock may be stale.
+ * Regular files and reads within a critical section bypass it.
+ *---------------------------------------------------------------*/
+#define DEV_BLOCK_CACHE_SIZE	4096
+#define DEV_BLOCK_CACHE_MAX	16384	/* blocks, i.e. 64MiB */
+
+struct block_key {
+	uint64_t dev;
+	uint64_t block;
+};
+
+struct cached_block {
+	struct dm_list list;
+	struct block_key key;
+	char data[DEV_BLOCK_CACHE_SIZE];
+};
+
+static struct dm_hash_table *_block_cache = NULL;
+static DM_LIST_INIT(_cached_blocks);
+static unsigned _cached_block_count = 0;
+
+static int _use_block_cache(struct device *dev)
+{
+	return !(dev->flags & DEV_REGULAR) && !critical_section();
+}
+
+static struct cached_block *_find_cached_block(struct device *dev, uint64_t block)
+{
+	struct block_key key = { .dev = (uint64_t) dev->dev, .block = block };
+
+	if (!_cached_block_count)
+		return NULL;
+
+	return dm_hash_lookup_binary(_block_cache, &key, sizeof(key));
+}
+
+/*
+ * Copy the region from the cache if every block it touches is cached.
+ */
+static int _read_cached_blocks(struct device_area *where, char *buffer)
+{
+	struct cached_block *cb;
+	uint64_t offset = where->start, end = where->start + where->size;
+	size_t delta, len;
+
+	while (offset < end) {
+		if (!(cb = _find_cached_block(where->dev, offset / DEV_BLOCK_CACHE_SIZE)))
+			return 0;
+
+		delta = (size_t) (offset % DEV_BLOCK_CACHE_SIZE);
+		len = DEV_BLOCK_CACHE_SIZE - delta;
+		if (len > end - offset)
+			len = (size_t) (end - offset);
+
+		memcpy(buffer, cb->data + delta, len);
+		buffer += len;
+		offset += len;
+	}
+
+	return 1;
+}
+
+/*
+ * Remember data read from a region aligned to DEV_BLOCK_CACHE_SIZE.
+ */
+static void _cache_blocks(struct device_area *aligned, const char *data)
+{
+	struct cached_block *cb;
+	uint64_t block = aligned->start / DEV_BLOCK_CACHE_SIZE;
+	uint64_t count = aligned->size / DEV_BLOCK_CACHE_SIZE;
+
+	if (!_block_cache && !(_block_cache = dm_hash_create(1024))) {
+		log_debug_devs("Failed to create block cache.");
+		return;
+	}
+
+	for (; count--; block++, data += DEV_BLOCK_CACHE_SIZE) {
+		if ((cb = _find_cached_block(aligned->dev, block))) {
+			memcpy(cb->data, data, DEV_BLOCK_CACHE_SIZE);
+			continue;
+		}
+
+		if (_cached_block_count >= DEV_BLOCK_CACHE_MAX)
+			return;
+
+		if (!(cb = dm_malloc(sizeof(*cb))))
+			return;
+
+		cb->key.dev = (uint64_t) aligned->dev->dev;
+		cb->key.block = block;
+		memcpy(cb->data, data, DEV_BLOCK_CACHE_SIZE);
+
+		if (!dm_hash_insert_binary(_block_cache, &cb->key, sizeof(cb->key), cb)) {
+			dm_free(cb);
+			return;
+		}
+
+		dm_list_add(&_cached_blocks, &cb->list);
+		_cached_block_count++;
+	}
+}
+
+static void _drop_cached_blocks(struct device_area *where)
+{
+	struct cached_block *cb;
+	uint64_t block, last;
+
+	if (!_cached_block_count || !where->size)
+		return;
+
+	block = where->start / DEV_BLOCK_CACHE_SIZE;
+	last = (where->start + where->size - 1) / DEV_BLOCK_CACHE_SIZE;
+
+	for (; block <= last && _cached_block_count; block++) {
+		if (!(cb = _find_cached_block(where->dev, block)))
+			continue;
+		dm_hash_remove_binary(_block_cache, &cb->key, sizeof(cb->key));
+		dm_list_del(&cb->list);
+		dm_free(cb);
+		_cached_block_count--;
+	}
+}
+
+/*
+ * Read a region through the block cache.  On a miss, the region is
+ * widened to whole cache blocks which are read with a single io.
+ * If that fails (e.g. beyond the end of the device) only the region
+ * itself is read and nothing is cached.
+ */
+static int _cached_read(struct device_area *where, char *buffer)
+{
+	struct device_area widened;
+	char *buf, *aligned;
+	uintptr_t mask = DEV_BLOCK_CACHE_SIZE - 1;
+	int r;
+
+	if (_read_cached_blocks(where, buffer))
+		return 1;
+
+	_widen_region(DEV_BLOCK_CACHE_SIZE, where, &widened);
+
+	if (!(buf = dm_malloc((size_t) widened.size + DEV_BLOCK_CACHE_SIZE)))
+		return _aligned_io(where, buffer, 0);
+
+	aligned = (char *) ((((uintptr_t) buf) + mask) & ~mask);
+
+	if ((r = _aligned_io(&widened, aligned, 0))) {
+		memcpy(buffer, aligned + (where->start - widened.start),
+		       (size_t) where->size);
+		_cache_blocks(&widened, aligned);
+	} else
+		r = _aligned_io(where, buffer, 0);
+
+	dm_free(buf);
+
+	return r;
+}
+
 static int _dev_get_size_file(struct device *dev, uint64_t *size)
 {
 	const char *name = dev_name(dev);
@@ -365,6 +535,7 @@ static int _dev_read_ahead_dev(struct device *dev, uint32_t *read_ahead)
 
 static int _dev_discard_blocks(struct device *dev, uint64_t offset_bytes, uint64_t size_bytes)
 {
+	struct device_area where;
 	uint64_t discard_range[2];
 
 	if (!dev_open(dev))
@@ -373,6 +544,11 @@ static int _dev_discard_blocks(struct device *dev, uint64_t offset_bytes, uint64
 	discard_range[0] = offset_bytes;
 	discard_range[1] = size_bytes;
 
+	where.dev = dev;
+	where.start = offset_bytes;
+	where.size = size_bytes;
+	_drop_cached_blocks(&where);
+
 	log_debug_devs("Discarding %" PRIu64 " bytes offset %" PRIu64 " bytes on %s.",
 		       size_bytes, offset_bytes, dev_name(dev));
 	if (ioctl(dev->fd, BLKDISCARD, &discard_range) < 0) {
@@ -398,6 +574,22 @@ void dev_size_seqno_inc(void)
 	_dev_size_seqno++;
 }
 
+void dev_drop_cached_blocks(void)
+{
+	struct cached_block *cb, *tcb;
+
+	dm_list_iterate_items_safe(cb, tcb, &_cached_blocks)
+		dm_free(cb);
+
+	dm_list_init(&_cached_blocks);
+	_cached_block_count = 0;
+
+	if (_block_cache) {
+		dm_hash_destroy(_block_cache);
+		_block_cache = NULL;
+	}
+}
+
 int dev_get_size(struct device *dev, uint64_t *size)
 {
 	if (!dev)
@@ -613,8 +805,13 @@ int dev_test_excl(struct device *dev)
 	return r;
 }
 
+static void _issue_device_writes(struct device *dev);
+
 static void _close(struct device *dev)
 {
+	/* Queued writes need the descriptor */
+	_issue_device_writes(dev);
+
 	if (close(dev->fd))
 		log_sys_error("close", dev_name(dev));
 	dev->fd = -1;
@@ -693,6 +890,9 @@ static void _dev_inc_error_count(struct device *dev)
 			 dev->max_error_count, dev_name(dev));
 }
 
+static struct dm_list *_deferred_writes = NULL;
+static void _issue_overlapping_writes(const struct device_area *where);
+
 int dev_read(struct device *dev, uint64_t offset, size_t len, void *buffer)
 {
 	struct device_area where;
@@ -708,15 +908,648 @@ int dev_read(struct device *dev, uint64_t offset, size_t len, void *buffer)
 	where.start = offset;
 	where.size = len;
 
+	_issue_overlapping_writes(&where);
+
 	// fprintf(stderr, "READ: %s, %lld, %d\n", dev_name(dev), offset, len);
 
-	ret = _aligned_io(&where, buffer, 0);
+	if (_use_block_cache(dev))
+		ret = _cached_read(&where, buffer);
+	else
+		ret = _aligned_io(&where, buffer, 0);
 	if (!ret)
 		_dev_inc_error_count(dev);
 
 	return ret;
 }
 
+#ifdef DEV_ASYNC_IO_SUPPORT
+/*-----------------------------------------------------------------
+ * Batched reads using the native Linux asynchronous io interface.
+ * All requests are submitted together so the whole batch costs
+ * roughly a single device round-trip.  The same alignment rules
+ * as for _aligned_io() apply, so every request is channelled
+ * through its own widened and aligned bounce buffer.
+ *---------------------------------------------------------------*/
+struct async_read {
+	struct iocb cb;
+	struct device_read *dr;
+	struct device_area widened;
+	char *bounce_buf;
+	char *bounce;
+};
+
+static int _io_setup(unsigned nr_events, aio_context_t *ctx)
+{
+	return (int) syscall(__NR_io_setup, nr_events, ctx);
+}
+
+static int _io_destroy(aio_context_t ctx)
+{
+	return (int) syscall(__NR_io_destroy, ctx);
+}
+
+static long _io_submit(aio_context_t ctx, long nr, struct iocb **cbs)
+{
+	return syscall(__NR_io_submit, ctx, nr, cbs);
+}
+
+static long _io_getevents(aio_context_t ctx, long min_nr, long nr,
+			  struct io_event *events)
+{
+	return syscall(__NR_io_getevents, ctx, min_nr, nr, events, NULL);
+}
+
+/*
+ * Every batch reuses one context: io_destroy() waits for an RCU grace
+ * period, which costs more than a small batch saves.  A forked child
+ * cannot use its parent's context and sets up its own.
+ */
+#define DEV_AIO_MIN_EVENTS 64
+
+static aio_context_t _aio_ctx = 0;
+static unsigned _aio_nr_events = 0;
+static pid_t _aio_pid = 0;
+
+static void _drop_aio_context(void)
+{
+	/* Waits for any io still in flight */
+	if (_aio_ctx && (_aio_pid == getpid()) && (_io_destroy(_aio_ctx) < 0))
+		log_sys_debug("io_destroy", "");
+
+	_aio_ctx = 0;
+	_aio_nr_events = 0;
+}
+
+static int _get_aio_context(unsigned nr_events, aio_context_t *ctx)
+{
+	if (!_aio_ctx || (_aio_pid != getpid()) || (_aio_nr_events < nr_events)) {
+		_drop_aio_context();
+
+		if (nr_events < DEV_AIO_MIN_EVENTS)
+			nr_events = DEV_AIO_MIN_EVENTS;
+
+		if (_io_setup(nr_events, &_aio_ctx) < 0) {
+			log_debug_devs("Asynchronous io unavailable: %s.", strerror(errno));
+			_aio_ctx = 0;
+			return 0;
+		}
+
+		_aio_nr_events = nr_events;
+		_aio_pid = getpid();
+	}
+
+	*ctx = _aio_ctx;
+
+	return 1;
+}
+
+static int _prepare_async_read(struct async_read *ar, struct device_read *dr)
+{
+	struct device *dev = dr->where.dev;
+	unsigned int physical_block_size = 0;
+	unsigned int block_size = 0;
+	uintptr_t mask;
+
+	if (!(dev->flags & DEV_REGULAR) &&
+	    !dev_get_block_size(dev, &physical_block_size, &block_size))
+		return_0;
+
+	if (!block_size)
+		block_size = lvm_getpagesize();
+
+	/* Read whole cache blocks so the result can be cached. */
+	if (_use_block_cache(dev) && block_size < DEV_BLOCK_CACHE_SIZE)
+		block_size = DEV_BLOCK_CACHE_SIZE;
+
+	_widen_region(block_size, &dr->where, &ar->widened);
+
+	if (!(ar->bounce_buf = ar->bounce = dm_malloc((size_t) ar->widened.size + block_size))) {
+		log_error("Bounce buffer malloc failed");
+		return 0;
+	}
+
+	mask = block_size - 1;
+	if (((uintptr_t) ar->bounce) & mask)
+		ar->bounce = (char *) ((((uintptr_t) ar->bounce) + mask) & ~mask);
+
+	ar->dr = dr;
+	ar->cb.aio_data = (uint64_t) (uintptr_t) ar;
+	ar->cb.aio_lio_opcode = IOCB_CMD_PREAD;
+	ar->cb.aio_fildes = (uint32_t) dev_fd(dev);
+	ar->cb.aio_buf = (uint64_t) (uintptr_t) ar->bounce;
+	ar->cb.aio_nbytes = ar->widened.size;
+	ar->cb.aio_offset = (int64_t) ar->widened.start;
+
+	return 1;
+}
+
+/*
+ * Returns the number of requests completed asynchronously.
+ * Anything not completed is left to the caller with result 0.
+ */
+static unsigned _dev_read_async(struct dm_list *reads, unsigned count)
+{
+	aio_context_t ctx = 0;
+	struct async_read *ars, *ar;
+	struct device_read *dr;
+	struct iocb **cbs = NULL;
+	struct io_event *events = NULL;
+	unsigned nr = 0, submitted = 0, completed = 0, done = 0;
+	long i, n;
+
+	if (!(ars = dm_zalloc(count * sizeof(*ars))) ||
+	    !(cbs = dm_malloc(count * sizeof(*cbs))) ||
+	    !(events = dm_malloc(count * sizeof(*events)))) {
+		log_error("Failed to allocate asynchronous io batch.");
+		goto out;
+	}
+
+	if (!_get_aio_context(count, &ctx))
+		goto out;
+
+	dm_list_iterate_items(dr, reads) {
+		if (dr->result || !dr->where.dev->open_count ||
+		    !_dev_is_valid(dr->where.dev))
+			continue;
+		if (!_prepare_async_read(&ars[nr], dr))
+			continue;
+		cbs[nr] = &ars[nr].cb;
+		nr++;
+	}
+
+	while (submitted < nr) {
+		if ((n = _io_submit(ctx, (long) (nr - submitted), cbs + submitted)) <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			log_debug_devs("Asynchronous io submission failed after %u "
+				       "of %u reads: %s.", submitted, nr,
+				       n < 0 ? strerror(errno) : "no progress");
+			break;
+		}
+		submitted += (unsigned) n;
+	}
+
+	while (completed < submitted) {
+		if ((n = _io_getevents(ctx, 1, (long) (submitted - completed), events)) < 0) {
+			if (errno == EINTR)
+				continue;
+			log_sys_debug("io_getevents", "");
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			ar = (struct async_read *) (uintptr_t) events[i].data;
+			dr = ar->dr;
+			if (events[i].res != (int64_t) ar->widened.size) {
+				log_debug_devs("%s: asynchronous read at %" PRIu64
+					       " failed (%" PRId64 ").",
+					       dev_name(dr->where.dev),
+					       (uint64_t) ar->widened.start,
+					       (int64_t) events[i].res);
+				continue;
+			}
+			memcpy(dr->buf, ar->bounce + (dr->where.start - ar->widened.start),
+			       (size_t) dr->where.size);
+			dr->result = 1;
+
+			if (_use_block_cache(dr->where.dev) &&
+			    !(ar->widened.start % DEV_BLOCK_CACHE_SIZE) &&
+			    !(ar->widened.size % DEV_BLOCK_CACHE_SIZE))
+				_cache_blocks(&ar->widened, ar->bounce);
+			done++;
+		}
+		completed += (unsigned) n;
+	}
+
+	/* Bounce buffers are freed next, wait for anything still in flight */
+	if (completed < submitted)
+		_drop_aio_context();
+
+out:
+	if (ars)
+		for (i = 0; i < (long) nr; i++)
+			dm_free(ars[i].bounce_buf);
+	dm_free(events);
+	dm_free(cbs);
+	dm_free(ars);
+
+	return done;
+}
+#endif
+
+static int _dev_read_batch(struct dm_list *reads, int fallback)
+{
+	struct device_read *dr;
+	unsigned count = 0;
+	unsigned done = 0;
+	int r = 1;
+
+	dm_list_iterate_items(dr, reads) {
+		dr->result = 0;
+		_issue_overlapping_writes(&dr->where);
+		if (dr->where.dev->open_count && _use_block_cache(dr->where.dev) &&
+		    _read_cached_blocks(&dr->where, dr->buf))
+			dr->result = 1;
+		else
+			count++;
+	}
+
+	if (!count)
+		return 1;
+
+#ifdef DEV_ASYNC_IO_SUPPORT
+	if (count > 1)
+		done = _dev_read_async(reads, count);
+#endif
+
+	if (done)
+		log_debug_devs("Completed %u of %u reads asynchronously.", done, count);
+
+	dm_list_iterate_items(dr, reads)
+		if (!dr->result &&
+		    (!fallback ||
+		     !(dr->result = dev_read(dr->where.dev, dr->where.start,
+					     (size_t) dr->where.size, dr->buf))))
+			r = 0;
+
+	return r;
+}
+
+/*
+ * Read every device_read on the list, issuing all the reads together
+ * as asynchronous io when possible.  Any read that cannot be completed
+ * that way is retried synchronously with dev_read().  Sets result in
+ * each device_read and returns 1 only if all reads succeeded.
+ */
+int dev_read_batch(struct dm_list *reads)
+{
+	return _dev_read_batch(reads, 1);
+}
+
+static void _prefetch_batch(struct dm_list *batch)
+{
+	struct device_read *dr;
+
+	(void) _dev_read_batch(batch, 0);
+
+	dm_list_iterate_items(dr, batch)
+		if (!dev_close(dr->where.dev))
+			stack;
+
+	dm_list_init(batch);
+}
+
+/*
+ * Read the first len bytes of each device into the block cache with
+ * asynchronous io, up to DEV_PREFETCH_BATCH devices at a time so they
+ * can all be held open.  Nothing is read synchronously: anything not
+ * prefetched is simply read on demand later.
+ */
+#define DEV_PREFETCH_BATCH 256
+
+void dev_prefetch(struct device **devs, unsigned count, size_t len)
+{
+	struct device_read *reqs;
+	struct dm_list batch;
+	char *buf;
+	unsigned i, n = 0;
+
+	if (count < 2)
+		return;
+
+	if (!(reqs = dm_malloc(DEV_PREFETCH_BATCH * sizeof(*reqs))))
+		return;
+
+	/* Only the cached copy matters, so all reads share one buffer. */
+	if (!(buf = dm_malloc(len))) {
+		dm_free(reqs);
+		return;
+	}
+
+	dm_list_init(&batch);
+
+	for (i = 0; i < count; i++) {
+		if (!_use_block_cache(devs[i]) || !dev_open_readonly_quiet(devs[i]))
+			continue;
+
+		reqs[n].where.dev = devs[i];
+		reqs[n].where.start = UINT64_C(0);
+		reqs[n].where.size = len;
+		reqs[n].buf = buf;
+		dm_list_add(&batch, &reqs[n].list);
+
+		if (++n == DEV_PREFETCH_BATCH) {
+			_prefetch_batch(&batch);
+			n = 0;
+		}
+	}
+
+	_prefetch_batch(&batch);
+
+	dm_free(buf);
+	dm_free(reqs);
+}
+
+/*-----------------------------------------------------------------
+ * Deferred writes.  While dev_defer_writes() has set a list, each
+ * dev_write() to a device opened with O_DIRECT is only queued there
+ * and reported successful.  dev_write_batch() then issues the whole
+ * queue together, so writing the same metadata to many devices costs
+ * about one device round-trip instead of one per device.
+ *
+ * Any read or write overlapping a queued write, or closing its
+ * device, issues the queue first so the order in which data reaches
+ * each device never changes.
+ *---------------------------------------------------------------*/
+static void *_deferred_context = NULL;
+static int _issuing_writes = 0;
+
+static int _queue_write(struct device_area *where, const void *buffer)
+{
+	struct device_write *dw;
+
+	if (!(dw = dm_zalloc(sizeof(*dw))) ||
+	    !(dw->buf = dm_malloc((size_t) where->size))) {
+		log_error("Failed to allocate deferred write.");
+		dm_free(dw);
+		return 0;
+	}
+
+	memcpy(dw->buf, buffer, (size_t) where->size);
+	dw->where = *where;
+	dw->context = _deferred_context;
+	dm_list_add(_deferred_writes, &dw->list);
+
+	return 1;
+}
+
+/* Read whatever the widened region keeps of the current content */
+static int _prepare_write(struct device_write *dw, struct dm_list *reads)
+{
+	struct device *dev = dw->where.dev;
+	unsigned int physical_block_size = 0;
+	unsigned int block_size = 0;
+	uintptr_t mask;
+
+	if (!dev_get_block_size(dev, &physical_block_size, &block_size))
+		return_0;
+
+	if (!block_size)
+		block_size = lvm_getpagesize();
+
+	_widen_region(block_size, &dw->where, &dw->widened);
+
+	if (!(dw->bounce_buf = dw->bounce = dm_malloc((size_t) dw->widened.size + block_size))) {
+		log_error("Bounce buffer malloc failed");
+		return 0;
+	}
+
+	mask = block_size - 1;
+	if (((uintptr_t) dw->bounce) & mask)
+		dw->bounce = (char *) ((((uintptr_t) dw->bounce) + mask) & ~mask);
+
+	if (memcmp(&dw->where, &dw->widened, sizeof(dw->widened))) {
+		dw->read.where = dw->widened;
+		dw->read.buf = dw->bounce;
+		dm_list_add(reads, &dw->read.list);
+	}
+
+	return 1;
+}
+
+#ifdef DEV_ASYNC_IO_SUPPORT
+/* Returns the number of writes completed asynchronously. */
+static unsigned _dev_write_async(struct dm_list *writes, unsigned count)
+{
+	aio_context_t ctx = 0;
+	struct device_write *dw;
+	struct iocb *cbs_mem = NULL, **cbs = NULL;
+	struct io_event *events = NULL;
+	unsigned nr = 0, submitted = 0, completed = 0, done = 0;
+	long i, n;
+
+	if (!(cbs_mem = dm_zalloc(count * sizeof(*cbs_mem))) ||
+	    !(cbs = dm_malloc(count * sizeof(*cbs))) ||
+	    !(events = dm_malloc(count * sizeof(*events)))) {
+		log_error("Failed to allocate asynchronous io batch.");
+		goto out;
+	}
+
+	if (!_get_aio_context(count, &ctx))
+		goto out;
+
+	dm_list_iterate_items(dw, writes) {
+		if (dw->issued || !dw->bounce)
+			continue;
+		cbs_mem[nr].aio_data = (uint64_t) (uintptr_t) dw;
+		cbs_mem[nr].aio_lio_opcode = IOCB_CMD_PWRITE;
+		cbs_mem[nr].aio_fildes = (uint32_t) dev_fd(dw->where.dev);
+		cbs_mem[nr].aio_buf = (uint64_t) (uintptr_t) dw->bounce;
+		cbs_mem[nr].aio_nbytes = dw->widened.size;
+		cbs_mem[nr].aio_offset = (int64_t) dw->widened.start;
+		cbs[nr] = &cbs_mem[nr];
+		nr++;
+	}
+
+	while (submitted < nr) {
+		if ((n = _io_submit(ctx, (long) (nr - submitted), cbs + submitted)) <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			log_debug_devs("Asynchronous io submission failed after %u "
+				       "of %u writes: %s.", submitted, nr,
+				       n < 0 ? strerror(errno) : "no progress");
+			break;
+		}
+		submitted += (unsigned) n;
+	}
+
+	while (completed < submitted) {
+		if ((n = _io_getevents(ctx, 1, (long) (submitted - completed), events)) < 0) {
+			if (errno == EINTR)
+				continue;
+			log_sys_debug("io_getevents", "");
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			dw = (struct device_write *) (uintptr_t) events[i].data;
+			dw->issued = 1;
+			if (events[i].res != (int64_t) dw->widened.size) {
+				log_error("%s: write failed at %" PRIu64 " of %" PRIu64
+					  " bytes: %s", dev_name(dw->where.dev),
+					  (uint64_t) dw->widened.start,
+					  (uint64_t) dw->widened.size,
+					  (events[i].res < 0) ? strerror((int) -events[i].res) :
+					  "short write");
+				continue;
+			}
+			dw->result = 1;
+			done++;
+		}
+		completed += (unsigned) n;
+	}
+
+	/* Bounce buffers are freed next, wait for anything still in flight */
+	if (completed < submitted)
+		_drop_aio_context();
+
+out:
+	dm_free(events);
+	dm_free(cbs);
+	dm_free(cbs_mem);
+
+	return done;
+}
+#endif
+
+/* Issue every queued write on the list not issued yet */
+static void _issue_writes(struct dm_list *writes)
+{
+	struct device_write *dw;
+	struct dm_list reads;
+	unsigned count = 0, done = 0;
+
+	/* Reading the rest of partial blocks must not issue them again */
+	_issuing_writes = 1;
+	dm_list_init(&reads);
+
+	dm_list_iterate_items(dw, writes) {
+		if (dw->issued)
+			continue;
+		if (!_prepare_write(dw, &reads)) {
+			dw->issued = 1;
+			continue;
+		}
+		count++;
+	}
+
+	/* Blocks partially written keep the rest of their content */
+	if (!dm_list_empty(&reads))
+		(void) dev_read_batch(&reads);
+
+	dm_list_iterate_items(dw, writes) {
+		if (dw->issued)
+			continue;
+		/*
+		 * A device kept open for a locked VG may no longer be
+		 * referenced, which dev_read() refuses, but its fd is
+		 * still there for the write itself.
+		 */
+		if (dw->read.buf && !dw->read.result)
+			dw->read.result = _io(&dw->widened, dw->bounce, 0);
+		/* FIXME pre-extend the file */
+		if (dw->read.buf && !dw->read.result)
+			memset(dw->bounce, '\n', dw->widened.size);
+		memcpy(dw->bounce + (dw->where.start - dw->widened.start), dw->buf,
+		       (size_t) dw->where.size);
+	}
+
+#ifdef DEV_ASYNC_IO_SUPPORT
+	if (count > 1)
+		done = _dev_write_async(writes, count);
+#endif
+
+	if (done)
+		log_debug_devs("Completed %u of %u writes asynchronously.", done, count);
+
+	dm_list_iterate_items(dw, writes) {
+		if (!dw->buf)
+			continue; /* Issued before */
+		if (!dw->issued) {
+			dw->issued = 1;
+			dw->result = _io(&dw->widened, dw->bounce, 1);
+		}
+		if (!dw->result)
+			_dev_inc_error_count(dw->where.dev);
+		/* Reading partial blocks may have cached the old content */
+		_drop_cached_blocks(&dw->widened);
+		dm_free(dw->bounce_buf);
+		dw->bounce_buf = dw->bounce = NULL;
+		dm_free(dw->buf);
+		dw->buf = NULL;
+	}
+
+	_issuing_writes = 0;
+}
+
+static int _overlaps(const struct device_area *a, const struct device_area *b)
+{
+	uint64_t mask = (uint64_t) lvm_getpagesize() - 1;
+
+	/* Compare whole pages, partial block writes read the rest */
+	return (a->dev == b->dev) &&
+		((a->start & ~mask) < ((b->start + b->size + mask) & ~mask)) &&
+		((b->start & ~mask) < ((a->start + a->size + mask) & ~mask));
+}
+
+static void _issue_overlapping_writes(const struct device_area *where)
+{
+	struct device_write *dw;
+
+	if (!_deferred_writes || _issuing_writes)
+		return;
+
+	dm_list_iterate_items(dw, _deferred_writes)
+		if (!dw->issued && _overlaps(&dw->where, where)) {
+			log_debug_devs("%s: issuing deferred writes before overlapping io.",
+				       dev_name(where->dev));
+			_issue_writes(_deferred_writes);
+			return;
+		}
+}
+
+static void _issue_device_writes(struct device *dev)
+{
+	struct device_write *dw;
+
+	if (!_deferred_writes || _issuing_writes)
+		return;
+
+	dm_list_iterate_items(dw, _deferred_writes)
+		if (!dw->issued && (dw->where.dev == dev)) {
+			_issue_writes(_deferred_writes);
+			return;
+		}
+}
+
+void dev_defer_writes(struct dm_list *writes, void *context)
+{
+	if (_deferred_writes && (_deferred_writes != writes))
+		log_error(INTERNAL_ERROR "Deferring writes while other writes are deferred.");
+
+	_deferred_writes = writes;
+	_deferred_context = context;
+}
+
+int dev_write_batch(struct dm_list *writes)
+{
+	struct device_write *dw;
+	int r = 1;
+
+	if (_deferred_writes == writes) {
+		_deferred_writes = NULL;
+		_deferred_context = NULL;
+	}
+
+	_issue_writes(writes);
+
+	dm_list_iterate_items(dw, writes)
+		if (!dw->result)
+			r = 0;
+
+	return r;
+}
+
+void dev_free_writes(struct dm_list *writes)
+{
+	struct device_write *dw, *tdw;
+
+	dm_list_iterate_items_safe(dw, tdw, writes) {
+		dm_list_del(&dw->list);
+		dm_free(dw);
+	}
+}
+
 /*
  * Read from 'dev' into 'buf', possibly in 2 distinct regions, denoted
  * by (offset,len) and (offset2,len2).  Thus, the total size of
@@ -784,6 +1617,13 @@ int dev_write(struct device *dev, uint64_t offset, size_t len, void *buffer)
 
 	dev->flags |= DEV_ACCESSED_W;
 
+	_drop_cached_blocks(&where);
+	_issue_overlapping_writes(&where);
+
+	if (_deferred_writes && (dev->flags & DEV_O_DIRECT) &&
+	    !(dev->flags & DEV_REGULAR))
+		return test_mode() ? 1 : _queue_write(&where, buffer);
+
 	ret = _aligned_io(&where, buffer, 1);
 	if (!ret)
 		_dev_inc_error_count(dev);
@@ -90,6 +90,33 @@ struct device_area {
 	uint64_t size;		/* Bytes */
 };
 
+/*
+ * A read request for dev_read_batch().
+ */
+struct device_read {
+	struct dm_list list;
+	struct device_area where;	/* Device must be open */
+	char *buf;			/* Must hold where.size bytes */
+	int result;			/* Set to 1 when read succeeded */
+};
+
+/*
+ * A write queued by dev_write() after dev_defer_writes().
+ * Only context and result are meant for the caller.
+ */
+struct device_write {
+	struct dm_list list;
+	struct device_area where;
+	void *context;			/* As passed to dev_defer_writes() */
+	int result;			/* Set to 1 when write succeeded */
+	int issued;
+	char *buf;			/* Copy of the data to write */
+	struct device_area widened;
+	char *bounce_buf;
+	char *bounce;
+	struct device_read read;	/* Rest of partially written blocks */
+};
+
 /*
  * Support for external device info.
  */
@@ -106,6 +133,12 @@ int dev_ext_release(struct device *dev);
  */
 void dev_size_seqno_inc(void);
 
+/*
+ * Drop all device blocks cached by dev_read().
+ * Called whenever VG locks change.
+ */
+void dev_drop_cached_blocks(void);
+
 /*
  * All io should use these routines.
  */
@@ -130,10 +163,21 @@ int dev_fd(struct device *dev);
 const char *dev_name(const struct device *dev);
 
 int dev_read(struct device *dev, uint64_t offset, size_t len, void *buffer);
+int dev_read_batch(struct dm_list *reads);
+void dev_prefetch(struct device **devs, unsigned count, size_t len);
 int dev_read_circular(struct device *dev, uint64_t offset, size_t len,
 		      uint64_t offset2, size_t len2, char *buf);
 int dev_write(struct device *dev, uint64_t offset, size_t len, void *buffer);
 int dev_append(struct device *dev, size_t len, char *buffer);
+
+/*
+ * Queue dev_write()s on writes until dev_write_batch() issues them
+ * all together and sets result in each device_write.  Returns 1 only
+ * if every write succeeded.  dev_free_writes() releases the list.
+ */
+void dev_defer_writes(struct dm_list *writes, void *context);
+int dev_write_batch(struct dm_list *writes);
+void dev_free_writes(struct dm_list *writes);
 int dev_set(struct device *dev, uint64_t offset, size_t len, int value);
 void dev_flush(struct device *dev);
 
@@ -38,6 +38,70 @@ static int _and_p_with_dev_ext_info(struct dev_filter *f, struct device *dev)
 	return r;
 }
 
+/*
+ * Amount read from the start of each device ahead of the first filter
+ * that reads device contents.  Covers the partition table, md v1.1 and
+ * v1.2 superblocks and LVM labels.
+ */
+#define FILTER_PREFETCH_SIZE 8192
+
+static void _prefetch(struct device **devs, char *passes, unsigned count)
+{
+	struct device **candidates;
+	unsigned i, n = 0;
+
+	/* External device info sources do not read devices. */
+	if (external_device_info_source() != DEV_EXT_NONE)
+		return;
+
+	if (!(candidates = dm_malloc(count * sizeof(*candidates))))
+		return;
+
+	for (i = 0; i < count; i++)
+		if (passes[i])
+			candidates[n++] = devs[i];
+
+	dev_prefetch(candidates, n, FILTER_PREFETCH_SIZE);
+
+	dm_free(candidates);
+}
+
+/*
+ * Apply each filter in turn to all the devices still passing, so that
+ * the device io needed by the filters that read devices can be issued
+ * as one batch.  A device rejected by one filter is never passed to
+ * the next, just as with _and_p().
+ */
+static void _and_p_batch(struct dev_filter *f, struct device **devs,
+			 char *passes, unsigned count)
+{
+	struct dev_filter **filters;
+	int prefetched = 0;
+
+	for (filters = (struct dev_filter **) f->private; *filters; ++filters) {
+		if ((*filters)->reads_devices && !prefetched) {
+			_prefetch(devs, passes, count);
+			prefetched = 1;
+		}
+		dev_filter_batch(*filters, devs, passes, count);
+	}
+}
+
+static void _and_p_batch_with_dev_ext_info(struct dev_filter *f, struct device **devs,
+					   char *passes, unsigned count)
+{
+	unsigned i;
+
+	for (i = 0; i < count; i++)
+		if (passes[i])
+			dev_ext_enable(devs[i], external_device_info_source());
+
+	_and_p_batch(f, devs, passes, count);
+
+	for (i = 0; i < count; i++)
+		dev_ext_disable(devs[i]);
+}
+
 static void _composite_destroy(struct dev_filter *f)
 {
 	struct dev_filter **filters;
@@ -95,6 +159,7 @@ struct dev_filter *composite_filter_create(int n, int use_dev_ext_info, struct d
 	}
 
 	cft->passes_filter = use_dev_ext_info ? _and_p_with_dev_ext_info : _and_p;
+	cft->passes_filter_batch = use_dev_ext_info ? _and_p_batch_with_dev_ext_info : _and_p_batch;
 	cft->destroy = _composite_destroy;
 	cft->dump = _dump;
 	cft->wipe = _wipe;
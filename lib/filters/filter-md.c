@@ -68,6 +68,7 @@ struct dev_filter *md_filter_create(struct dev_types *dt)
 	f->passes_filter = _ignore_md;
 	f->destroy = _destroy;
 	f->use_count = 0;
+	f->reads_devices = 1;
 	f->private = dt;
 
 	log_debug_devs("MD filter initialised.");
@@ -54,6 +54,7 @@ struct dev_filter *partitioned_filter_create(struct dev_types *dt)
 	f->passes_filter = _passes_partitioned_filter;
 	f->destroy = _partitioned_filter_destroy;
 	f->use_count = 0;
+	f->reads_devices = 1;
 	f->private = dt;
 
 	log_debug_devs("Partitioned filter initialised.");
@@ -271,11 +271,23 @@ out:
 	return r;
 }
 
+static int _hash_aliases(struct pfilter *pf, struct device *dev, void *l)
+{
+	struct dm_str_list *sl;
+
+	dm_list_iterate_items(sl, &dev->aliases)
+		if (!dm_hash_insert(pf->devices, sl->str, l)) {
+			log_error("Failed to hash alias to filter.");
+			return 0;
+		}
+
+	return 1;
+}
+
 static int _lookup_p(struct dev_filter *f, struct device *dev)
 {
 	struct pfilter *pf = (struct pfilter *) f->private;
 	void *l = dm_hash_lookup(pf->devices, dev_name(dev));
-	struct dm_str_list *sl;
 
 	/* Cached BAD? */
 	if (l == PF_BAD_DEVICE) {
@@ -285,12 +297,8 @@ static int _lookup_p(struct dev_filter *f, struct device *dev)
 
 	/* Test dm devices every time, so cache them as GOOD. */
 	if (MAJOR(dev->dev) == pf->dt->device_mapper_major) {
-		if (!l)
-			dm_list_iterate_items(sl, &dev->aliases)
-				if (!dm_hash_insert(pf->devices, sl->str, PF_GOOD_DEVICE)) {
-					log_error("Failed to hash device to filter.");
-					return 0;
-				}
+		if (!l && !_hash_aliases(pf, dev, PF_GOOD_DEVICE))
+			return_0;
 		return pf->real->passes_filter(pf->real, dev);
 	}
 
@@ -298,16 +306,79 @@ static int _lookup_p(struct dev_filter *f, struct device *dev)
 	if (!l) {
 		l = pf->real->passes_filter(pf->real, dev) ?  PF_GOOD_DEVICE : PF_BAD_DEVICE;
 
-		dm_list_iterate_items(sl, &dev->aliases)
-			if (!dm_hash_insert(pf->devices, sl->str, l)) {
-				log_error("Failed to hash alias to filter.");
-				return 0;
-			}
+		if (!_hash_aliases(pf, dev, l))
+			return_0;
 	}
 
 	return (l == PF_BAD_DEVICE) ? 0 : 1;
 }
 
+/*
+ * Batched equivalent of _lookup_p(): devices with no cached state
+ * and dm devices are passed together to the real filter.
+ */
+static void _lookup_p_batch(struct dev_filter *f, struct device **devs,
+			    char *passes, unsigned count)
+{
+	struct pfilter *pf = (struct pfilter *) f->private;
+	struct device **uncached;
+	unsigned *idx;
+	char *uncached_passes;
+	unsigned i, j, n = 0;
+	void *l;
+
+	if (!(uncached = dm_malloc(count * (sizeof(*uncached) + sizeof(*idx) + 1)))) {
+		for (i = 0; i < count; i++)
+			if (passes[i] && !_lookup_p(f, devs[i]))
+				passes[i] = 0;
+		return;
+	}
+
+	idx = (unsigned *) (uncached + count);
+	uncached_passes = (char *) (idx + count);
+
+	for (i = 0; i < count; i++) {
+		if (!passes[i])
+			continue;
+
+		l = dm_hash_lookup(pf->devices, dev_name(devs[i]));
+
+		if (l == PF_BAD_DEVICE) {
+			log_debug_devs("%s: Skipping (cached)", dev_name(devs[i]));
+			passes[i] = 0;
+			continue;
+		}
+
+		if (MAJOR(devs[i]->dev) == pf->dt->device_mapper_major) {
+			if (!l && !_hash_aliases(pf, devs[i], PF_GOOD_DEVICE)) {
+				passes[i] = 0;
+				continue;
+			}
+		} else if (l)
+			continue;
+
+		uncached[n] = devs[i];
+		uncached_passes[n] = 1;
+		idx[n++] = i;
+	}
+
+	if (n)
+		dev_filter_batch(pf->real, uncached, uncached_passes, n);
+
+	for (j = 0; j < n; j++) {
+		i = idx[j];
+		passes[i] = uncached_passes[j];
+
+		if (MAJOR(devs[i]->dev) == pf->dt->device_mapper_major)
+			continue;
+
+		if (!_hash_aliases(pf, devs[i], passes[i] ? PF_GOOD_DEVICE : PF_BAD_DEVICE))
+			passes[i] = 0;
+	}
+
+	dm_free(uncached);
+}
+
 static void _persistent_destroy(struct dev_filter *f)
 {
 	struct pfilter *pf = (struct pfilter *) f->private;
@@ -359,6 +430,7 @@ struct dev_filter *persistent_filter_create(struct dev_types *dt,
 		lvm_stat_ctim(&pf->ctime, &info);
 
 	f->passes_filter = _lookup_p;
+	f->passes_filter_batch = _lookup_p_batch;
 	f->destroy = _persistent_destroy;
 	f->use_count = 0;
 	f->private = pf;
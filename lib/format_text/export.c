@@ -1038,7 +1038,10 @@ size_t text_vg_export_raw(struct volume_group *vg, const char *desc, char **buf)
 	if (!(f = dm_zalloc(sizeof(*f))))
 		return_0;
 
-	f->data.buf.size = 65536;	/* Initial metadata limit */
+	/* Initial metadata limit, start with the last size seen */
+	f->data.buf.size = 65536;
+	while (f->data.buf.size < vg->export_size)
+		f->data.buf.size *= 2;
 	if (!(f->data.buf.start = dm_malloc(f->data.buf.size))) {
 		log_error("text_export buffer allocation failed");
 		goto out;
@@ -1067,6 +1070,43 @@ size_t export_vg_to_buffer(struct volume_group *vg, char **buf)
 	return text_vg_export_raw(vg, "", buf);
 }
 
+/*
+ * Text written by the vg_write() in progress, or for a precommitted or
+ * committed copy the text it was imported from.  A VG without it, or
+ * changed since, is formatted again.
+ */
+size_t export_vg_written_to_buffer(struct volume_group *vg, char **buf)
+{
+	if (!vg->export_buf || (vg->export_seqno != vg->seqno))
+		return export_vg_to_buffer(vg, buf);
+
+	log_debug_metadata("Reusing written metadata of VG %s seqno %" PRIu32 ".",
+			   vg->name, vg->seqno);
+
+	if (!(*buf = dm_malloc(vg->export_size))) {
+		log_error("text_export buffer allocation failed");
+		return 0;
+	}
+
+	memcpy(*buf, vg->export_buf, vg->export_size);
+
+	return vg->export_size;
+}
+
+struct dm_config_tree *export_vg_written_to_config_tree(struct volume_group *vg)
+{
+	struct dm_config_tree *vg_cft;
+	if (!vg->export_buf || (vg->export_seqno != vg->seqno))
+		return export_vg_to_config_tree(vg);
+
+	if (!(vg_cft = dm_config_from_string(vg->export_buf))) {
+		log_error("Error parsing metadata for VG %s.", vg->name);
+		return NULL;
+	}
+
+	return vg_cft;
+}
+
 struct dm_config_tree *export_vg_to_config_tree(struct volume_group *vg)
 {
 	char *buf = NULL;
@@ -403,6 +403,50 @@ static int _raw_write_mda_header(const struct format_type *fmt,
 	return 1;
 }
 
+/*
+ * Metadata read before the VG lock by _text_vgs_read_ahead().
+ * vg_read() uses it only when the mda header it reads under the
+ * lock still records exactly the same committed metadata.
+ */
+struct read_ahead {
+	struct dm_list list;
+	struct device *dev;
+	uint64_t start;			/* Of the metadata area */
+	struct raw_locn rlocn;		/* Committed metadata when read */
+	char *buf;			/* rlocn.size bytes, unwrapped */
+};
+
+static DM_LIST_INIT(_read_aheads);
+
+static struct read_ahead *_find_read_ahead(struct device_area *dev_area,
+					   struct raw_locn *rlocn)
+{
+	struct read_ahead *ra;
+
+	dm_list_iterate_items(ra, &_read_aheads)
+		if (ra->dev == dev_area->dev && ra->start == dev_area->start &&
+		    ra->rlocn.offset == rlocn->offset &&
+		    ra->rlocn.size == rlocn->size &&
+		    ra->rlocn.checksum == rlocn->checksum)
+			return ra;
+
+	return NULL;
+}
+
+static void _drop_read_ahead(struct read_ahead *ra)
+{
+	dm_list_del(&ra->list);
+	dm_free(ra);
+}
+
+static void _drop_read_aheads(void)
+{
+	struct read_ahead *ra, *tmp;
+
+	dm_list_iterate_items_safe(ra, tmp, &_read_aheads)
+		_drop_read_ahead(ra);
+}
+
 static struct raw_locn *_find_vg_rlocn(struct device_area *dev_area,
 				       struct mda_header *mdah,
 				       const char *vgname,
@@ -411,6 +455,7 @@ static struct raw_locn *_find_vg_rlocn(struct device_area *dev_area,
 	size_t len;
 	char vgnamebuf[NAME_LEN + 2] __attribute__((aligned(8)));
 	struct raw_locn *rlocn, *rlocn_precommitted;
+	struct read_ahead *ra;
 	struct lvmcache_info *info;
 	struct lvmcache_vgsummary vgsummary_orphan = {
 		.vgname = FMT_TEXT_ORPHAN_VG_NAME,
@@ -441,8 +486,11 @@ static struct raw_locn *_find_vg_rlocn(struct device_area *dev_area,
 
 	/* FIXME Loop through rlocns two-at-a-time.  List null-terminated. */
 	/* FIXME Ignore if checksum incorrect!!! */
-	if (!dev_read(dev_area->dev, dev_area->start + rlocn->offset,
-		      sizeof(vgnamebuf), vgnamebuf))
+	if ((ra = _find_read_ahead(dev_area, rlocn)) &&
+	    ra->rlocn.size >= sizeof(vgnamebuf))
+		memcpy(vgnamebuf, ra->buf, sizeof(vgnamebuf));
+	else if (!dev_read(dev_area->dev, dev_area->start + rlocn->offset,
+			   sizeof(vgnamebuf), vgnamebuf))
 		goto_bad;
 
 	if (!strncmp(vgnamebuf, vgname, len = strlen(vgname)) &&
@@ -511,6 +559,7 @@ static struct volume_group *_vg_read_raw_area(struct format_instance *fid,
 	struct volume_group *vg = NULL;
 	struct raw_locn *rlocn;
 	struct mda_header *mdah;
+	struct read_ahead *ra;
 	time_t when;
 	char *desc;
 	uint32_t wrap = 0;
@@ -532,13 +581,23 @@ static struct volume_group *_vg_read_raw_area(struct format_instance *fid,
 		goto out;
 	}
 
-	/* FIXME 64-bit */
-	if (!(vg = text_vg_import_fd(fid, NULL, vg_fmtdata, use_previous_vg, single_device, area->dev, 
-				     (off_t) (area->start + rlocn->offset),
-				     (uint32_t) (rlocn->size - wrap),
-				     (off_t) (area->start + MDA_HEADER_SIZE),
-				     wrap, calc_crc, rlocn->checksum, &when,
-				     &desc)) && (!use_previous_vg || !*use_previous_vg))
+	if ((ra = _find_read_ahead(area, rlocn))) {
+		log_debug_metadata("Using metadata read ahead from %s at %" PRIu64,
+				   dev_name(area->dev), area->start + rlocn->offset);
+		vg = text_vg_import_buf(fid, ra->buf, (uint32_t) rlocn->size,
+					vg_fmtdata, use_previous_vg, single_device,
+					calc_crc, rlocn->checksum, &when, &desc);
+		_drop_read_ahead(ra);
+	} else
+		/* FIXME 64-bit */
+		vg = text_vg_import_fd(fid, NULL, vg_fmtdata, use_previous_vg, single_device, area->dev,
+				       (off_t) (area->start + rlocn->offset),
+				       (uint32_t) (rlocn->size - wrap),
+				       (off_t) (area->start + MDA_HEADER_SIZE),
+				       wrap, calc_crc, rlocn->checksum, &when,
+				       &desc);
+
+	if (!vg && (!use_previous_vg || !*use_previous_vg))
 		goto_out;
 
 	if (vg)
@@ -641,6 +700,11 @@ static int _vg_write_raw(struct format_instance *fid, struct volume_group *vg,
 		goto out;
 	}
 
+	/* lvmcache, lvmetad and the precommitted copy need the same text */
+	if ((vg->export_seqno != vg->seqno || !vg->export_buf) &&
+	    !vg_set_exported_text(vg, fidtc->raw_metadata_buf, fidtc->raw_metadata_buf_size))
+		goto_out;
+
 	mdac->rlocn.size = fidtc->raw_metadata_buf_size;
 
 	if (mdac->rlocn.offset + mdac->rlocn.size > mdah->size)
@@ -1686,6 +1750,8 @@ static void _free_raws(struct dm_list *raw_list)
 
 static void _text_destroy(struct format_type *fmt)
 {
+	_drop_read_aheads();
+
 	if (fmt->orphan_vg)
 		free_orphan_vg(fmt->orphan_vg);
 
@@ -2395,8 +2461,178 @@ static struct format_instance *_text_create_text_instance(const struct format_ty
 	return fid;
 }
 
+struct read_ahead_mda {
+	struct dm_list list;
+	struct device_area area;
+	struct device_read header;
+	struct device_read text[2];	/* Second one if wrapped */
+	struct read_ahead *ra;
+};
+
+struct read_ahead_baton {
+	const struct format_type *fmt;
+	struct dm_pool *mem;
+	struct dm_list mdas;
+	struct dm_list reads;
+};
+
+static int _read_ahead_mda(struct metadata_area *mda, void *baton)
+{
+	struct read_ahead_baton *rab = baton;
+	struct mda_context *mdac = (struct mda_context *) mda->metadata_locn;
+	struct read_ahead_mda *ram;
+
+	if (mda->ops != &_metadata_text_raw_ops || mda_is_ignored(mda))
+		return 1;
+
+	if (!(ram = dm_pool_zalloc(rab->mem, sizeof(*ram))) ||
+	    !(ram->header.buf = dm_pool_alloc(rab->mem, MDA_HEADER_SIZE)))
+		return_0;
+
+	if (!dev_open_readonly_quiet(mdac->area.dev))
+		return 1;
+
+	ram->area = mdac->area;
+	ram->header.where = mdac->area;
+	ram->header.where.size = MDA_HEADER_SIZE;
+	dm_list_add(&rab->mdas, &ram->list);
+	dm_list_add(&rab->reads, &ram->header.list);
+
+	return 1;
+}
+
+static int _read_ahead_pv(struct lvmcache_info *info, void *baton)
+{
+	struct read_ahead_baton *rab = baton;
+
+	if (lvmcache_fmt(info) != rab->fmt)
+		return 1;
+
+	return lvmcache_foreach_mda(info, _read_ahead_mda, baton);
+}
+
+static void _add_text_read(struct read_ahead_baton *rab, struct device_read *dr,
+			   struct device *dev, uint64_t start, uint64_t size,
+			   char *buf)
+{
+	dr->where.dev = dev;
+	dr->where.start = start;
+	dr->where.size = size;
+	dr->buf = buf;
+	dm_list_add(&rab->reads, &dr->list);
+}
+
+/*
+ * Read the mda headers of all the VGs with asynchronous io, then the
+ * committed metadata they point to.  Nothing here is trusted: the VG
+ * is not locked yet, so it is only kept for _vg_read_raw_area() to
+ * match against the header it reads once it is.
+ */
+static void _text_vgs_read_ahead(const struct format_type *fmt,
+				 const char **vgids, unsigned count)
+{
+	struct read_ahead_baton rab = { .fmt = fmt };
+	struct lvmcache_vginfo *vginfo;
+	struct read_ahead_mda *ram;
+	struct read_ahead *ra;
+	struct mda_header *mdah;
+	struct raw_locn *rlocn;
+	uint64_t wrap;
+	unsigned i, n = 0;
+
+	/* Whatever was not used by now is not going to be */
+	_drop_read_aheads();
+
+	if (!(rab.mem = dm_pool_create("read_ahead", 4096))) {
+		stack;
+		return;
+	}
+
+	dm_list_init(&rab.mdas);
+	dm_list_init(&rab.reads);
+
+	for (i = 0; i < count; i++)
+		if ((vginfo = lvmcache_vginfo_from_vgid(vgids[i])) &&
+		    !lvmcache_foreach_pv(vginfo, _read_ahead_pv, &rab)) {
+			stack;
+			break;
+		}
+
+	if (dm_list_empty(&rab.mdas))
+		goto out;
+
+	(void) dev_read_batch(&rab.reads);
+	dm_list_init(&rab.reads);
+
+	dm_list_iterate_items(ram, &rab.mdas) {
+		mdah = (struct mda_header *) ram->header.buf;
+		if (!ram->header.result ||
+		    mdah->checksum_xl != xlate32(calc_crc(INITIAL_CRC, (uint8_t *)mdah->magic,
+							  MDA_HEADER_SIZE -
+							  sizeof(mdah->checksum_xl))))
+			continue;
+
+		_xlate_mdah(mdah);
+		rlocn = mdah->raw_locns;
+
+		if (strncmp((char *)mdah->magic, FMTT_MAGIC, sizeof(mdah->magic)) ||
+		    mdah->start != ram->area.start || !rlocn->offset || !rlocn->size ||
+		    rlocn->offset >= mdah->size || rlocn->size > mdah->size)
+			continue;
+
+		wrap = (rlocn->offset + rlocn->size > mdah->size) ?
+			rlocn->offset + rlocn->size - mdah->size : 0;
+		if (wrap > rlocn->offset)
+			continue;
+
+		if (!(ra = dm_malloc(sizeof(*ra) + rlocn->size))) {
+			log_error("Failed to allocate metadata read ahead buffer.");
+			break;
+		}
+
+		ra->dev = ram->area.dev;
+		ra->start = ram->area.start;
+		ra->rlocn = *rlocn;
+		ra->buf = (char *) (ra + 1);
+		ram->ra = ra;
+
+		_add_text_read(&rab, &ram->text[0], ra->dev, ra->start + rlocn->offset,
+			       rlocn->size - wrap, ra->buf);
+		if (wrap)
+			_add_text_read(&rab, &ram->text[1], ra->dev, ra->start + MDA_HEADER_SIZE,
+				       wrap, ra->buf + rlocn->size - wrap);
+	}
+
+	(void) dev_read_batch(&rab.reads);
+
+	dm_list_iterate_items(ram, &rab.mdas) {
+		if (!(ra = ram->ra))
+			continue;
+
+		/* A read racing with a metadata update can be torn */
+		if (!ram->text[0].result || (ram->text[1].buf && !ram->text[1].result) ||
+		    calc_crc(INITIAL_CRC, (uint8_t *) ra->buf, (uint32_t) ra->rlocn.size) !=
+		    ra->rlocn.checksum) {
+			dm_free(ra);
+			continue;
+		}
+
+		dm_list_add(&_read_aheads, &ra->list);
+		n++;
+	}
+
+	log_debug_metadata("Read ahead metadata of %u VG(s) from %u area(s).", count, n);
+out:
+	dm_list_iterate_items(ram, &rab.mdas)
+		if (!dev_close(ram->area.dev))
+			stack;
+
+	dm_pool_destroy(rab.mem);
+}
+
 static struct format_handler _text_handler = {
 	.scan = _text_scan,
+	.vgs_read_ahead = _text_vgs_read_ahead,
 	.pv_read = _text_pv_read,
 	.pv_initialise = _text_pv_initialise,
 	.pv_setup = _text_pv_setup,
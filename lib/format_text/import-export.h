@@ -78,6 +78,15 @@ struct volume_group *text_vg_import_fd(struct format_instance *fid,
 				       uint32_t checksum,
 				       time_t *when, char **desc);
 
+struct volume_group *text_vg_import_buf(struct format_instance *fid,
+					const char *buf, uint32_t size,
+					struct cached_vg_fmtdata **vg_fmtdata,
+					unsigned *use_previous_vg,
+					int single_device,
+					checksum_fn_t checksum_fn,
+					uint32_t checksum,
+					time_t *when, char **desc);
+
 int text_vgsummary_import(const struct format_type *fmt,
 		       struct device *dev,
 		       off_t offset, uint32_t size,
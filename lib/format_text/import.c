@@ -91,17 +91,17 @@ struct cached_vg_fmtdata {
         size_t cached_mda_size;
 };
 
-struct volume_group *text_vg_import_fd(struct format_instance *fid,
-				       const char *file,
-				       struct cached_vg_fmtdata **vg_fmtdata,
-				       unsigned *use_previous_vg,
-				       int single_device,
-				       struct device *dev,
-				       off_t offset, uint32_t size,
-				       off_t offset2, uint32_t size2,
-				       checksum_fn_t checksum_fn,
-				       uint32_t checksum,
-				       time_t *when, char **desc)
+static struct volume_group *_text_vg_import(struct format_instance *fid,
+					    const char *file, const char *buf,
+					    struct cached_vg_fmtdata **vg_fmtdata,
+					    unsigned *use_previous_vg,
+					    int single_device,
+					    struct device *dev,
+					    off_t offset, uint32_t size,
+					    off_t offset2, uint32_t size2,
+					    checksum_fn_t checksum_fn,
+					    uint32_t checksum,
+					    time_t *when, char **desc)
 {
 	struct volume_group *vg = NULL;
 	struct dm_config_tree *cft;
@@ -127,7 +127,9 @@ struct volume_group *text_vg_import_fd(struct format_instance *fid,
 		     ((*vg_fmtdata)->cached_mda_checksum == checksum) &&
 		     ((*vg_fmtdata)->cached_mda_size == (size + size2));
 
-	if ((!dev && !config_file_read(cft)) ||
+	if ((buf && !config_file_read_buf(cft, buf, size, checksum_fn, checksum,
+					  skip_parse)) ||
+	    (!buf && !dev && !config_file_read(cft)) ||
 	    (dev && !config_file_read_fd(cft, dev, offset, size,
 					 offset2, size2, checksum_fn, checksum,
 					 skip_parse)))
@@ -166,6 +168,40 @@ struct volume_group *text_vg_import_fd(struct format_instance *fid,
 	return vg;
 }
 
+struct volume_group *text_vg_import_fd(struct format_instance *fid,
+				       const char *file,
+				       struct cached_vg_fmtdata **vg_fmtdata,
+				       unsigned *use_previous_vg,
+				       int single_device,
+				       struct device *dev,
+				       off_t offset, uint32_t size,
+				       off_t offset2, uint32_t size2,
+				       checksum_fn_t checksum_fn,
+				       uint32_t checksum,
+				       time_t *when, char **desc)
+{
+	return _text_vg_import(fid, file, NULL, vg_fmtdata, use_previous_vg,
+			       single_device, dev, offset, size, offset2, size2,
+			       checksum_fn, checksum, when, desc);
+}
+
+/*
+ * Import metadata already read into buf, e.g. read ahead of the VG lock.
+ */
+struct volume_group *text_vg_import_buf(struct format_instance *fid,
+					const char *buf, uint32_t size,
+					struct cached_vg_fmtdata **vg_fmtdata,
+					unsigned *use_previous_vg,
+					int single_device,
+					checksum_fn_t checksum_fn,
+					uint32_t checksum,
+					time_t *when, char **desc)
+{
+	return _text_vg_import(fid, NULL, buf, vg_fmtdata, use_previous_vg,
+			       single_device, NULL, (off_t)0, size, (off_t)0, 0,
+			       checksum_fn, checksum, when, desc);
+}
+
 struct volume_group *text_vg_import_file(struct format_instance *fid,
 					 const char *file,
 					 time_t *when, char **desc)
@@ -109,23 +109,28 @@ static void _update_lvmcache_orphan(struct lvmcache_info *info)
 		stack;
 }
 
-static struct labeller *_find_labeller(struct device *dev, char *buf,
-				       uint64_t *label_sector,
-				       uint64_t scan_sector)
+static void _label_not_found(struct device *dev)
+{
+	struct lvmcache_info *info;
+
+	if ((info = lvmcache_info_from_pvid(dev->pvid, dev, 0)))
+		_update_lvmcache_orphan(info);
+	log_very_verbose("%s: No label detected", dev_name(dev));
+}
+
+/*
+ * Look for a valid label in the LABEL_SCAN_SIZE bytes already read
+ * into readbuf from scan_sector and copy it into buf.
+ */
+static struct labeller *_find_labeller_in_buf(struct device *dev, char *readbuf,
+					      char *buf, uint64_t *label_sector,
+					      uint64_t scan_sector)
 {
 	struct labeller_i *li;
 	struct labeller *r = NULL;
 	struct label_header *lh;
-	struct lvmcache_info *info;
 	uint64_t sector;
 	int found = 0;
-	char readbuf[LABEL_SCAN_SIZE] __attribute__((aligned(8)));
-
-	if (!dev_read(dev, scan_sector << SECTOR_SHIFT,
-		      LABEL_SCAN_SIZE, readbuf)) {
-		log_debug_devs("%s: Failed to read label area", dev_name(dev));
-		goto out;
-	}
 
 	/* Scan a few sectors for a valid label */
 	for (sector = 0; sector < LABEL_SCAN_SECTORS;
@@ -182,16 +187,28 @@ static struct labeller *_find_labeller(struct device *dev, char *buf,
 		}
 	}
 
-      out:
-	if (!found) {
-		if ((info = lvmcache_info_from_pvid(dev->pvid, dev, 0)))
-			_update_lvmcache_orphan(info);
-		log_very_verbose("%s: No label detected", dev_name(dev));
-	}
+	if (!found)
+		_label_not_found(dev);
 
 	return r;
 }
 
+static struct labeller *_find_labeller(struct device *dev, char *buf,
+				       uint64_t *label_sector,
+				       uint64_t scan_sector)
+{
+	char readbuf[LABEL_SCAN_SIZE] __attribute__((aligned(8)));
+
+	if (!dev_read(dev, scan_sector << SECTOR_SHIFT,
+		      LABEL_SCAN_SIZE, readbuf)) {
+		log_debug_devs("%s: Failed to read label area", dev_name(dev));
+		_label_not_found(dev);
+		return NULL;
+	}
+
+	return _find_labeller_in_buf(dev, readbuf, buf, label_sector, scan_sector);
+}
+
 /* FIXME Also wipe associated metadata area headers? */
 int label_remove(struct device *dev)
 {
@@ -262,14 +279,27 @@ int label_remove(struct device *dev)
 	return r;
 }
 
-int label_read(struct device *dev, struct label **result,
-		uint64_t scan_sector)
+static int _label_read_labeller(struct labeller *l, struct device *dev, char *buf,
+				uint64_t sector, struct label **result)
+{
+	int r;
+
+	if ((r = (l->ops->read)(l, dev, buf, result)) && result && *result) {
+		(*result)->dev = dev;
+		(*result)->sector = sector;
+	}
+
+	return r;
+}
+
+/*
+ * Returns 1 if the label is already known to lvmcache.
+ * Returns 0 if the device is now open and must be read.
+ * Returns -1 if the device could not be opened.
+ */
+static int _label_read_prepare(struct device *dev, struct label **result)
 {
-	char buf[LABEL_SIZE] __attribute__((aligned(8)));
-	struct labeller *l;
-	uint64_t sector;
 	struct lvmcache_info *info;
-	int r = 0;
 
 	if ((info = lvmcache_info_from_pvid(dev->pvid, dev, 1))) {
 		log_debug_devs("Reading label from lvmcache for %s", dev_name(dev));
@@ -285,14 +315,25 @@ int label_read(struct device *dev, struct label **result,
 		if ((info = lvmcache_info_from_pvid(dev->pvid, dev, 0)))
 			_update_lvmcache_orphan(info);
 
-		return r;
+		return -1;
 	}
 
+	return 0;
+}
+
+int label_read(struct device *dev, struct label **result,
+		uint64_t scan_sector)
+{
+	char buf[LABEL_SIZE] __attribute__((aligned(8)));
+	struct labeller *l;
+	uint64_t sector;
+	int r;
+
+	if ((r = _label_read_prepare(dev, result)))
+		return (r > 0) ? 1 : 0;
+
 	if ((l = _find_labeller(dev, buf, &sector, scan_sector)))
-		if ((r = (l->ops->read)(l, dev, buf, result)) && result && *result) {
-			(*result)->dev = dev;
-			(*result)->sector = sector;
-		}
+		r = _label_read_labeller(l, dev, buf, sector, result);
 
 	if (!dev_close(dev))
 		stack;
@@ -300,6 +341,88 @@ int label_read(struct device *dev, struct label **result,
 	return r;
 }
 
+/*
+ * Label areas read by one batch in label_read_devs().
+ * The batch size is bounded so that all its devices
+ * can be held open at once without exhausting descriptors.
+ */
+#define LABEL_READ_BATCH 256
+
+struct label_read_req {
+	struct device_read dr;
+	char readbuf[LABEL_SCAN_SIZE] __attribute__((aligned(8)));
+};
+
+static void _label_read_batch(struct dm_list *batch)
+{
+	char buf[LABEL_SIZE] __attribute__((aligned(8)));
+	struct label_read_req *req;
+	struct labeller *l;
+	struct label *label;
+	struct device *dev;
+	uint64_t sector;
+
+	(void) dev_read_batch(batch);
+
+	dm_list_iterate_items_gen(req, batch, dr.list) {
+		dev = req->dr.where.dev;
+
+		if (!req->dr.result) {
+			log_debug_devs("%s: Failed to read label area", dev_name(dev));
+			_label_not_found(dev);
+		} else if ((l = _find_labeller_in_buf(dev, req->readbuf, buf, &sector, UINT64_C(0))))
+			(void) _label_read_labeller(l, dev, buf, sector, &label);
+
+		if (!dev_close(dev))
+			stack;
+	}
+
+	dm_list_init(batch);
+}
+
+/*
+ * Equivalent to calling label_read() for each device on the list,
+ * but the label areas of up to LABEL_READ_BATCH devices are read
+ * together by a single dev_read_batch().
+ */
+void label_read_devs(struct dm_list *devs)
+{
+	struct label_read_req *reqs;
+	struct device_list *devl;
+	struct dm_list batch;
+	struct label *label;
+	unsigned n = 0;
+
+	if (!(reqs = dm_malloc(LABEL_READ_BATCH * sizeof(*reqs)))) {
+		log_debug_devs("Failed to allocate label read batch.");
+		dm_list_iterate_items(devl, devs)
+			(void) label_read(devl->dev, &label, UINT64_C(0));
+		return;
+	}
+
+	dm_list_init(&batch);
+
+	dm_list_iterate_items(devl, devs) {
+		if (_label_read_prepare(devl->dev, &label))
+			continue;
+
+		reqs[n].dr.where.dev = devl->dev;
+		reqs[n].dr.where.start = UINT64_C(0);
+		reqs[n].dr.where.size = LABEL_SCAN_SIZE;
+		reqs[n].dr.buf = reqs[n].readbuf;
+		dm_list_add(&batch, &reqs[n].dr.list);
+
+		if (++n == LABEL_READ_BATCH) {
+			_label_read_batch(&batch);
+			n = 0;
+		}
+	}
+
+	_label_read_batch(&batch);
+
+	dm_free(reqs);
+}
+
 /* Caller may need to use label_get_handler to create label struct! */
 int label_write(struct device *dev, struct label *label)
 {
@@ -277,6 +277,7 @@ static int _lock_vol(struct cmd_context *cmd, const char *resource,
 			if (lck_type != LCK_UNLOCK)
 				lvmcache_lock_vgname(resource, lck_type == LCK_READ);
 			dev_reset_error_count(cmd);
+			dev_drop_cached_blocks();
 		}
 
 		_update_vg_lock_count(resource, flags);
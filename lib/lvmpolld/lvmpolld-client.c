@@ -41,7 +41,8 @@ static daemon_handle _lvmpolld_open(const char *socket)
 		.path = "lvmpolld",
 		.socket = socket ?: LVMPOLLD_SOCKET,
 		.protocol = LVMPOLLD_PROTOCOL,
-		.protocol_version = LVMPOLLD_PROTOCOL_VERSION
+		.protocol_version = LVMPOLLD_PROTOCOL_VERSION,
+		.binary = 1
 	};
 
 	return daemon_open(lvmpolld_info);
@@ -76,6 +76,17 @@ struct alloc_state {
 	uint32_t num_positional_areas;	/* Number of parallel allocations that must be contiguous/cling */
 };
 
+/*
+ * Free space maps shared by the allocations of lv_create_batch().
+ * Each allocation consumes what it takes from them, so they stay
+ * valid for the next one as long as nothing else changes the VG.
+ */
+struct alloc_batch {
+	struct dm_pool *mem;
+	struct dm_list *allocatable_pvs;	/* pvms were built for */
+	struct dm_list *pvms;
+};
+
 struct lv_names {
 	const char *old;
 	const char *new;
@@ -2496,13 +2507,10 @@ static uint32_t _calc_required_extents(struct alloc_handle *ah, struct pv_area *
 	} else if (required < ah->log_len)
 		required = ah->log_len;
 
-	if (required >= pva->unreserved) {
+	if (required >= pva->unreserved)
 		required = pva->unreserved;
-		pva->unreserved = 0;
-	} else {
-		pva->unreserved -= required;
-		reinsert_changed_pv_area(pva);
-	}
+
+	reserve_pv_area(pva, required);
 
 	return required;
 }
@@ -2517,19 +2525,6 @@ static void _clear_areas(struct alloc_state *alloc_state)
 		alloc_state->areas[s].pva = NULL;
 }
 
-static void _reset_unreserved(struct dm_list *pvms)
-{
-	struct pv_map *pvm;
-	struct pv_area *pva;
-
-	dm_list_iterate_items(pvm, pvms)
-		dm_list_iterate_items(pva, &pvm->areas)
-			if (pva->unreserved != pva->count) {
-				pva->unreserved = pva->count;
-				reinsert_changed_pv_area(pva);
-			}
-}
-
 static void _report_needed_allocation_space(struct alloc_handle *ah,
 					    struct alloc_state *alloc_state,
 					    struct dm_list *pvms)
@@ -2623,7 +2618,7 @@ static int _find_some_parallel_space(struct alloc_handle *ah,
 	uint32_t required;
 
 	_clear_areas(alloc_state);
-	_reset_unreserved(pvms);
+	reset_unreserved_pv_areas(pvms);
 
 	/* num_positional_areas holds the number of parallel allocations that must be contiguous/cling */
 	/* These appear first in the array, so it is also the offset to the non-preferred allocations */
@@ -2953,6 +2948,33 @@ static int _find_max_parallel_space_for_one_policy(struct alloc_handle *ah, stru
 	return 1;
 }
 
+/*
+ * Build the sets of available areas on the pv's, or reuse those
+ * left by the previous allocation of the same batch.
+ */
+static struct dm_list *_get_pv_maps(struct alloc_handle *ah,
+				    struct volume_group *vg,
+				    struct dm_list *allocatable_pvs)
+{
+	struct alloc_batch *batch = vg->alloc_batch;
+
+	if (!batch)
+		return create_pv_maps(ah->mem, vg, allocatable_pvs);
+
+	if (batch->pvms && batch->allocatable_pvs == allocatable_pvs)
+		return reset_pv_maps(batch->pvms) ? batch->pvms : NULL;
+
+	batch->pvms = NULL;
+	dm_pool_empty(batch->mem);
+
+	if (!(batch->pvms = create_pv_maps(batch->mem, vg, allocatable_pvs)))
+		return_NULL;
+
+	batch->allocatable_pvs = allocatable_pvs;
+
+	return batch->pvms;
+}
+
 /*
  * Allocate several segments, each the same size, in parallel.
  * If mirrored_pv and mirrored_pe are supplied, it is used as
@@ -2995,10 +3017,7 @@ static int _allocate(struct alloc_handle *ah,
 	if (lv && !dm_list_empty(&lv->segments))
 		prev_lvseg = dm_list_item(dm_list_last(&lv->segments),
 				       struct lv_segment);
-	/*
-	 * Build the sets of available areas on the pv's.
-	 */
-	if (!(pvms = create_pv_maps(ah->mem, vg, allocatable_pvs)))
+	if (!(pvms = _get_pv_maps(ah, vg, allocatable_pvs)))
 		return_0;
 
 	if (!_log_parallel_areas(ah->mem, ah->parallel_areas))
@@ -3094,6 +3113,10 @@ static int _allocate(struct alloc_handle *ah,
 	r = 1;
 
       out:
+	/* Areas may have been consumed by a failed allocation */
+	if (!r && vg->alloc_batch)
+		vg->alloc_batch->pvms = NULL;
+
 	dm_free(alloc_state.areas);
 	return r;
 }
@@ -7495,6 +7518,10 @@ static struct logical_volume *_lv_create_an_lv(struct volume_group *vg,
 	if (lv_activation_skip(lv, lp->activate, lp->activation_skip & ACTIVATION_SKIP_IGNORE))
 		lp->activate = CHANGE_AN;
 
+	/* Written, activated and wiped together with the rest of the batch */
+	if (lp->batch)
+		goto out;
+
 	/* store vg on disk(s) */
 	if (!vg_write(vg) || !vg_commit(vg))
 		/* Pool created metadata LV, but better avoid recover when vg_write/commit fails */
@@ -7783,3 +7810,154 @@ struct logical_volume *lv_create_single(struct volume_group *vg,
 
 	return lv;
 }
+
+static int _lv_create_batch_activate(struct cmd_context *cmd,
+				     struct logical_volume *lv,
+				     struct lvcreate_params *lp)
+{
+	if (_should_wipe_lv(lp, lv, 0))
+		lv->status |= LV_NOSCAN;
+
+	if (!lv_active_change(cmd, lv, lp->activate, 0)) {
+		log_error("Failed to activate new LV %s.", display_lvname(lv));
+		return 0;
+	}
+
+	if (_should_wipe_lv(lp, lv, !lp->suppress_zero_warn) &&
+	    !wipe_lv(lv, (struct wipe_params)
+		     {
+			     .do_zero = lp->zero,
+			     .do_wipe_signatures = lp->wipe_signatures,
+			     .yes = lp->yes,
+			     .force = lp->force
+		     })) {
+		log_error("Aborting. Failed to wipe start of new LV %s.",
+			  display_lvname(lv));
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Create 'count' LVs described by 'lps' with one metadata update.
+ *
+ * All allocations are made against one set of free space maps, so each
+ * one sees the extents taken by the LVs before it without mapping the
+ * VG again, and nothing is written until every LV has been allocated.
+ * If that fails the VG has been changed in memory only and the caller
+ * must not write it.
+ *
+ * Only linear, striped and thin volumes in an existing pool are
+ * supported.  Thin pools with queued messages for new thin volumes get
+ * them sent (and another commit) before the thin volumes are activated.
+ */
+int lv_create_batch(struct volume_group *vg, struct lvcreate_params *lps,
+		    unsigned count)
+{
+	struct cmd_context *cmd = vg->cmd;
+	struct alloc_batch batch = { 0 };
+	struct logical_volume **lvs;
+	struct logical_volume *pool_lv;
+	struct dm_list inactive_pools;
+	struct lv_list *lvl, *pool_lvl;
+	unsigned i;
+	int r = 1;
+
+	for (i = 0; i < count; i++)
+		if (lps[i].create_pool || lps[i].snapshot || lps[i].origin_name ||
+		    lps[i].log_count ||
+		    (!seg_is_striped(&lps[i]) && !seg_is_thin_volume(&lps[i]))) {
+			log_error(INTERNAL_ERROR "Cannot create %s volume %s in a batch.",
+				  lps[i].segtype->name, lps[i].lv_name ? : "");
+			return 0;
+		}
+
+	if (!(lvs = dm_pool_zalloc(cmd->mem, count * sizeof(*lvs))))
+		return_0;
+
+	if (!(batch.mem = dm_pool_create("allocation batch", 1024))) {
+		log_error("allocation batch pool creation failed");
+		return 0;
+	}
+
+	vg->alloc_batch = &batch;
+
+	for (i = 0; i < count; i++) {
+		lps[i].batch = 1;
+		if (!(lvs[i] = _lv_create_an_lv(vg, &lps[i], lps[i].lv_name))) {
+			stack;
+			r = 0;
+			break;
+		}
+	}
+
+	vg->alloc_batch = NULL;
+	dm_pool_destroy(batch.mem);
+
+	if (!r)
+		return 0;
+
+	/* store vg on disk(s) */
+	if (!vg_write(vg) || !vg_commit(vg))
+		return_0;
+
+	backup(vg);
+
+	for (i = 0; i < count; i++)
+		log_print_unless_silent("Logical volume \"%s\" created.", lvs[i]->name);
+
+	if (test_mode()) {
+		log_verbose("Test mode: Skipping activation, zeroing and signature wiping.");
+		return 1;
+	}
+
+	/* Send create messages of new thin volumes, as lv_create_single() does */
+	dm_list_init(&inactive_pools);
+	dm_list_iterate_items(lvl, &vg->lvs) {
+		pool_lv = lvl->lv;
+		if (!lv_is_thin_pool(pool_lv) ||
+		    dm_list_empty(&first_seg(pool_lv)->thin_messages))
+			continue;
+
+		if (!lv_is_active(pool_lv)) {
+			if (!activate_lv_excl(cmd, pool_lv) || !lv_is_active(pool_lv)) {
+				log_error("Failed to activate thin pool %s.",
+					  display_lvname(pool_lv));
+				return 0;
+			}
+			if (!(pool_lvl = dm_pool_alloc(cmd->mem, sizeof(*pool_lvl))))
+				return_0;
+			pool_lvl->lv = pool_lv;
+			dm_list_add(&inactive_pools, &pool_lvl->list);
+		}
+
+		if (!update_pool_lv(pool_lv, 1))
+			return_0;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (_lv_create_batch_activate(cmd, lvs[i], &lps[i]))
+			continue;
+
+		r = 0;
+		lockd_free_lv(cmd, vg, lvs[i]->name, &lvs[i]->lvid.id[1], lps[i].lock_args);
+
+		if (!deactivate_lv(cmd, lvs[i]) ||
+		    !lv_remove(lvs[i]) || !vg_write(vg) || !vg_commit(vg))
+			log_error("Manual intervention may be required to remove "
+				  "abandoned LV(s) before retrying.");
+		else
+			backup(vg);
+	}
+
+	/* Restore inactive state of pools */
+	dm_list_iterate_items(lvl, &inactive_pools)
+		if (!deactivate_lv(cmd, lvl->lv)) {
+			log_error("Failed to deactivate thin pool %s.",
+				  display_lvname(lvl->lv));
+			r = 0;
+		}
+
+	return r;
+}
@@ -704,6 +704,8 @@ struct volume_group *vg_read(struct cmd_context *cmd, const char *vg_name,
 			     const char *vgid, uint32_t read_flags, uint32_t lockd_state);
 struct volume_group *vg_read_for_update(struct cmd_context *cmd, const char *vg_name,
 			 const char *vgid, uint32_t read_flags, uint32_t lockd_state);
+void vg_read_ahead(struct cmd_context *cmd, struct dm_list *vgnameids,
+		   struct vgnameid_list *vgnl, unsigned count);
 
 /* 
  * Test validity of a VG handle.
@@ -924,6 +926,7 @@ struct lvcreate_params {
 	int thin_chunk_size_calc_policy;
 	unsigned suppress_zero_warn : 1;
 	unsigned needs_lockd_init : 1;
+	unsigned batch : 1; /* written and activated by lv_create_batch() */
 
 	const char *vg_name; /* only-used when VG is not yet opened (in /tools) */
 	const char *lv_name; /* all */
@@ -983,6 +986,8 @@ struct lvcreate_params {
 
 struct logical_volume *lv_create_single(struct volume_group *vg,
 					struct lvcreate_params *lp);
+int lv_create_batch(struct volume_group *vg, struct lvcreate_params *lps,
+		    unsigned count);
 
 /*
  * The activation can be skipped for selected LVs. Some LVs are skipped
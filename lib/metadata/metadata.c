@@ -1038,7 +1038,7 @@ static int _vg_update_vg_precommitted(struct volume_group *vg)
 		vg->cft_precommitted = NULL;
 	}
 
-	if (!(vg->cft_precommitted = export_vg_to_config_tree(vg)))
+	if (!(vg->cft_precommitted = export_vg_written_to_config_tree(vg)))
 		return_0;
 
 	if (!(vg->vg_precommitted = import_vg_from_config_tree(vg->cft_precommitted, vg->fid))) {
@@ -1047,6 +1047,12 @@ static int _vg_update_vg_precommitted(struct volume_group *vg)
 		return_0;
 	}
 
+	/* Precommitted copy becomes vg_committed sent to lvmetad */
+	if (vg->export_buf && (vg->export_seqno == vg->seqno) &&
+	    (vg->vg_precommitted->seqno == vg->seqno) &&
+	    !vg_set_exported_text(vg->vg_precommitted, vg->export_buf, vg->export_size))
+		stack;
+
 	return 1;
 }
 
@@ -3412,13 +3418,46 @@ static int _handle_historical_lvs(struct volume_group *vg)
  * After vg_write() returns success,
  * caller MUST call either vg_commit() or vg_revert()
  */
+static uint64_t _monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double _ms_since(uint64_t start_ns)
+{
+	return (_monotonic_ns() - start_ns) / 1000000.0;
+}
+
+/*
+ * Writes of every metadata area are queued while its ops run and
+ * issued together afterwards.  Returns 0 if any write queued for the
+ * metadata area failed.
+ */
+static int _mda_writes_succeeded(struct dm_list *writes, struct metadata_area *mda)
+{
+	struct device_write *dw;
+
+	dm_list_iterate_items(dw, writes)
+		if ((dw->context == mda) && !dw->result)
+			return 0;
+
+	return 1;
+}
+
 int vg_write(struct volume_group *vg)
 {
 	struct dm_list *mdah;
 	struct pv_to_write *pv_to_write, *pv_to_write_safe;
 	struct pv_list *pvl, *pvl_safe;
-	struct metadata_area *mda;
+	struct metadata_area *mda, *wmda;
 	struct lv_list *lvl;
+	struct dm_list writes;
+	uint64_t start_ns;
+	double write_ms;
 	int revert = 0, wrote = 0;
 
 	dm_list_iterate_items(lvl, &vg->lvs) {
@@ -3482,6 +3521,7 @@ int vg_write(struct volume_group *vg)
 
 	/* Unlock memory if possible */
 	memlock_unlock(vg->cmd);
+	vg_drop_exported_text(vg);
 	vg->seqno++;
 
 	dm_list_iterate_items_safe(pvl, pvl_safe, &vg->pv_write_list) {
@@ -3496,7 +3536,9 @@ int vg_write(struct volume_group *vg)
 		dm_list_del(&pv_to_write->list);
 	}
 
-	/* Write to each copy of the metadata area */
+	/* Write to each copy of the metadata area, all at once */
+	start_ns = _monotonic_ns();
+	dm_list_init(&writes);
 	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
 		if (!mda->ops->vg_write) {
 			log_error("Format does not support writing volume"
@@ -3504,6 +3546,7 @@ int vg_write(struct volume_group *vg)
 			revert = 1;
 			break;
 		}
+		dev_defer_writes(&writes, mda);
 		if (!mda->ops->vg_write(vg->fid, vg, mda)) {
 			if (vg->cmd->handles_missing_pvs) {
 				log_warn("WARNING: Failed to write an MDA of VG %s.", vg->name);
@@ -3517,8 +3560,24 @@ int vg_write(struct volume_group *vg)
 			++ wrote;
 	}
 
+	if (!dev_write_batch(&writes))
+		dm_list_iterate_items(wmda, &vg->fid->metadata_areas_in_use) {
+			if ((wmda->status & MDA_FAILED) ||
+			    _mda_writes_succeeded(&writes, wmda))
+				continue;
+			if (vg->cmd->handles_missing_pvs) {
+				log_warn("WARNING: Failed to write an MDA of VG %s.", vg->name);
+				wmda->status |= MDA_FAILED;
+				--wrote;
+			} else
+				revert = 1;
+		}
+	dev_free_writes(&writes);
+	write_ms = _ms_since(start_ns);
+
 	if (revert || !wrote) {
 		log_error("Failed to write VG %s.", vg->name);
+		vg_drop_exported_text(vg);
 		dm_list_uniterate(mdah, &vg->fid->metadata_areas_in_use, &mda->list) {
 			mda = dm_list_item(mdah, struct metadata_area);
 
@@ -3530,26 +3589,44 @@ int vg_write(struct volume_group *vg)
 		return 0;
 	}
 
-	/* Now pre-commit each copy of the new metadata */
+	/*
+	 * Now pre-commit each copy of the new metadata. Every metadata
+	 * text write above has completed before any header points at it.
+	 */
+	start_ns = _monotonic_ns();
+	dev_defer_writes(&writes, NULL);
 	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
 		if (mda->status & MDA_FAILED)
 			continue;
 		if (mda->ops->vg_precommit &&
 		    !mda->ops->vg_precommit(vg->fid, vg, mda)) {
 			stack;
-			/* Revert */
-			dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
-				if (mda->status & MDA_FAILED)
-					continue;
-				if (mda->ops->vg_revert &&
-				    !mda->ops->vg_revert(vg->fid, vg, mda)) {
-					stack;
-				}
+			revert = 1;
+			break;
+		}
+	}
+
+	if (!dev_write_batch(&writes))
+		revert = 1;
+	dev_free_writes(&writes);
+
+	if (revert) {
+		vg_drop_exported_text(vg);
+		dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
+			if (mda->status & MDA_FAILED)
+				continue;
+			if (mda->ops->vg_revert &&
+			    !mda->ops->vg_revert(vg->fid, vg, mda)) {
+				stack;
 			}
-			return 0;
 		}
+		return 0;
 	}
 
+	log_verbose("Wrote metadata of VG %s seqno %" PRIu32 " to %d area(s): "
+		    "%.3f ms writing, %.3f ms precommitting.", vg->name,
+		    vg->seqno, wrote, write_ms, _ms_since(start_ns));
+
 	if (!_vg_update_vg_precommitted(vg)) /* prepare precommited */
 		return_0;
 
@@ -3573,7 +3650,10 @@ static int _vg_commit_mdas(struct volume_group *vg)
 {
 	struct metadata_area *mda, *tmda;
 	struct dm_list ignored;
-	int failed = 0;
+	struct dm_list writes;
+	uint64_t start_ns = _monotonic_ns();
+	unsigned count = 0, i = 0, committed = 0;
+	int *failed;
 	int cache_updated = 0;
 
 	/* Rearrange the metadata_areas_in_use so ignored mdas come first. */
@@ -3585,23 +3665,56 @@ static int _vg_commit_mdas(struct volume_group *vg)
 	dm_list_iterate_items_safe(mda, tmda, &ignored)
 		dm_list_move(&vg->fid->metadata_areas_in_use, &mda->list);
 
-	/* Commit to each copy of the metadata area */
+	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use)
+		count++;
+
+	if (!(failed = dm_zalloc(count * sizeof(*failed) + 1))) {
+		log_error("Failed to allocate metadata commit results.");
+		return 0;
+	}
+
+	/* Commit to each copy of the metadata area, all at once */
+	dm_list_init(&writes);
 	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
-		if (mda->status & MDA_FAILED)
+		if (mda->status & MDA_FAILED) {
+			failed[i++] = 1;
 			continue;
-		failed = 0;
+		}
+		dev_defer_writes(&writes, mda);
 		if (mda->ops->vg_commit &&
 		    !mda->ops->vg_commit(vg->fid, vg, mda)) {
 			stack;
-			failed = 1;
+			failed[i] = 1;
+		}
+		i++;
+	}
+
+	(void) dev_write_batch(&writes);
+
+	i = 0;
+	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
+		if (failed[i++])
+			continue;
+		if (!_mda_writes_succeeded(&writes, mda)) {
+			log_error("Failed to commit metadata of VG %s to an MDA.", vg->name);
+			continue;
 		}
+		committed++;
 		/* Update cache first time we succeed */
-		if (!failed && !cache_updated) {
+		if (!cache_updated) {
 			lvmcache_update_vg(vg, 0);
 			// lvmetad_vg_commit(vg);
 			cache_updated = 1;
 		}
 	}
+
+	dev_free_writes(&writes);
+	dm_free(failed);
+
+	log_verbose("Committed metadata of VG %s seqno %" PRIu32 " to %u of %u "
+		    "area(s) in %.3f ms.", vg->name, vg->seqno, committed, count,
+		    _ms_since(start_ns));
+
 	return cache_updated;
 }
 
@@ -3645,6 +3758,9 @@ int vg_commit(struct volume_group *vg)
 		log_error("Attempt to drop cached metadata failed "
 			  "after commit for VG %s.", vg->name);
 
+	/* Changes made from now on are not in the written text */
+	vg_drop_exported_text(vg);
+
 	/* If at least one mda commit succeeded, it was committed */
 	return cache_updated;
 }
@@ -3672,6 +3788,7 @@ void vg_revert(struct volume_group *vg)
 
 	release_vg(vg->vg_precommitted);  /* VG is no longer needed */
 	vg->vg_precommitted = NULL;
+	vg_drop_exported_text(vg);
 	if (vg->cft_precommitted) {
 		dm_config_destroy(vg->cft_precommitted);
 		vg->cft_precommitted = NULL;
@@ -5929,6 +6046,37 @@ struct volume_group *vg_read_for_update(struct cmd_context *cmd, const char *vg_
 	return vg_read(cmd, vg_name, vgid, read_flags | READ_FOR_UPDATE, lockd_state);
 }
 
+/*
+ * Read ahead the metadata of up to count VGs on the vgnameids list,
+ * starting at vgnl, for vg_read() to use if it is still current once
+ * each VG is locked.
+ */
+void vg_read_ahead(struct cmd_context *cmd, struct dm_list *vgnameids,
+		   struct vgnameid_list *vgnl, unsigned count)
+{
+	const char **vgids;
+	unsigned i, n = 0;
+
+	/* With lvmetad, vg_read() does not read metadata from disk */
+	if (!cmd->fmt->ops->vgs_read_ahead || lvmetad_used() || !count)
+		return;
+
+	if (!(vgids = dm_malloc(count * sizeof(*vgids)))) {
+		log_error("Failed to allocate VG read ahead list.");
+		return;
+	}
+
+	for (i = 0; &vgnl->list != vgnameids && i < count;
+	     i++, vgnl = dm_list_item(vgnl->list.n, struct vgnameid_list))
+		if (vgnl->vgid && !is_orphan_vg(vgnl->vg_name))
+			vgids[n++] = vgnl->vgid;
+
+	if (n)
+		cmd->fmt->ops->vgs_read_ahead(cmd->fmt, vgids, n);
+
+	dm_free(vgids);
+}
+
 /*
  * Test the validity of a VG handle returned by vg_read() or vg_read_for_update().
  */
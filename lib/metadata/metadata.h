@@ -246,6 +246,13 @@ struct format_handler {
 	 */
 	int (*scan) (const struct format_type * fmt, const char *vgname);
 
+	/*
+	 * Optional. Read ahead the metadata of the VGs with the given ids
+	 * in one go, for the vg_read() of each VG to check and use later.
+	 */
+	void (*vgs_read_ahead) (const struct format_type * fmt,
+				const char **vgids, unsigned count);
+
 	/*
 	 * Return PV with given path.
 	 */
@@ -471,6 +478,8 @@ void lv_calculate_readahead(const struct logical_volume *lv, uint32_t *read_ahea
  */
 size_t export_vg_to_buffer(struct volume_group *vg, char **buf);
 struct dm_config_tree *export_vg_to_config_tree(struct volume_group *vg);
+size_t export_vg_written_to_buffer(struct volume_group *vg, char **buf);
+struct dm_config_tree *export_vg_written_to_config_tree(struct volume_group *vg);
 struct volume_group *import_vg_from_buffer(const char *buf,
 					   struct format_instance *fid);
 struct volume_group *import_vg_from_config_tree(const struct dm_config_tree *cft,
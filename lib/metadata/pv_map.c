@@ -56,7 +56,12 @@ static int _create_single_area(struct dm_pool *mem, struct pv_map *pvm,
 	pva->start = start;
 	pva->count = length;
 	pva->unreserved = pva->count;
-	_insert_area(&pvm->areas, pva, 0);
+	pva->index = pvm->nr_areas;
+
+	/* Put in size order by _sort_areas() once all areas exist */
+	dm_list_add(&pvm->areas, &pva->list);
+	pvm->pe_count += pva->count;
+	pvm->nr_areas++;
 
 	return 1;
 }
@@ -127,6 +132,57 @@ static int _create_all_areas_for_pv(struct dm_pool *mem, struct pv_map *pvm,
 	return 1;
 }
 
+static void _merge_sort_areas(struct pv_area **areas, struct pv_area **tmp, uint32_t n)
+{
+	uint32_t i, j, k, m = n / 2;
+
+	if (n < 2)
+		return;
+
+	_merge_sort_areas(areas, tmp, m);
+	_merge_sort_areas(areas + m, tmp, n - m);
+
+	/* Equal sizes keep the order they were created in */
+	for (i = 0, j = m, k = 0; k < n; k++)
+		tmp[k] = (j == n || (i < m && (areas[i]->count > areas[j]->count ||
+					       (areas[i]->count == areas[j]->count &&
+						areas[i]->index < areas[j]->index)))) ?
+			 areas[i++] : areas[j++];
+
+	memcpy(areas, tmp, sizeof(*areas) * n);
+}
+
+/*
+ * Order the areas as inserting them one by one with _insert_area()
+ * on creation would, without walking the list for each of them.
+ */
+static int _sort_areas(struct pv_map *pvm)
+{
+	struct pv_area **areas, *pva;
+	uint32_t i = 0;
+
+	if (pvm->nr_areas < 2)
+		return 1;
+
+	if (!(areas = dm_malloc(sizeof(*areas) * pvm->nr_areas * 2))) {
+		log_error("Failed to allocate PV area sort buffer.");
+		return 0;
+	}
+
+	dm_list_iterate_items(pva, &pvm->areas)
+		areas[i++] = pva;
+
+	_merge_sort_areas(areas, areas + pvm->nr_areas, pvm->nr_areas);
+
+	dm_list_init(&pvm->areas);
+	for (i = 0; i < pvm->nr_areas; i++)
+		dm_list_add(&pvm->areas, &areas[i]->list);
+
+	dm_free(areas);
+
+	return 1;
+}
+
 static int _create_maps(struct dm_pool *mem, struct dm_list *pvs, struct dm_list *pvms)
 {
 	struct pv_map *pvm, *pvm2;
@@ -163,6 +219,10 @@ static int _create_maps(struct dm_pool *mem, struct dm_list *pvs, struct dm_list
 			return_0;
 	}
 
+	dm_list_iterate_items(pvm, pvms)
+		if (!_sort_areas(pvm))
+			return_0;
+
 	return 1;
 }
 
@@ -193,11 +253,16 @@ struct dm_list *create_pv_maps(struct dm_pool *mem, struct volume_group *vg,
 
 void consume_pv_area(struct pv_area *pva, uint32_t to_go)
 {
+	if (pva->unreserved != pva->count)
+		pva->map->nr_reserved--;
+
 	_remove_area(pva);
 
 	assert(to_go <= pva->count);
 
-	if (to_go < pva->count) {
+	if (to_go == pva->count)
+		pva->map->nr_areas--;
+	else {
 		/* split the area */
 		pva->start += to_go;
 		pva->count -= to_go;
@@ -206,6 +271,23 @@ void consume_pv_area(struct pv_area *pva, uint32_t to_go)
 	}
 }
 
+/*
+ * Provisionally allocate extents from an area during an allocation pass.
+ * A fully reserved area stays where it is.
+ */
+void reserve_pv_area(struct pv_area *pva, uint32_t required)
+{
+	assert(required <= pva->unreserved);
+
+	if (pva->unreserved == pva->count && required)
+		pva->map->nr_reserved++;
+
+	pva->unreserved -= required;
+
+	if (pva->unreserved)
+		reinsert_changed_pv_area(pva);
+}
+
 /*
  * Remove an area from list and reinsert it based on its new size
  * after a provisional allocation (or reverting one).
@@ -216,6 +298,49 @@ void reinsert_changed_pv_area(struct pv_area *pva)
 	_insert_area(&pva->map->areas, pva, 1);
 }
 
+/*
+ * Revert all provisional allocations, visiting only the PVs that have any.
+ */
+void reset_unreserved_pv_areas(struct dm_list *pvms)
+{
+	struct pv_map *pvm;
+	struct pv_area *pva;
+
+	dm_list_iterate_items(pvm, pvms) {
+		if (!pvm->nr_reserved)
+			continue;
+
+		dm_list_iterate_items(pva, &pvm->areas)
+			if (pva->unreserved != pva->count) {
+				pva->unreserved = pva->count;
+				pvm->nr_reserved--;
+				reinsert_changed_pv_area(pva);
+			}
+	}
+}
+
+/*
+ * Drop provisional allocations and put the areas back in the order
+ * create_pv_maps() would give the free space left, so maps can be
+ * reused for another allocation.
+ */
+int reset_pv_maps(struct dm_list *pvms)
+{
+	struct pv_map *pvm;
+	struct pv_area *pva;
+
+	dm_list_iterate_items(pvm, pvms) {
+		dm_list_iterate_items(pva, &pvm->areas)
+			pva->unreserved = pva->count;
+		pvm->nr_reserved = 0;
+
+		if (!_sort_areas(pvm))
+			return_0;
+	}
+
+	return 1;
+}
+
 uint32_t pv_maps_size(struct dm_list *pvms)
 {
 	struct pv_map *pvm;
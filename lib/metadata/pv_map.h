@@ -34,6 +34,8 @@ struct pv_area {
 	/* Number of extents unreserved during a single allocation pass. */
 	uint32_t unreserved;
 
+	uint32_t index;			/* Order of creation in the map */
+
 	struct dm_list list;		/* pv_map.areas */
 };
 
@@ -56,6 +58,9 @@ struct pv_map {
 	struct dm_list areas;		/* struct pv_areas */
 	uint32_t pe_count;		/* Total number of PEs */
 
+	uint32_t nr_areas;		/* Areas in the map */
+	uint32_t nr_reserved;		/* Areas with unreserved < count */
+
 	struct dm_list list;
 };
 
@@ -66,7 +71,10 @@ struct dm_list *create_pv_maps(struct dm_pool *mem, struct volume_group *vg,
 			    struct dm_list *allocatable_pvs);
 
 void consume_pv_area(struct pv_area *area, uint32_t to_go);
+void reserve_pv_area(struct pv_area *pva, uint32_t required);
 void reinsert_changed_pv_area(struct pv_area *pva);
+void reset_unreserved_pv_areas(struct dm_list *pvms);
+int reset_pv_maps(struct dm_list *pvms);
 
 uint32_t pv_maps_size(struct dm_list *pvms);
 
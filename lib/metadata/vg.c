@@ -88,6 +88,7 @@ static void _free_vg(struct volume_group *vg)
 
 	log_debug_mem("Freeing VG %s at %p.", vg->name, vg);
 
+	vg_drop_exported_text(vg);
 	dm_hash_destroy(vg->hostnames);
 	dm_pool_destroy(vg->vgmem);
 }
@@ -121,6 +122,33 @@ void free_orphan_vg(struct volume_group *vg)
 	_free_vg(vg);
 }
 
+/*
+ * Keep the metadata text of the current seqno.
+ * size includes the terminating NUL.
+ */
+int vg_set_exported_text(struct volume_group *vg, const char *buf, size_t size)
+{
+	vg_drop_exported_text(vg);
+
+	if (!(vg->export_buf = dm_malloc(size))) {
+		log_error("Failed to allocate exported metadata copy.");
+		return 0;
+	}
+
+	memcpy(vg->export_buf, buf, size);
+	vg->export_size = size;
+	vg->export_seqno = vg->seqno;
+
+	return 1;
+}
+
+/* export_size stays as a hint for the size of the next export */
+void vg_drop_exported_text(struct volume_group *vg)
+{
+	dm_free(vg->export_buf);
+	vg->export_buf = NULL;
+}
+
 int link_lv_to_vg(struct volume_group *vg, struct logical_volume *lv)
 {
 	struct lv_list *lvl;
@@ -21,6 +21,7 @@
 struct cmd_context;
 struct format_instance;
 struct logical_volume;
+struct alloc_batch;
 
 typedef enum {
 	ALLOC_INVALID,
@@ -64,6 +65,16 @@ struct volume_group {
 	struct dm_config_tree *cft_precommitted; /* Precommitted metadata */
 	struct volume_group *vg_precommitted; /* Parsed from cft */
 
+	/*
+	 * Metadata text written by vg_write() for export_seqno, kept only
+	 * until vg_commit() or vg_revert() so the precommitted copy,
+	 * lvmcache and lvmetad need not format it again.  A precommitted
+	 * or committed copy keeps the text it was imported from.
+	 */
+	char *export_buf;
+	size_t export_size;
+	uint32_t export_seqno;
+
 	alloc_policy_t alloc;
 	struct profile *profile;
 	uint64_t status;
@@ -164,6 +175,7 @@ struct volume_group {
 	struct dm_hash_table *hostnames; /* map of creation hostnames */
 	struct logical_volume *pool_metadata_spare_lv; /* one per VG */
 	struct logical_volume *sanlock_lv; /* one per VG */
+	struct alloc_batch *alloc_batch; /* set by lv_create_batch() */
 };
 
 struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
@@ -176,6 +188,9 @@ struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 void release_vg(struct volume_group *vg);
 void free_orphan_vg(struct volume_group *vg);
 
+int vg_set_exported_text(struct volume_group *vg, const char *buf, size_t size);
+void vg_drop_exported_text(struct volume_group *vg);
+
 char *vg_fmt_dup(const struct volume_group *vg);
 char *vg_name_dup(const struct volume_group *vg);
 char *vg_system_id_dup(const struct volume_group *vg);
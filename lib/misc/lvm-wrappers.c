@@ -66,6 +66,28 @@ bad:
 	return 0;
 }
 
+/*
+ * Returns 1 if udev has no events left to process.
+ */
+int udev_is_settled(void)
+{
+	struct udev_queue *udev_queue;
+	int r;
+
+	if (!_udev)
+		return 1;
+
+	if (!(udev_queue = udev_queue_new(_udev))) {
+		log_debug_activation("Could not get udev state.");
+		return 0;
+	}
+
+	r = udev_queue_get_queue_is_empty(udev_queue);
+	udev_queue_unref(udev_queue);
+
+	return r;
+}
+
 void *udev_get_library_context(void)
 {
 	return _udev;
@@ -92,6 +114,11 @@ int udev_is_running(void)
 	return 0;
 }
 
+int udev_is_settled(void)
+{
+	return 1;
+}
+
 #endif
 
 int lvm_getpagesize(void)
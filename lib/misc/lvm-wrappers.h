@@ -20,6 +20,7 @@ int udev_init_library_context(void);
 void *udev_get_library_context(void);
 void udev_fin_library_context(void);
 int udev_is_running(void);
+int udev_is_settled(void);
 
 int lvm_getpagesize(void);
 
@@ -66,6 +66,15 @@ static uint64_t _raidmismatchcount(const struct logical_volume *lv)
 	return cnt;
 }
 
+static uint64_t _timetofull(const struct logical_volume *lv)
+{
+	uint64_t seconds;
+
+	if (!lv_thin_pool_time_to_full(lv, &seconds))
+		return 0;
+	return seconds;
+}
+
 static char *_raidsyncaction(const struct logical_volume *lv)
 {
 	char *action;
@@ -330,6 +339,8 @@ GET_LV_NUM_PROPERTY_FN(copy_percent, _copy_percent(lv))
 #define _copy_percent_set prop_not_implemented_set
 GET_LV_NUM_PROPERTY_FN(sync_percent, _copy_percent(lv))
 #define _sync_percent_set prop_not_implemented_set
+GET_LV_NUM_PROPERTY_FN(time_to_full, _timetofull(lv))
+#define _time_to_full_set prop_not_implemented_set
 GET_LV_NUM_PROPERTY_FN(raid_mismatch_count, _raidmismatchcount(lv))
 #define _raid_mismatch_count_set prop_not_implemented_set
 GET_LV_NUM_PROPERTY_FN(raid_write_behind, _raidwritebehind(lv))
@@ -2860,6 +2860,21 @@ static int _raidsyncaction_disp(struct dm_report *rh __attribute__((unused)),
 	return _field_set_value(field, "", NULL);
 }
 
+static int _timetofull_disp(struct dm_report *rh __attribute__((unused)),
+			    struct dm_pool *mem,
+			    struct dm_report_field *field,
+			    const void *data,
+			    void *private __attribute__((unused)))
+{
+	const struct logical_volume *lv = (const struct logical_volume *) data;
+	uint64_t seconds;
+
+	if (lv_is_thin_pool(lv) && lv_thin_pool_time_to_full(lv, &seconds))
+		return dm_report_field_uint64(rh, field, &seconds);
+
+	return _field_set_value(field, "", &GET_TYPE_RESERVED_VALUE(num_undef_64));
+}
+
 static int _raidmismatchcount_disp(struct dm_report *rh __attribute__((unused)),
 				struct dm_pool *mem,
 				struct dm_report_field *field,
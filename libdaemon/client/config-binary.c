@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU Lesser General Public License v.2.1.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _REENTRANT
+
+#include "tool.h"
+
+#include "config-util.h"
+#include "dm-logging.h"
+
+/*
+ * Compact encoding of a config tree, used on the daemon socket once both
+ * sides agreed on it in the hello exchange (see daemon_open).
+ *
+ *   header:  "\0LVB" <payload length: 32 bit little endian>
+ *   payload: <nr strings> (<length> <bytes>)*  <node list>
+ *   list:    <nr nodes> (<key string> <kind> ...)*
+ *            kind 0: section, a node list follows
+ *            kind 1: <nr values> (<type> [<format flags>] <value>)*
+ *
+ * All numbers are unsigned LEB128 varints; integer values are zigzag
+ * encoded first.  Keys and string values are references into the string
+ * table, so each distinct string (PV ids, status flags, ...) is sent and
+ * allocated once.  Floats are sent in host representation: the socket
+ * is local.
+ *
+ * A text message can never start with a zero byte, so the two encodings
+ * are told apart by the first byte of each message.
+ */
+
+static const char _magic[4] = { 0, 'L', 'V', 'B' };
+
+#define BINARY_KIND_SECTION	0
+#define BINARY_KIND_VALUES	1
+#define BINARY_TYPE_FLAGS	0x80	/* format flags follow the type */
+#define BINARY_MAX_DEPTH	64
+
+struct binary_encoder {
+	struct buffer strings;
+	struct buffer nodes;
+	struct dm_hash_table *ids;
+	uint64_t nr_strings;
+};
+
+static int _append_raw(struct buffer *buf, const void *data, int len)
+{
+	if ((!buf->mem || (buf->allocated - buf->used <= len)) &&
+	    !buffer_realloc(buf, len + 1))
+		return 0;
+
+	memcpy(buf->mem + buf->used, data, len);
+	buf->used += len;
+
+	return 1;
+}
+
+static int _varint(unsigned char *bytes, uint64_t v)
+{
+	int len = 0;
+
+	do {
+		bytes[len] = v & 0x7f;
+		if (v >>= 7)
+			bytes[len] |= 0x80;
+		len++;
+	} while (v);
+
+	return len;
+}
+
+static int _append_varint(struct buffer *buf, uint64_t v)
+{
+	unsigned char bytes[10];
+
+	return _append_raw(buf, bytes, _varint(bytes, v));
+}
+
+static int _append_string(struct binary_encoder *enc, const char *str)
+{
+	uintptr_t id;
+	size_t len;
+
+	if (!(id = (uintptr_t) dm_hash_lookup(enc->ids, str))) {
+		len = strlen(str);
+		id = (uintptr_t) ++enc->nr_strings;
+		if (!dm_hash_insert(enc->ids, str, (void *) id) ||
+		    !_append_varint(&enc->strings, len) ||
+		    !_append_raw(&enc->strings, str, len))
+			return 0;
+	}
+
+	return _append_varint(&enc->nodes, id - 1);
+}
+
+static int _encode_values(struct binary_encoder *enc, const struct dm_config_value *v)
+{
+	const struct dm_config_value *cv;
+	uint64_t count = 0;
+	unsigned char type;
+
+	for (cv = v; cv; cv = cv->next)
+		count++;
+
+	if (!_append_varint(&enc->nodes, count))
+		return 0;
+
+	for (; v; v = v->next) {
+		type = (unsigned char) v->type;
+		if (v->format_flags)
+			type |= BINARY_TYPE_FLAGS;
+
+		if (!_append_raw(&enc->nodes, &type, 1) ||
+		    (v->format_flags && !_append_varint(&enc->nodes, v->format_flags)))
+			return 0;
+
+		switch (v->type) {
+		case DM_CFG_INT:
+			if (!_append_varint(&enc->nodes, ((uint64_t) v->v.i << 1) ^ (uint64_t) (v->v.i >> 63)))
+				return 0;
+			break;
+		case DM_CFG_FLOAT:
+			if (!_append_raw(&enc->nodes, &v->v.f, sizeof(v->v.f)))
+				return 0;
+			break;
+		case DM_CFG_STRING:
+			if (!_append_string(enc, v->v.str))
+				return 0;
+			break;
+		case DM_CFG_EMPTY_ARRAY:
+			break;
+		}
+	}
+
+	return 1;
+}
+
+static int _encode_nodes(struct binary_encoder *enc, const struct dm_config_node *cn)
+{
+	const struct dm_config_node *n;
+	unsigned char kind;
+	uint64_t count = 0;
+
+	for (n = cn; n; n = n->sib)
+		count++;
+
+	if (!_append_varint(&enc->nodes, count))
+		return 0;
+
+	for (; cn; cn = cn->sib) {
+		kind = cn->v ? BINARY_KIND_VALUES : BINARY_KIND_SECTION;
+
+		if (!_append_string(enc, cn->key) ||
+		    !_append_raw(&enc->nodes, &kind, 1))
+			return 0;
+
+		if (cn->v ? !_encode_values(enc, cn->v) : !_encode_nodes(enc, cn->child))
+			return 0;
+	}
+
+	return 1;
+}
+
+int config_write_binary(struct buffer *buf, const struct dm_config_node *cn)
+{
+	struct binary_encoder enc = { .nr_strings = 0 };
+	unsigned char header[CONFIG_BINARY_HEADER_SIZE];
+	unsigned char count[10];
+	int count_len;
+	uint32_t len;
+	int r = 0;
+
+	buffer_init(&enc.strings);
+	buffer_init(&enc.nodes);
+
+	if (!(enc.ids = dm_hash_create(512)))
+		return_0;
+
+	if (!_encode_nodes(&enc, cn))
+		goto_out;
+
+	count_len = _varint(count, enc.nr_strings);
+	len = (uint32_t) (count_len + enc.strings.used + enc.nodes.used);
+
+	memcpy(header, _magic, sizeof(_magic));
+	header[4] = len & 0xff;
+	header[5] = (len >> 8) & 0xff;
+	header[6] = (len >> 16) & 0xff;
+	header[7] = (len >> 24) & 0xff;
+
+	if (!_append_raw(buf, header, sizeof(header)) ||
+	    !_append_raw(buf, count, count_len) ||
+	    (enc.strings.used && !_append_raw(buf, enc.strings.mem, enc.strings.used)) ||
+	    !_append_raw(buf, enc.nodes.mem, enc.nodes.used))
+		goto_out;
+
+	r = 1;
+out:
+	dm_hash_destroy(enc.ids);
+	buffer_destroy(&enc.strings);
+	buffer_destroy(&enc.nodes);
+
+	return r;
+}
+
+int buffer_is_binary(const struct buffer *buf)
+{
+	return buf->mem && buf->used >= (int) sizeof(_magic) &&
+		!memcmp(buf->mem, _magic, sizeof(_magic));
+}
+
+int config_binary_size(const char *mem, int used)
+{
+	const unsigned char *h = (const unsigned char *) mem;
+	uint32_t len;
+
+	if (used < CONFIG_BINARY_HEADER_SIZE)
+		return 0;
+
+	len = h[4] | (h[5] << 8) | (h[6] << 16) | ((uint32_t) h[7] << 24);
+	if (len > INT32_MAX - CONFIG_BINARY_HEADER_SIZE - 1)
+		return -1;
+
+	return CONFIG_BINARY_HEADER_SIZE + (int) len;
+}
+
+struct binary_decoder {
+	const unsigned char *p;
+	const unsigned char *end;
+	struct dm_config_tree *cft;
+	const char **strings;
+	uint64_t nr_strings;
+};
+
+static int _read_varint(struct binary_decoder *dec, uint64_t *v)
+{
+	unsigned shift = 0;
+
+	*v = 0;
+	while (dec->p < dec->end && shift < 64) {
+		*v |= (uint64_t) (*dec->p & 0x7f) << shift;
+		if (!(*dec->p++ & 0x80))
+			return 1;
+		shift += 7;
+	}
+
+	return 0;
+}
+
+static int _read_string(struct binary_decoder *dec, const char **str)
+{
+	uint64_t id;
+
+	if (!_read_varint(dec, &id) || id >= dec->nr_strings)
+		return 0;
+
+	*str = dec->strings[id];
+
+	return 1;
+}
+
+static int _read_byte(struct binary_decoder *dec, unsigned char *c)
+{
+	if (dec->p >= dec->end)
+		return 0;
+
+	*c = *dec->p++;
+
+	return 1;
+}
+
+static int _decode_values(struct binary_decoder *dec, struct dm_config_value **values)
+{
+	struct dm_config_value *v, *last = NULL;
+	uint64_t count, u;
+	unsigned char type;
+
+	/* Every value takes at least one byte. */
+	if (!_read_varint(dec, &count) || count > (uint64_t) (dec->end - dec->p))
+		return 0;
+
+	*values = NULL;
+	while (count--) {
+		if (!_read_byte(dec, &type) ||
+		    !(v = dm_config_create_value(dec->cft)))
+			return 0;
+
+		if (type & BINARY_TYPE_FLAGS) {
+			if (!_read_varint(dec, &u))
+				return 0;
+			v->format_flags = (uint32_t) u;
+			type &= ~BINARY_TYPE_FLAGS;
+		}
+
+		switch (type) {
+		case DM_CFG_INT:
+			if (!_read_varint(dec, &u))
+				return 0;
+			v->v.i = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+			break;
+		case DM_CFG_FLOAT:
+			if ((size_t) (dec->end - dec->p) < sizeof(v->v.f))
+				return 0;
+			memcpy(&v->v.f, dec->p, sizeof(v->v.f));
+			dec->p += sizeof(v->v.f);
+			break;
+		case DM_CFG_STRING:
+			if (!_read_string(dec, &v->v.str))
+				return 0;
+			break;
+		case DM_CFG_EMPTY_ARRAY:
+			break;
+		default:
+			return 0;
+		}
+
+		v->type = (dm_config_value_type_t) type;
+		if (last)
+			last->next = v;
+		else
+			*values = v;
+		last = v;
+	}
+
+	return 1;
+}
+
+static int _decode_nodes(struct binary_decoder *dec, struct dm_config_node *parent,
+			 struct dm_config_node **nodes, unsigned depth)
+{
+	struct dm_config_node *cn, *last = NULL;
+	unsigned char kind;
+	uint64_t count;
+
+	/* Every node takes at least two bytes. */
+	if (depth > BINARY_MAX_DEPTH || !_read_varint(dec, &count) ||
+	    count > (uint64_t) (dec->end - dec->p) / 2)
+		return 0;
+
+	*nodes = NULL;
+	while (count--) {
+		if (!(cn = dm_pool_zalloc(dec->cft->mem, sizeof(*cn))))
+			return 0;
+
+		if (!_read_string(dec, &cn->key) ||
+		    !_read_byte(dec, &kind))
+			return 0;
+
+		cn->parent = parent;
+		if (kind == BINARY_KIND_VALUES) {
+			if (!_decode_values(dec, &cn->v))
+				return 0;
+		} else if (kind == BINARY_KIND_SECTION) {
+			if (!_decode_nodes(dec, cn, &cn->child, depth + 1))
+				return 0;
+		} else
+			return 0;
+
+		if (last)
+			last->sib = cn;
+		else
+			*nodes = cn;
+		last = cn;
+	}
+
+	return 1;
+}
+
+struct dm_config_tree *config_read_binary(const char *mem, int size)
+{
+	struct binary_decoder dec = { .p = (const unsigned char *) mem + CONFIG_BINARY_HEADER_SIZE };
+	uint64_t i, len;
+	int msg_size;
+
+	if ((msg_size = config_binary_size(mem, size)) <= 0 || msg_size > size) {
+		log_error("Truncated binary config.");
+		return NULL;
+	}
+
+	dec.end = (const unsigned char *) mem + msg_size;
+
+	if (!(dec.cft = dm_config_create()))
+		return_NULL;
+
+	/* Every string takes at least one byte. */
+	if (!_read_varint(&dec, &dec.nr_strings) ||
+	    dec.nr_strings > (uint64_t) (dec.end - dec.p))
+		goto bad;
+
+	if (dec.nr_strings &&
+	    !(dec.strings = dm_malloc(sizeof(*dec.strings) * dec.nr_strings)))
+		goto_bad;
+
+	for (i = 0; i < dec.nr_strings; i++) {
+		if (!_read_varint(&dec, &len) || len > (uint64_t) (dec.end - dec.p))
+			goto bad;
+		if (!(dec.strings[i] = dm_pool_strndup(dec.cft->mem, (const char *) dec.p, len)))
+			goto_bad;
+		dec.p += len;
+	}
+
+	if (!_decode_nodes(&dec, NULL, &dec.cft->root, 0) || dec.p != dec.end)
+		goto bad;
+
+	dm_free(dec.strings);
+
+	return dec.cft;
+bad:
+	log_error("Failed to decode binary config.");
+	dm_free(dec.strings);
+	dm_config_destroy(dec.cft);
+
+	return NULL;
+}
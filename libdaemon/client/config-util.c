@@ -226,7 +226,7 @@ struct dm_config_node *config_make_nodes_v(struct dm_config_tree *cft,
 	struct dm_config_node *first = NULL;
 	struct dm_config_node *cn;
 	const char *fmt;
-	char *key;
+	char *key, *end;
 
 	while ((next = va_arg(ap, char *))) {
 		cn = NULL;
@@ -242,7 +242,11 @@ struct dm_config_node *config_make_nodes_v(struct dm_config_tree *cft,
 			return NULL;
 		}
 
-		key[fmt - next] = '\0';
+		/* "key = %s": no spaces in the key, text parser would drop them */
+		end = key + (fmt - next);
+		while (end > key && end[-1] == ' ')
+			end--;
+		*end = '\0';
 		fmt += 2;
 
 		if (!strcmp(fmt, "%d") || !strcmp(fmt, FMTd64)) {
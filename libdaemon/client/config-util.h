@@ -30,6 +30,19 @@ int buffer_realloc(struct buffer *buf, int needed);
 
 int buffer_line(const char *line, void *baton);
 
+/*
+ * Binary encoding of config trees (see config-binary.c).  A binary
+ * message starts with a header of CONFIG_BINARY_HEADER_SIZE bytes
+ * holding its size.
+ */
+#define CONFIG_BINARY_HEADER_SIZE 8
+
+int config_write_binary(struct buffer *buf, const struct dm_config_node *cn);
+struct dm_config_tree *config_read_binary(const char *mem, int size);
+int buffer_is_binary(const struct buffer *buf);
+/* Size of the whole message, 0 if the header is incomplete, -1 if bogus. */
+int config_binary_size(const char *mem, int used);
+
 int set_flag(struct dm_config_tree *cft, struct dm_config_node *parent,
 	     const char *field, const char *flag, int want);
 
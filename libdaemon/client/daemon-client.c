@@ -50,7 +50,10 @@ daemon_handle daemon_open(daemon_info i)
 	}
 
 	log_debug("Sending daemon %s: hello", i.path);
-	r = daemon_send_simple(h, "hello", NULL);
+	if (i.binary)
+		r = daemon_send_simple(h, "hello", "wire = %s", "binary", NULL);
+	else
+		r = daemon_send_simple(h, "hello", NULL);
 	if (r.error || strcmp(daemon_reply_str(r, "response", "unknown"), "OK")) {
 		h.error = r.error;
 		log_error("Daemon %s returned error %d", i.path, r.error);
@@ -62,6 +65,7 @@ daemon_handle daemon_open(daemon_info i)
 	if (h.protocol)
 		h.protocol = dm_strdup(h.protocol); /* keep around */
 	h.protocol_version = daemon_reply_int(r, "version", 0);
+	h.binary = (i.binary && !strcmp(daemon_reply_str(r, "wire", "text"), "binary")) ? 1 : 0;
 
 	if (i.protocol && (!h.protocol || strcmp(h.protocol, i.protocol))) {
 		log_error("Daemon %s: requested protocol %s != %s",
@@ -104,11 +108,18 @@ daemon_reply daemon_send(daemon_handle h, daemon_request rq)
 
 	buffer = rq.buffer;
 
-	if (!buffer.mem)
-		if (!dm_config_write_node(rq.cft->root, buffer_line, &buffer)) {
+	if (!buffer.mem) {
+		if (h.binary) {
+			if (!config_write_binary(&buffer, rq.cft->root)) {
+				buffer_destroy(&buffer);
+				reply.error = ENOMEM;
+				return reply;
+			}
+		} else if (!dm_config_write_node(rq.cft->root, buffer_line, &buffer)) {
 			reply.error = ENOMEM;
 			return reply;
 		}
+	}
 
 	if (!buffer.mem) {
 		log_error(INTERNAL_ERROR "Daemon send: no memory available");
@@ -120,7 +131,10 @@ daemon_reply daemon_send(daemon_handle h, daemon_request rq)
 		reply.error = errno;
 
 	if (buffer_read(h.socket_fd, &reply.buffer)) {
-		reply.cft = dm_config_from_string(reply.buffer.mem);
+		if (buffer_is_binary(&reply.buffer))
+			reply.cft = config_read_binary(reply.buffer.mem, reply.buffer.used);
+		else
+			reply.cft = dm_config_from_string(reply.buffer.mem);
 		if (!reply.cft)
 			reply.error = EPROTO;
 	} else
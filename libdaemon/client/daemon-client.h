@@ -22,6 +22,7 @@ typedef struct {
 	const char *protocol;
 	int protocol_version;  /* version of the protocol the daemon uses */
 	int error;
+	unsigned binary:1; /* the daemon accepts and sends binary encoded trees */
 } daemon_handle;
 
 typedef struct {
@@ -35,6 +36,12 @@ typedef struct {
 	 */
 	const char *protocol;
 	int protocol_version;
+
+	/*
+	 * Ask the daemon for the binary encoding of requests and replies
+	 * carrying config trees.  Daemons not knowing about it keep text.
+	 */
+	unsigned binary:1;
 } daemon_info;
 
 typedef struct {
@@ -30,6 +30,7 @@
  */
 int buffer_read(int fd, struct buffer *buffer) {
 	int result;
+	int size;
 
 	if (!buffer_realloc(buffer, 32)) /* ensure we have some space */
 		return 0;
@@ -38,6 +39,23 @@ int buffer_read(int fd, struct buffer *buffer) {
 		result = read(fd, buffer->mem + buffer->used, buffer->allocated - buffer->used);
 		if (result > 0) {
 			buffer->used += result;
+			if (buffer->mem[0] == '\0') {
+				/* binary encoding, the header carries the size */
+				if (!(size = config_binary_size(buffer->mem, buffer->used)))
+					continue;
+				if (size < 0 || !buffer_is_binary(buffer)) {
+					errno = EPROTO;
+					return 0;
+				}
+				if ((buffer->allocated <= size) &&
+				    !buffer_realloc(buffer, size + 1 - buffer->allocated))
+					return 0;
+				if (buffer->used >= size) {
+					buffer->mem[buffer->used] = 0;
+					break; /* the whole binary message is in */
+				}
+				continue;
+			}
 			if (buffer->used >= 4 && !strncmp((buffer->mem) + buffer->used - 4, "\n##\n", 4)) {
 				buffer->used -= 4;
 				buffer->mem[buffer->used] = 0;
@@ -72,8 +90,10 @@ int buffer_write(int fd, const struct buffer *buffer) {
 	static const struct buffer _terminate = { .mem = (char *) "\n##\n", .used = 4 };
 	const struct buffer *use;
 	int done, written, result;
+	/* binary messages are delimited by the size in their header */
+	int parts = buffer_is_binary(buffer) ? 1 : 2;
 
-	for (done = 0; done < 2; ++done) {
+	for (done = 0; done < parts; ++done) {
 		use = (done == 0) ? buffer : &_terminate;
 		for (written = 0; written < use->used;) {
 			result = write(fd, use->mem + written, use->used - written);
@@ -21,6 +21,7 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <pthread.h>
+#include <sys/epoll.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
@@ -82,9 +83,11 @@ static void _exit_handler(int sig __attribute__((unused)))
 #  define SD_LISTEN_FDS_START 3
 #  define SD_FD_SOCKET_SERVER SD_LISTEN_FDS_START
 
+static unsigned _pool_clients(void);
+
 static int _is_idle(daemon_state s)
 {
-	return s.idle && s.idle->is_idle && !s.threads->next;
+	return s.idle && s.idle->is_idle && !s.threads->next && !_pool_clients();
 }
 
 static struct timeval *_get_timeout(daemon_state s)
@@ -298,7 +301,7 @@ static int _open_socket(daemon_state s)
 
 	file_created = 1;
 
-	if (listen(fd, 1) != 0) {
+	if (listen(fd, SOMAXCONN) != 0) {
 		perror("listen local");
 		goto error;
 	}
@@ -418,70 +421,416 @@ end:
 	return res;
 }
 
-static response _builtin_handler(daemon_state s, client_handle h, request r)
+static response _pool_stats(void);
+
+static response _builtin_handler(daemon_state s, client_handle *h, request r)
 {
 	const char *rq = daemon_request_str(r, "request", "NONE");
 	response res = { .error = EPROTO };
 
 	if (!strcmp(rq, "hello")) {
+		/* Replies with a config tree are sent binary encoded from now on. */
+		if (!strcmp(daemon_request_str(r, "wire", "text"), "binary")) {
+			h->binary = 1;
+			return daemon_reply_simple("OK", "protocol = %s", s.protocol ?: "default",
+						   "version = %" PRId64, (int64_t) s.protocol_version,
+						   "wire = %s", "binary", NULL);
+		}
 		return daemon_reply_simple("OK", "protocol = %s", s.protocol ?: "default",
 					   "version = %" PRId64, (int64_t) s.protocol_version, NULL);
 	}
 
+	if (!strcmp(rq, "daemon_stats"))
+		return _pool_stats();
+
 	buffer_init(&res.buffer);
 	return res;
 }
 
-static void *_client_thread(void *state)
+/*
+ * Read one request from the client, handle it and send the response.
+ * Returns 0 when the client connection should be closed.
+ */
+static int _serve_request(daemon_state *s, client_handle *client)
 {
-	thread_state *ts = state;
 	request req;
 	response res;
+	int r = 0;
 
 	buffer_init(&req.buffer);
 
-	while (1) {
-		if (!buffer_read(ts->client.socket_fd, &req.buffer))
-			goto fail;
+	if (!buffer_read(client->socket_fd, &req.buffer))
+		goto out;
 
-		req.cft = dm_config_from_string(req.buffer.mem);
+	if (buffer_is_binary(&req.buffer)) {
+		if (!(req.cft = config_read_binary(req.buffer.mem, req.buffer.used)))
+			fprintf(stderr, "error decoding binary request\n");
+	} else if (!(req.cft = dm_config_from_string(req.buffer.mem)))
+		fprintf(stderr, "error parsing request:\n %s\n", req.buffer.mem);
 
-		if (!req.cft)
-			fprintf(stderr, "error parsing request:\n %s\n", req.buffer.mem);
-		else
-			daemon_log_cft(ts->s.log, DAEMON_LOG_WIRE, "<- ", req.cft->root);
+	if (req.cft)
+		daemon_log_cft(s->log, DAEMON_LOG_WIRE, "<- ", req.cft->root);
 
-		res = _builtin_handler(ts->s, ts->client, req);
+	res = _builtin_handler(*s, client, req);
 
-		if (res.error == EPROTO) /* Not a builtin, delegate to the custom handler. */
-			res = ts->s.handler(ts->s, ts->client, req);
+	if (res.error == EPROTO) /* Not a builtin, delegate to the custom handler. */
+		res = s->handler(*s, *client, req);
 
+	if (!res.buffer.mem && client->binary) {
+		daemon_log_cft(s->log, DAEMON_LOG_WIRE, "-> ", res.cft->root);
+		if (!config_write_binary(&res.buffer, res.cft->root))
+			goto out;
+		dm_config_destroy(res.cft);
+	} else {
 		if (!res.buffer.mem) {
 			if (!dm_config_write_node(res.cft->root, buffer_line, &res.buffer))
-				goto fail;
+				goto out;
 			if (!buffer_append(&res.buffer, "\n\n"))
-				goto fail;
+				goto out;
 			dm_config_destroy(res.cft);
 		}
+		daemon_log_multi(s->log, DAEMON_LOG_WIRE, "-> ", res.buffer.mem);
+	}
 
-		if (req.cft)
-			dm_config_destroy(req.cft);
-		buffer_destroy(&req.buffer);
+	if (req.cft)
+		dm_config_destroy(req.cft);
+	buffer_destroy(&req.buffer);
 
-		daemon_log_multi(ts->s.log, DAEMON_LOG_WIRE, "-> ", res.buffer.mem);
-		buffer_write(ts->client.socket_fd, &res.buffer);
+	buffer_write(client->socket_fd, &res.buffer);
+
+	buffer_destroy(&res.buffer);
+	r = 1;
+out:
+	buffer_destroy(&req.buffer);
+	return r;
+}
+
+static void *_client_thread(void *state)
+{
+	thread_state *ts = state;
+
+	while (_serve_request(&ts->s, &ts->client))
+		;
 
-		buffer_destroy(&res.buffer);
-	}
-fail:
 	/* TODO what should we really do here? */
 	if (close(ts->client.socket_fd))
 		perror("close");
-	buffer_destroy(&req.buffer);
 	ts->active = 0;
 	return NULL;
 }
 
+/*
+ * Worker pool mode.
+ *
+ * The main thread waits in epoll for new connections and for requests
+ * on idle client connections.  A client with a pending request is
+ * queued for one of the worker threads, which serves that single
+ * request and hands the connection back to epoll.  The queue is
+ * bounded: once full, the main thread stops picking up requests until
+ * a worker frees a place, leaving further clients waiting in the
+ * kernel.
+ */
+#define POOL_EVENTS 64
+
+typedef struct pool_client {
+	client_handle client;
+	uint64_t queued_us;	/* When the request was queued */
+	struct pool_client *next;
+} pool_client;
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;	/* Queue not empty or stopping */
+	pthread_cond_t space;	/* Queue not full */
+	pool_client *head, *tail;
+	unsigned queued, max_queued;
+	unsigned clients;	/* Open client connections */
+	unsigned stop;
+	int epoll_fd;
+	pthread_t *workers;
+	int num_workers;
+
+	/* Latency accounting, in microseconds */
+	uint64_t requests;
+	uint64_t wait_us, max_wait_us;
+	uint64_t service_us, max_service_us;
+	unsigned max_queue_depth;
+} _pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.space = PTHREAD_COND_INITIALIZER,
+	.epoll_fd = -1,
+};
+
+static uint64_t _now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static unsigned _pool_clients(void)
+{
+	unsigned r;
+
+	pthread_mutex_lock(&_pool.lock);
+	r = _pool.clients;
+	pthread_mutex_unlock(&_pool.lock);
+
+	return r;
+}
+
+static response _pool_stats(void)
+{
+	response res;
+
+	pthread_mutex_lock(&_pool.lock);
+	res = daemon_reply_simple("OK",
+				  "workers = %" PRId64, (int64_t) _pool.num_workers,
+				  "clients = %" PRId64, (int64_t) _pool.clients,
+				  "queued = %" PRId64, (int64_t) _pool.queued,
+				  "max_queue_depth = %" PRId64, (int64_t) _pool.max_queue_depth,
+				  "requests = %" PRId64, (int64_t) _pool.requests,
+				  "wait_us = %" PRId64, (int64_t) _pool.wait_us,
+				  "max_wait_us = %" PRId64, (int64_t) _pool.max_wait_us,
+				  "service_us = %" PRId64, (int64_t) _pool.service_us,
+				  "max_service_us = %" PRId64, (int64_t) _pool.max_service_us,
+				  NULL);
+	pthread_mutex_unlock(&_pool.lock);
+
+	return res;
+}
+
+/* Wait for a request on the connection again */
+static int _pool_watch(daemon_state *s, pool_client *pc, int op)
+{
+	struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data.ptr = pc };
+
+	if (epoll_ctl(_pool.epoll_fd, op, pc->client.socket_fd, &ev)) {
+		ERROR(s, "epoll_ctl failed for client fd %d: %s",
+		      pc->client.socket_fd, strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _pool_close(pool_client *pc)
+{
+	if (close(pc->client.socket_fd))
+		perror("close");
+	dm_free(pc);
+
+	pthread_mutex_lock(&_pool.lock);
+	_pool.clients--;
+	pthread_mutex_unlock(&_pool.lock);
+}
+
+static void *_pool_worker(void *state)
+{
+	daemon_state *s = state;
+	pool_client *pc;
+	uint64_t start, wait, service;
+
+	while (1) {
+		pthread_mutex_lock(&_pool.lock);
+		while (!_pool.head && !_pool.stop)
+			pthread_cond_wait(&_pool.work, &_pool.lock);
+
+		if (!(pc = _pool.head)) {
+			pthread_mutex_unlock(&_pool.lock);
+			break;
+		}
+
+		if (!(_pool.head = pc->next))
+			_pool.tail = NULL;
+		_pool.queued--;
+		pthread_cond_signal(&_pool.space);
+		pthread_mutex_unlock(&_pool.lock);
+
+		pc->client.thread_id = pthread_self();
+		start = _now_us();
+		wait = start - pc->queued_us;
+
+		if (!_serve_request(s, &pc->client) ||
+		    !_pool_watch(s, pc, EPOLL_CTL_MOD)) {
+			_pool_close(pc);
+			pc = NULL;
+		}
+
+		service = _now_us() - start;
+		DEBUGLOG(s, "request %s after %" PRIu64 " us in queue, took %" PRIu64 " us",
+			 pc ? "served" : "failed", wait, service);
+
+		pthread_mutex_lock(&_pool.lock);
+		_pool.requests++;
+		_pool.wait_us += wait;
+		_pool.service_us += service;
+		if (wait > _pool.max_wait_us)
+			_pool.max_wait_us = wait;
+		if (service > _pool.max_service_us)
+			_pool.max_service_us = service;
+		pthread_mutex_unlock(&_pool.lock);
+	}
+
+	return NULL;
+}
+
+static void _pool_queue(pool_client *pc)
+{
+	pc->queued_us = _now_us();
+	pc->next = NULL;
+
+	pthread_mutex_lock(&_pool.lock);
+	while (_pool.queued >= _pool.max_queued)
+		pthread_cond_wait(&_pool.space, &_pool.lock);
+
+	if (_pool.tail)
+		_pool.tail->next = pc;
+	else
+		_pool.head = pc;
+	_pool.tail = pc;
+
+	if (++_pool.queued > _pool.max_queue_depth)
+		_pool.max_queue_depth = _pool.queued;
+
+	pthread_cond_signal(&_pool.work);
+	pthread_mutex_unlock(&_pool.lock);
+}
+
+static void _pool_accept(daemon_state *s)
+{
+	pool_client *pc;
+	int fd;
+
+	/* The listening socket is non-blocking: take all pending clients */
+	while ((fd = accept(s->socket_fd, NULL, NULL)) >= 0) {
+		if (fcntl(fd, F_SETFD, FD_CLOEXEC))
+			WARN(s, "setting CLOEXEC on client socket fd %d failed", fd);
+
+		if (!(pc = dm_zalloc(sizeof(*pc)))) {
+			ERROR(s, "Failed to allocate client state");
+			if (close(fd))
+				perror("close");
+			continue;
+		}
+
+		pc->client.socket_fd = fd;
+
+		pthread_mutex_lock(&_pool.lock);
+		_pool.clients++;
+		pthread_mutex_unlock(&_pool.lock);
+
+		if (!_pool_watch(s, pc, EPOLL_CTL_ADD))
+			_pool_close(pc);
+	}
+
+	if (errno != EAGAIN && errno != EINTR)
+		ERROR(s, "Failed to accept connection errno %d.", errno);
+}
+
+static void _pool_destroy(void)
+{
+	int i;
+
+	pthread_mutex_lock(&_pool.lock);
+	_pool.stop = 1;
+	pthread_cond_broadcast(&_pool.work);
+	pthread_mutex_unlock(&_pool.lock);
+
+	for (i = 0; i < _pool.num_workers; i++)
+		if ((errno = pthread_join(_pool.workers[i], NULL)))
+			perror("pthread_join");
+
+	dm_free(_pool.workers);
+	_pool.workers = NULL;
+	_pool.num_workers = 0;
+
+	if (_pool.epoll_fd >= 0 && close(_pool.epoll_fd))
+		perror("close");
+	_pool.epoll_fd = -1;
+}
+
+static int _pool_create(daemon_state *s)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+	sigset_t set, old;
+	int i;
+
+	_pool.max_queued = s->max_queued_requests ? : 4 * (unsigned) s->worker_threads;
+
+	if ((_pool.epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		ERROR(s, "Failed to create epoll instance: %s", strerror(errno));
+		return 0;
+	}
+
+	/* A socket handed over by systemd may be blocking, see _pool_accept() */
+	if (fcntl(s->socket_fd, F_SETFL, fcntl(s->socket_fd, F_GETFL, 0) | O_NONBLOCK)) {
+		ERROR(s, "Failed to set O_NONBLOCK on daemon socket: %s", strerror(errno));
+		goto bad;
+	}
+
+	if (epoll_ctl(_pool.epoll_fd, EPOLL_CTL_ADD, s->socket_fd, &ev)) {
+		ERROR(s, "Failed to watch daemon socket: %s", strerror(errno));
+		goto bad;
+	}
+
+	if (!(_pool.workers = dm_zalloc(sizeof(*_pool.workers) * s->worker_threads))) {
+		ERROR(s, "Failed to allocate worker threads.");
+		goto bad;
+	}
+
+	/* Leave signal handling to the main thread so it notices shutdown */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+
+	for (i = 0; i < s->worker_threads; i++) {
+		if ((errno = pthread_create(&_pool.workers[i], NULL, _pool_worker, s))) {
+			ERROR(s, "Failed to create worker thread errno %d.", errno);
+			break;
+		}
+		_pool.num_workers++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (_pool.num_workers != s->worker_threads)
+		goto bad;
+
+	INFO(s, "%s serving clients with %d worker threads", s->name, _pool.num_workers);
+
+	return 1;
+bad:
+	_pool_destroy();
+	return 0;
+}
+
+/* Dispatch ready clients to the workers; returns 1 if there was activity. */
+static int _pool_wait(daemon_state *s)
+{
+	struct epoll_event events[POOL_EVENTS];
+	struct timeval *tv = _get_timeout(*s);
+	int i, n, activity = 0;
+
+	n = epoll_wait(_pool.epoll_fd, events, POOL_EVENTS,
+		       tv ? (int) (tv->tv_sec * 1000 + tv->tv_usec / 1000) : -1);
+
+	if (n < 0 && errno != EINTR)
+		perror("epoll_wait error");
+
+	for (i = 0; i < n; i++) {
+		activity = 1;
+		if (!events[i].data.ptr)
+			_pool_accept(s);
+		else
+			_pool_queue(events[i].data.ptr);
+	}
+
+	return activity;
+}
+
 static int handle_connect(daemon_state s)
 {
 	thread_state *ts;
@@ -626,20 +975,28 @@ void daemon_start(daemon_state s)
 		if (!s.daemon_init(&s))
 			failed = 1;
 
+	if (!failed && s.worker_threads > 0 && !_pool_create(&s))
+		failed = 1;
+
 	while (!failed) {
 		_reset_timeout(s);
-		FD_ZERO(&in);
-		FD_SET(s.socket_fd, &in);
-		if (select(FD_SETSIZE, &in, NULL, NULL, _get_timeout(s)) < 0 && errno != EINTR)
-			perror("select error");
-		if (FD_ISSET(s.socket_fd, &in)) {
-			timeout_count = 0;
-			handle_connect(s);
+		if (s.worker_threads > 0) {
+			if (_pool_wait(&s))
+				timeout_count = 0;
+		} else {
+			FD_ZERO(&in);
+			FD_SET(s.socket_fd, &in);
+			if (select(FD_SETSIZE, &in, NULL, NULL, _get_timeout(s)) < 0 && errno != EINTR)
+				perror("select error");
+			if (FD_ISSET(s.socket_fd, &in)) {
+				timeout_count = 0;
+				handle_connect(s);
+			}
 		}
 
 		_reap(s, 0);
 
-		if (_shutdown_requested && !s.threads->next)
+		if (_shutdown_requested && !s.threads->next && !_pool_clients())
 			break;
 
 		/* s.idle == NULL equals no shutdown on timeout */
@@ -654,6 +1011,8 @@ void daemon_start(daemon_state s)
 
 	INFO(&s, "%s waiting for client threads to finish", s.name);
 	_reap(s, 1);
+	if (s.worker_threads > 0)
+		_pool_destroy();
 out:
 	/* If activated by systemd, do not unlink the socket - systemd takes care of that! */
 	if (!_systemd_activation && s.socket_fd >= 0)
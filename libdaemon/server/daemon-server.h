@@ -22,6 +22,7 @@ typedef struct {
 	pthread_t thread_id;
 	char *read_buf;
 	void *private; /* this holds per-client state */
+	unsigned binary:1; /* client negotiated binary encoded replies */
 } client_handle;
 
 typedef struct {
@@ -95,6 +96,15 @@ typedef struct daemon_state {
 	 */
 	int thread_stack_size;
 
+	/*
+	 * When non-zero, client requests are served by a fixed pool of
+	 * this many worker threads instead of a thread per client. Clients
+	 * with a pending request wait in a queue of at most
+	 * max_queued_requests entries (defaults to four per worker).
+	 */
+	int worker_threads;
+	unsigned max_queued_requests;
+
 	/* Flags & attributes affecting the behaviour of the daemon. */
 	unsigned avoid_oom:1;
 	unsigned foreground:1;
@@ -15,81 +15,97 @@
 
 #include "dmlib.h"
 
+/*
+ * Open addressing hash table with linear probing.
+ *
+ * Each slot caches the full 32-bit hash of its node's key so probing
+ * only touches nodes whose hash matches.  Removed entries leave a
+ * DELETED marker behind so that entries never move while the table is
+ * being iterated.
+ *
+ * The table doubles once three quarters of its slots are in use.  The
+ * previous slot array is kept and its entries are moved across a few
+ * slots at a time on each following insert so that no single insert
+ * pays for rehashing the whole table.  Until that completes, lookups
+ * search both arrays.
+ */
+
 struct dm_hash_node {
-	struct dm_hash_node *next;
 	void *data;
 	unsigned data_len;
 	unsigned keylen;
+	uint32_t hash;
+	unsigned slot;			/* Index in the array holding it */
 	char key[0];
 };
 
+struct dm_hash_slot {
+	uint32_t hash;
+	struct dm_hash_node *node;
+};
+
 struct dm_hash_table {
 	unsigned num_nodes;
-	unsigned num_slots;
-	struct dm_hash_node **slots;
+	unsigned num_slots;		/* Power of two */
+	unsigned num_used;		/* Live and deleted slots */
+	struct dm_hash_slot *slots;
+
+	/* Array being emptied into slots by incremental rehash */
+	unsigned num_old_slots;
+	unsigned old_pos;		/* Old slots below this have been moved */
+	struct dm_hash_slot *old_slots;
 };
 
-/* Permutation of the Integers 0 through 255 */
-static unsigned char _nums[] = {
-	1, 14, 110, 25, 97, 174, 132, 119, 138, 170, 125, 118, 27, 233, 140, 51,
-	87, 197, 177, 107, 234, 169, 56, 68, 30, 7, 173, 73, 188, 40, 36, 65,
-	49, 213, 104, 190, 57, 211, 148, 223, 48, 115, 15, 2, 67, 186, 210, 28,
-	12, 181, 103, 70, 22, 58, 75, 78, 183, 167, 238, 157, 124, 147, 172,
-	144,
-	176, 161, 141, 86, 60, 66, 128, 83, 156, 241, 79, 46, 168, 198, 41, 254,
-	178, 85, 253, 237, 250, 154, 133, 88, 35, 206, 95, 116, 252, 192, 54,
-	221,
-	102, 218, 255, 240, 82, 106, 158, 201, 61, 3, 89, 9, 42, 155, 159, 93,
-	166, 80, 50, 34, 175, 195, 100, 99, 26, 150, 16, 145, 4, 33, 8, 189,
-	121, 64, 77, 72, 208, 245, 130, 122, 143, 55, 105, 134, 29, 164, 185,
-	194,
-	193, 239, 101, 242, 5, 171, 126, 11, 74, 59, 137, 228, 108, 191, 232,
-	139,
-	6, 24, 81, 20, 127, 17, 91, 92, 251, 151, 225, 207, 21, 98, 113, 112,
-	84, 226, 18, 214, 199, 187, 13, 32, 94, 220, 224, 212, 247, 204, 196,
-	43,
-	249, 236, 45, 244, 111, 182, 153, 136, 129, 90, 217, 202, 19, 165, 231,
-	71,
-	230, 142, 96, 227, 62, 179, 246, 114, 162, 53, 160, 215, 205, 180, 47,
-	109,
-	44, 38, 31, 149, 135, 0, 216, 52, 63, 23, 37, 69, 39, 117, 146, 184,
-	163, 200, 222, 235, 248, 243, 219, 10, 152, 131, 123, 229, 203, 76, 120,
-	209
-};
+/* Number of old slots moved across on each insert during rehash */
+#define REHASH_STEP 32
 
-static struct dm_hash_node *_create_node(const char *str, unsigned len)
+static struct dm_hash_node _deleted_node;
+#define DELETED (&_deleted_node)
+
+#define _slot_live(s) ((s)->node && (s)->node != DELETED)
+
+static struct dm_hash_node *_create_node(const char *str, unsigned len,
+					 uint32_t hash)
 {
 	struct dm_hash_node *n = dm_malloc(sizeof(*n) + len);
 
 	if (n) {
 		memcpy(n->key, str, len);
 		n->keylen = len;
+		n->hash = hash;
+		n->data_len = 0;
 	}
 
 	return n;
 }
 
-static unsigned long _hash(const char *str, unsigned len)
+/* FNV-1a with a final avalanche so low bits are usable as slot index */
+static uint32_t _hash(const char *str, unsigned len)
 {
-	unsigned long h = 0, g;
+	uint32_t h = 2166136261u;
 	unsigned i;
 
 	for (i = 0; i < len; i++) {
-		h <<= 4;
-		h += _nums[(unsigned char) *str++];
-		g = h & ((unsigned long) 0xf << 16u);
-		if (g) {
-			h ^= g >> 16u;
-			h ^= g >> 5u;
-		}
+		h ^= (unsigned char) *str++;
+		h *= 16777619u;
 	}
 
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
 	return h;
 }
 
+static struct dm_hash_slot *_alloc_slots(unsigned num_slots)
+{
+	return dm_zalloc(sizeof(struct dm_hash_slot) * num_slots);
+}
+
 struct dm_hash_table *dm_hash_create(unsigned size_hint)
 {
-	size_t len;
 	unsigned new_size = 16u;
 	struct dm_hash_table *hc = dm_zalloc(sizeof(*hc));
 
@@ -101,12 +117,11 @@ struct dm_hash_table *dm_hash_create(unsigned size_hint)
 		new_size = new_size << 1;
 
 	hc->num_slots = new_size;
-	len = sizeof(*(hc->slots)) * new_size;
-	if (!(hc->slots = dm_malloc(len))) {
+	if (!(hc->slots = _alloc_slots(new_size))) {
 		stack;
 		goto bad;
 	}
-	memset(hc->slots, 0, len);
+
 	return hc;
 
       bad:
@@ -115,16 +130,25 @@ struct dm_hash_table *dm_hash_create(unsigned size_hint)
 	return 0;
 }
 
-static void _free_nodes(struct dm_hash_table *t)
+static void _free_slot_nodes(struct dm_hash_slot *slots, unsigned num_slots)
 {
-	struct dm_hash_node *c, *n;
 	unsigned i;
 
-	for (i = 0; i < t->num_slots; i++)
-		for (c = t->slots[i]; c; c = n) {
-			n = c->next;
-			dm_free(c);
-		}
+	for (i = 0; i < num_slots; i++)
+		if (_slot_live(&slots[i]))
+			dm_free(slots[i].node);
+}
+
+static void _free_nodes(struct dm_hash_table *t)
+{
+	_free_slot_nodes(t->slots, t->num_slots);
+
+	if (t->old_slots) {
+		_free_slot_nodes(t->old_slots, t->num_old_slots);
+		dm_free(t->old_slots);
+		t->old_slots = NULL;
+		t->num_old_slots = t->old_pos = 0;
+	}
 }
 
 void dm_hash_destroy(struct dm_hash_table *t)
@@ -134,64 +158,182 @@ void dm_hash_destroy(struct dm_hash_table *t)
 	dm_free(t);
 }
 
-static struct dm_hash_node **_find(struct dm_hash_table *t, const void *key,
-				   uint32_t len)
+/*
+ * Store node in the first free slot of its probe sequence.
+ * Caller ensures the array has free slots.
+ */
+static void _place_node(struct dm_hash_table *t, uint32_t hash,
+			struct dm_hash_node *n)
+{
+	unsigned mask = t->num_slots - 1;
+	unsigned i = hash & mask;
+
+	while (_slot_live(&t->slots[i]))
+		i = (i + 1) & mask;
+
+	if (!t->slots[i].node)
+		t->num_used++;
+
+	t->slots[i].hash = hash;
+	t->slots[i].node = n;
+	n->slot = i;
+}
+
+/* Move up to count old slots into the current array */
+static void _rehash_step(struct dm_hash_table *t, unsigned count)
+{
+	struct dm_hash_slot *s;
+
+	while (t->old_slots && count--) {
+		s = &t->old_slots[t->old_pos];
+		if (_slot_live(s)) {
+			_place_node(t, s->hash, s->node);
+			s->node = DELETED;
+		}
+
+		if (++t->old_pos == t->num_old_slots) {
+			dm_free(t->old_slots);
+			t->old_slots = NULL;
+			t->num_old_slots = t->old_pos = 0;
+		}
+	}
+}
+
+/*
+ * Switch to a new slot array with room for twice the current number of
+ * entries.  Also used to drop DELETED markers once they fill the table.
+ * The table never shrinks, so the old array is always emptied long
+ * before the new one fills up.
+ */
+static int _grow(struct dm_hash_table *t)
+{
+	struct dm_hash_slot *slots;
+	unsigned new_size = t->num_slots;
+
+	/* Finish any rehash still in progress */
+	if (t->old_slots)
+		_rehash_step(t, t->num_old_slots - t->old_pos);
+
+	while (new_size / 2 <= t->num_nodes)
+		new_size <<= 1;
+
+	if (!(slots = _alloc_slots(new_size)))
+		return_0;
+
+	t->old_slots = t->slots;
+	t->num_old_slots = t->num_slots;
+	t->old_pos = 0;
+
+	t->slots = slots;
+	t->num_slots = new_size;
+	t->num_used = 0;
+
+	return 1;
+}
+
+static struct dm_hash_slot *_find_in(struct dm_hash_slot *slots, unsigned num_slots,
+				     uint32_t hash, const void *key, uint32_t len,
+				     const void *val, uint32_t val_len,
+				     struct dm_hash_slot *after)
 {
-	unsigned h = _hash(key, len) & (t->num_slots - 1);
-	struct dm_hash_node **c;
+	unsigned mask = num_slots - 1;
+	unsigned i = hash & mask;
+	struct dm_hash_slot *s;
+
+	if (after)
+		i = ((after - slots) + 1) & mask;
 
-	for (c = &t->slots[h]; *c; c = &((*c)->next)) {
-		if ((*c)->keylen != len)
+	for (; (s = &slots[i])->node; i = (i + 1) & mask) {
+		if (s->hash != hash || s->node == DELETED ||
+		    s->node->keylen != len || memcmp(key, s->node->key, len))
 			continue;
 
-		if (!memcmp(key, (*c)->key, len))
-			break;
+		if (!val)
+			return s;
+
+		if (s->node->data && s->node->data_len == val_len &&
+		    !memcmp(val, s->node->data, val_len))
+			return s;
 	}
 
-	return c;
+	return NULL;
+}
+
+/*
+ * Find the slot holding key.  If val is set, also match the value.
+ */
+static struct dm_hash_slot *_find(struct dm_hash_table *t, const void *key,
+				  uint32_t len, const void *val, uint32_t val_len)
+{
+	uint32_t hash = _hash(key, len);
+	struct dm_hash_slot *s;
+
+	if ((s = _find_in(t->slots, t->num_slots, hash, key, len, val, val_len, NULL)))
+		return s;
+
+	if (t->old_slots)
+		return _find_in(t->old_slots, t->num_old_slots, hash, key, len,
+				val, val_len, NULL);
+
+	return NULL;
+}
+
+static int _insert_node(struct dm_hash_table *t, const void *key, uint32_t len,
+			uint32_t hash, void *data, uint32_t data_len)
+{
+	struct dm_hash_node *n;
+
+	if (t->num_used + 1 > t->num_slots / 4 * 3 && !_grow(t))
+		return_0;
+
+	if (!(n = _create_node(key, len, hash)))
+		return_0;
+
+	n->data = data;
+	n->data_len = data_len;
+	_place_node(t, hash, n);
+	t->num_nodes++;
+
+	_rehash_step(t, REHASH_STEP);
+
+	return 1;
+}
+
+static void _remove_slot(struct dm_hash_table *t, struct dm_hash_slot *s)
+{
+	dm_free(s->node);
+	s->node = DELETED;
+	t->num_nodes--;
 }
 
 void *dm_hash_lookup_binary(struct dm_hash_table *t, const void *key,
 			    uint32_t len)
 {
-	struct dm_hash_node **c = _find(t, key, len);
+	struct dm_hash_slot *s = _find(t, key, len, NULL, 0);
 
-	return *c ? (*c)->data : 0;
+	return s ? s->node->data : 0;
 }
 
 int dm_hash_insert_binary(struct dm_hash_table *t, const void *key,
 			  uint32_t len, void *data)
 {
-	struct dm_hash_node **c = _find(t, key, len);
-
-	if (*c)
-		(*c)->data = data;
-	else {
-		struct dm_hash_node *n = _create_node(key, len);
+	struct dm_hash_slot *s = _find(t, key, len, NULL, 0);
 
-		if (!n)
-			return 0;
-
-		n->data = data;
-		n->next = 0;
-		*c = n;
-		t->num_nodes++;
+	if (s) {
+		s->node->data = data;
+		return 1;
 	}
 
-	return 1;
+	return _insert_node(t, key, len, _hash(key, len), data, 0);
 }
 
 void dm_hash_remove_binary(struct dm_hash_table *t, const void *key,
 			uint32_t len)
 {
-	struct dm_hash_node **c = _find(t, key, len);
+	struct dm_hash_slot *s = _find(t, key, len, NULL, 0);
 
-	if (*c) {
-		struct dm_hash_node *old = *c;
-		*c = (*c)->next;
-		dm_free(old);
-		t->num_nodes--;
-	}
+	if (s)
+		_remove_slot(t, s);
 }
 
 void *dm_hash_lookup(struct dm_hash_table *t, const char *key)
@@ -209,56 +351,12 @@ void dm_hash_remove(struct dm_hash_table *t, const char *key)
 	dm_hash_remove_binary(t, key, strlen(key) + 1);
 }
 
-static struct dm_hash_node **_find_str_with_val(struct dm_hash_table *t,
-					        const void *key, const void *val,
-					        uint32_t len, uint32_t val_len)
-{
-	struct dm_hash_node **c;
-	unsigned h;
-       
-	h = _hash(key, len) & (t->num_slots - 1);
-
-	for (c = &t->slots[h]; *c; c = &((*c)->next)) {
-		if ((*c)->keylen != len)
-			continue;
-
-		if (!memcmp(key, (*c)->key, len) && (*c)->data) {
-			if (((*c)->data_len == val_len) &&
-			    !memcmp(val, (*c)->data, val_len))
-				return c;
-		}
-	}
-
-	return NULL;
-}
-
 int dm_hash_insert_allow_multiple(struct dm_hash_table *t, const char *key,
 				  const void *val, uint32_t val_len)
 {
-	struct dm_hash_node *n;
-	struct dm_hash_node *first;
-	int len = strlen(key) + 1;
-	unsigned h;
-
-	n = _create_node(key, len);
-	if (!n)
-		return 0;
-
-	n->data = (void *)val;
-	n->data_len = val_len;
-
-	h = _hash(key, len) & (t->num_slots - 1);
-
-	first = t->slots[h];
-
-	if (first)
-		n->next = first;
-	else
-		n->next = 0;
-	t->slots[h] = n;
+	uint32_t len = strlen(key) + 1;
 
-	t->num_nodes++;
-	return 1;
+	return _insert_node(t, key, len, _hash(key, len), (void *) val, val_len);
 }
 
 /*
@@ -268,11 +366,11 @@ int dm_hash_insert_allow_multiple(struct dm_hash_table *t, const char *key,
 void *dm_hash_lookup_with_val(struct dm_hash_table *t, const char *key,
 			      const void *val, uint32_t val_len)
 {
-	struct dm_hash_node **c;
+	struct dm_hash_slot *s;
 
-	c = _find_str_with_val(t, key, val, strlen(key) + 1, val_len);
+	s = _find(t, key, strlen(key) + 1, val, val_len);
 
-	return (c && *c) ? (*c)->data : 0;
+	return s ? s->node->data : 0;
 }
 
 /*
@@ -282,16 +380,10 @@ void *dm_hash_lookup_with_val(struct dm_hash_table *t, const char *key,
 void dm_hash_remove_with_val(struct dm_hash_table *t, const char *key,
 			     const void *val, uint32_t val_len)
 {
-	struct dm_hash_node **c;
+	struct dm_hash_slot *s;
 
-	c = _find_str_with_val(t, key, val, strlen(key) + 1, val_len);
-
-	if (c && *c) {
-		struct dm_hash_node *old = *c;
-		*c = (*c)->next;
-		dm_free(old);
-		t->num_nodes--;
-	}
+	if ((s = _find(t, key, strlen(key) + 1, val, val_len)))
+		_remove_slot(t, s);
 }
 
 /*
@@ -308,30 +400,26 @@ void dm_hash_remove_with_val(struct dm_hash_table *t, const char *key,
  */
 void *dm_hash_lookup_with_count(struct dm_hash_table *t, const char *key, int *count)
 {
-	struct dm_hash_node **c;
-	struct dm_hash_node **c1 = NULL;
+	struct dm_hash_slot *s, *first = NULL;
 	uint32_t len = strlen(key) + 1;
-	unsigned h;
+	uint32_t hash = _hash(key, len);
 
 	*count = 0;
 
-	h = _hash(key, len) & (t->num_slots - 1);
-
-	for (c = &t->slots[h]; *c; c = &((*c)->next)) {
-		if ((*c)->keylen != len)
-			continue;
+	for (s = NULL; (s = _find_in(t->slots, t->num_slots, hash, key, len, NULL, 0, s)); ) {
+		(*count)++;
+		if (!first)
+			first = s;
+	}
 
-		if (!memcmp(key, (*c)->key, len)) {
+	if (t->old_slots)
+		for (s = NULL; (s = _find_in(t->old_slots, t->num_old_slots, hash, key, len, NULL, 0, s)); ) {
 			(*count)++;
-			if (!c1)
-				c1 = c;
+			if (!first)
+				first = s;
 		}
-	}
 
-	if (!c1)
-		return NULL;
-	else
-		return *c1 ? (*c1)->data : 0;
+	return first ? first->node->data : NULL;
 }
 
 unsigned dm_hash_get_num_entries(struct dm_hash_table *t)
@@ -342,20 +430,20 @@ unsigned dm_hash_get_num_entries(struct dm_hash_table *t)
 void dm_hash_iter(struct dm_hash_table *t, dm_hash_iterate_fn f)
 {
 	struct dm_hash_node *c, *n;
-	unsigned i;
 
-	for (i = 0; i < t->num_slots; i++)
-		for (c = t->slots[i]; c; c = n) {
-			n = c->next;
-			f(c->data);
-		}
+	/* f may remove the entry from the table */
+	for (c = dm_hash_get_first(t); c; c = n) {
+		n = dm_hash_get_next(t, c);
+		f(c->data);
+	}
 }
 
 void dm_hash_wipe(struct dm_hash_table *t)
 {
 	_free_nodes(t);
-	memset(t->slots, 0, sizeof(struct dm_hash_node *) * t->num_slots);
+	memset(t->slots, 0, sizeof(struct dm_hash_slot) * t->num_slots);
 	t->num_nodes = 0u;
+	t->num_used = 0u;
 }
 
 char *dm_hash_get_key(struct dm_hash_table *t __attribute__((unused)),
@@ -370,25 +458,39 @@ void *dm_hash_get_data(struct dm_hash_table *t __attribute__((unused)),
 	return n->data;
 }
 
-static struct dm_hash_node *_next_slot(struct dm_hash_table *t, unsigned s)
+/*
+ * Iteration visits the current slot array and then whatever is left
+ * in the old one.
+ */
+static struct dm_hash_node *_next_slot(struct dm_hash_table *t,
+				       struct dm_hash_slot *slots, unsigned s)
 {
-	struct dm_hash_node *c = NULL;
 	unsigned i;
 
-	for (i = s; i < t->num_slots && !c; i++)
-		c = t->slots[i];
+	if (slots == t->slots) {
+		for (i = s; i < t->num_slots; i++)
+			if (_slot_live(&t->slots[i]))
+				return t->slots[i].node;
+		s = 0;
+	}
+
+	if (t->old_slots)
+		for (i = s; i < t->num_old_slots; i++)
+			if (_slot_live(&t->old_slots[i]))
+				return t->old_slots[i].node;
 
-	return c;
+	return NULL;
 }
 
 struct dm_hash_node *dm_hash_get_first(struct dm_hash_table *t)
 {
-	return _next_slot(t, 0);
+	return _next_slot(t, t->slots, 0);
 }
 
 struct dm_hash_node *dm_hash_get_next(struct dm_hash_table *t, struct dm_hash_node *n)
 {
-	unsigned h = _hash(n->key, n->keylen) & (t->num_slots - 1);
+	if (n->slot < t->num_slots && t->slots[n->slot].node == n)
+		return _next_slot(t, t->slots, n->slot + 1);
 
-	return n->next ? n->next : _next_slot(t, h + 1);
+	return _next_slot(t, t->old_slots, n->slot + 1);
 }
@@ -115,6 +115,9 @@ static struct cmd_data _cmd_data_v4[] = {
 #ifdef DM_DEV_SET_GEOMETRY
 	{"setgeometry",	DM_DEV_SET_GEOMETRY,	{4, 6, 0}},
 #endif
+#ifdef DM_DEV_ARM_POLL
+	{"armpoll",	DM_DEV_ARM_POLL,	{4, 37, 0}},
+#endif
 };
 /* *INDENT-ON* */
 
@@ -467,7 +470,7 @@ static void _dm_zfree_dmi(struct dm_ioctl *dmi)
 	}
 }
 
-void dm_task_destroy(struct dm_task *dmt)
+static void _dm_task_free_targets(struct dm_task *dmt)
 {
 	struct target *t, *n;
 
@@ -478,7 +481,15 @@ void dm_task_destroy(struct dm_task *dmt)
 		dm_free(t);
 	}
 
+	dmt->head = dmt->tail = NULL;
+}
+
+void dm_task_destroy(struct dm_task *dmt)
+{
+	_dm_task_free_targets(dmt);
+
 	_dm_zfree_dmi(dmt->dmi.v4);
+	_dm_zfree_dmi(dmt->dmi_spare);
 	dm_free(dmt->dev_name);
 	dm_free(dmt->mangled_dev_name);
 	dm_free(dmt->newname);
@@ -741,6 +752,31 @@ struct dm_names *dm_task_get_names(struct dm_task *dmt)
 				    dmt->dmi.v4->data_start);
 }
 
+int dm_task_get_names_event_nr(struct dm_task *dmt,
+			       const struct dm_names *names,
+			       uint32_t *event_nr)
+{
+	const unsigned *v = dmt->dmi.v4->version;
+
+	/*
+	 * Driver 4.37 stores event_nr 8-byte aligned after the name and
+	 * pads it to the next entry. Prefer the offset of the next entry
+	 * since unmangling may have shortened the name in place.
+	 */
+	if (v[0] < 4 || (v[0] == 4 && v[1] < 37))
+		return 0;
+
+	if (names->next)
+		*event_nr = *(const uint32_t *) ((const char *) names +
+						 names->next - ALIGNMENT);
+	else
+		*event_nr = *(const uint32_t *) _align((char *) names->name +
+						       strlen(names->name) + 1,
+						       ALIGNMENT);
+
+	return 1;
+}
+
 struct dm_versions *dm_task_get_versions(struct dm_task *dmt)
 {
 	return (struct dm_versions *) (((char *) dmt->dmi.v4) +
@@ -1075,7 +1111,8 @@ static int _lookup_dev_name(uint64_t dev, char *buf, size_t len)
 	return r;
 }
 
-static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
+static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count,
+				 size_t *size)
 {
 	const size_t min_size = 16 * 1024;
 	const int (*version)[3];
@@ -1148,9 +1185,18 @@ static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
 	while (repeat_count--)
 		len *= 2;
 
-	if (!(dmi = dm_malloc(len)))
+	/*
+	 * Task run again: reuse the spare buffer if it was allocated big
+	 * enough.  Not data_size, which the kernel shrinks to what it used.
+	 */
+	if ((dmi = dmt->dmi_spare) && (dmt->dmi_spare_size >= len)) {
+		dmt->dmi_spare = NULL;
+		len = dmt->dmi_spare_size;
+	} else if (!(dmi = dm_malloc(len)))
 		return NULL;
 
+	*size = len;
+
 	memset(dmi, 0, len);
 
 	version = &_cmd_data_v4[dmt->type].version;
@@ -1551,6 +1597,7 @@ static int _reload_with_suppression_v4(struct dm_task *dmt)
 	
 	if (!t1 && !t2) {
 		dmt->dmi.v4 = task->dmi.v4;
+		dmt->dmi_size = task->dmi_size;
 		task->dmi.v4 = NULL;
 		dm_task_destroy(task);
 		return 1;
@@ -1745,7 +1792,7 @@ static int _dm_ioctl_unmangle_uuids(int type, struct dm_ioctl *dmi)
 static struct dm_ioctl *_do_dm_ioctl(struct dm_task *dmt, unsigned command,
 				     unsigned buffer_repeat_count,
 				     unsigned retry_repeat_count,
-				     int *retryable)
+				     int *retryable, size_t *size)
 {
 	struct dm_ioctl *dmi;
 	int ioctl_with_uevent;
@@ -1753,7 +1800,7 @@ static struct dm_ioctl *_do_dm_ioctl(struct dm_task *dmt, unsigned command,
 
 	dmt->ioctl_errno = 0;
 
-	dmi = _flatten(dmt, buffer_repeat_count);
+	dmi = _flatten(dmt, buffer_repeat_count, size);
 	if (!dmi) {
 		log_error("Couldn't create ioctl argument.");
 		return NULL;
@@ -1932,6 +1979,7 @@ int dm_task_run(struct dm_task *dmt)
 	int suspended_counter;
 	unsigned ioctl_retry = 1;
 	int retryable = 0;
+	size_t size;
 	const char *dev_name = DEV_NAME(dmt);
 	const char *dev_uuid = DEV_UUID(dmt);
 
@@ -1981,7 +2029,7 @@ int dm_task_run(struct dm_task *dmt)
 	/* FIXME Detect and warn if cookie set but should not be. */
 repeat_ioctl:
 	if (!(dmi = _do_dm_ioctl(dmt, command, _ioctl_buffer_double_factor,
-				 ioctl_retry, &retryable))) {
+				 ioctl_retry, &retryable, &size))) {
 		/*
 		 * Async udev rules that scan devices commonly cause transient
 		 * failures.  Normally you'd expect the user to have made sure
@@ -2070,14 +2118,22 @@ repeat_ioctl:
 	case DM_DEVICE_STATUS:
 	case DM_DEVICE_TABLE:
 	case DM_DEVICE_WAITEVENT:
+		/* Replace targets returned by a previous run */
+		_dm_task_free_targets(dmt);
 		if (!_unmarshal_status(dmt, dmi))
 			goto bad;
 		break;
 	}
 
-	/* Was structure reused? */
-	_dm_zfree_dmi(dmt->dmi.v4);
+	/*
+	 * Keep the results of the previous run until this one succeeded,
+	 * then hold on to its buffer for the next run.
+	 */
+	_dm_zfree_dmi(dmt->dmi_spare);
+	dmt->dmi_spare = dmt->dmi.v4;
+	dmt->dmi_spare_size = dmt->dmi_size;
 	dmt->dmi.v4 = dmi;
+	dmt->dmi_size = size;
 	return 1;
 
       bad:
@@ -2093,6 +2149,14 @@ void dm_hold_control_dev(int hold_open)
 		  _hold_control_fd_open ? "" : "un");
 }
 
+int dm_get_control_fd(void)
+{
+	if (!_open_control())
+		return -1;
+
+	return _control_fd;
+}
+
 void dm_lib_release(void)
 {
 	if (!_hold_control_fd_open)
@@ -50,6 +50,9 @@ struct dm_task {
 	union {
 		struct dm_ioctl *v4;
 	} dmi;
+	size_t dmi_size;		/* Allocated size of dmi.v4 */
+	struct dm_ioctl *dmi_spare;	/* Buffer of an earlier run to reuse */
+	size_t dmi_spare_size;
 	char *newname;
 	char *message;
 	char *geometry;
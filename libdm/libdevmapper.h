@@ -119,7 +119,9 @@ enum {
 	
 	DM_DEVICE_TARGET_MSG,
 
-	DM_DEVICE_SET_GEOMETRY
+	DM_DEVICE_SET_GEOMETRY,
+
+	DM_DEVICE_ARM_POLL
 };
 
 /*
@@ -207,6 +209,15 @@ const char *dm_task_get_message_response(struct dm_task *dmt);
 const char *dm_task_get_name(const struct dm_task *dmt);
 struct dm_names *dm_task_get_names(struct dm_task *dmt);
 
+/*
+ * With driver version 4.37.0 or later a DM_DEVICE_LIST task also
+ * returns the current event number of each listed device. Returns 0
+ * if the driver that ran dmt did not supply it.
+ */
+int dm_task_get_names_event_nr(struct dm_task *dmt,
+			       const struct dm_names *names,
+			       uint32_t *event_nr);
+
 int dm_task_set_ro(struct dm_task *dmt);
 int dm_task_set_newname(struct dm_task *dmt, const char *newname);
 int dm_task_set_newuuid(struct dm_task *dmt, const char *newuuid);
@@ -432,6 +443,60 @@ struct dm_status_thin {
 int dm_get_status_thin(struct dm_pool *mem, const char *params,
 		       struct dm_status_thin **status);
 
+/*
+ * Status batch.
+ *
+ * Reads the status of a set of devices in a single pass, typically
+ * driven by one polling loop on behalf of many monitors. A device
+ * queued with dm_status_batch_add() keeps its status task inside the
+ * batch between runs, so the ioctl buffer of the previous run is
+ * reused instead of being allocated again for every read.
+ *
+ * The batch is not thread-safe.
+ */
+struct dm_status_batch;
+
+struct dm_status_batch_counters {
+	uint64_t passes;	/* Runs that read at least one device */
+	uint64_t ioctls;	/* Status ioctls issued */
+	uint64_t failures;	/* Status ioctls that failed */
+	uint64_t ioctl_ns;	/* Time spent in status ioctls */
+};
+
+/*
+ * Called once for each device read by dm_status_batch_run() with the
+ * context given to dm_status_batch_add(). dmt is NULL if the status
+ * could not be read. Otherwise it remains owned by the batch and stays
+ * valid until the device is run again or removed; it must not be
+ * destroyed by the caller.
+ */
+typedef int (*dm_status_batch_fn)(struct dm_task *dmt, void *context, void *data);
+
+struct dm_status_batch *dm_status_batch_create(void);
+
+/*
+ * Queue device uuid for the next dm_status_batch_run(). Adding a
+ * device that is already known only updates its context.
+ */
+int dm_status_batch_add(struct dm_status_batch *dsb, const char *uuid, void *context);
+
+/*
+ * Forget device uuid and release its status task.
+ */
+void dm_status_batch_remove(struct dm_status_batch *dsb, const char *uuid);
+
+/*
+ * Read the status of all queued devices and call fn for each of them.
+ * Returns 0 if any callback failed.
+ */
+int dm_status_batch_run(struct dm_status_batch *dsb,
+			dm_status_batch_fn fn, void *data);
+
+void dm_status_batch_get_counters(struct dm_status_batch *dsb,
+				  struct dm_status_batch_counters *counters);
+
+void dm_status_batch_destroy(struct dm_status_batch *dsb);
+
 /*
  * device-mapper statistics support
  */
@@ -1318,6 +1383,34 @@ uint64_t *dm_stats_create_regions_from_fd(struct dm_stats *dms, int fd,
 					  struct dm_histogram *bounds,
 					  const char *alias);
 
+/*
+ * Update a group of regions that correspond to the extents of a file
+ * in the filesystem, adding and removing regions to account for
+ * allocation changes in the underlying file.
+ *
+ * File descriptor fd must reference a regular file, open for reading,
+ * in a local file system that supports the FIEMAP ioctl and that
+ * returns data describing the physical location of extents.
+ *
+ * Regions whose start and length still match an extent of the file
+ * are left in place and retain their counter values: only regions for
+ * extents that have been added, moved or resized are created and stale
+ * regions are deleted. New regions use the histogram bounds, precision
+ * and alias of the existing group.
+ *
+ * The function returns a pointer to an array of uint64_t containing
+ * the IDs of the regions in the updated group. The array is terminated
+ * by the value DM_STATS_REGIONS_ALL and should be freed using
+ * dm_free() when no longer required.
+ *
+ * The array is sorted by region_id: since the group_id is the lowest
+ * region_id in the group it may change as a result of the update and
+ * the group_id for the updated group is equal to the region_id value in
+ * the first array element.
+ */
+uint64_t *dm_stats_update_regions_from_fd(struct dm_stats *dms, int fd,
+					  uint64_t group_id);
+
 /*
  * Call this to actually run the ioctl.
  */
@@ -1446,6 +1539,15 @@ void dm_lib_exit(void) __attribute__((destructor));
 /* An optimisation for clients making repeated calls involving dm ioctls */
 void dm_hold_control_dev(int hold_open);
 
+/*
+ * Return the file descriptor of the control device, opening it if
+ * necessary, or -1 on failure. Once a DM_DEVICE_ARM_POLL task has run
+ * (driver version 4.37.0 or later) the descriptor polls readable as
+ * soon as any device raises an event. Use dm_hold_control_dev() to
+ * keep it open across dm_lib_release().
+ */
+int dm_get_control_fd(void);
+
 /*
  * Use NULL for all devices.
  */
@@ -3038,6 +3140,81 @@ uint64_t dm_stats_get_counter(const struct dm_stats *dms,
 			      dm_stats_counter_t counter,
 			      uint64_t region_id, uint64_t area_id);
 
+/*
+ * Stats samplers: repeated sampling with constant memory.
+ *
+ * dm_stats_sampler_create() lists the regions of the device bound to
+ * dms (selected by program_id as for dm_stats_populate()) and allocates
+ * counter and histogram tables for every area once. Each call to
+ * dm_stats_sampler_sample() then reads and clears the counters of all
+ * listed regions, storing the values in place in the tables used by
+ * dm_stats_get_counter(), dm_stats_get_histogram() and the metric
+ * functions, and sets the sampling interval of dms to the time since
+ * the previous sample.
+ *
+ * The counters of the last nr_samples samples are also kept by the
+ * sampler and may be read with dm_stats_sampler_get_counter(): sample 0
+ * is the most recent. Group aggregation is not available for samples
+ * read from the history.
+ *
+ * If the device has no regions, dm_stats_sampler_create() returns NULL
+ * without logging an error and dm_stats_get_nr_regions() returns zero.
+ *
+ * Regions created after the sampler are not sampled. If a sampled
+ * region is deleted or changed dm_stats_sampler_sample() fails and a
+ * new sampler should be created.
+ *
+ * Any call that replaces the region table of dms (dm_stats_list,
+ * dm_stats_populate) detaches the sampler; it must still be released
+ * with dm_stats_sampler_destroy(). A sampler must be destroyed before
+ * the dm_stats handle it was created from.
+ */
+struct dm_stats_sampler;
+
+struct dm_stats_sampler *dm_stats_sampler_create(struct dm_stats *dms,
+						 const char *program_id,
+						 unsigned nr_samples);
+
+int dm_stats_sampler_sample(struct dm_stats_sampler *dss);
+
+/*
+ * Number of samples currently held (at most nr_samples).
+ */
+unsigned dm_stats_sampler_get_nr_samples(const struct dm_stats_sampler *dss);
+
+/*
+ * Time in nanoseconds between a sample and the one before it. For the
+ * first sample this is the time since the sampler was created.
+ */
+uint64_t dm_stats_sampler_get_interval_ns(const struct dm_stats_sampler *dss,
+					  unsigned sample);
+
+/*
+ * Read a counter value from a stored sample. The special values
+ * DM_STATS_REGION_CURRENT and DM_STATS_AREA_CURRENT use the current
+ * cursor of the dm_stats handle and DM_STATS_WALK_REGION as area_id
+ * returns the sum over all areas of the region.
+ */
+uint64_t dm_stats_sampler_get_counter(const struct dm_stats_sampler *dss,
+				      dm_stats_counter_t counter,
+				      uint64_t region_id, uint64_t area_id,
+				      unsigned sample);
+
+/*
+ * Return the histogram accumulated over all samples taken by the
+ * sampler for an area, a region (area_id DM_STATS_WALK_REGION) or a
+ * group (region_id DM_STATS_WALK_GROUP | group_id), or the object at
+ * the current cursor position of the dm_stats handle when given
+ * DM_STATS_REGION_CURRENT and DM_STATS_AREA_CURRENT.
+ *
+ * Returns NULL if the region has no histogram configured.
+ */
+struct dm_histogram *dm_stats_sampler_get_histogram(const struct dm_stats_sampler *dss,
+						    uint64_t region_id,
+						    uint64_t area_id);
+
+void dm_stats_sampler_destroy(struct dm_stats_sampler *dss);
+
 uint64_t dm_stats_get_reads(const struct dm_stats *dms,
 			    uint64_t region_id, uint64_t area_id);
 
@@ -3244,6 +3421,20 @@ uint64_t dm_histogram_get_bin_count(const struct dm_histogram *dmh, int bin);
 dm_percent_t dm_histogram_get_bin_percent(const struct dm_histogram *dmh,
 					  int bin);
 
+/*
+ * Estimate the latency below which the given percentage (0 to 100) of
+ * the I/Os counted in the histogram completed, e.g. 99.9 for p99.9.
+ *
+ * Latencies are assumed to be evenly distributed within each bin and
+ * the estimate is interpolated from the bin bounds. If the percentile
+ * falls in the final, unbounded, bin the lower bound of that bin is
+ * returned. An empty histogram gives a value of zero.
+ *
+ * Returns 1 on success or 0 for an invalid percentile.
+ */
+int dm_histogram_get_percentile(const struct dm_histogram *dmh,
+				double percentile, uint64_t *value);
+
 /*
  * Return the total observations (sum of bin counts) for the histogram
  * of the area specified by region_id and area_id.
@@ -3332,6 +3523,12 @@ struct dm_config_tree {
 struct dm_config_tree *dm_config_create(void);
 struct dm_config_tree *dm_config_from_string(const char *config_settings);
 int dm_config_parse(struct dm_config_tree *cft, const char *start, const char *end);
+/*
+ * Like dm_config_parse, but the tree's keys and strings point into the
+ * buffer instead of being copied: the buffer is modified and must stay
+ * valid until the tree is destroyed. *end must be writable.
+ */
+int dm_config_parse_in_place(struct dm_config_tree *cft, char *start, char *end);
 
 void *dm_config_get_custom(struct dm_config_tree *cft);
 void dm_config_set_custom(struct dm_config_tree *cft, void *custom);
@@ -3341,6 +3538,15 @@ void dm_config_set_custom(struct dm_config_tree *cft, void *custom);
  */
 struct dm_config_tree *dm_config_insert_cascaded_tree(struct dm_config_tree *first_cft, struct dm_config_tree *second_cft);
 
+/*
+ * Keep a hash of the children of large sections, built as lookups
+ * first scan them, so dm_config_tree_find_*() is not linear in the
+ * size of a section.  Setting it again drops the hash, as is needed
+ * after nodes are relinked other than through the tree.  Not for
+ * trees looked up from several threads at once.
+ */
+void dm_config_tree_set_indexed(struct dm_config_tree *cft, int indexed);
+
 /*
  * If there's a cascaded dm_config_tree, remove the top layer
  * and return the layer below.  Otherwise return NULL.
@@ -2435,6 +2435,8 @@ static const char *_task_type_disp(int type)
 		return "TARGET_MSG";
         case DM_DEVICE_SET_GEOMETRY:
 		return "SET_GEOMETRY";
+        case DM_DEVICE_ARM_POLL:
+		return "ARM_POLL";
 	}
 	return "unknown";
 }
@@ -25,6 +25,10 @@
 #define SECTION_B_CHAR '{'
 #define SECTION_E_CHAR '}'
 
+/* Sections with at least this many children get looked up by hash */
+#define INDEX_MIN_CHILDREN 64
+#define INDEX_MAX_KEY 256
+
 enum {
 	TOK_INT,
 	TOK_FLOAT,
@@ -41,6 +45,17 @@ enum {
 	TOK_EOF
 };
 
+/*
+ * Private part of every tree returned by dm_config_create().
+ * The lookup index is built section by section as lookups scan
+ * large sections and uses the same keys as the parser's.
+ */
+struct config_tree {
+	struct dm_config_tree cft;	/* Must be first */
+	struct dm_hash_table *index;
+	int indexed;
+};
+
 struct parser {
 	const char *fb, *fe;		/* file limits */
 
@@ -50,6 +65,16 @@ struct parser {
 	int line;		/* line number we are on */
 
 	struct dm_pool *mem;
+	/*
+	 * Maps the address of a section node followed by a child's name
+	 * to that child.  A key that is just the section's address marks
+	 * the section as indexed.  Dummy parents (with no key) are never
+	 * indexed.
+	 */
+	struct dm_hash_table *index;
+
+	int in_place;		/* strings are kept in the parsed buffer */
+	char *term;		/* in_place: '\0' still due at end of last string */
 };
 
 struct config_output {
@@ -69,6 +94,7 @@ static int _match_aux(struct parser *p, int t);
 static struct dm_config_value *_create_value(struct dm_pool *mem);
 static struct dm_config_node *_create_node(struct dm_pool *mem);
 static char *_dup_tok(struct parser *p);
+static void _terminate_tok(struct parser *p);
 static char *_dup_token(struct dm_pool *mem, const char *b, const char *e);
 
 static const int sep = '/';
@@ -95,7 +121,7 @@ static int _tok_match(const char *str, const char *b, const char *e)
 
 struct dm_config_tree *dm_config_create(void)
 {
-	struct dm_config_tree *cft;
+	struct config_tree *ct;
 	struct dm_pool *mem = dm_pool_create("config", 10 * 1024);
 
 	if (!mem) {
@@ -103,14 +129,30 @@ struct dm_config_tree *dm_config_create(void)
 		return 0;
 	}
 
-	if (!(cft = dm_pool_zalloc(mem, sizeof(*cft)))) {
+	if (!(ct = dm_pool_zalloc(mem, sizeof(*ct)))) {
 		log_error("Failed to allocate config tree.");
 		dm_pool_destroy(mem);
 		return 0;
 	}
-	cft->mem = mem;
+	ct->cft.mem = mem;
 
-	return cft;
+	return &ct->cft;
+}
+
+static void _drop_index(struct config_tree *ct)
+{
+	if (ct->index) {
+		dm_hash_destroy(ct->index);
+		ct->index = NULL;
+	}
+}
+
+void dm_config_tree_set_indexed(struct dm_config_tree *cft, int indexed)
+{
+	struct config_tree *ct = (struct config_tree *) cft;
+
+	ct->indexed = indexed;
+	_drop_index(ct);
 }
 
 void dm_config_set_custom(struct dm_config_tree *cft, void *custom)
@@ -125,6 +167,7 @@ void *dm_config_get_custom(struct dm_config_tree *cft)
 
 void dm_config_destroy(struct dm_config_tree *cft)
 {
+	_drop_index((struct config_tree *) cft);
 	dm_pool_destroy(cft->mem);
 }
 
@@ -170,27 +213,53 @@ static struct dm_config_node *_config_reverse(struct dm_config_node *head)
 	return middle;
 }
 
-int dm_config_parse(struct dm_config_tree *cft, const char *start, const char *end)
+static int _parse(struct dm_config_tree *cft, const char *start, const char *end,
+		  int in_place)
 {
 	/* TODO? if (start == end) return 1; */
 
 	struct parser *p;
-	if (!(p = dm_pool_alloc(cft->mem, sizeof(*p))))
+	int r = 0;
+
+	if (!(p = dm_pool_zalloc(cft->mem, sizeof(*p))))
 		return_0;
 
+	/* The old root goes */
+	_drop_index((struct config_tree *) cft);
+
 	p->mem = cft->mem;
 	p->fb = start;
 	p->fe = end;
 	p->tb = p->te = p->fb;
 	p->line = 1;
+	p->in_place = in_place;
 
 	_get_token(p, TOK_SECTION_E);
 	if (!(cft->root = _file(p)))
-		return_0;
+		goto_out;
 
 	cft->root = _config_reverse(cft->root);
+	r = 1;
+out:
+	/* Callers may relink nodes later, which an index would miss */
+	if (p->index)
+		dm_hash_destroy(p->index);
 
-	return 1;
+	return r;
+}
+
+int dm_config_parse(struct dm_config_tree *cft, const char *start, const char *end)
+{
+	return _parse(cft, start, end, 0);
+}
+
+/*
+ * Keys and string values are not copied: they are terminated and
+ * unescaped where they are in the buffer, which the tree then refers to.
+ */
+int dm_config_parse_in_place(struct dm_config_tree *cft, char *start, char *end)
+{
+	return _parse(cft, start, end, 1);
 }
 
 struct dm_config_tree *dm_config_from_string(const char *config_settings)
@@ -469,7 +538,11 @@ static char *_dup_string_tok(struct parser *p)
 		return NULL;
 	}
 
-	if (!(str = _dup_tok(p)))
+	if (p->in_place) {
+		/* The closing quote belongs to this token, reuse it now. */
+		str = (char *) p->tb;
+		*(char *) p->te = '\0';
+	} else if (!(str = _dup_tok(p)))
 		return_NULL;
 
 	p->te++;
@@ -480,7 +553,6 @@ static char *_dup_string_tok(struct parser *p)
 static struct dm_config_node *_file(struct parser *p)
 {
 	struct dm_config_node root = { 0 };
-	root.key = "<root>";
 
 	while (p->t != TOK_EOF)
 		if (!_section(p, &root))
@@ -490,14 +562,19 @@ static struct dm_config_node *_file(struct parser *p)
 
 static struct dm_config_node *_make_node(struct dm_pool *mem,
 					 const char *key_b, const char *key_e,
-					 struct dm_config_node *parent)
+					 struct dm_config_node *parent,
+					 int key_owned)
 {
 	struct dm_config_node *n;
 
 	if (!(n = _create_node(mem)))
 		return_NULL;
 
-	n->key = _dup_token(mem, key_b, key_e);
+	/* A final path segment the tree already owns needs no copy */
+	if (key_owned && !*key_e)
+		n->key = key_b;
+	else if (!(n->key = _dup_token(mem, key_b, key_e)))
+		return_NULL;
 	if (parent) {
 		n->parent = parent;
 		n->sib = parent->child;
@@ -506,14 +583,83 @@ static struct dm_config_node *_make_node(struct dm_pool *mem,
 	return n;
 }
 
-/* when mem is not NULL, we create the path if it doesn't exist yet */
+static size_t _index_key(char *buf, const struct dm_config_node *parent,
+			 const char *b, const char *e)
+{
+	size_t len = e - b;
+
+	/* An empty name would look like the section marker */
+	if (!len || len > INDEX_MAX_KEY - sizeof(parent))
+		return 0;
+
+	memcpy(buf, &parent, sizeof(parent));
+	memcpy(buf + sizeof(parent), b, len);
+
+	return sizeof(parent) + len;
+}
+
+static int _index_has_section(struct dm_hash_table *index,
+			      const struct dm_config_node *parent)
+{
+	return index && parent && parent->key &&
+		dm_hash_lookup_binary(index, &parent, sizeof(parent));
+}
+
+/* The first of any duplicates is the one found */
+static int _index_insert(struct dm_hash_table *index,
+			 const struct dm_config_node *parent,
+			 struct dm_config_node *cn)
+{
+	char key[INDEX_MAX_KEY];
+	size_t len;
+
+	if (!(len = _index_key(key, parent, cn->key, cn->key + strlen(cn->key))))
+		return 1;
+
+	if (dm_hash_lookup_binary(index, key, len)) {
+		log_warn("WARNING: Ignoring duplicate config node: %s", cn->key);
+		return 1;
+	}
+
+	return dm_hash_insert_binary(index, key, len, cn);
+}
+
+static void _index_section(struct dm_hash_table **index, struct dm_config_node *parent)
+{
+	struct dm_config_node *cn;
+
+	if (!*index && !(*index = dm_hash_create(1024)))
+		return;
+
+	for (cn = parent->child; cn; cn = cn->sib)
+		if (!_index_insert(*index, parent, cn))
+			goto bad;
+
+	if (dm_hash_insert_binary(*index, &parent, sizeof(parent), parent))
+		return;
+bad:
+	/* Not fatal: lookups just fall back to scanning the section */
+	dm_hash_destroy(*index);
+	*index = NULL;
+}
+
+/*
+ * When mem is not NULL, we create the path if it doesn't exist yet.
+ * With path_owned, path lives as long as the tree and may be referenced.
+ * With index, large sections are indexed and searched by name.
+ */
 static struct dm_config_node *_find_or_make_node(struct dm_pool *mem,
+						 struct dm_hash_table **index,
 						 struct dm_config_node *parent,
-						 const char *path)
+						 const char *path, int path_owned)
 {
 	const char *e;
 	struct dm_config_node *cn = parent ? parent->child : NULL;
 	struct dm_config_node *cn_found = NULL;
+	char key[INDEX_MAX_KEY];
+	unsigned nr_children;
+	size_t len;
+	int indexed;
 
 	while (cn || mem) {
 		/* trim any leading slashes */
@@ -525,24 +671,41 @@ static struct dm_config_node *_find_or_make_node(struct dm_pool *mem,
 
 		/* hunt for the node */
 		cn_found = NULL;
+		indexed = index && _index_has_section(*index, parent);
+
+		if (indexed && (len = _index_key(key, parent, path, e)))
+			cn_found = dm_hash_lookup_binary(*index, key, len);
+		else {
+			nr_children = 0;
+			while (cn) {
+				if (_tok_match(cn->key, path, e)) {
+					/* Inefficient */
+					if (!cn_found)
+						cn_found = cn;
+					else
+						log_warn("WARNING: Ignoring duplicate"
+							 " config node: %s ("
+							 "seeking %s)", cn->key, path);
+				}
 
-		while (cn) {
-			if (_tok_match(cn->key, path, e)) {
-				/* Inefficient */
-				if (!cn_found)
-					cn_found = cn;
-				else
-					log_warn("WARNING: Ignoring duplicate"
-						 " config node: %s ("
-						 "seeking %s)", cn->key, path);
+				cn = cn->sib;
+				nr_children++;
 			}
 
-			cn = cn->sib;
+			if (!indexed && index && parent && parent->key &&
+			    nr_children >= INDEX_MIN_CHILDREN) {
+				_index_section(index, parent);
+				indexed = _index_has_section(*index, parent);
+			}
 		}
 
 		if (!cn_found && mem) {
-			if (!(cn_found = _make_node(mem, path, e, parent)))
+			if (!(cn_found = _make_node(mem, path, e, parent, path_owned)))
 				return_NULL;
+			if (indexed && !_index_insert(*index, parent, cn_found)) {
+				dm_hash_destroy(*index);
+				*index = NULL;
+			}
 		}
 
 		if (cn_found && *e) {
@@ -588,7 +751,7 @@ static struct dm_config_node *_section(struct parser *p, struct dm_config_node *
 		return NULL;
 	}
 
-	if (!(root = _find_or_make_node(p->mem, parent, str)))
+	if (!(root = _find_or_make_node(p->mem, &p->index, parent, str, 1)))
 		return_NULL;
 
 	if (p->t == TOK_SECTION_B) {
@@ -732,6 +895,7 @@ static void _get_token(struct parser *p, int tok_prev)
 	_eat_space(p);
 	if (p->tb == p->fe || !*p->tb) {
 		p->t = TOK_EOF;
+		_terminate_tok(p);
 		return;
 	}
 
@@ -843,6 +1007,7 @@ static void _get_token(struct parser *p, int tok_prev)
 	}
 
 	p->te = te;
+	_terminate_tok(p);
 }
 
 static void _eat_space(struct parser *p)
@@ -893,9 +1058,23 @@ static char *_dup_token(struct dm_pool *mem, const char *b, const char *e)
 
 static char *_dup_tok(struct parser *p)
 {
+	if (p->in_place) {
+		/* The byte after the token is only overwritten once scanned */
+		p->term = (char *) p->te;
+		return (char *) p->tb;
+	}
+
 	return _dup_token(p->mem, p->tb, p->te);
 }
 
+static void _terminate_tok(struct parser *p)
+{
+	if (p->term) {
+		*p->term = '\0';
+		p->term = NULL;
+	}
+}
+
 /*
  * Utility functions
  */
@@ -912,16 +1091,21 @@ typedef const struct dm_config_node *node_lookup_fn(const void *start, const cha
 
 static const struct dm_config_node *_find_config_node(const void *start, const char *path) {
 	struct dm_config_node dummy = { .child = (void *) start };
-	return _find_or_make_node(NULL, &dummy, path);
+	return _find_or_make_node(NULL, NULL, &dummy, path, 0);
 }
 
 static const struct dm_config_node *_find_first_config_node(const void *start, const char *path)
 {
 	const struct dm_config_tree *cft = start;
 	const struct dm_config_node *cn = NULL;
+	struct dm_config_node dummy = { 0 };
+	struct config_tree *ct;
 
 	while (cft) {
-		if ((cn = _find_config_node(cft->root, path)))
+		ct = (struct config_tree *) cft;
+		dummy.child = cft->root;
+		if ((cn = _find_or_make_node(NULL, ct->indexed ? &ct->index : NULL,
+					     &dummy, path, 0)))
 			return cn;
 		cft = cft->cascade;
 	}
@@ -1393,9 +1577,11 @@ struct dm_pool *dm_config_memory(struct dm_config_tree *cft)
 static int _override_path(const char *path, struct dm_config_node *node, void *baton)
 {
 	struct dm_config_tree *cft = baton;
-	struct dm_config_node dummy, *target;
+	struct config_tree *ct = baton;
+	struct dm_config_node dummy = { 0 }, *target;
 	dummy.child = cft->root;
-	if (!(target = _find_or_make_node(cft->mem, &dummy, path)))
+	if (!(target = _find_or_make_node(cft->mem, ct->indexed ? &ct->index : NULL,
+					  &dummy, path, 0)))
 		return_0;
 	if (!(target->v = _clone_config_value(cft->mem, node->v)))
 		return_0;
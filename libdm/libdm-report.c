@@ -77,6 +77,12 @@ struct dm_report {
 	struct dm_hash_table *value_cache;
 
 	struct report_group_item *group_item;
+
+	/*
+	 * Unbuffered JSON output holds back the last row printed: whether
+	 * it needs a separator is only known once the next one arrives.
+	 */
+	char *json_row;
 };
 
 struct dm_report_group {
@@ -1338,6 +1344,7 @@ struct dm_report *dm_report_init(uint32_t *report_types,
 
 void dm_report_free(struct dm_report *rh)
 {
+	dm_free(rh->json_row);
 	if (rh->selection)
 		dm_pool_destroy(rh->selection->mem);
 	if (rh->value_cache)
@@ -4561,6 +4568,36 @@ static int _output_as_rows(struct dm_report *rh)
 	return 0;
 }
 
+static void _print_json_row(struct dm_report *rh, int more)
+{
+	if (!rh->json_row)
+		return;
+
+	if (more)
+		strcat(rh->json_row, JSON_SEPARATOR);
+
+	log_print("%*s", rh->group_item->group->indent + (int) strlen(rh->json_row), rh->json_row);
+
+	dm_free(rh->json_row);
+	rh->json_row = NULL;
+}
+
+static int _hold_json_row(struct dm_report *rh, const char *line)
+{
+	size_t len = strlen(line);
+
+	_print_json_row(rh, 1);
+
+	if (!(rh->json_row = dm_malloc(len + sizeof(JSON_SEPARATOR)))) {
+		log_error("dm_report: Failed to allocate JSON output line.");
+		return 0;
+	}
+
+	memcpy(rh->json_row, line, len + 1);
+
+	return 1;
+}
+
 static int _output_as_columns(struct dm_report *rh)
 {
 	struct dm_list *fh, *rowh, *ftmp, *rtmp;
@@ -4642,7 +4679,11 @@ static int _output_as_columns(struct dm_report *rh)
 		}
 
 		line = (char *) dm_pool_end_object(rh->mem);
-		log_print("%*s", rh->group_item ? rh->group_item->group->indent + (int) strlen(line) : 0, line);
+		if (_is_json_report(rh) && !(rh->flags & DM_REPORT_OUTPUT_BUFFERED)) {
+			if (!_hold_json_row(rh, line))
+				return_0;
+		} else
+			log_print("%*s", rh->group_item ? rh->group_item->group->indent + (int) strlen(line) : 0, line);
 		if (!(rh->flags & DM_REPORT_OUTPUT_MULTIPLE_TIMES))
 			dm_list_del(&row->list);
 	}
@@ -4737,6 +4778,9 @@ static int _prepare_json_report_output(struct dm_report *rh)
 	}
 
 	if (rh->group_item->needs_closing) {
+		/* Unbuffered rows all go into the array the first one started */
+		if (!(rh->flags & DM_REPORT_OUTPUT_BUFFERED))
+			return 1;
 		log_error("dm_report: dm_report_output: unfinished JSON output detected");
 		return 0;
 	}
@@ -4881,7 +4925,9 @@ static int _report_group_push_json(struct report_group_item *item, const char *n
 		item->report->flags &= ~(DM_REPORT_OUTPUT_ALIGNED |
 					 DM_REPORT_OUTPUT_HEADINGS |
 					 DM_REPORT_OUTPUT_COLUMNS_AS_ROWS);
-		item->report->flags |= DM_REPORT_OUTPUT_BUFFERED;
+		/* Unbuffered reports stream rows into their JSON array */
+		if (!(item->report->flags & DM_REPORT_OUTPUT_BUFFERED))
+			item->report->flags &= ~(DM_REPORT_OUTPUT_MULTIPLE_TIMES);
 	} else {
 		_json_output_start(item->group);
 		if (name) {
@@ -4970,6 +5016,9 @@ static int _report_group_pop_basic(struct report_group_item *item)
 
 static int _report_group_pop_json(struct report_group_item *item)
 {
+	if (item->report)
+		_print_json_row(item->report, 0);
+
 	if (item->output_done && item->needs_closing) {
 		if (item->data) {
 			item->group->indent -= JSON_INDENT_UNIT;
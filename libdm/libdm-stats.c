@@ -126,6 +126,7 @@ struct dm_stats {
 	int precise; /* use precise_timestamps when creating regions */
 	struct dm_stats_region *regions;
 	struct dm_stats_group *groups;
+	struct dm_stats_sampler *sampler; /* owns region counters if set */
 	/* statistics cursor */
 	uint64_t walk_flags; /* walk control flags */
 	uint64_t cur_flags;
@@ -331,6 +332,8 @@ static void _stats_region_destroy(struct dm_stats_region *region)
 	region->region_id = DM_STATS_REGION_NOT_PRESENT;
 }
 
+static void _stats_sampler_detach(struct dm_stats *dms);
+
 static void _stats_regions_destroy(struct dm_stats *dms)
 {
 	struct dm_pool *mem = dms->mem;
@@ -339,6 +342,9 @@ static void _stats_regions_destroy(struct dm_stats *dms)
 	if (!dms->regions)
 		return;
 
+	/* Counters owned by a sampler are not in the pool */
+	_stats_sampler_detach(dms);
+
 	/* walk backwards to obey pool order */
 	for (i = dms->max_region; (i != DM_STATS_REGION_NOT_PRESENT); i--) {
 		_stats_histograms_destroy(dms->hist_mem, &dms->regions[i]);
@@ -3213,6 +3219,35 @@ static void _sum_histogram_bins(const struct dm_stats *dms,
 		bins[bin].count += dmh_cur->bins[bin].count;
 }
 
+/*
+ * Sum the bins of every area of a region, or of every region of a group,
+ * into dmh_aggr.  Bin bounds must already be set.
+ */
+static void _fill_aggregate_histogram(const struct dm_stats *dms,
+				      struct dm_histogram *dmh_aggr,
+				      uint64_t id, int group)
+{
+	uint64_t region_id, area_id;
+	int bin;
+
+	for (bin = 0; bin < dmh_aggr->nr_bins; bin++)
+		dmh_aggr->bins[bin].count = 0;
+
+	if (!group)
+		_foreach_region_area(dms, id, area_id) {
+			_sum_histogram_bins(dms, dmh_aggr, id, area_id);
+		}
+	else {
+		_foreach_group_area(dms, id, region_id, area_id) {
+			_sum_histogram_bins(dms, dmh_aggr, region_id, area_id);
+		}
+	}
+
+	dmh_aggr->sum = 0;
+	for (bin = 0; bin < dmh_aggr->nr_bins; bin++)
+		dmh_aggr->sum += dmh_aggr->bins[bin].count;
+}
+
 /*
  * Create an aggregate histogram for a sub-divided region or a group.
  */
@@ -3275,20 +3310,10 @@ static struct dm_histogram *_aggregate_histogram(const struct dm_stats *dms,
 	dmh_aggr->nr_bins = dmh_cur->nr_bins;
 	dmh_aggr->dms = dms;
 
-	if (!group)
-		_foreach_region_area(dms, region_id, area_id) {
-			_sum_histogram_bins(dms, dmh_aggr, region_id, area_id);
-		}
-	else {
-		_foreach_group_area(dms, group_id, region_id, area_id) {
-			_sum_histogram_bins(dms, dmh_aggr, region_id, area_id);
-		}
-	}
-
-	for (bin = 0; bin < nr_bins; bin++) {
-		dmh_aggr->sum += dmh_aggr->bins[bin].count;
+	for (bin = 0; bin < nr_bins; bin++)
 		dmh_aggr->bins[bin].upper = dmh_cur->bins[bin].upper;
-	}
+
+	_fill_aggregate_histogram(dms, dmh_aggr, region_id, group);
 
 	/* cache aggregate histogram for subsequent access */
 	*dmh_cachep = dmh_aggr;
@@ -3379,6 +3404,50 @@ dm_percent_t dm_histogram_get_bin_percent(const struct dm_histogram *dmh,
 	return dm_make_percent((uint64_t) val, total);
 }
 
+int dm_histogram_get_percentile(const struct dm_histogram *dmh,
+				double percentile, uint64_t *value)
+{
+	double target, lower, upper;
+	uint64_t below = 0, count;
+	int bin;
+
+	if (percentile < 0.0 || percentile > 100.0) {
+		log_error("Invalid histogram percentile: %f", percentile);
+		return 0;
+	}
+
+	*value = 0;
+
+	if (!dmh->sum)
+		return 1;
+
+	target = percentile * (double) dmh->sum / 100.0;
+
+	for (bin = 0; bin < dmh->nr_bins; bin++) {
+		count = dmh->bins[bin].count;
+		if (!count || ((double) (below + count) < target)) {
+			below += count;
+			continue;
+		}
+
+		lower = (double) dm_histogram_get_bin_lower(dmh, bin);
+		upper = (double) dmh->bins[bin].upper;
+
+		/* The last bin has no upper bound: report its lower bound. */
+		if (dmh->bins[bin].upper == UINT64_MAX) {
+			*value = (uint64_t) lower;
+			return 1;
+		}
+
+		/* Assume latencies are spread evenly across the bin. */
+		*value = (uint64_t) (lower + (upper - lower)
+				     * (target - (double) below) / (double) count);
+		return 1;
+	}
+
+	return 1;
+}
+
 /*
  * Histogram string helper functions: used to construct histogram and
  * bin boundary strings from numeric data.
@@ -3742,6 +3811,523 @@ bad:
 	return NULL;
 }
 
+/*
+ * Stats sampler
+ *
+ * A sampler takes ownership of the counter tables of a listed dm_stats
+ * handle: one set of counters (and histograms) per area is allocated
+ * when the sampler is created and is overwritten in place by each call
+ * to dm_stats_sampler_sample().  The counters of the last nr_samples
+ * intervals are kept in a ring indexed by sample number and histogram
+ * counts are accumulated over all samples for each area, region and
+ * group.
+ */
+struct dm_stats_sampler {
+	struct dm_stats *dms; /* NULL once the region table is gone */
+	uint64_t nr_areas; /* total areas over all regions */
+	uint64_t *area_base; /* index of each region's first area */
+	struct dm_stats_counters *counters; /* current sample */
+	void *hist_tables; /* per-area histograms for all regions */
+	void *total_tables; /* accumulated histograms */
+	struct dm_histogram **totals; /* accumulated histogram of each area */
+	struct dm_histogram **region_totals; /* ... of each region */
+	struct dm_histogram **group_totals; /* ... of each group */
+	void *hist_mark; /* aggregate histograms follow this in hist_mem */
+	struct dm_stats_counters *ring; /* nr_samples tables of nr_areas */
+	uint64_t *ring_interval_ns; /* measured interval of each sample */
+	unsigned nr_samples; /* ring size */
+	unsigned nr_valid; /* samples stored in the ring */
+	unsigned head; /* ring slot of the latest sample */
+	struct dm_timestamp *ts_last;
+	struct dm_timestamp *ts_now;
+};
+
+/*
+ * Drop the region table's references to sampler owned memory. The
+ * aggregate histograms cached since the sampler was created are freed.
+ */
+static void _stats_sampler_detach(struct dm_stats *dms)
+{
+	struct dm_stats_sampler *dss = dms->sampler;
+	uint64_t i;
+
+	if (!dss)
+		return;
+
+	for (i = 0; i <= dms->max_region; i++) {
+		dms->regions[i].counters = NULL;
+		dms->regions[i].histogram = NULL;
+		if (dms->groups)
+			dms->groups[i].histogram = NULL;
+	}
+
+	dm_pool_free(dms->hist_mem, dss->hist_mark);
+
+	dss->dms = NULL;
+	dms->sampler = NULL;
+}
+
+static struct dm_histogram *_stats_sampler_init_histogram(struct dm_stats *dms,
+							  struct dm_stats_region *region,
+							  void *mem)
+{
+	struct dm_histogram *hist = mem;
+
+	hist->dms = dms;
+	hist->region = region;
+	hist->nr_bins = region->bounds->nr_bins;
+	memcpy(hist->bins, region->bounds->bins,
+	       hist->nr_bins * sizeof(struct dm_histogram_bin));
+
+	return hist;
+}
+
+struct dm_stats_sampler *dm_stats_sampler_create(struct dm_stats *dms,
+						 const char *program_id,
+						 unsigned nr_samples)
+{
+	struct dm_stats_sampler *dss;
+	struct dm_stats_region *region;
+	struct dm_histogram *hist;
+	size_t hist_size, hist_total = 0;
+	uint64_t i, area;
+	char *p, *t;
+
+	if (!_stats_bound(dms))
+		return_NULL;
+
+	if (!nr_samples) {
+		log_error("Stats sampler requires at least one sample.");
+		return NULL;
+	}
+
+	if (!program_id)
+		program_id = dms->program_id;
+
+	/* Replaces any previous region table and sampler. */
+	if (!dm_stats_list(dms, program_id)) {
+		log_error("Could not parse @stats_list response.");
+		return NULL;
+	}
+
+	if (!_stats_set_name_cache(dms))
+		return_NULL;
+
+	/* Nothing to sample is not an error, as for dm_stats_populate() */
+	if (!dms->nr_regions)
+		return NULL;
+
+	if (!(dss = dm_zalloc(sizeof(*dss)))) {
+		log_error("Could not allocate stats sampler.");
+		return NULL;
+	}
+
+	if (!(dss->area_base = dm_zalloc(sizeof(*dss->area_base)
+					 * (dms->max_region + 1))))
+		goto_bad;
+
+	for (i = 0; i <= dms->max_region; i++) {
+		region = &dms->regions[i];
+		if (!_stats_region_present(region))
+			continue;
+		dss->area_base[i] = dss->nr_areas;
+		dss->nr_areas += _nr_areas_region(region);
+		/* Accumulated tables add one region and one group total. */
+		if (region->bounds)
+			hist_total += (_nr_areas_region(region) + 2)
+				* (sizeof(*hist) + region->bounds->nr_bins
+				   * sizeof(struct dm_histogram_bin));
+	}
+
+	dss->nr_samples = nr_samples;
+
+	if (!(dss->counters = dm_zalloc(sizeof(*dss->counters) * dss->nr_areas)) ||
+	    !(dss->ring = dm_zalloc(sizeof(*dss->ring) * dss->nr_areas
+				    * nr_samples)) ||
+	    !(dss->ring_interval_ns = dm_zalloc(sizeof(*dss->ring_interval_ns)
+						* nr_samples)) ||
+	    !(dss->totals = dm_zalloc(sizeof(*dss->totals) * dss->nr_areas)) ||
+	    !(dss->region_totals = dm_zalloc(sizeof(*dss->region_totals)
+					     * (dms->max_region + 1))) ||
+	    !(dss->group_totals = dm_zalloc(sizeof(*dss->group_totals)
+					    * (dms->max_region + 1))) ||
+	    (hist_total && !(dss->hist_tables = dm_zalloc(hist_total))) ||
+	    (hist_total && !(dss->total_tables = dm_zalloc(hist_total))) ||
+	    !(dss->ts_last = dm_timestamp_alloc()) ||
+	    !(dss->ts_now = dm_timestamp_alloc()))
+		goto_bad;
+
+	/* Carve the per-area histograms out of single tables. */
+	p = dss->hist_tables;
+	t = dss->total_tables;
+	for (i = 0; i <= dms->max_region; i++) {
+		region = &dms->regions[i];
+		if (!_stats_region_present(region) || !region->bounds)
+			continue;
+		hist_size = sizeof(*hist) + region->bounds->nr_bins
+			* sizeof(struct dm_histogram_bin);
+		for (area = 0; area < _nr_areas_region(region); area++) {
+			hist = _stats_sampler_init_histogram(dms, region, p);
+			dss->counters[dss->area_base[i] + area].histogram = hist;
+			p += hist_size;
+			dss->totals[dss->area_base[i] + area] =
+				_stats_sampler_init_histogram(dms, region, t);
+			t += hist_size;
+		}
+		dss->region_totals[i] = _stats_sampler_init_histogram(dms, region, t);
+		t += hist_size;
+		dss->group_totals[i] = _stats_sampler_init_histogram(dms, region, t);
+		t += hist_size;
+	}
+
+	if (!(dss->hist_mark = dm_pool_alloc(dms->hist_mem, 1)))
+		goto_bad;
+
+	for (i = 0; i <= dms->max_region; i++)
+		if (_stats_region_present(&dms->regions[i]))
+			dms->regions[i].counters = &dss->counters[dss->area_base[i]];
+
+	dss->dms = dms;
+	dms->sampler = dss;
+
+	if (!dm_timestamp_get(dss->ts_last)) {
+		dm_stats_sampler_destroy(dss);
+		return_NULL;
+	}
+
+	return dss;
+
+bad:
+	log_error("Could not allocate stats sampler tables.");
+	dm_stats_sampler_destroy(dss);
+	return NULL;
+}
+
+/*
+ * Parse an unsigned decimal value and skip the separator following it.
+ */
+static const char *_stats_parse_u64(const char *c, uint64_t *val, char sep)
+{
+	uint64_t v = 0;
+
+	if (*c < '0' || *c > '9')
+		return NULL;
+
+	while (*c >= '0' && *c <= '9')
+		v = v * 10 + (uint64_t) (*c++ - '0');
+
+	if (*c != sep)
+		return NULL;
+
+	*val = v;
+
+	return c + 1;
+}
+
+/*
+ * Parse a @stats_print response for region directly into the region's
+ * counter table. The area layout must match the listed region.
+ */
+static int _stats_sampler_parse_region(struct dm_stats_region *region,
+				       const char *resp)
+{
+	struct dm_stats_counters *area = region->counters;
+	uint64_t start, len, vals[DM_STATS_NR_COUNTERS];
+	uint64_t nr_areas = _nr_areas_region(region), area_id = 0;
+	uint64_t timescale = region->timescale;
+	struct dm_histogram *hist;
+	const char *c = resp;
+	int i;
+
+	while (c && *c) {
+		if (area_id == nr_areas)
+			goto changed;
+
+		if (!(c = _stats_parse_u64(c, &start, '+')) ||
+		    !(c = _stats_parse_u64(c, &len, ' ')))
+			goto bad;
+
+		if ((start != region->start + area_id * region->step) ||
+		    (len > region->step))
+			goto changed;
+
+		/* The last counter is followed by a histogram or newline. */
+		for (i = 0; i < DM_STATS_NR_COUNTERS; i++)
+			if (!(c = _stats_parse_u64(c, &vals[i],
+					((i + 1 < DM_STATS_NR_COUNTERS)
+					 || region->bounds) ? ' ' : '\n')))
+				goto bad;
+
+		area->reads = vals[DM_STATS_READS_COUNT];
+		area->reads_merged = vals[DM_STATS_READS_MERGED_COUNT];
+		area->read_sectors = vals[DM_STATS_READ_SECTORS_COUNT];
+		area->read_nsecs = vals[DM_STATS_READ_NSECS] * timescale;
+		area->writes = vals[DM_STATS_WRITES_COUNT];
+		area->writes_merged = vals[DM_STATS_WRITES_MERGED_COUNT];
+		area->write_sectors = vals[DM_STATS_WRITE_SECTORS_COUNT];
+		area->write_nsecs = vals[DM_STATS_WRITE_NSECS] * timescale;
+		area->io_in_progress = vals[DM_STATS_IO_IN_PROGRESS_COUNT];
+		area->io_nsecs = vals[DM_STATS_IO_NSECS] * timescale;
+		area->weighted_io_nsecs = vals[DM_STATS_WEIGHTED_IO_NSECS] * timescale;
+		area->total_read_nsecs = vals[DM_STATS_TOTAL_READ_NSECS] * timescale;
+		area->total_write_nsecs = vals[DM_STATS_TOTAL_WRITE_NSECS] * timescale;
+
+		if ((hist = area->histogram)) {
+			hist->sum = 0;
+			for (i = 0; i < hist->nr_bins; i++) {
+				if (!(c = _stats_parse_u64(c, &hist->bins[i].count,
+						(i + 1 < hist->nr_bins) ? ':' : '\n')))
+					goto bad;
+				hist->sum += hist->bins[i].count;
+			}
+		}
+
+		area++;
+		area_id++;
+	}
+
+	if (!c)
+		goto bad;
+
+	if (area_id == nr_areas)
+		return 1;
+
+changed:
+	log_error("Stats region " FMTu64 " layout has changed.",
+		  region->region_id);
+	return 0;
+bad:
+	log_error("Could not parse @stats_print row.");
+	return 0;
+}
+
+static void _stats_add_histogram(struct dm_histogram *to,
+				 const struct dm_histogram *from)
+{
+	int bin;
+
+	for (bin = 0; bin < to->nr_bins; bin++)
+		to->bins[bin].count += from->bins[bin].count;
+	to->sum += from->sum;
+}
+
+/*
+ * Add the histograms of the current sample to the accumulated area,
+ * region and group totals.
+ */
+static void _stats_sampler_accumulate(struct dm_stats_sampler *dss)
+{
+	const struct dm_stats *dms = dss->dms;
+	const struct dm_histogram *hist;
+	uint64_t i, area, group_id;
+
+	for (i = 0; i <= dms->max_region; i++) {
+		if (!_stats_region_present(&dms->regions[i]) ||
+		    !dms->regions[i].bounds)
+			continue;
+
+		group_id = dms->regions[i].group_id;
+
+		_foreach_region_area(dms, i, area) {
+			hist = dss->counters[dss->area_base[i] + area].histogram;
+			_stats_add_histogram(dss->totals[dss->area_base[i] + area], hist);
+			_stats_add_histogram(dss->region_totals[i], hist);
+			if ((group_id != DM_STATS_GROUP_NOT_PRESENT) &&
+			    dss->group_totals[group_id])
+				_stats_add_histogram(dss->group_totals[group_id], hist);
+		}
+	}
+}
+
+int dm_stats_sampler_sample(struct dm_stats_sampler *dss)
+{
+	struct dm_stats *dms = dss->dms;
+	struct dm_task *dmt;
+	uint64_t i;
+	int r;
+
+	if (!dms) {
+		log_error("Stats sampler is no longer attached to a "
+			  "region table.");
+		return 0;
+	}
+
+	for (i = 0; i <= dms->max_region; i++) {
+		if (!_stats_region_present(&dms->regions[i]))
+			continue;
+
+		/* obtain all lines and clear counter values */
+		if (!(dmt = _stats_print_region(dms, i, 0, 0, 1)))
+			return_0;
+
+		r = _stats_sampler_parse_region(&dms->regions[i],
+						dm_task_get_message_response(dmt) ? : "");
+		dm_task_destroy(dmt);
+		if (!r)
+			return_0;
+	}
+
+	if (!dm_timestamp_get(dss->ts_now))
+		return_0;
+
+	_stats_sampler_accumulate(dss);
+
+	/* Refresh any aggregate histograms cached by the caller. */
+	for (i = 0; i <= dms->max_region; i++) {
+		if (dms->regions[i].histogram)
+			_fill_aggregate_histogram(dms, dms->regions[i].histogram,
+						  i, 0);
+		if (dms->groups && dms->groups[i].histogram)
+			_fill_aggregate_histogram(dms, dms->groups[i].histogram,
+						  i, 1);
+	}
+
+	dss->head = (dss->head + 1) % dss->nr_samples;
+	memcpy(dss->ring + dss->head * dss->nr_areas, dss->counters,
+	       sizeof(*dss->counters) * dss->nr_areas);
+	dss->ring_interval_ns[dss->head] = dm_timestamp_delta(dss->ts_now,
+							      dss->ts_last);
+	dm_timestamp_copy(dss->ts_last, dss->ts_now);
+
+	if (dss->nr_valid < dss->nr_samples)
+		dss->nr_valid++;
+
+	dms->interval_ns = dss->ring_interval_ns[dss->head];
+
+	return 1;
+}
+
+unsigned dm_stats_sampler_get_nr_samples(const struct dm_stats_sampler *dss)
+{
+	return dss->nr_valid;
+}
+
+static const struct dm_stats_counters *_stats_sampler_slot(const struct dm_stats_sampler *dss,
+							   unsigned sample)
+{
+	unsigned slot;
+
+	if (sample >= dss->nr_valid) {
+		log_error("Stats sample %u is not available.", sample);
+		return NULL;
+	}
+
+	slot = (dss->head + dss->nr_samples - sample) % dss->nr_samples;
+
+	return dss->ring + slot * dss->nr_areas;
+}
+
+uint64_t dm_stats_sampler_get_interval_ns(const struct dm_stats_sampler *dss,
+					  unsigned sample)
+{
+	if (!_stats_sampler_slot(dss, sample))
+		return_0;
+
+	return dss->ring_interval_ns[(dss->head + dss->nr_samples - sample)
+				     % dss->nr_samples];
+}
+
+uint64_t dm_stats_sampler_get_counter(const struct dm_stats_sampler *dss,
+				      dm_stats_counter_t counter,
+				      uint64_t region_id, uint64_t area_id,
+				      unsigned sample)
+{
+	const struct dm_stats *dms = dss->dms;
+	const struct dm_stats_counters *slot;
+	uint64_t sum = 0;
+
+	if (!dms || !(slot = _stats_sampler_slot(dss, sample)))
+		return_0;
+
+	region_id = (region_id == DM_STATS_REGION_CURRENT)
+		     ? dms->cur_region : region_id;
+	area_id = (area_id == DM_STATS_AREA_CURRENT)
+		   ? dms->cur_area : area_id;
+
+	if ((region_id > dms->max_region) ||
+	    !_stats_region_present(&dms->regions[region_id]))
+		return_0;
+
+	slot += dss->area_base[region_id];
+
+	if (area_id == DM_STATS_WALK_REGION) {
+		_foreach_region_area(dms, region_id, area_id)
+			sum += _stats_get_counter(dms, &slot[area_id], counter);
+		return sum;
+	}
+
+	if (area_id >= _nr_areas_region(&dms->regions[region_id]))
+		return_0;
+
+	return _stats_get_counter(dms, &slot[area_id], counter);
+}
+
+struct dm_histogram *dm_stats_sampler_get_histogram(const struct dm_stats_sampler *dss,
+						    uint64_t region_id,
+						    uint64_t area_id)
+{
+	const struct dm_stats *dms = dss->dms;
+	int group = 0;
+
+	if (!dms)
+		return_NULL;
+
+	if (region_id == DM_STATS_REGION_CURRENT) {
+		region_id = dms->cur_region;
+		if (region_id & DM_STATS_WALK_GROUP) {
+			region_id = dms->cur_group;
+			group = 1;
+		}
+	} else if (region_id & DM_STATS_WALK_GROUP) {
+		region_id &= ~DM_STATS_WALK_GROUP;
+		group = 1;
+	}
+
+	region_id &= ~DM_STATS_WALK_REGION;
+
+	if ((region_id > dms->max_region) ||
+	    !_stats_region_present(&dms->regions[region_id]))
+		return_NULL;
+
+	if (group)
+		return dss->group_totals[region_id];
+
+	area_id = (area_id == DM_STATS_AREA_CURRENT)
+		   ? dms->cur_area : area_id;
+
+	if (area_id == DM_STATS_WALK_REGION)
+		return dss->region_totals[region_id];
+
+	if (area_id >= _nr_areas_region(&dms->regions[region_id]))
+		return_NULL;
+
+	return dss->totals[dss->area_base[region_id] + area_id];
+}
+
+void dm_stats_sampler_destroy(struct dm_stats_sampler *dss)
+{
+	if (!dss)
+		return;
+
+	if (dss->dms)
+		_stats_sampler_detach(dss->dms);
+
+	if (dss->ts_now)
+		dm_timestamp_destroy(dss->ts_now);
+	if (dss->ts_last)
+		dm_timestamp_destroy(dss->ts_last);
+	dm_free(dss->total_tables);
+	dm_free(dss->hist_tables);
+	dm_free(dss->group_totals);
+	dm_free(dss->region_totals);
+	dm_free(dss->totals);
+	dm_free(dss->ring_interval_ns);
+	dm_free(dss->ring);
+	dm_free(dss->counters);
+	dm_free(dss->area_base);
+	dm_free(dss);
+}
+
 /*
  * A lightweight representation of an extent (region, area, file
  * system block or extent etc.). A table of extents can be used
@@ -4258,13 +4844,12 @@ bad:
  * created is returned in the memory pointed to by count (which must be
  * non-NULL).
  */
-static uint64_t *_stats_create_file_regions(struct dm_stats *dms, int fd,
-					    struct dm_histogram *bounds,
-					    int precise, uint64_t *count)
+/*
+ * Check that fd refers to a regular file on a device-mapper device in
+ * a file system that returns physical extent data from FIEMAP.
+ */
+static int _stats_check_file_fd(int fd)
 {
-	struct _extent *extents = NULL;
-	uint64_t *regions = NULL, i;
-	char *hist_arg = NULL;
 	struct statfs fsbuf;
 	struct stat buf;
 
@@ -4296,6 +4881,20 @@ static uint64_t *_stats_create_file_regions(struct dm_stats *dms, int fd,
 		return 0;
 	}
 
+	return 1;
+}
+
+static uint64_t *_stats_create_file_regions(struct dm_stats *dms, int fd,
+					    struct dm_histogram *bounds,
+					    int precise, uint64_t *count)
+{
+	struct _extent *extents = NULL;
+	uint64_t *regions = NULL, i;
+	char *hist_arg = NULL;
+
+	if (!_stats_check_file_fd(fd))
+		return_0;
+
 	if (!(extents = _stats_get_extents_for_file(dms->mem, fd, count)))
 		return_0;
 
@@ -4375,6 +4974,239 @@ out:
 	return NULL;
 }
 
+/*
+ * Copy the histogram bounds of region_id, without the final unbounded
+ * bin, into a new histogram suitable for _build_histogram_arg().
+ */
+static struct dm_histogram *_stats_copy_region_bounds(const struct dm_stats *dms,
+						      uint64_t region_id)
+{
+	const struct dm_histogram *src = dms->regions[region_id].bounds;
+	struct dm_histogram *bounds;
+	int i;
+
+	if (!src || src->nr_bins < 2)
+		return NULL;
+
+	if (!(bounds = _alloc_dm_histogram(src->nr_bins - 1))) {
+		log_error("Could not allocate memory for histogram bounds.");
+		return NULL;
+	}
+
+	bounds->nr_bins = src->nr_bins - 1;
+	for (i = 0; i < bounds->nr_bins; i++)
+		bounds->bins[i].upper = src->bins[i].upper;
+
+	return bounds;
+}
+
+static int _region_id_compare(const void *p1, const void *p2)
+{
+	uint64_t id1 = *(const uint64_t *) p1, id2 = *(const uint64_t *) p2;
+
+	return (id1 > id2) - (id1 < id2);
+}
+
+/*
+ * Build a table of the extents of the regions in group_id sorted by
+ * increasing start sector.
+ */
+static struct _extent *_stats_get_group_extents(const struct dm_stats *dms,
+						uint64_t group_id,
+						uint64_t *count)
+{
+	dm_bitset_t regions = dms->groups[group_id].regions;
+	struct _extent *extents;
+	int id;
+
+	*count = 0;
+	if (!(extents = dm_zalloc((dms->max_region + 1) * sizeof(*extents)))) {
+		log_error("Could not allocate memory for region map.");
+		return NULL;
+	}
+
+	for (id = dm_bit_get_first(regions); id >= 0;
+	     id = dm_bit_get_next(regions, id)) {
+		extents[*count].id = id;
+		extents[*count].start = dms->regions[id].start;
+		extents[*count].len = dms->regions[id].len;
+		(*count)++;
+	}
+
+	qsort(extents, *count, sizeof(*extents), _extent_start_compare);
+
+	return extents;
+}
+
+uint64_t *dm_stats_update_regions_from_fd(struct dm_stats *dms, int fd,
+					  uint64_t group_id)
+{
+	struct _extent *pool_extents, *extents = NULL, *old = NULL;
+	uint64_t *regions = NULL, count = 0, nr_old = 0, nr_kept = 0, i, j;
+	uint64_t max_region;
+	struct dm_histogram *bounds = NULL;
+	dm_bitset_t keep = NULL, stale = NULL;
+	char *alias = NULL, *hist_arg = NULL;
+	int precise, id;
+
+	if (!_stats_bound(dms))
+		return_NULL;
+
+	/* refresh handle: the group may have changed since the last call */
+	if (!dm_stats_list(dms, NULL))
+		return_NULL;
+
+	if (!_stats_group_id_present(dms, group_id)) {
+		log_error("Group ID " FMTu64 " does not exist.", group_id);
+		return NULL;
+	}
+
+	if (!_stats_check_file_fd(fd))
+		return_NULL;
+
+	if (!(pool_extents = _stats_get_extents_for_file(dms->mem, fd, &count)))
+		return_NULL;
+
+	/* the handle pool is reset by dm_stats_list(): take a private copy */
+	if (!(extents = dm_malloc(count * sizeof(*extents)))) {
+		log_error("Could not allocate memory for extent map.");
+		dm_pool_free(dms->mem, pool_extents);
+		return NULL;
+	}
+	memcpy(extents, pool_extents, count * sizeof(*extents));
+	dm_pool_free(dms->mem, pool_extents);
+
+	qsort(extents, count, sizeof(*extents), _extent_start_compare);
+
+	if (!(old = _stats_get_group_extents(dms, group_id, &nr_old)))
+		goto_out;
+
+	/* regions created below may lie beyond the current table */
+	max_region = dms->max_region;
+	if (!(keep = dm_bitset_create(NULL, max_region + 1)) ||
+	    !(stale = dm_bitset_create(NULL, max_region + 1))) {
+		log_error("Could not allocate memory for region bitmaps.");
+		goto out;
+	}
+
+	/* match file extents to existing regions: both sorted by start */
+	for (i = 0; i < count; i++)
+		extents[i].id = DM_STATS_REGION_NOT_PRESENT;
+
+	for (i = j = 0; i < count && j < nr_old;) {
+		if (extents[i].start < old[j].start)
+			i++;
+		else if (extents[i].start > old[j].start)
+			j++;
+		else {
+			if (extents[i].len == old[j].len) {
+				extents[i].id = old[j].id;
+				dm_bit_set(keep, old[j].id);
+				nr_kept++;
+			}
+			i++;
+			j++;
+		}
+	}
+
+	/* the region table is still valid: nothing to do */
+	if (nr_kept == count && nr_kept == nr_old)
+		goto out_regions;
+
+	log_very_verbose("Updating group ID " FMTu64 ": " FMTu64 " regions "
+			 "unchanged, " FMTu64 " to create, " FMTu64 " to delete.",
+			 group_id, nr_kept, count - nr_kept, nr_old - nr_kept);
+
+	for (j = 0; j < nr_old; j++)
+		if (!dm_bit(keep, old[j].id))
+			dm_bit_set(stale, old[j].id);
+
+	/* new regions inherit the configuration of the group leader */
+	precise = (dms->regions[group_id].timescale == 1);
+	if ((bounds = _stats_copy_region_bounds(dms, group_id)) &&
+	    !(hist_arg = _build_histogram_arg(bounds, &precise)))
+		goto_out;
+
+	if (dms->groups[group_id].alias &&
+	    !(alias = dm_strdup(dms->groups[group_id].alias))) {
+		log_error("Could not allocate memory for group alias.");
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (extents[i].id != DM_STATS_REGION_NOT_PRESENT)
+			continue;
+		if (!_stats_create_region(dms, &extents[i].id, extents[i].start,
+					  extents[i].len, -1, precise, hist_arg,
+					  dms->program_id, "")) {
+			log_error("Failed to create region for extent at "
+				  FMTu64 ".", extents[i].start);
+			extents[i].id = DM_STATS_REGION_NOT_PRESENT;
+			goto out_remove;
+		}
+	}
+
+	/* ungroup the old regions before deleting any that are stale */
+	if (!dm_stats_delete_group(dms, group_id, 0)) {
+		stack;
+		goto out_remove;
+	}
+
+	for (id = dm_bit_get_first(stale); id >= 0;
+	     id = dm_bit_get_next(stale, id))
+		if (!dm_stats_delete_region(dms, (uint64_t) id))
+			log_warn("Failed to delete region %d on %s.",
+				 id, dms->name);
+
+	if (!dm_stats_list(dms, NULL))
+		goto_out;
+
+out_regions:
+	if (!(regions = dm_malloc((1 + count) * sizeof(*regions)))) {
+		log_error("Could not allocate memory for region IDs.");
+		goto out;
+	}
+
+	for (i = 0; i < count; i++)
+		regions[i] = extents[i].id;
+	regions[count] = DM_STATS_REGION_NOT_PRESENT;
+
+	/* the group leader is the first entry, as for create */
+	qsort(regions, count, sizeof(*regions), _region_id_compare);
+
+	if ((nr_kept != count || nr_kept != nr_old) &&
+	    !_stats_group_file_regions(dms, regions, count, alias)) {
+		dm_free(regions);
+		regions = NULL;
+	}
+	goto out;
+
+out_remove:
+	/* clean up regions created by this call after a failure */
+	if (!dm_stats_list(dms, NULL))
+		goto_out;
+
+	for (i = 0; i < count; i++)
+		if (extents[i].id != DM_STATS_REGION_NOT_PRESENT &&
+		    (extents[i].id > max_region ||
+		     !dm_bit(keep, extents[i].id)) &&
+		    !dm_stats_delete_region(dms, extents[i].id))
+			log_error("Could not delete region " FMTu64 ".",
+				  extents[i].id);
+out:
+	if (keep)
+		dm_bitset_destroy(keep);
+	if (stale)
+		dm_bitset_destroy(stale);
+	dm_free(bounds);
+	dm_free(hist_arg);
+	dm_free(alias);
+	dm_free(extents);
+	dm_free(old);
+
+	return regions;
+}
+
 #else /* HAVE_LINUX_FIEMAP */
 uint64_t *dm_stats_create_regions_from_fd(struct dm_stats *dms, int fd,
 					  int group, int precise,
@@ -4384,6 +5216,13 @@ uint64_t *dm_stats_create_regions_from_fd(struct dm_stats *dms, int fd,
 	log_error("File mapping requires FIEMAP ioctl support.");
 	return 0;
 }
+
+uint64_t *dm_stats_update_regions_from_fd(struct dm_stats *dms, int fd,
+					  uint64_t group_id)
+{
+	log_error("File mapping requires FIEMAP ioctl support.");
+	return 0;
+}
 #endif /* HAVE_LINUX_FIEMAP */
 
 /*
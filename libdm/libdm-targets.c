@@ -518,3 +518,186 @@ out:
 
 	return 0;
 }
+
+/*
+ * Status batch: read the status of a set of devices in one pass.
+ *
+ * Each member keeps its DM_DEVICE_STATUS task between passes so the
+ * ioctl buffer and the uuid are set up once and reused.
+ */
+struct dm_status_batch_member {
+	struct dm_list list;
+	struct dm_task *dmt;
+	void *context;
+	int queued;
+};
+
+struct dm_status_batch {
+	struct dm_pool *mem;
+	struct dm_hash_table *members;	/* Indexed by uuid */
+	struct dm_list queue;		/* Members to read on the next run */
+	struct dm_list spare;		/* Released members for reuse */
+	struct dm_timestamp *ts_start;
+	struct dm_timestamp *ts_end;
+	struct dm_status_batch_counters counters;
+};
+
+struct dm_status_batch *dm_status_batch_create(void)
+{
+	struct dm_status_batch *dsb;
+	struct dm_pool *mem;
+
+	if (!(mem = dm_pool_create("status_batch", 1024)))
+		return_NULL;
+
+	if (!(dsb = dm_pool_zalloc(mem, sizeof(*dsb))))
+		goto_bad;
+
+	dsb->mem = mem;
+	dm_list_init(&dsb->queue);
+	dm_list_init(&dsb->spare);
+
+	if (!(dsb->members = dm_hash_create(64)))
+		goto_bad;
+
+	if (!(dsb->ts_start = dm_timestamp_alloc()) ||
+	    !(dsb->ts_end = dm_timestamp_alloc()))
+		goto_bad;
+
+	return dsb;
+bad:
+	if (dsb) {
+		if (dsb->members)
+			dm_hash_destroy(dsb->members);
+		if (dsb->ts_start)
+			dm_timestamp_destroy(dsb->ts_start);
+	}
+	dm_pool_destroy(mem);
+
+	return NULL;
+}
+
+int dm_status_batch_add(struct dm_status_batch *dsb, const char *uuid, void *context)
+{
+	struct dm_status_batch_member *m;
+
+	if (!(m = dm_hash_lookup(dsb->members, uuid))) {
+		if (!dm_list_empty(&dsb->spare)) {
+			m = dm_list_item(dm_list_first(&dsb->spare),
+					 struct dm_status_batch_member);
+			dm_list_del(&m->list);
+		} else if (!(m = dm_pool_zalloc(dsb->mem, sizeof(*m))))
+			return_0;
+
+		if (!(m->dmt = dm_task_create(DM_DEVICE_STATUS)))
+			goto_bad;
+
+		if (!dm_task_set_uuid(m->dmt, uuid) ||
+		    !dm_task_no_flush(m->dmt))
+			goto_bad;
+
+		if (!dm_hash_insert(dsb->members, uuid, m))
+			goto_bad;
+
+		m->queued = 0;
+	}
+
+	m->context = context;
+
+	if (!m->queued) {
+		dm_list_add(&dsb->queue, &m->list);
+		m->queued = 1;
+	}
+
+	return 1;
+bad:
+	if (m->dmt) {
+		dm_task_destroy(m->dmt);
+		m->dmt = NULL;
+	}
+	dm_list_add(&dsb->spare, &m->list);
+
+	return 0;
+}
+
+void dm_status_batch_remove(struct dm_status_batch *dsb, const char *uuid)
+{
+	struct dm_status_batch_member *m;
+
+	if (!(m = dm_hash_lookup(dsb->members, uuid)))
+		return;
+
+	dm_hash_remove(dsb->members, uuid);
+
+	if (m->queued)
+		dm_list_del(&m->list);
+
+	dm_task_destroy(m->dmt);
+	m->dmt = NULL;
+	m->context = NULL;
+	m->queued = 0;
+	dm_list_add(&dsb->spare, &m->list);
+}
+
+int dm_status_batch_run(struct dm_status_batch *dsb,
+			dm_status_batch_fn fn, void *data)
+{
+	struct dm_status_batch_member *m;
+	struct dm_list queue;
+	int r = 1, ok;
+
+	if (dm_list_empty(&dsb->queue))
+		return 1;
+
+	/* Callbacks may queue members for the next run */
+	dm_list_init(&queue);
+	dm_list_splice(&queue, &dsb->queue);
+
+	dsb->counters.passes++;
+
+	while (!dm_list_empty(&queue)) {
+		m = dm_list_item(dm_list_first(&queue), struct dm_status_batch_member);
+		dm_list_del(&m->list);
+		m->queued = 0;
+
+		(void) dm_timestamp_get(dsb->ts_start);
+		ok = dm_task_run(m->dmt);
+		if (dm_timestamp_get(dsb->ts_end))
+			dsb->counters.ioctl_ns +=
+				dm_timestamp_delta(dsb->ts_end, dsb->ts_start);
+		dsb->counters.ioctls++;
+
+		if (!ok)
+			dsb->counters.failures++;
+
+		if (!fn(ok ? m->dmt : NULL, m->context, data))
+			r = 0;
+	}
+
+	return r;
+}
+
+void dm_status_batch_get_counters(struct dm_status_batch *dsb,
+				  struct dm_status_batch_counters *counters)
+{
+	*counters = dsb->counters;
+}
+
+void dm_status_batch_destroy(struct dm_status_batch *dsb)
+{
+	struct dm_hash_node *n;
+	struct dm_status_batch_member *m;
+
+	if (!dsb)
+		return;
+
+	dm_hash_iterate(n, dsb->members) {
+		m = dm_hash_get_data(dsb->members, n);
+		dm_task_destroy(m->dmt);
+	}
+
+	dm_hash_destroy(dsb->members);
+	dm_timestamp_destroy(dsb->ts_start);
+	dm_timestamp_destroy(dsb->ts_end);
+	dm_pool_destroy(dsb->mem);
+}
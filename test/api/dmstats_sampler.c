@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU Lesser General Public License v.2.1.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#undef NDEBUG
+
+#include "libdevmapper.h"
+#include "assert.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define NR_SAMPLES 3
+#define NR_INTERVALS 5
+
+/*
+ * Sample region 0 of a device with a histogram and several areas.
+ * Interval k writes k sectors to area k % nr_areas, so each sample of
+ * the ring can be told apart from its neighbours.
+ */
+int main(int argc, char *argv[])
+{
+	struct dm_stats *dms;
+	struct dm_stats_sampler *dss;
+	struct dm_histogram *dmh;
+	uint64_t nr_areas, area, area_len, ios = 0;
+	unsigned k, i, s;
+	void *buf;
+	int fd;
+
+	assert(argc == 3);
+
+	fd = open(argv[1], O_WRONLY | O_DIRECT);
+	assert(fd >= 0);
+	assert(!posix_memalign(&buf, 4096, 512));
+
+	dms = dm_stats_create("dmstats_sampler");
+	assert(dms);
+	assert(dm_stats_bind_name(dms, argv[2]));
+
+	dss = dm_stats_sampler_create(dms, "dmstats", NR_SAMPLES);
+	assert(dss);
+	assert(!dm_stats_sampler_get_nr_samples(dss));
+
+	nr_areas = dm_stats_get_region_nr_areas(dms, 0);
+	assert(nr_areas > 1);
+	assert(dm_stats_get_region_area_len(dms, &area_len, 0));
+
+	/* Anything from before the sampler existed */
+	assert(dm_stats_sampler_sample(dss));
+	ios += dm_stats_sampler_get_counter(dss, DM_STATS_READS_COUNT, 0,
+					    DM_STATS_WALK_REGION, 0);
+	ios += dm_stats_sampler_get_counter(dss, DM_STATS_WRITES_COUNT, 0,
+					    DM_STATS_WALK_REGION, 0);
+
+	for (k = 1; k <= NR_INTERVALS; k++) {
+		for (i = 0; i < k; i++)
+			assert(pwrite(fd, buf, 512, ((k % nr_areas) * area_len
+						     + i) * 512) == 512);
+
+		assert(dm_stats_sampler_sample(dss));
+
+		/* Each sample holds only the I/O since the last one */
+		for (area = 0; area < nr_areas; area++) {
+			assert(dm_stats_sampler_get_counter(dss, DM_STATS_WRITES_COUNT,
+							    0, area, 0)
+			       == ((area == k % nr_areas) ? k : 0));
+			/* The region's own counters are the sampler's */
+			assert(dm_stats_get_counter(dms, DM_STATS_WRITES_COUNT,
+						    0, area)
+			       == ((area == k % nr_areas) ? k : 0));
+		}
+		assert(dm_stats_sampler_get_counter(dss, DM_STATS_WRITE_SECTORS_COUNT,
+						    0, DM_STATS_WALK_REGION, 0) == k);
+
+		ios += dm_stats_sampler_get_counter(dss, DM_STATS_READS_COUNT, 0,
+						    DM_STATS_WALK_REGION, 0);
+		ios += dm_stats_sampler_get_counter(dss, DM_STATS_WRITES_COUNT, 0,
+						    DM_STATS_WALK_REGION, 0);
+	}
+
+	/* The ring keeps the last NR_SAMPLES intervals, newest first */
+	assert(dm_stats_sampler_get_nr_samples(dss) == NR_SAMPLES);
+	for (s = 0; s < NR_SAMPLES; s++) {
+		k = NR_INTERVALS - s;
+		assert(dm_stats_sampler_get_interval_ns(dss, s));
+		assert(dm_stats_sampler_get_counter(dss, DM_STATS_WRITES_COUNT,
+						    0, DM_STATS_WALK_REGION, s) == k);
+		assert(dm_stats_sampler_get_counter(dss, DM_STATS_WRITES_COUNT,
+						    0, k % nr_areas, s) == k);
+	}
+	assert(!dm_stats_sampler_get_interval_ns(dss, NR_SAMPLES));
+
+	/* Histograms accumulate over every sample, not just the ring */
+	dmh = dm_stats_sampler_get_histogram(dss, 0, DM_STATS_WALK_REGION);
+	assert(dmh);
+	assert(dm_histogram_get_sum(dmh) == ios);
+	assert(ios >= NR_INTERVALS * (NR_INTERVALS + 1) / 2);
+
+	dm_stats_sampler_destroy(dss);
+	dm_stats_destroy(dms);
+	free(buf);
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This file is part of LVM2.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+# Don't attempt to test stats with driver < 4.33.00
+aux driver_at_least 4 33 || skip
+
+aux prepare_devs 1
+
+name=$(basename "$dev1")
+dmstats create --areas 4 --bounds 1ms,10ms "$dev1"
+
+aux apitest dmstats_sampler "$dev1" "$name"
+
+# The last sample cleared every write it read
+dmsetup message "$name" 0 @stats_print 0 >out
+cat out
+test "$(wc -l <out)" -eq 4
+test -z "$(awk '$6 != 0 || $8 != 0' out)"
+
+dmstats delete --allregions "$dev1"
@@ -0,0 +1,150 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check allocation from PVs with many small free areas
+SKIP_WITH_LVMLOCKD=1
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux prepare_pvs 4 64
+
+vgcreate -s 64K $vg $(cat DEVICES)
+
+PE_COUNT=$(get pv_field "$dev1" pe_count)
+
+vgcfgbackup -f data $vg
+
+# Fill every other extent of each PV with one LV, leaving only single
+# extent free areas behind
+awk -v PVS=4 -v PE_COUNT=$PE_COUNT '/^\t\}/ && !done { \
+    printf("\t}\n\tlogical_volumes {\n");\
+    printf("\t\tfiller {\n");\
+    print "\t\t\tid = \"000000-1111-2222-3333-2222-1111-000000\""; \
+    print "\t\t\tstatus = [\"READ\", \"WRITE\", \"VISIBLE\"]"; \
+    printf("\t\t\tsegment_count = %d\n", PVS * int(PE_COUNT / 2)); \
+    seg = 0; \
+    for (p = 0; p < PVS; p++) \
+	for (pe = 1; pe < PE_COUNT; pe += 2) { \
+	    printf("\t\t\tsegment%d {\n", seg + 1); \
+	    printf("\t\t\t\tstart_extent = %d\n", seg++); \
+	    print "\t\t\t\textent_count = 1"; \
+	    print "\t\t\t\ttype = \"striped\""; \
+	    print "\t\t\t\tstripe_count = 1"; \
+	    print "\t\t\t\tstripes = ["; \
+	    printf("\t\t\t\t\t\"pv%d\", %d\n", p, pe); \
+	    printf("\t\t\t\t]\n\t\t\t}\n"); \
+	} \
+    printf("\t\t}\n\t}\n"); \
+    done = 1; next \
+  }
+  {print}
+' data >data_new
+
+vgcfgrestore -f data_new $vg
+
+FREE=$(get vg_field $vg vg_free_count)
+test "$FREE" -eq $(( 4 * (PE_COUNT - PE_COUNT / 2) ))
+
+# Striped allocation must pick up one extent per stripe from each area
+lvcreate -an -Zn -i 4 -l 256 -n $lv1 $vg
+check lv_field $vg/$lv1 seg_count 64
+
+# Remaining free space in whatever order the allocator prefers
+lvcreate -an -Zn -l 100%FREE -n $lv2 $vg
+check vg_field $vg vg_free_count 0
+
+lvremove -f $vg/$lv1
+lvextend -l +100%FREE $vg/$lv2
+check vg_field $vg vg_free_count 0
+
+vgremove -ff $vg
+
+# Free areas of varied sizes in the first 256 extents of each PV.
+# The layouts below are the ones the allocator has always chosen.
+vgcreate -s 64K $vg $(cat DEVICES)
+vgcfgbackup -f data $vg
+
+awk -v PVS=4 '/^\t\}/ && !done { \
+    printf("\t}\n\tlogical_volumes {\n");\
+    printf("\t\tfiller {\n");\
+    print "\t\t\tid = \"000000-1111-2222-3333-2222-1111-000000\""; \
+    print "\t\t\tstatus = [\"READ\", \"WRITE\", \"VISIBLE\"]"; \
+    seg = 0; \
+    for (p = 0; p < PVS; p++) \
+	for (i = pe = 0; (pe += (i * 7 + p * 5) % 11 + 1) < 256; i++) { \
+	    used[seg] = p; \
+	    at[seg++] = pe++; \
+	} \
+    printf("\t\t\tsegment_count = %d\n", seg); \
+    for (s = 0; s < seg; s++) { \
+	printf("\t\t\tsegment%d {\n", s + 1); \
+	printf("\t\t\t\tstart_extent = %d\n", s); \
+	print "\t\t\t\textent_count = 1"; \
+	print "\t\t\t\ttype = \"striped\""; \
+	print "\t\t\t\tstripe_count = 1"; \
+	print "\t\t\t\tstripes = ["; \
+	printf("\t\t\t\t\t\"pv%d\", %d\n", used[s], at[s]); \
+	printf("\t\t\t\t]\n\t\t\t}\n"); \
+    } \
+    printf("\t\t}\n\t}\n"); \
+    done = 1; next \
+  }
+  {print}
+' data >data_new
+
+vgcfgrestore -f data_new $vg
+
+RANGES="$dev1:0-255 $dev2:0-255 $dev3:0-255 $dev4:0-255"
+lvcreate -an -Zn -l 20 -n l1 $vg $RANGES
+lvcreate -an -Zn -i 3 -l 45 -n l2 $vg $RANGES
+lvcreate -an -Zn -i 2 -I 64k -l 50 -n l3 $vg $RANGES
+lvcreate -an -Zn -l 7 -n l4 $vg "$dev2:0-255"
+lvextend -l +33 $vg/l1 $RANGES
+lvremove -f $vg/l2
+lvcreate -an -Zn -i 4 -l 60 -n l5 $vg $RANGES
+lvextend -l +50 --alloc anywhere $vg/l4 "$dev2:0-255" "$dev3:0-255"
+lvcreate -an -Zn -l 60 -n l6 $vg $RANGES
+
+lvs -a --noheadings -S 'lv_name!=filler' -o lv_name,seg_pe_ranges \
+    --sort lv_name,seg_start $vg | awk '{ $1 = $1; print }' >layout
+
+cat >expected <<EOF
+l1 $dev1:16-26
+l1 $dev1:93-103
+l1 $dev1:117-126
+l1 $dev1:194-203
+l1 $dev1:61-69
+l1 $dev1:138-139
+l3 $dev2:196-206 $dev3:154-164
+l3 $dev2:66-75 $dev3:231-240
+l3 $dev2:143-146 $dev3:24-27
+l4 $dev2:220-229
+l4 $dev2:10-18
+l4 $dev2:87-95
+l4 $dev2:164-172
+l4 $dev2:241-249
+l4 $dev2:28-35
+l4 $dev2:105-107
+l5 $dev1:170-180 $dev2:42-52 $dev3:0-10 $dev4:22-32
+l5 $dev1:40-43 $dev2:119-122 $dev3:77-80 $dev4:99-102
+l6 $dev4:176-186
+l6 $dev4:46-55
+l6 $dev4:123-132
+l6 $dev4:200-209
+l6 $dev4:67-75
+l6 $dev4:144-152
+l6 $dev4:221-221
+EOF
+
+diff expected layout
+
+vgremove -ff $vg
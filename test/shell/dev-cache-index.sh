@@ -0,0 +1,49 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check the persistent device index is written, reused and
+# rescans directories where devices change.
+
+SKIP_WITH_LVMLOCKD=1
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+test -e LOCAL_LVMETAD && skip
+
+aux prepare_devs 3
+
+pvcreate "$dev1" "$dev2"
+
+aux lvmconf "devices/device_index = 1"
+rm -f "$TESTDIR/etc/.devindex"
+
+pvs --config "devices/write_cache_state = 0" >/dev/null
+test ! -e "$TESTDIR/etc/.devindex"
+
+# Directories changed within the last seconds are not trusted
+sleep 2
+
+pvs --noheadings -o pv_name | sort > scan.out
+test -f "$TESTDIR/etc/.devindex"
+
+pvs -vvvv --noheadings -o pv_name 2> err | sort > index.out
+grep "Loaded device list from index" err
+diff scan.out index.out
+
+# A new device must be found even though the index exists
+dmsetup create "${PREFIX}new" --table "0 8192 linear $dev3 0"
+pvcreate "$DM_DEV_DIR/mapper/${PREFIX}new"
+check pv_field "$DM_DEV_DIR/mapper/${PREFIX}new" pv_name "$DM_DEV_DIR/mapper/${PREFIX}new"
+
+pvremove "$DM_DEV_DIR/mapper/${PREFIX}new"
+dmsetup remove "${PREFIX}new"
+not pvs "$DM_DEV_DIR/mapper/${PREFIX}new"
@@ -0,0 +1,129 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Exercise dmstats update_filemap and dmfilemapd
+
+SKIP_WITH_LVMPOLLD=1
+
+mntdir="${PREFIX}mnt"
+pid=
+
+cleanup_mounted_and_teardown()
+{
+	test -z "$pid" || kill "$pid" 2>/dev/null || true
+	umount "$mntdir" 2>/dev/null || true
+	aux teardown
+}
+
+. lib/inittest
+
+# Don't attempt to test stats with driver < 4.33.00
+aux driver_at_least 4 33 || skip
+which mkfs.ext4 || skip
+which fallocate || skip
+export MKE2FS_CONFIG="$TESTDIR/lib/mke2fs.conf"
+
+aux prepare_devs 1 64
+
+mkfs.ext4 -b 4096 "$dev1"
+trap 'cleanup_mounted_and_teardown' EXIT
+mkdir "$mntdir"
+mount "$dev1" "$mntdir"
+file="$mntdir/file"
+
+# Small files share a locality group preallocation, so appending to
+# two of them in turn gives each one block at a time, none adjacent.
+grow() {
+	for i in $(seq 1 $1); do
+		dd if=/dev/zero of="$file" bs=4k count=1 oflag=append conv=notrunc,fsync
+		dd if=/dev/zero of="$mntdir/other" bs=4k count=1 oflag=append conv=notrunc,fsync
+	done
+}
+
+# ID, start, length and group of every region on the device
+regions() {
+	dmstats list --region --noheadings --nosuffix --units s \
+		-o region_id,region_start,region_len,group_id "$dev1" |
+		awk '{ $1 = $1; print }'
+}
+
+# ID, start and length of the regions in group $1
+group_regions() {
+	regions | awk -v g="$1" '$4 == g { print $1, $2, $3 }' | sort -n
+}
+
+grow 6
+dmstats create --filemap "$file" | tee out
+group=$(sed -n 's/.*as group ID \([0-9]*\)\./\1/p' out)
+group_regions $group >old
+cat old
+test $(wc -l <old) -gt 2
+
+# Punch out two blocks and add two more
+fallocate -p -o 4096 -l 8192 "$file"
+grow 2
+
+dmstats update_filemap --groupid $group "$file" | tee out
+group=$(sed -n 's/.*Updated group ID \([0-9]*\)\./\1/p' out)
+group_regions $group >new
+regions | awk '{ print $1 }' >ids
+cat new
+
+# The extents as a new mapping of the file sees them
+dmstats create --filemap --nogroup "$file" | tee out
+sed -n 's/.*as region ID \([0-9]*\)\./\1/p' out >fresh_ids
+regions | awk 'NR == FNR { f[$1] = 1; next } ($1 in f) { print $2, $3 }' \
+	fresh_ids - | sort >fresh
+for id in $(cat fresh_ids); do
+	dmstats delete --regionid $id "$dev1"
+done
+
+# The group covers exactly the file's extents
+awk '{ print $2, $3 }' new | sort | diff fresh -
+
+# Unchanged extents kept their region, with its counters
+kept=$(awk 'NR == FNR { o[$0] = 1; next } ($0 in o)' old new | wc -l)
+# New extents got new regions in the group
+added=$(awk 'NR == FNR { o[$1] = 1; next } !($1 in o)' old new | wc -l)
+# Regions of extents that are gone were deleted
+deleted=$(awk 'NR == FNR { o[$1] = 1; next } !($1 in o)' ids old | wc -l)
+test "$kept" -gt 0
+test "$added" -gt 0
+test "$deleted" -gt 0
+test $(( kept + added )) -eq $(wc -l <new)
+
+# The group leader is its lowest region ID
+test "$(head -n 1 new | cut -d' ' -f1)" = "$group"
+
+# No change: nothing is recreated
+dmstats update_filemap --groupid $group "$file"
+group_regions $group | diff new -
+
+# dmfilemapd picks up writes after --interval and exits with the file
+dmfilemapd --groupid $group --interval 1 --foreground "$file" &
+pid=$!
+grow 2
+for i in $(seq 1 20); do
+	group_regions $group >daemon
+	test $(wc -l <daemon) -gt $(wc -l <new) && break
+	sleep .5
+done
+cat daemon
+test $(wc -l <daemon) -gt $(wc -l <new)
+# nothing was deleted, so every region was kept
+awk 'NR == FNR { d[$0] = 1; next } !($0 in d)' daemon new >missing
+test ! -s missing
+
+rm -f "$file"
+wait $pid
+pid=
+
+umount "$mntdir"
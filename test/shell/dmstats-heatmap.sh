@@ -0,0 +1,75 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Exercise dmstats heatmap CSV records and --map
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+# Don't attempt to test stats with driver < 4.33.00
+aux driver_at_least 4 33 || skip
+
+aux prepare_devs 2
+
+# 64KiB chunks striped across the two devices
+heat="${PREFIX}heat"
+dmsetup create "$heat" --table "0 4096 striped 2 128 $dev1 0 $dev2 0"
+dmstats create --areas 64 "$heat"
+
+# 128 writes to sectors 1024-1151, all in bucket 8 of 32
+dd if=/dev/zero of="$DM_DEV_DIR/mapper/$heat" bs=512 seek=1024 count=128 oflag=direct
+
+dmstats heatmap --buckets 32 --count 2 --interval 1 --map "$heat" >out
+cat out
+
+grep -x "heatmap,$heat,0,4096,32,128" out
+test "$(grep -c ^bucket, out)" -eq 32
+test "$(grep -c ^sample, out)" -eq 2
+# every sample has a count for each bucket
+test -z "$(awk -F, '/^sample,/ && NF != 35' out)"
+awk -F, '/^sample,1,/ { exit !($12 >= 128) }' out
+
+# Each bucket maps through its stripe and the linear PV to the backing device
+set -- $(dmsetup table "$dev1")
+majmin=$4 off1=$5
+set -- $(dmsetup table "$dev2")
+test "$4" = "$majmin"
+off2=$5
+bdev=$(basename "$(readlink /sys/dev/block/$majmin)")
+for b in 0 1 2 3 8 9 31; do
+	if test $(( b % 2 )) -eq 0; then
+		pv=${PREFIX}pv1 off=$off1
+	else
+		pv=${PREFIX}pv2 off=$off2
+	fi
+	pe=$(( b / 2 * 128 ))
+	grep -x "bucket,$b,$(( b * 128 )),128,$heat:$(( b * 128 ))>$pv:$pe>$bdev:$(( off + pe ))" out
+done
+
+# Without --map buckets just have their range
+dmstats heatmap --buckets 4 "$heat" >out
+grep -x "bucket,3,3072,1024" out
+
+# Only the given region, and never more buckets than sectors
+dmstats create --start 2048 --length 16 "$heat" | tee out
+region=$(awk '/region ID/ { print $NF }' out)
+dmstats heatmap --regionid "$region" --buckets 64 "$heat" >out
+grep -x "heatmap,$heat,2048,16,16,1" out
+test "$(grep -c ^bucket, out)" -eq 16
+grep -x "bucket,15,2063,1" out
+
+not dmstats heatmap --buckets 0 "$heat"
+not dmstats heatmap --regionid 99 "$heat"
+dmstats delete --allregions "$heat"
+not dmstats heatmap "$heat"
+
+dmsetup remove "$heat"
@@ -26,3 +26,26 @@ dmstats create --bounds 10ms,20ms,30ms "$dev1"
 dmstats report
 dmstats report --count 1
 dmstats report --histogram
+
+# Latency percentiles from known histogram bins: reads go straight
+# through and land in the first bin, writes are delayed by 50ms
+aux delay_dev "$dev1" 0 50
+test -f HAVE_DM_DELAY || exit 0
+
+dmstats delete --allregions "$dev1"
+r1=$(dmstats create --bounds 10ms,20ms,40ms,1s "$dev1" | sed -n 's/.*region ID \([0-9]*\)$/\1/p')
+r2=$(dmstats create --bounds 10ms,20ms "$dev1" | sed -n 's/.*region ID \([0-9]*\)$/\1/p')
+
+dd if="$dev1" of=/dev/null bs=4k count=10 iflag=direct
+dd if=/dev/zero of="$dev1" bs=4k count=10 oflag=direct
+
+dmstats report --noheadings -o region_id,hist_count,latency_p50,latency_p95,latency_p99,latency_p999 \
+	"$dev1" | awk '{ $1 = $1; print }' >out
+cat out
+
+# Interpolated within the bin: 904ms is 90% of the way from 40ms to 1s
+grep -x "$r1 10:0:0:10:0 10.00 904.00 980.80 998.08" out
+# The last bin has no upper bound: its lower bound is reported
+grep -x "$r2 10:0:10 10.00 20.00 20.00 20.00" out
+
+dmstats delete --allregions "$dev1"
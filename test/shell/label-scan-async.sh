@@ -0,0 +1,38 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check batched asynchronous label scanning finds the same PVs
+# as scanning devices one by one.
+
+SKIP_WITH_LVMLOCKD=1
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+test -e LOCAL_LVMETAD && skip
+
+aux prepare_devs 6
+
+pvcreate "$dev1" "$dev2" "$dev3" "$dev4"
+vgcreate $vg1 "$dev1" "$dev2"
+vgcreate $vg2 "$dev3"
+
+aux lvmconf "devices/async_label_scan = 0"
+pvs --noheadings -o pv_name,vg_name | sort > sync.out
+
+aux lvmconf "devices/async_label_scan = 1"
+pvs --noheadings -o pv_name,vg_name | sort > async.out
+
+diff sync.out async.out
+check pv_field "$dev4" vg_name ""
+check pv_field "$dev1" vg_name $vg1
+
+vgremove -ff $vg1 $vg2
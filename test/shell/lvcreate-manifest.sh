@@ -0,0 +1,108 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Exercise lvcreate --manifest
+
+SKIP_WITH_LVMLOCKD=1
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux prepare_vg 3 32
+
+cat > manifest <<EOF2
+$lv1 { size = 4 }
+$lv2 { size = "8m" stripes = 2 tags = [ "t1", "t2" ] }
+$lv3 { extents = 3 }
+EOF2
+
+SEQNO=$(get vg_field $vg seqno)
+lvcreate --manifest manifest -an --addtag common $vg
+# all LVs with a single metadata update
+check vg_field $vg seqno $(( SEQNO + 1 ))
+check lv_field $vg/$lv1 lv_size "4.00m"
+check lv_field $vg/$lv2 stripes 2
+check lv_field $vg/$lv2 lv_tags "common,t1,t2"
+check lv_field $vg/$lv3 seg_size_pe 3
+check inactive $vg $lv1
+
+# nothing created when any of the LVs fails
+cat > manifest <<EOF2
+$lv4 { size = 4 }
+$lv5 { size = "1t" }
+EOF2
+not lvcreate --manifest manifest -an $vg
+not lvs $vg/$lv4
+
+# activated and zeroed by default
+cat > manifest <<EOF2
+$lv4 { size = 4 }
+EOF2
+lvcreate --manifest manifest $vg "$dev2"
+check active $vg $lv4
+check lv_on $vg $lv4 "$dev2"
+
+# invalid manifests
+cat > manifest <<EOF2
+$lv5 { size = 4 unknown = 1 }
+EOF2
+not lvcreate --manifest manifest $vg
+cat > manifest <<EOF2
+$lv5 { size = 4 extents = 1 }
+EOF2
+not lvcreate --manifest manifest $vg
+cat > manifest <<EOF2
+$lv1 { size = 4 }
+EOF2
+not lvcreate --manifest manifest $vg
+invalid lvcreate --manifest manifest -L4 $vg
+invalid lvcreate --manifest manifest -n $lv5 $vg
+invalid lvcreate --manifest manifest $vg/$lv5
+
+# same layout as creating the LVs one by one, with fragmented free space
+vgchange -an $vg
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	lvcreate -an -Zn -l $(( i % 3 + 1 )) -n frag$i $vg
+done
+lvremove -f $vg/frag2 $vg/frag5 $vg/frag6 $vg/frag9
+cat > manifest <<EOF2
+b1 { extents = 3 }
+b2 { extents = 4 stripes = 2 }
+b3 { extents = 1 }
+b4 { extents = 6 stripes = 3 }
+b5 { extents = 5 }
+EOF2
+vgcfgbackup -f before $vg
+lvcreate --manifest manifest -an $vg
+lvs --noheadings -o lv_name,seg_pe_ranges -S 'lv_name=~^b' --sort lv_name,seg_start $vg >batch
+vgcfgrestore -f before $vg
+lvcreate -an -Zn -l 3 -n b1 $vg
+lvcreate -an -Zn -l 4 -i 2 -n b2 $vg
+lvcreate -an -Zn -l 1 -n b3 $vg
+lvcreate -an -Zn -l 6 -i 3 -n b4 $vg
+lvcreate -an -Zn -l 5 -n b5 $vg
+lvs --noheadings -o lv_name,seg_pe_ranges -S 'lv_name=~^b' --sort lv_name,seg_start $vg >single
+diff batch single
+lvremove -f $vg
+
+aux have_thin 1 0 0 || { vgremove -ff $vg; exit 0; }
+
+lvcreate -L8 -T $vg/pool
+cat > manifest <<EOF2
+thin1 { size = "1g" thinpool = "pool" }
+thin2 { size = 16 thinpool = "pool" }
+EOF2
+lvcreate --manifest manifest $vg
+check lv_field $vg/thin1 lv_size "1.00g"
+check lv_field $vg/thin2 pool_lv "pool"
+check active $vg thin2
+
+vgremove -ff $vg
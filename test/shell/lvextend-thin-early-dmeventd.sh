@@ -0,0 +1,78 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Test early autoextension of thin pool projected from the fill rate
+
+SKIP_WITH_LVMLOCKD=1
+SKIP_WITH_LVMPOLLD=1
+
+export LVM_TEST_THIN_REPAIR_CMD=${LVM_TEST_THIN_REPAIR_CMD-/bin/false}
+
+. lib/inittest
+
+# Write 1MiB at given offset in MiB
+write_mb_() {
+	dd if=/dev/urandom of="$DM_DEV_DIR/mapper/$vg-$lv1" bs=1M count=1 seek=$1 conv=fdatasync
+}
+
+pool_size_() {
+	get lv_field $vg/pool lv_size --units k --nosuffix
+}
+
+aux have_thin 1 10 0 || skip
+
+# Autoextend is only enabled by the pool's profile
+aux lvmconf "activation/thin_pool_autoextend_percent = 20" \
+	    "activation/thin_pool_autoextend_threshold = 100" \
+	    "activation/thin_pool_autoextend_horizon = 120"
+aux profileconf thin_early "activation/thin_pool_autoextend_threshold = 80"
+
+aux prepare_pvs 3 256
+
+vgcreate -s 256K $vg $(cat DEVICES)
+
+lvcreate -L10M -c 64k -T $vg/pool --metadataprofile thin_early
+lvcreate -V20M $vg/pool -n $lv1
+
+# 20% of 160 chunks left free at the threshold of the profile
+dmsetup table $vg-pool-tpool | awk '{ exit !($6 == 128 && $7 == 32) }'
+
+# Reporting the projection does not start dmeventd
+not pgrep dmeventd
+lvs --config 'activation{monitoring=1}' -o+time_to_full $vg/pool
+not pgrep dmeventd
+
+aux prepare_dmeventd
+lvchange --monitor y $vg/pool
+
+# Nothing written yet, nothing is projected
+test -z "$(get lv_field $vg/pool time_to_full)"
+
+# Fill 10% every 5 seconds up to 70%, staying below the threshold;
+# dmeventd samples the pool every 10 seconds
+for i in 0 1 2 3 4 5 6 ; do
+	write_mb_ $i
+	sleep 5
+done
+
+lvs -a -o+chunksize,time_to_full $vg
+dmsetup table
+dmsetup status
+
+# Filling pool reports its projection
+test -n "$(get lv_field $vg/pool time_to_full)"
+
+# Usage never crossed the threshold, so only the projection could
+# have extended the pool
+test "$(pool_size_)" != "10240.00"
+test "$(get lv_field $vg/pool data_percent | cut -d. -f1)" -lt 80
+
+vgremove -f $vg
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# The text written by vg_write is reused for lvmcache and lvmetad.
+# Commands that change a VG again after committing it must never
+# have the old text cached or sent anywhere.
+
+SKIP_WITH_LVMLOCKD=1
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+# Metadata as lvm sees it (lvmetad if used) matches the disks
+compare_() {
+	vgcfgbackup -f cached $vg
+	vgcfgbackup --config 'global/use_lvmetad=0' -f disk $vg
+	grep -v "^description\|^creation_time\|^contents\|^# " cached > cached.txt
+	grep -v "^description\|^creation_time\|^contents\|^# " disk > disk.txt
+	diff cached.txt disk.txt
+	grep "seqno = $(get vg_field $vg seqno)\$" disk.txt
+}
+
+aux prepare_vg 3
+
+lvcreate -an -Zn -l2 -n $lv1 $vg
+compare_
+
+# Several commits in one command
+lvcreate -aey --type mirror -m1 -l2 -n $lv2 $vg
+compare_
+grep ${lv2}_mlog disk.txt
+
+lvconvert -y -m0 $vg/$lv2
+compare_
+not grep ${lv2}_mimage disk.txt
+
+# Nothing of a failed command is left in the metadata
+not lvcreate -an -Zn -l 10000 -n $lv3 $vg
+compare_
+not grep $lv3 disk.txt
+
+lvrename $vg/$lv1 $vg/$lv3
+compare_
+grep $lv3 disk.txt
+not grep "$lv1 {" disk.txt
+
+lvremove -f $vg/$lv2
+compare_
+
+vgremove -ff $vg
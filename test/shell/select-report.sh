@@ -218,3 +218,37 @@ sel lv '(lv_name=vol1 || lv_name=vol2) && lv_size < 8m' vol2
 sel lv '(lv_name=vol1 && lv_size=8m) && vg_tags=vg_tag2' vol1
 # negation of clause grouped by ( )
 sel lv '!(lv_name=vol1 || lv_name=vol2)' abc xyz orig snap
+
+#######################################
+# STREAMED JSON OUTPUT (--unbuffered) #
+#######################################
+# Unbuffered JSON holds back each row until the next one, or the end of
+# its report, tells whether it needs a separator.
+json_well_formed_() {
+	awk '{ gsub(/"[^"]*"/, "\"\""); sub(/^ */, "") }
+	     prev ~ /,$/ && /^[]}]/ { exit 1 }
+	     prev ~ /[]}]$/ && /^[{"]/ { exit 1 }
+	     { depth += gsub(/[[{]/, "&") - gsub(/[]}]/, "&"); if (depth < 0) exit 1; prev = $0 }
+	     END { exit depth }' "$1"
+}
+
+# The same rows as buffered output, which is sorted
+json_() {
+	"$@" --reportformat json >buffered
+	"$@" --reportformat json --unbuffered >out
+	cat out
+	json_well_formed_ out
+	sed 's/,$//' buffered | sort >buffered_rows
+	sed 's/,$//' out | sort | diff buffered_rows -
+}
+
+json_ lvs -o lv_name --select 'lv_name=none'
+not grep lv_name out
+json_ lvs -o lv_name --select 'lv_name=vol1'
+test "$(grep -c lv_name out)" -eq 1
+json_ lvs -o lv_name,lv_size
+test "$(grep -c lv_name out)" -eq 6
+# Nested groups: reports of each VG and the command log
+json_ lvm fullreport
+json_ lvm fullreport --config 'log{report_command_log=1}'
+grep '"log": \[' out
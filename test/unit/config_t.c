@@ -88,6 +88,146 @@ static void test_parse(void)
 	dm_config_destroy(tree);
 }
 
+static int _append_line(const char *line, void *baton)
+{
+	struct dm_pool *pool = baton;
+
+	return dm_pool_grow_object(pool, line, 0) &&
+		dm_pool_grow_object(pool, "\n", 1);
+}
+
+static char *_tree_text(struct dm_config_tree *tree)
+{
+	if (!dm_pool_begin_object(mem, 1024) ||
+	    !dm_config_write_node(tree->root, _append_line, mem) ||
+	    !dm_pool_grow_object(mem, "", 1))
+		return NULL;
+
+	return dm_pool_end_object(mem);
+}
+
+static void test_parse_in_place(void)
+{
+	static const char text[] =
+		"a=1 b=\"x\\\"y\" c='q' d=bare#comment\n"
+		"\"e f\" { g/h = [\"i\",'j'] }\n"
+		"l/m = -2.5\n"
+		"n = \"end\"";
+	struct dm_config_tree *copied = dm_config_from_string(text);
+	struct dm_config_tree *tree = dm_config_create();
+	char *buf = dm_pool_alloc(mem, sizeof(text));
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(copied);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(tree);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+
+	/* The parse is allowed to write to the byte at end */
+	memcpy(buf, text, sizeof(text));
+	CU_ASSERT(dm_config_parse_in_place(tree, buf, buf + sizeof(text) - 1));
+
+	CU_ASSERT_STRING_EQUAL(dm_config_find_str(tree->root, "b", NULL), "x\"y");
+	CU_ASSERT_STRING_EQUAL(dm_config_find_str(tree->root, "d", NULL), "bare");
+	CU_ASSERT_STRING_EQUAL(dm_config_find_str(tree->root, "e f/g/h", NULL), "i");
+	CU_ASSERT_STRING_EQUAL(dm_config_find_str(tree->root, "n", NULL), "end");
+	CU_ASSERT_EQUAL(dm_config_find_float(tree->root, "l/m", 0), -2.5);
+
+	/* Strings are not copied */
+	CU_ASSERT_PTR_EQUAL(dm_config_find_str(tree->root, "c", NULL), buf + 16);
+
+	CU_ASSERT_STRING_EQUAL(_tree_text(tree), _tree_text(copied));
+
+	dm_config_destroy(tree);
+	dm_config_destroy(copied);
+}
+
+static void test_large_section(void)
+{
+	struct dm_config_tree *tree = dm_config_create();
+	char path[64], *text;
+	unsigned i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(tree);
+	CU_ASSERT_FATAL(dm_pool_begin_object(mem, 1024));
+	CU_ASSERT(dm_pool_grow_object(mem, "lvs {\n", 0));
+	for (i = 0; i < 1000; i++) {
+		snprintf(path, sizeof(path), "lv%u { id = %u }\n", i, i);
+		CU_ASSERT(dm_pool_grow_object(mem, path, 0));
+	}
+	/* Reopened section is merged into the indexed one */
+	CU_ASSERT(dm_pool_grow_object(mem, "}\nlvs { lv7 { seg = 1 } }\n", 0));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(text = dm_pool_end_object(mem));
+
+	CU_ASSERT_FATAL(dm_config_parse(tree, text, text + strlen(text)));
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(path, sizeof(path), "lvs/lv%u/id", i);
+		CU_ASSERT_EQUAL(dm_config_tree_find_int(tree, path, -1), (int) i);
+		CU_ASSERT_EQUAL(dm_config_find_int(tree->root, path, -1), (int) i);
+	}
+
+	CU_ASSERT_EQUAL(dm_config_tree_find_int(tree, "lvs/lv7/seg", -1), 1);
+	CU_ASSERT_PTR_NULL(dm_config_tree_find_node(tree, "lvs/lv1000"));
+	CU_ASSERT_PTR_NULL(dm_config_tree_find_node(tree, "lvs/"));
+	CU_ASSERT_PTR_NULL(dm_config_tree_find_node(tree, "lvs/lv1/id/x"));
+
+	dm_config_destroy(tree);
+}
+
+static void test_indexed_lookup(void)
+{
+	struct dm_config_tree *tree = dm_config_create();
+	struct dm_config_tree *top = dm_config_from_string("lvs { lv1 { id = 42 } }");
+	struct dm_config_node *cn;
+	char path[64], *text;
+	unsigned i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(tree);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(top);
+	CU_ASSERT_FATAL(dm_pool_begin_object(mem, 1024));
+	CU_ASSERT(dm_pool_grow_object(mem, "lvs {\n", 0));
+	for (i = 0; i < 100; i++) {
+		snprintf(path, sizeof(path), "lv%u { id = %u }\n", i, i);
+		CU_ASSERT(dm_pool_grow_object(mem, path, 0));
+	}
+	CU_ASSERT(dm_pool_grow_object(mem, "}\n", 1));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(text = dm_pool_end_object(mem));
+
+	dm_config_tree_set_indexed(tree, 1);
+	CU_ASSERT_FATAL(dm_config_parse(tree, text, text + strlen(text)));
+
+	/* First lookup scans the section and indexes it */
+	CU_ASSERT_PTR_NOT_NULL_FATAL(cn = (struct dm_config_node *)
+				     dm_config_tree_find_node(tree, "lvs/lv5"));
+	CU_ASSERT_EQUAL(dm_config_tree_find_int(tree, "lvs/lv99/id", -1), 99);
+
+	/* Later lookups go by the index, not by the keys in the section */
+	cn->key = "renamed";
+	CU_ASSERT_PTR_EQUAL(dm_config_tree_find_node(tree, "lvs/lv5"), cn);
+	CU_ASSERT_PTR_NULL(dm_config_tree_find_node(tree, "lvs/renamed"));
+	CU_ASSERT_PTR_NULL(dm_config_tree_find_node(tree, "lvs/lv100"));
+
+	/* Setting it again drops the index */
+	dm_config_tree_set_indexed(tree, 1);
+	CU_ASSERT_PTR_NULL(dm_config_tree_find_node(tree, "lvs/lv5"));
+	CU_ASSERT_EQUAL(dm_config_tree_find_int(tree, "lvs/renamed/id", -1), 5);
+	CU_ASSERT_PTR_EQUAL(dm_config_tree_find_node(tree, "lvs/renamed"), cn);
+
+	/* The index is per tree within a cascade */
+	dm_config_tree_set_indexed(top, 1);
+	CU_ASSERT_PTR_EQUAL(dm_config_insert_cascaded_tree(top, tree), top);
+	CU_ASSERT_EQUAL(dm_config_tree_find_int(top, "lvs/lv1/id", -1), 42);
+	CU_ASSERT_EQUAL(dm_config_tree_find_int(top, "lvs/lv2/id", -1), 2);
+	CU_ASSERT_EQUAL(dm_config_tree_find_int(top, "lvs/renamed/id", -1), 5);
+
+	/* Parsing into the tree again replaces what was indexed */
+	CU_ASSERT_FATAL(dm_config_parse(tree, text, text + strlen(text)));
+	CU_ASSERT_EQUAL(dm_config_tree_find_int(top, "lvs/lv5/id", -1), 5);
+	CU_ASSERT_PTR_NULL(dm_config_tree_find_node(top, "lvs/renamed"));
+
+	dm_config_destroy(top);
+	dm_config_destroy(tree);
+}
+
 static void test_clone(void)
 {
 	struct dm_config_tree *tree = dm_config_from_string(conf);
@@ -146,6 +286,9 @@ static void test_cascade(void)
 
 CU_TestInfo config_list[] = {
 	{ (char*)"parse", test_parse },
+	{ (char*)"parse_in_place", test_parse_in_place },
+	{ (char*)"large_section", test_large_section },
+	{ (char*)"indexed_lookup", test_indexed_lookup },
 	{ (char*)"clone", test_clone },
 	{ (char*)"cascade", test_cascade },
 	CU_TEST_INFO_NULL
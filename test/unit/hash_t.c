@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "units.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+	NR_KEYS = 50000
+};
+
+static char (*keys)[32];
+
+int hash_init(void)
+{
+	unsigned i;
+
+	if (!(keys = dm_malloc(sizeof(*keys) * NR_KEYS)))
+		return 1;
+
+	for (i = 0; i < NR_KEYS; i++)
+		snprintf(keys[i], sizeof(*keys), "pv%08u-uuid-%u", i * 7919, i);
+
+	return 0;
+}
+
+int hash_fini(void)
+{
+	dm_free(keys);
+
+	return 0;
+}
+
+static void test_insert_lookup(void)
+{
+	struct dm_hash_table *t = dm_hash_create(16);
+	unsigned i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(t);
+
+	/* Table must grow well past its initial size */
+	for (i = 0; i < NR_KEYS; i++)
+		CU_ASSERT(dm_hash_insert(t, keys[i], keys[i]));
+
+	CU_ASSERT_EQUAL(dm_hash_get_num_entries(t), NR_KEYS);
+
+	for (i = 0; i < NR_KEYS; i++)
+		CU_ASSERT_PTR_EQUAL(dm_hash_lookup(t, keys[i]), keys[i]);
+
+	CU_ASSERT_PTR_NULL(dm_hash_lookup(t, "missing"));
+
+	/* Replace existing value */
+	CU_ASSERT(dm_hash_insert(t, keys[7], keys[8]));
+	CU_ASSERT_PTR_EQUAL(dm_hash_lookup(t, keys[7]), keys[8]);
+	CU_ASSERT_EQUAL(dm_hash_get_num_entries(t), NR_KEYS);
+
+	dm_hash_destroy(t);
+}
+
+static void test_remove(void)
+{
+	struct dm_hash_table *t = dm_hash_create(16);
+	unsigned i, round;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(t);
+
+	/* Repeated insert and remove must not fill the table */
+	for (round = 0; round < 4; round++) {
+		for (i = 0; i < NR_KEYS; i++)
+			CU_ASSERT(dm_hash_insert(t, keys[i], keys[i]));
+
+		for (i = 0; i < NR_KEYS; i += 2)
+			dm_hash_remove(t, keys[i]);
+
+		CU_ASSERT_EQUAL(dm_hash_get_num_entries(t), NR_KEYS / 2);
+
+		for (i = 0; i < NR_KEYS; i++)
+			CU_ASSERT_PTR_EQUAL(dm_hash_lookup(t, keys[i]),
+					    (i & 1) ? keys[i] : NULL);
+
+		for (i = 1; i < NR_KEYS; i += 2)
+			dm_hash_remove(t, keys[i]);
+
+		CU_ASSERT_EQUAL(dm_hash_get_num_entries(t), 0);
+	}
+
+	dm_hash_destroy(t);
+}
+
+static void test_binary(void)
+{
+	struct dm_hash_table *t = dm_hash_create(16);
+	const char k1[] = { 1, 0, 2 }, k2[] = { 1, 0, 3 };
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(t);
+
+	CU_ASSERT(dm_hash_insert_binary(t, k1, sizeof(k1), (void *) k1));
+	CU_ASSERT(dm_hash_insert_binary(t, k2, sizeof(k2), (void *) k2));
+	CU_ASSERT_PTR_EQUAL(dm_hash_lookup_binary(t, k1, sizeof(k1)), k1);
+	CU_ASSERT_PTR_EQUAL(dm_hash_lookup_binary(t, k2, sizeof(k2)), k2);
+	CU_ASSERT_PTR_NULL(dm_hash_lookup_binary(t, k1, 2));
+
+	dm_hash_remove_binary(t, k1, sizeof(k1));
+	CU_ASSERT_PTR_NULL(dm_hash_lookup_binary(t, k1, sizeof(k1)));
+	CU_ASSERT_PTR_EQUAL(dm_hash_lookup_binary(t, k2, sizeof(k2)), k2);
+
+	dm_hash_destroy(t);
+}
+
+static void test_multiple(void)
+{
+	struct dm_hash_table *t = dm_hash_create(16);
+	const char v1[] = "one", v2[] = "two";
+	int count;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(t);
+
+	CU_ASSERT(dm_hash_insert_allow_multiple(t, "key", v1, sizeof(v1)));
+	CU_ASSERT(dm_hash_insert_allow_multiple(t, "key", v2, sizeof(v2)));
+	CU_ASSERT(dm_hash_insert(t, "other", (void *) v1));
+
+	CU_ASSERT_PTR_EQUAL(dm_hash_lookup_with_val(t, "key", v1, sizeof(v1)), v1);
+	CU_ASSERT_PTR_EQUAL(dm_hash_lookup_with_val(t, "key", v2, sizeof(v2)), v2);
+	CU_ASSERT_PTR_NOT_NULL(dm_hash_lookup_with_count(t, "key", &count));
+	CU_ASSERT_EQUAL(count, 2);
+
+	dm_hash_remove_with_val(t, "key", v1, sizeof(v1));
+	CU_ASSERT_PTR_NULL(dm_hash_lookup_with_val(t, "key", v1, sizeof(v1)));
+	CU_ASSERT_PTR_EQUAL(dm_hash_lookup_with_count(t, "key", &count), v2);
+	CU_ASSERT_EQUAL(count, 1);
+
+	dm_hash_remove(t, "key");
+	CU_ASSERT_PTR_NULL(dm_hash_lookup_with_count(t, "key", &count));
+	CU_ASSERT_EQUAL(count, 0);
+	CU_ASSERT_EQUAL(dm_hash_get_num_entries(t), 1);
+
+	dm_hash_destroy(t);
+}
+
+static void test_iterate(void)
+{
+	struct dm_hash_table *t = dm_hash_create(16);
+	struct dm_hash_node *n;
+	char *seen;
+	unsigned i, visited = 0;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(t);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(seen = dm_zalloc(NR_KEYS));
+
+	for (i = 0; i < NR_KEYS; i++)
+		CU_ASSERT(dm_hash_insert(t, keys[i], &seen[i]));
+
+	/* Each entry exactly once, including any still awaiting rehash */
+	dm_hash_iterate(n, t) {
+		CU_ASSERT_STRING_EQUAL(dm_hash_get_key(t, n),
+				       keys[(char *) dm_hash_get_data(t, n) - seen]);
+		(*(char *) dm_hash_get_data(t, n))++;
+		visited++;
+	}
+
+	CU_ASSERT_EQUAL(visited, NR_KEYS);
+	for (i = 0; i < NR_KEYS; i++)
+		CU_ASSERT_EQUAL(seen[i], 1);
+
+	dm_hash_wipe(t);
+	CU_ASSERT_EQUAL(dm_hash_get_num_entries(t), 0);
+	CU_ASSERT_PTR_NULL(dm_hash_get_first(t));
+	CU_ASSERT_PTR_NULL(dm_hash_lookup(t, keys[0]));
+
+	dm_free(seen);
+	dm_hash_destroy(t);
+}
+
+static double _elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start->tv_sec) * 1e3 +
+		(end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/*
+ * Not a correctness test: report timings for a table of the size
+ * lvmetad and dev-cache deal with on large systems.
+ */
+static void test_benchmark(void)
+{
+	struct dm_hash_table *t = dm_hash_create(64);
+	struct dm_hash_node *n;
+	struct timespec start;
+	unsigned i, round, found = 0;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(t);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < NR_KEYS; i++)
+		CU_ASSERT(dm_hash_insert(t, keys[i], keys[i]));
+	printf("\n    insert  %u keys: %8.3f ms\n", NR_KEYS, _elapsed(&start));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < 10; round++)
+		for (i = 0; i < NR_KEYS; i++)
+			found += dm_hash_lookup(t, keys[i]) ? 1 : 0;
+	printf("    lookup  %u keys: %8.3f ms\n", 10 * NR_KEYS, _elapsed(&start));
+	CU_ASSERT_EQUAL(found, 10 * NR_KEYS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < 10; round++)
+		dm_hash_iterate(n, t)
+			found--;
+	printf("    iterate %u keys: %8.3f ms\n", 10 * NR_KEYS, _elapsed(&start));
+	CU_ASSERT_EQUAL(found, 0);
+
+	dm_hash_destroy(t);
+}
+
+CU_TestInfo hash_list[] = {
+	{ (char*)"insert_lookup", test_insert_lookup },
+	{ (char*)"remove", test_remove },
+	{ (char*)"binary", test_binary },
+	{ (char*)"multiple", test_multiple },
+	{ (char*)"iterate", test_iterate },
+	{ (char*)"benchmark", test_benchmark },
+	CU_TEST_INFO_NULL
+};
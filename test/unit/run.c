@@ -15,10 +15,13 @@
 CU_SuiteInfo suites[] = {
 	USE(bitset),
 	USE(config),
+	USE(crc),
 	USE(dmlist),
 	USE(dmstatus),
+	USE(hash),
 	USE(regex),
 	USE(string),
+	USE(wire),
 	CU_SUITE_INFO_NULL
 };
 
@@ -25,9 +25,12 @@
 
 DECL(bitset);
 DECL(config);
+DECL(crc);
 DECL(dmlist);
 DECL(dmstatus);
+DECL(hash);
 DECL(regex);
 DECL(string);
+DECL(wire);
 
 #endif
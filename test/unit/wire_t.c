@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2016 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "units.h"
+#include "config-util.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+	NR_LVS = 4000,
+	NR_ROUNDS = 20
+};
+
+/* vg_lookup reply for a VG with NR_LVS linear LVs */
+static struct dm_config_tree *big_vg;
+
+int wire_init(void)
+{
+	struct buffer b;
+	char line[512];
+	unsigned i;
+
+	buffer_init(&b);
+
+	if (!buffer_append(&b, "response = \"OK\"\nname = \"vg\"\nmetadata {\n"
+			   "id = \"Yx0dfO-Xp3x-Ao7I-BqbD-5xX2-2Ruh-dTNkmE\"\n"
+			   "seqno = 4021\nformat = \"lvm2\"\n"
+			   "status = [\"RESIZEABLE\", \"READ\", \"WRITE\"]\nflags = []\n"
+			   "extent_size = 8192\nmax_lv = 0\nmax_pv = 0\n"
+			   "physical_volumes {\npv0 {\n"
+			   "id = \"hS8x2B-Fd3e-Ix1W-cT4F-eb9V-2bBi-ytQd7A\"\n"
+			   "device = \"/dev/sdb\"\nstatus = [\"ALLOCATABLE\"]\n"
+			   "flags = []\ndev_size = 2147483648\npe_start = 2048\n"
+			   "pe_count = 262143\n}\n}\nlogical_volumes {\n"))
+		return 1;
+
+	for (i = 0; i < NR_LVS; i++) {
+		snprintf(line, sizeof(line),
+			 "lvol%u {\nid = \"Lv%04u-Xp3x-Ao7I-BqbD-5xX2-2Ruh-dTNkmE\"\n"
+			 "status = [\"READ\", \"WRITE\", \"VISIBLE\"]\nflags = []\n"
+			 "creation_time = %u\ncreation_host = \"host.example.com\"\n"
+			 "segment_count = 1\nsegment1 {\nstart_extent = 0\n"
+			 "extent_count = 16\ntype = \"striped\"\nstripe_count = 1\n"
+			 "stripes = [\"pv0\", %u]\n}\n}\n", i, i, 1470000000 + i, i * 16);
+		if (!buffer_append(&b, line))
+			return 1;
+	}
+
+	if (!buffer_append(&b, "}\n}\n") ||
+	    !(big_vg = dm_config_from_string(b.mem)))
+		return 1;
+
+	buffer_destroy(&b);
+
+	return 0;
+}
+
+int wire_fini(void)
+{
+	dm_config_destroy(big_vg);
+
+	return 0;
+}
+
+static struct dm_config_tree *_round_trip(const struct dm_config_node *cn)
+{
+	struct dm_config_tree *cft;
+	struct buffer b;
+
+	buffer_init(&b);
+	if (!config_write_binary(&b, cn))
+		return NULL;
+
+	CU_ASSERT(buffer_is_binary(&b));
+	CU_ASSERT_EQUAL(config_binary_size(b.mem, b.used), b.used);
+
+	cft = config_read_binary(b.mem, b.used);
+	buffer_destroy(&b);
+
+	return cft;
+}
+
+static void test_values(void)
+{
+	struct dm_config_tree *cft, *res;
+
+	cft = dm_config_from_string("a = -1\nb = 9223372036854775807\nc = -9223372036854775807\n"
+				    "d = 1.5\ne = \"\"\nf = []\ng = [ 1, \"x\", 2.25 ]\n"
+				    "h { }\ni { j { k = \"a\" } l = \"a\" }\n");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(cft);
+	dm_config_value_set_format_flags(dm_config_find_node(cft->root, "a")->v,
+					 DM_CONFIG_VALUE_FMT_INT_OCTAL);
+
+	res = _round_trip(cft->root);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(res);
+
+	CU_ASSERT_EQUAL(compare_config(cft->root, res->root), 0);
+	CU_ASSERT_EQUAL(dm_config_find_int64(res->root, "a", 0), -1);
+	CU_ASSERT_EQUAL(dm_config_find_int64(res->root, "b", 0), INT64_MAX);
+	CU_ASSERT_EQUAL(dm_config_find_int64(res->root, "c", 0), -INT64_MAX);
+	CU_ASSERT_EQUAL(dm_config_find_float(res->root, "d", 0), 1.5);
+	CU_ASSERT_STRING_EQUAL(dm_config_find_str_allow_empty(res->root, "e", "x"), "");
+	CU_ASSERT_EQUAL(dm_config_find_node(res->root, "f")->v->type, DM_CFG_EMPTY_ARRAY);
+	CU_ASSERT_EQUAL(dm_config_find_node(res->root, "a")->v->format_flags,
+			DM_CONFIG_VALUE_FMT_INT_OCTAL);
+	CU_ASSERT_STRING_EQUAL(dm_config_find_str(res->root, "i/j/k", NULL), "a");
+	CU_ASSERT_PTR_NOT_NULL(dm_config_find_node(res->root, "h"));
+
+	dm_config_destroy(res);
+	dm_config_destroy(cft);
+}
+
+static void test_corrupt(void)
+{
+	struct buffer b;
+	uint32_t len;
+	int i;
+
+	buffer_init(&b);
+	CU_ASSERT_FATAL(config_write_binary(&b, big_vg->root));
+
+	/* Any truncation must be refused, not read past the end */
+	for (i = 0; i < 64; i++)
+		CU_ASSERT_PTR_NULL(config_read_binary(b.mem, CONFIG_BINARY_HEADER_SIZE + i));
+	CU_ASSERT_PTR_NULL(config_read_binary(b.mem, b.used - 1));
+
+	/* Consistent header, payload cut short */
+	len = b.used - CONFIG_BINARY_HEADER_SIZE - 1;
+	b.mem[4] = len & 0xff;
+	b.mem[5] = (len >> 8) & 0xff;
+	b.mem[6] = (len >> 16) & 0xff;
+	b.mem[7] = (len >> 24) & 0xff;
+	CU_ASSERT_PTR_NULL(config_read_binary(b.mem, b.used - 1));
+
+	/* Garbage after a valid header */
+	memset(b.mem + CONFIG_BINARY_HEADER_SIZE, 0xff, b.used - CONFIG_BINARY_HEADER_SIZE);
+	CU_ASSERT_PTR_NULL(config_read_binary(b.mem, b.used));
+
+	buffer_destroy(&b);
+}
+
+static double _elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start->tv_sec) * 1e3 +
+		(end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/*
+ * Not a correctness test: compare the cost of sending a large vg_lookup
+ * reply as text with the binary encoding (encode and decode, no socket).
+ */
+static void test_benchmark(void)
+{
+	struct dm_config_tree *cft;
+	struct timespec start;
+	struct buffer b;
+	unsigned round;
+	int size = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < NR_ROUNDS; round++) {
+		buffer_init(&b);
+		CU_ASSERT_FATAL(dm_config_write_node(big_vg->root, buffer_line, &b));
+		CU_ASSERT_PTR_NOT_NULL_FATAL(cft = dm_config_from_string(b.mem));
+		if (!round)
+			CU_ASSERT_EQUAL(compare_config(big_vg->root, cft->root), 0);
+		size = b.used;
+		dm_config_destroy(cft);
+		buffer_destroy(&b);
+	}
+	printf("\n    text   %8d bytes: %8.3f ms per round trip\n",
+	       size, _elapsed(&start) / NR_ROUNDS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < NR_ROUNDS; round++) {
+		buffer_init(&b);
+		CU_ASSERT_FATAL(config_write_binary(&b, big_vg->root));
+		CU_ASSERT_PTR_NOT_NULL_FATAL(cft = config_read_binary(b.mem, b.used));
+		if (!round)
+			CU_ASSERT_EQUAL(compare_config(big_vg->root, cft->root), 0);
+		size = b.used;
+		dm_config_destroy(cft);
+		buffer_destroy(&b);
+	}
+	printf("    binary %8d bytes: %8.3f ms per round trip\n",
+	       size, _elapsed(&start) / NR_ROUNDS);
+}
+
+CU_TestInfo wire_list[] = {
+	{ (char*)"values", test_values },
+	{ (char*)"corrupt", test_corrupt },
+	{ (char*)"benchmark", test_benchmark },
+	CU_TEST_INFO_NULL
+};
@@ -56,6 +56,7 @@ arg(lockstart_ARG, '\0', "lockstart", NULL, 0, 0)
 arg(lockstop_ARG, '\0', "lockstop", NULL, 0, 0)
 arg(locktype_ARG, '\0', "locktype", locktype_arg, 0, 0)
 arg(logonly_ARG, '\0', "logonly", NULL, 0, 0)
+arg(manifest_ARG, '\0', "manifest", string_arg, 0, 0)
 arg(maxrecoveryrate_ARG, '\0', "maxrecoveryrate", size_kb_arg, 0, 0)
 arg(merge_ARG, '\0', "merge", NULL, 0, 0)
 arg(mergedconfig_ARG, '\0', "mergedconfig", NULL, 0, 0)
@@ -440,13 +440,36 @@ xx(lvcreate,
    "\t  --cachepool CachePoolLogicalVolume[Path]}]\n"
    "\t[-v|--verbose]\n"
    "\t[--version]\n"
-   "\t[PhysicalVolumePath...]\n\n",
+   "\t[PhysicalVolumePath...]\n\n"
+
+   "lvcreate\n"
+   "\t--manifest ManifestFile\n"
+   "\t[-A|--autobackup {y|n}]\n"
+   "\t[-a|--activate [a|e|l]{y|n}]\n"
+   "\t[--addtag Tag]\n"
+   "\t[--alloc AllocationPolicy]\n"
+   "\t[-C|--contiguous {y|n}]\n"
+   "\t[--commandprofile ProfileName]\n"
+   "\t[-d|--debug]\n"
+   "\t[-h|-?|--help]\n"
+   "\t[-I|--stripesize StripeSize]\n"
+   "\t[-k|--setactivationskip {y|n}]\n"
+   "\t[-K|--ignoreactivationskip]\n"
+   "\t[--noudevsync]\n"
+   "\t[-p|--permission {r|rw}]\n"
+   "\t[-r|--readahead {ReadAheadSectors|auto|none}]\n"
+   "\t[-t|--test]\n"
+   "\t[-v|--verbose]\n"
+   "\t[-W|--wipesignatures {y|n}]\n"
+   "\t[-Z|--zero {y|n}]\n"
+   "\t[--version]\n"
+   "\tVolumeGroupName [PhysicalVolumePath...]\n\n",
 
    addtag_ARG, alloc_ARG, autobackup_ARG, activate_ARG, available_ARG,
    cache_ARG, cachemode_ARG, cachepool_ARG, cachepolicy_ARG, cachesettings_ARG,
    chunksize_ARG, contiguous_ARG, corelog_ARG, discards_ARG, errorwhenfull_ARG,
    extents_ARG, ignoreactivationskip_ARG, ignoremonitoring_ARG, major_ARG,
-   metadataprofile_ARG, minor_ARG, mirrorlog_ARG, mirrors_ARG, monitor_ARG,
+   manifest_ARG, metadataprofile_ARG, minor_ARG, mirrorlog_ARG, mirrors_ARG, monitor_ARG,
    minrecoveryrate_ARG, maxrecoveryrate_ARG, name_ARG, nosync_ARG,
    noudevsync_ARG, permission_ARG, persistent_ARG,
    //pooldatasize_ARG,
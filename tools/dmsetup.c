@@ -80,6 +80,8 @@ extern char *optarg;
 
 #ifdef __linux__
 #  include "kdev_t.h"
+#  include <poll.h>
+#  include <sys/inotify.h>
 #else
 #  define MAJOR(x) major((x))
 #  define MINOR(x) minor((x))
@@ -117,7 +119,8 @@ typedef enum {
 	DMLOSETUP_CMD = 2,
 	DMSTATS_CMD = 3,
 	DMSETUP_STATS_CMD = 4,
-	DEVMAP_NAME_CMD = 5
+	DEVMAP_NAME_CMD = 5,
+	DMFILEMAPD_CMD = 6
 } cmd_name_t;
 
 typedef enum {
@@ -133,6 +136,7 @@ typedef enum {
 #define DMSTATS_CMD_NAME "dmstats"
 #define DMSETUP_STATS_CMD_NAME "dmsetup stats"
 #define DEVMAP_NAME_CMD_NAME "devmap_name"
+#define DMFILEMAPD_CMD_NAME "dmfilemapd"
 
 static const struct {
 	cmd_name_t command;
@@ -145,6 +149,7 @@ static const struct {
 	{ DMSTATS_CMD, DMSTATS_CMD_NAME, STATS_TYPE },
 	{ DMSETUP_STATS_CMD, DMSETUP_STATS_CMD_NAME, STATS_TYPE },
 	{ DEVMAP_NAME_CMD, DEVMAP_NAME_CMD_NAME, DEVMAP_NAME_TYPE },
+	{ DMFILEMAPD_CMD, DMFILEMAPD_CMD_NAME, STATS_TYPE },
 };
 
 static const int _num_base_commands = DM_ARRAY_SIZE(_base_commands);
@@ -164,6 +169,7 @@ enum {
 	AREAS_ARG,
 	AREA_SIZE_ARG,
 	BOUNDS_ARG,
+	BUCKETS_ARG,
 	CHECKS_ARG,
 	CLEAR_ARG,
 	COLS_ARG,
@@ -173,6 +179,7 @@ enum {
 	EXEC_ARG,
 	FILEMAP_ARG,
 	FORCE_ARG,
+	FOREGROUND_ARG,
 	GID_ARG,
 	GROUP_ARG,
 	GROUP_ID_ARG,
@@ -183,6 +190,7 @@ enum {
 	LENGTH_ARG,
 	MANGLENAME_ARG,
 	MAJOR_ARG,
+	MAP_ARG,
 	REGIONS_ARG,
 	MINOR_ARG,
 	MODE_ARG,
@@ -287,6 +295,11 @@ static uint64_t _new_interval = 0; /* flag top-of-interval */
 static uint64_t _last_interval = 0; /* approx. measured interval in nsecs */
 static int _timer_fd = -1; /* timerfd file descriptor. */
 
+/* stats handles kept across intervals of a repeating report */
+static struct dm_hash_table *_stats_samplers = NULL;
+/* sampler of the stats object currently being reported, if any */
+static struct dm_stats_sampler *_report_sampler = NULL;
+
 /* Invalid fd value used to signal end-of-reporting. */
 #define TIMER_STOPPED -2
 
@@ -815,10 +828,92 @@ out:
 	return r;
 }
 
+struct dmsetup_stats_sampler {
+	struct dm_stats *dms;
+	struct dm_stats_sampler *dss;
+};
+
+static void _destroy_stats_sampler(struct dmsetup_stats_sampler *sampler)
+{
+	dm_stats_sampler_destroy(sampler->dss);
+	dm_stats_destroy(sampler->dms);
+	dm_free(sampler);
+}
+
+static void _destroy_stats_samplers(void)
+{
+	struct dm_hash_node *n;
+
+	if (!_stats_samplers)
+		return;
+
+	dm_hash_iterate(n, _stats_samplers)
+		_destroy_stats_sampler(dm_hash_get_data(_stats_samplers, n));
+
+	dm_hash_destroy(_stats_samplers);
+	_stats_samplers = NULL;
+}
+
+/*
+ * Return a stats handle for the device holding the counters of the
+ * current interval. The handle and its counter tables are created on
+ * the first interval and reused until the device's regions change.
+ * A device without regions keeps its handle and is listed again on
+ * each interval; NULL is returned for it without an error.
+ */
+static struct dm_stats *_sample_stats(struct dm_info *info)
+{
+	struct dmsetup_stats_sampler *sampler;
+	int devno[2] = { info->major, info->minor };
+
+	if (!_stats_samplers && !(_stats_samplers = dm_hash_create(32)))
+		return_NULL;
+
+	if ((sampler = dm_hash_lookup_binary(_stats_samplers, devno,
+					     sizeof(devno)))) {
+		if (sampler->dss) {
+			if (dm_stats_sampler_sample(sampler->dss)) {
+				_report_sampler = sampler->dss;
+				return sampler->dms;
+			}
+
+			/* Regions were changed: start again with a new list. */
+			log_debug("Re-creating stats sampler for %d:%d.",
+				  info->major, info->minor);
+			dm_stats_sampler_destroy(sampler->dss);
+			sampler->dss = NULL;
+		}
+	} else {
+		if (!(sampler = dm_zalloc(sizeof(*sampler))))
+			return_NULL;
+
+		if (!(sampler->dms = dm_stats_create(DM_STATS_PROGRAM_ID)) ||
+		    !dm_hash_insert_binary(_stats_samplers, devno, sizeof(devno), sampler)) {
+			if (sampler->dms)
+				dm_stats_destroy(sampler->dms);
+			dm_free(sampler);
+			return_NULL;
+		}
+
+		dm_stats_bind_devno(sampler->dms, info->major, info->minor);
+	}
+
+	if (!(sampler->dss = dm_stats_sampler_create(sampler->dms, _program_id, 1)))
+		return NULL;
+
+	if (!dm_stats_sampler_sample(sampler->dss))
+		return_NULL;
+
+	_report_sampler = sampler->dss;
+
+	return sampler->dms;
+}
+
 static int _display_info_cols(struct dm_task *dmt, struct dm_info *info)
 {
 	struct dmsetup_report_obj obj;
 	uint64_t walk_flags = _statstype;
+	int sampled = 0;
 	int r = 0;
 
 	if (!info->exists) {
@@ -860,7 +955,19 @@ static int _display_info_cols(struct dm_task *dmt, struct dm_info *info)
 	 * Obtain statistics for the current reporting object and set
 	 * the interval estimate used for stats rate conversion.
 	 */
-	if (_report_type & DR_STATS) {
+	if ((_report_type & DR_STATS) && (_count > 1)) {
+		/* Repeating report: keep counter tables between intervals. */
+		if (!(obj.stats = _sample_stats(info)))
+			goto_out;
+		sampled = 1;
+
+		/* Update timestamps and handle end-of-interval accounting. */
+		_update_interval_times();
+
+		log_debug("Adjusted sample interval duration: %12"PRIu64"ns", _last_interval);
+		/* use measured approximation for calculations */
+		dm_stats_set_sampling_interval_ns(obj.stats, _last_interval);
+	} else if (_report_type & DR_STATS) {
 		if (!(obj.stats = dm_stats_create(DM_STATS_PROGRAM_ID)))
 			goto_out;
 
@@ -910,8 +1017,9 @@ out:
 		dm_task_destroy(obj.deps_task);
 	if (obj.split_name)
 		_destroy_split_name(obj.split_name);
-	if (obj.stats)
+	if (obj.stats && !sampled)
 		dm_stats_destroy(obj.stats);
+	_report_sampler = NULL;
 	return r;
 }
 
@@ -3635,6 +3743,82 @@ static int _dm_stats_hist_percent_ranges_disp(struct dm_report *rh,
 	return _stats_hist_percent_disp(rh, field, data, DM_HISTOGRAM_BOUNDS_RANGE);
 }
 
+/*
+ * Latency percentiles are estimated from the histogram accumulated over
+ * all intervals of a repeating report, or from the current sample.
+ */
+static int _stats_latency_disp(struct dm_report *rh, struct dm_pool *mem,
+			       struct dm_report_field *field, const void *data,
+			       double percentile)
+{
+	const struct dm_stats *dms = (const struct dm_stats *) data;
+	const struct dm_histogram *dmh;
+	char buf[64];
+	char *repstr;
+	double *sortval;
+	uint64_t latency;
+
+	dmh = (_report_sampler)
+	       ? dm_stats_sampler_get_histogram(_report_sampler,
+						DM_STATS_REGION_CURRENT,
+						DM_STATS_AREA_CURRENT)
+	       : dm_stats_get_histogram(dms, DM_STATS_REGION_CURRENT,
+					DM_STATS_AREA_CURRENT);
+
+	if (!(sortval = dm_pool_zalloc(mem, sizeof(*sortval))))
+		return_0;
+
+	if (!dmh) {
+		/* No histogram. */
+		dm_report_field_set_value(field, "", sortval);
+		return 1;
+	}
+
+	if (!dm_histogram_get_percentile(dmh, percentile, &latency))
+		return_0;
+
+	/* FIXME: make scale configurable */
+	/* display in msecs */
+	*sortval = (double) latency / NSEC_PER_MSEC;
+
+	if (!dm_snprintf(buf, sizeof(buf), "%.2f", *sortval))
+		return_0;
+
+	if (!(repstr = dm_pool_strdup(mem, buf)))
+		return_0;
+
+	dm_report_field_set_value(field, repstr, sortval);
+	return 1;
+}
+
+static int _dm_stats_latency_p50_disp(struct dm_report *rh, struct dm_pool *mem,
+				      struct dm_report_field *field, const void *data,
+				      void *private __attribute__((unused)))
+{
+	return _stats_latency_disp(rh, mem, field, data, 50.0);
+}
+
+static int _dm_stats_latency_p95_disp(struct dm_report *rh, struct dm_pool *mem,
+				      struct dm_report_field *field, const void *data,
+				      void *private __attribute__((unused)))
+{
+	return _stats_latency_disp(rh, mem, field, data, 95.0);
+}
+
+static int _dm_stats_latency_p99_disp(struct dm_report *rh, struct dm_pool *mem,
+				      struct dm_report_field *field, const void *data,
+				      void *private __attribute__((unused)))
+{
+	return _stats_latency_disp(rh, mem, field, data, 99.0);
+}
+
+static int _dm_stats_latency_p999_disp(struct dm_report *rh, struct dm_pool *mem,
+				       struct dm_report_field *field, const void *data,
+				       void *private __attribute__((unused)))
+{
+	return _stats_latency_disp(rh, mem, field, data, 99.9);
+}
+
 static int _stats_hist_bounds_disp(struct dm_report *rh,
 				   struct dm_report_field *field, const void *data,
 				   int bounds)
@@ -4266,6 +4450,10 @@ FIELD_F(STATS, STR, "Histogram Counts", 16, dm_stats_hist_count_ranges, "hist_co
 FIELD_F(STATS, STR, "Histogram%", 10, dm_stats_hist_percent, "hist_percent", "Relative latency histogram.")
 FIELD_F(STATS, STR, "Histogram%", 10, dm_stats_hist_percent_bounds, "hist_percent_bounds", "Relative latency histogram with bin boundaries.")
 FIELD_F(STATS, STR, "Histogram%", 10, dm_stats_hist_percent_ranges, "hist_percent_ranges", "Relative latency histogram with bin ranges.")
+FIELD_F(STATS, NUM, "LatP50", 6, dm_stats_latency_p50, "latency_p50", "Median latency estimated from the histogram.")
+FIELD_F(STATS, NUM, "LatP95", 6, dm_stats_latency_p95, "latency_p95", "95th percentile latency estimated from the histogram.")
+FIELD_F(STATS, NUM, "LatP99", 6, dm_stats_latency_p99, "latency_p99", "99th percentile latency estimated from the histogram.")
+FIELD_F(STATS, NUM, "LatP99.9", 8, dm_stats_latency_p999, "latency_p999", "99.9th percentile latency estimated from the histogram.")
 
 /* Stats interval duration estimates */
 FIELD_F(STATS, NUM, "IntervalNs", 10, dm_stats_sample_interval_ns, "interval_ns", "Sampling interval in nanoseconds.")
@@ -5407,6 +5595,295 @@ out:
 	return r;
 }
 
+/*
+ * Heatmap: I/O counts of all areas of a device summed into a fixed
+ * number of equal sized offset buckets, one row per interval.
+ *
+ * Output is comma separated with a record type in the first column:
+ *
+ *   heatmap,<device>,<first_sector>,<length>,<nr_buckets>,<bucket_size>
+ *   bucket,<bucket>,<start>,<length>[,<mapping>]
+ *   sample,<interval>,<seconds>,<ios_bucket_0>,...,<ios_bucket_n>
+ *
+ * With --map each bucket row includes the devices that its first sector
+ * maps to through the linear and striped targets of the device tables,
+ * as <name>:<sector> pairs separated by '>'.
+ */
+#define HEATMAP_DEFAULT_BUCKETS 32
+#define HEATMAP_MAX_DEPTH 16
+
+static int _heatmap_append(char *buf, size_t size, const char *name,
+			   uint64_t sector)
+{
+	size_t len = strlen(buf);
+
+	if (dm_snprintf(buf + len, size - len, "%s%s:" FMTu64,
+			len ? ">" : "", name, sector) < 0) {
+		log_error("Heatmap mapping too long.");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Follow sector of device major:minor down through the device tables
+ * appending each device visited to buf.
+ */
+static int _heatmap_map_sector(uint32_t major, uint32_t minor,
+			       uint64_t sector, char *buf, size_t size,
+			       int depth)
+{
+	struct dm_task *dmt;
+	struct dm_info info;
+	char *target_type, *params, name[PATH_MAX];
+	uint64_t start, length, chunk, offset, rel;
+	uint32_t stripes, stripe, dev_major, dev_minor;
+	void *next = NULL;
+	int n, r = 0;
+
+	if (!dm_device_get_name(major, minor, 0, name, sizeof(name)) &&
+	    (dm_snprintf(name, sizeof(name), "%u:%u", major, minor) < 0))
+		return_0;
+
+	if (!_heatmap_append(buf, size, name, sector))
+		return_0;
+
+	if (!dm_is_dm_major(major) || (depth >= HEATMAP_MAX_DEPTH))
+		return 1;
+
+	if (!(dmt = dm_task_create(DM_DEVICE_TABLE)))
+		return_0;
+
+	if (!dm_task_set_major(dmt, major) || !dm_task_set_minor(dmt, minor) ||
+	    !dm_task_no_open_count(dmt))
+		goto_out;
+
+	if (!_task_run(dmt) || !dm_task_get_info(dmt, &info) || !info.exists)
+		goto_out;
+
+	do {
+		next = dm_get_next_target(dmt, next, &start, &length,
+					  &target_type, &params);
+		if (!target_type || (sector < start) || (sector >= start + length))
+			continue;
+
+		rel = sector - start;
+
+		if (!strcmp(target_type, "linear")) {
+			if (sscanf(params, "%u:%u " FMTu64,
+				   &dev_major, &dev_minor, &offset) != 3)
+				break;
+			offset += rel;
+		} else if (!strcmp(target_type, "striped")) {
+			if (sscanf(params, "%u " FMTu64 "%n",
+				   &stripes, &chunk, &n) != 2 || !stripes || !chunk)
+				break;
+			params += n;
+			for (stripe = (rel / chunk) % stripes; ; stripe--) {
+				if (sscanf(params, " %u:%u " FMTu64 "%n", &dev_major,
+					   &dev_minor, &offset, &n) != 3)
+					goto_out;
+				params += n;
+				if (!stripe)
+					break;
+			}
+			offset += (rel / chunk / stripes) * chunk + rel % chunk;
+		} else {
+			/* Mapping does not pass through to a single device. */
+			r = 1;
+			goto out;
+		}
+
+		r = _heatmap_map_sector(dev_major, dev_minor, offset,
+					buf, size, depth + 1);
+		goto out;
+	} while (next);
+
+	/* Unmapped sector or unrecognised table line. */
+	r = 1;
+out:
+	dm_task_destroy(dmt);
+	return r;
+}
+
+static int _heatmap_print_buckets(const struct dm_info *info, uint64_t first,
+				  uint64_t len, uint64_t bucket_size,
+				  unsigned nr_buckets)
+{
+	char mapping[4096];
+	uint64_t start;
+	unsigned bucket;
+
+	for (bucket = 0; bucket < nr_buckets; bucket++) {
+		start = first + bucket * bucket_size;
+		printf("bucket,%u," FMTu64 "," FMTu64, bucket, start,
+		       (bucket + 1 < nr_buckets) ? bucket_size
+						 : first + len - start);
+
+		if (_switches[MAP_ARG]) {
+			*mapping = '\0';
+			if (!_heatmap_map_sector(info->major, info->minor, start,
+						 mapping, sizeof(mapping), 0))
+				return_0;
+			printf(",%s", mapping);
+		}
+		printf("\n");
+	}
+
+	return 1;
+}
+
+static int _stats_heatmap(CMD_ARGS)
+{
+	struct dm_stats_sampler *dss = NULL;
+	struct dm_stats *dms = NULL;
+	struct dm_task *dmt;
+	struct dm_info info;
+	uint64_t region_id, area_id, start, len, first = UINT64_MAX;
+	uint64_t last = 0, bucket_size, elapsed_ns = 0, nr_samples = 0, *ios = NULL;
+	unsigned bucket, nr_buckets = HEATMAP_DEFAULT_BUCKETS;
+	const char *name = NULL;
+	int r = 0;
+
+	/* heatmap does not use a report */
+	if (_report) {
+		dm_report_free(_report);
+		_report = NULL;
+	}
+
+	if (names)
+		name = names->name;
+	else if (argc)
+		name = argv[0];
+	else if (!_switches[UUID_ARG] && !_switches[MAJOR_ARG]) {
+		err("Please specify a device.");
+		return 0;
+	}
+
+	if (_switches[BUCKETS_ARG]) {
+		if (_int_args[BUCKETS_ARG] <= 0) {
+			err("Number of buckets must be positive.");
+			return 0;
+		}
+		nr_buckets = (unsigned) _int_args[BUCKETS_ARG];
+	}
+
+	if (_switches[PROGRAM_ID_ARG])
+		_program_id = _string_args[PROGRAM_ID_ARG];
+
+	if (_switches[ALL_PROGRAMS_ARG])
+		_program_id = "";
+
+	if (!(dmt = dm_task_create(DM_DEVICE_INFO)))
+		return_0;
+
+	if (!_set_task_device(dmt, name, 0) || !_task_run(dmt) ||
+	    !dm_task_get_info(dmt, &info) || !info.exists)
+		goto_out;
+
+	if (!(dms = dm_stats_create(DM_STATS_PROGRAM_ID)) ||
+	    !dm_stats_bind_devno(dms, info.major, info.minor))
+		goto_out;
+
+	if (!(dss = dm_stats_sampler_create(dms, _program_id, 1))) {
+		if (!dm_stats_get_nr_regions(dms))
+			log_error("Device %s has no stats regions.", name);
+		goto out;
+	}
+
+	if (_switches[REGION_ID_ARG] &&
+	    !dm_stats_region_present(dms, (uint64_t) _int_args[REGION_ID_ARG])) {
+		log_error("Region " FMTu64 " does not exist.",
+			  (uint64_t) _int_args[REGION_ID_ARG]);
+		goto out;
+	}
+
+	/* Span of the regions to be mapped. */
+	dm_stats_foreach_region(dms) {
+		region_id = dm_stats_get_current_region(dms);
+		if (_switches[REGION_ID_ARG] &&
+		    (region_id != (uint64_t) _int_args[REGION_ID_ARG]))
+			continue;
+		if (!dm_stats_get_region_start(dms, &start, region_id) ||
+		    !dm_stats_get_region_len(dms, &len, region_id))
+			goto_out;
+		first = (start < first) ? start : first;
+		last = (start + len > last) ? start + len : last;
+	}
+
+	bucket_size = (last - first + nr_buckets - 1) / nr_buckets;
+	if (!bucket_size)
+		goto_out;
+
+	/* Never more buckets than sectors. */
+	nr_buckets = (unsigned) ((last - first + bucket_size - 1) / bucket_size);
+
+	if (!(ios = dm_malloc(nr_buckets * sizeof(*ios))))
+		goto_out;
+
+	printf("heatmap,%s," FMTu64 "," FMTu64 ",%u," FMTu64 "\n",
+	       dm_task_get_name(dmt), first, last - first, nr_buckets, bucket_size);
+
+	if (!_heatmap_print_buckets(&info, first, last - first,
+				    bucket_size, nr_buckets))
+		goto_out;
+
+	/*
+	 * The main command loop repeats reports: run every interval here
+	 * and leave a final count of one for it.
+	 */
+	while (1) {
+		if (!dm_stats_sampler_sample(dss)) {
+			log_error("Could not sample regions: region layout "
+				  "changed?");
+			goto out;
+		}
+
+		memset(ios, 0, nr_buckets * sizeof(*ios));
+
+		dm_stats_foreach_area(dms) {
+			region_id = dm_stats_get_current_region(dms);
+			area_id = dm_stats_get_current_area(dms);
+			if (_switches[REGION_ID_ARG] &&
+			    (region_id != (uint64_t) _int_args[REGION_ID_ARG]))
+				continue;
+			if (!dm_stats_get_area_start(dms, &start, region_id, area_id))
+				goto_out;
+			ios[(start - first) / bucket_size] +=
+				dm_stats_get_reads(dms, region_id, area_id) +
+				dm_stats_get_writes(dms, region_id, area_id);
+		}
+
+		/* The first sample covers the time since the last clear. */
+		if (nr_samples++)
+			elapsed_ns += dm_stats_sampler_get_interval_ns(dss, 0);
+
+		printf("sample," FMTu64 ",%.3f", nr_samples,
+		       (double) elapsed_ns / NSEC_PER_SEC);
+		for (bucket = 0; bucket < nr_buckets; bucket++)
+			printf("," FMTu64, ios[bucket]);
+		printf("\n");
+		fflush(stdout);
+
+		if (_count <= 1)
+			break;
+
+		if (!_do_timer_wait())
+			goto_out;
+		_count--;
+	}
+
+	r = 1;
+out:
+	dm_free(ios);
+	dm_stats_sampler_destroy(dss);
+	if (dms)
+		dm_stats_destroy(dms);
+	dm_task_destroy(dmt);
+	return r;
+}
+
 static int _stats_report(CMD_ARGS)
 {
 	int r = 0, objtype_args;
@@ -5582,6 +6059,221 @@ out:
 	return r;
 }
 
+/*
+ * Re-map the file open on fd and update the regions of *group_id to
+ * match. On success *group_id is set to the ID of the updated group.
+ */
+static int _stats_update_file(struct dm_stats *dms, int fd,
+			      uint64_t *group_id, const char *path)
+{
+	uint64_t *regions, *region, count = 0;
+
+	if (!(regions = dm_stats_update_regions_from_fd(dms, fd, *group_id))) {
+		log_error("Could not update regions from file %s", path);
+		return 0;
+	}
+
+	for (region = regions; *region != DM_STATS_REGIONS_ALL; region++)
+		count++;
+
+	if (regions[0] != *group_id)
+		log_verbose("%s: Group ID "FMTu64" is now group ID "FMTu64".",
+			    path, *group_id, regions[0]);
+
+	*group_id = regions[0];
+	dm_free(regions);
+
+	log_verbose("%s: Updated group ID "FMTu64" with "FMTu64" region(s).",
+		    path, *group_id, count);
+
+	return 1;
+}
+
+#ifdef __linux__
+static uint64_t _monotonic_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+
+	return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+#define FILEMAPD_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF)
+
+/*
+ * dmfilemapd: watch the file open on fd with inotify and update its
+ * regions when the file is written. Updates are rate limited to one
+ * per --interval seconds (default 1s) since each one syncs the file
+ * and walks its extents. Exits when the file is unlinked.
+ */
+static int _stats_filemapd(struct dm_stats *dms, int fd, uint64_t group_id,
+			   const char *path)
+{
+	char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	uint64_t interval_ms = 1000, deadline = 0, now;
+	const struct inotify_event *event;
+	struct pollfd pfd;
+	struct stat st;
+	int ifd, timeout, r = 0;
+	ssize_t len;
+	char *p;
+
+	if (_switches[INTERVAL_ARG])
+		interval_ms = 1000 * (uint64_t) _int_args[INTERVAL_ARG];
+
+	if ((ifd = inotify_init1(IN_CLOEXEC)) < 0) {
+		log_sys_error("inotify_init1", path);
+		return 0;
+	}
+
+	if (inotify_add_watch(ifd, path, FILEMAPD_EVENTS) < 0) {
+		log_sys_error("inotify_add_watch", path);
+		goto out;
+	}
+
+	if (!_switches[FOREGROUND_ARG] && daemon(0, 0)) {
+		log_sys_error("daemon", path);
+		goto out;
+	}
+
+	pfd.fd = ifd;
+	pfd.events = POLLIN;
+
+	for (;;) {
+		/* update once the interval following the first write ends */
+		if (deadline) {
+			now = _monotonic_ms();
+			if (now >= deadline) {
+				if (!_stats_update_file(dms, fd, &group_id, path))
+					goto_out;
+				deadline = 0;
+				continue;
+			}
+			timeout = (int) (deadline - now);
+		} else
+			timeout = -1;
+
+		if (poll(&pfd, 1, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			log_sys_error("poll", path);
+			goto out;
+		}
+
+		if (!(pfd.revents & POLLIN))
+			continue;
+
+		if ((len = read(ifd, buf, sizeof(buf))) < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			log_sys_error("read", path);
+			goto out;
+		}
+
+		for (p = buf; p < buf + len;
+		     p += sizeof(*event) + event->len) {
+			event = (const struct inotify_event *) p;
+
+			if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+				goto gone;
+
+			/* unlink is reported as a link count change */
+			if ((event->mask & IN_ATTRIB) && !fstat(fd, &st) &&
+			    !st.st_nlink)
+				goto gone;
+
+			if ((event->mask & (IN_MODIFY | IN_CLOSE_WRITE)) &&
+			    !deadline)
+				deadline = _monotonic_ms() + interval_ms;
+		}
+	}
+
+gone:
+	log_verbose("%s: File was removed: exiting.", path);
+	r = 1;
+out:
+	if (close(ifd))
+		log_sys_error("close", path);
+
+	return r;
+}
+#else
+static int _stats_filemapd(struct dm_stats *dms, int fd, uint64_t group_id,
+			   const char *path)
+{
+	log_error("File monitoring requires inotify support.");
+	return 0;
+}
+#endif
+
+static int _stats_update_filemap(CMD_ARGS)
+{
+	struct dm_stats *dms;
+	uint64_t group_id;
+	char *abspath;
+	int fd = -1, r = 0;
+
+	/* update_filemap does not use a report */
+	if (_report) {
+		dm_report_free(_report);
+		_report = NULL;
+	}
+
+	/* dmfilemapd runs its own loop: --interval is the update rate */
+	_count = 1;
+
+	if (!_switches[GROUP_ID_ARG]) {
+		err("Please specify group id.");
+		return 0;
+	}
+
+	group_id = (uint64_t) _int_args[GROUP_ID_ARG];
+
+	if (argc != 1) {
+		log_error("Please specify one file path argument.");
+		return 0;
+	}
+
+	if (!(abspath = _get_abspath(argv[0]))) {
+		log_error("Could not canonicalize file name: %s", argv[0]);
+		return 0;
+	}
+
+	if (!(dms = dm_stats_create(DM_STATS_PROGRAM_ID))) {
+		dm_free(abspath);
+		return_0;
+	}
+
+	if ((fd = open(abspath, O_RDONLY)) < 0) {
+		log_error("Could not open %s for reading", abspath);
+		goto out;
+	}
+
+	if (!_bind_stats_from_fd(dms, fd))
+		goto_out;
+
+	if (!_stats_update_file(dms, fd, &group_id, abspath))
+		goto_out;
+
+	if (_base_command == DMFILEMAPD_CMD)
+		r = _stats_filemapd(dms, fd, group_id, abspath);
+	else {
+		printf("%s: Updated group ID "FMTu64".\n", argv[0], group_id);
+		r = 1;
+	}
+
+out:
+	if ((fd > -1) && close(fd))
+		log_error("Error closing %s", abspath);
+
+	dm_free(abspath);
+	dm_stats_destroy(dms);
+	return r;
+}
+
 /*
  * Command dispatch tables and usage.
  */
@@ -5598,11 +6290,16 @@ static int _stats_help(CMD_ARGS);
  *    delete [--regionid] <device_name>
  *    delete_all [--programid id]
  *    group [--alias name] [--alldevices] [--regions <regions>] [<device_name>]
+ *    heatmap [--interval seconds] [--count count] [--buckets nr_buckets]
+ *           [--map] [--programid id] [--regionid id] <device_name>
  *    list [--programid id] [<device_name>]
  *    print [--clear] [--programid id] [--regionid id] [<device_name>]
  *    report [--interval seconds] [--count count] [--units units] [--regionid id]
  *           [--programid id] [<device>]
  *    ungroup [--alldevices] [--groupid id] [<device_name>]
+ *    update_filemap --groupid id <file>
+ *
+ * dmfilemapd --groupid id [--interval seconds] [--foreground] <file>
  */
 
 #define AREA_OPTS "[--areas <nr_areas>] [--areasize <size>] "
@@ -5612,6 +6309,7 @@ static int _stats_help(CMD_ARGS);
 #define PRINT_OPTS "[--clear] " SELECT_OPTS
 #define REPORT_OPTS "[--interval <seconds>] [--count <cnt>]\n\t\t[--units <u>]" SELECT_OPTS
 #define GROUP_OPTS "[--alias NAME] --regions <regions>"
+#define HEATMAP_OPTS "[--interval <seconds>] [--count <cnt>]\n\t\t[--buckets <nr_buckets>] [--map] " SELECT_OPTS
 
 static struct command _stats_subcommands[] = {
 	{"help", "", 0, 0, 0, 0, _stats_help},
@@ -5619,16 +6317,19 @@ static struct command _stats_subcommands[] = {
 	{"create", CREATE_OPTS "\n\t\t" ID_OPTS "[<device>]", 0, -1, 1, 0, _stats_create},
 	{"delete", "--regionid <id> <device>", 1, -1, 1, 0, _stats_delete},
 	{"group", GROUP_OPTS, 1, -1, 1, 0, _stats_group},
+	{"heatmap", HEATMAP_OPTS "<device>", 0, 1, 0, 0, _stats_heatmap},
 	{"list", "[--programid <id>] [<device>]", 0, -1, 1, 0, _stats_report},
 	{"print", PRINT_OPTS "[<device>]", 0, -1, 1, 0, _stats_print},
 	{"report", REPORT_OPTS "[<device>]", 0, -1, 1, 0, _stats_report},
 	{"ungroup", "--groupid <id> [device]", 1, -1, 1, 0, _stats_ungroup},
+	{"update_filemap", "--groupid <id> <file>", 1, 1, 0, 0, _stats_update_filemap},
 	{"version", "", 0, -1, 1, 0, _version},
 	{NULL, NULL, 0, 0, 0, 0, NULL}
 };
 
 #undef AREA_OPTS
 #undef CREATE_OPTS
+#undef HEATMAP_OPTS
 #undef ID_OPTS
 #undef PRINT_OPTS
 #undef REPORT_OPTS
@@ -5687,10 +6388,20 @@ static void _devmap_name_usage(FILE *out)
 	fprintf(out, "Usage: " DEVMAP_NAME_CMD_NAME " <major> <minor>\n\n");
 }
 
+static void _filemapd_usage(FILE *out)
+{
+	fprintf(out, "Usage: " DMFILEMAPD_CMD_NAME " --groupid <id> "
+		     "[--interval <seconds>] [--foreground]\n"
+		     "       [-v|--verbose [-v|--verbose ...]] <file>\n\n");
+}
+
 static void _stats_usage(FILE *out)
 {
 	int i;
 
+	if (_base_command == DMFILEMAPD_CMD)
+		return _filemapd_usage(out);
+
 	fprintf(out, "Usage:\n\n");
 	fprintf(out, "%s\n", _base_commands[_base_command].name);
 	fprintf(out, "        [-h|--help]\n");
@@ -5701,7 +6412,8 @@ static void _stats_usage(FILE *out)
 	fprintf(out, "        [-o <fields>] [-O|--sort <sort_fields>]\n");
 	fprintf(out, "	      [--programid <id>]\n");
 	fprintf(out, "        [--start <start>] [--length <length>]\n");
-	fprintf(out, "        [--segments] [--units <units>]\n\n");
+	fprintf(out, "        [--segments] [--units <units>]\n");
+	fprintf(out, "        [--buckets <nr_buckets>] [--map]\n\n");
 
 	for (i = 0; _stats_subcommands[i].name; i++)
 		fprintf(out, "\t%s %s\n", _stats_subcommands[i].name, _stats_subcommands[i].help);
@@ -6223,6 +6935,7 @@ static int _process_switches(int *argcp, char ***argvp, const char *dev_dir)
 		{"areas", 1, &ind, AREAS_ARG},
 		{"areasize", 1, &ind, AREA_SIZE_ARG},
 		{"bounds", 1, &ind, BOUNDS_ARG},
+		{"buckets", 1, &ind, BUCKETS_ARG},
 		{"checks", 0, &ind, CHECKS_ARG},
 		{"clear", 0, &ind, CLEAR_ARG},
 		{"columns", 0, &ind, COLS_ARG},
@@ -6232,6 +6945,7 @@ static int _process_switches(int *argcp, char ***argvp, const char *dev_dir)
 		{"exec", 1, &ind, EXEC_ARG},
 		{"filemap", 0, &ind, FILEMAP_ARG},
 		{"force", 0, &ind, FORCE_ARG},
+		{"foreground", 0, &ind, FOREGROUND_ARG},
 		{"gid", 1, &ind, GID_ARG},
 		{"group", 0, &ind, GROUP_ARG},
 		{"groupid", 1, &ind, GROUP_ID_ARG},
@@ -6242,6 +6956,7 @@ static int _process_switches(int *argcp, char ***argvp, const char *dev_dir)
 		{"length", 1, &ind, LENGTH_ARG},
 		{"manglename", 1, &ind, MANGLENAME_ARG},
 		{"major", 1, &ind, MAJOR_ARG},
+		{"map", 0, &ind, MAP_ARG},
 		{"minor", 1, &ind, MINOR_ARG},
 		{"mode", 1, &ind, MODE_ARG},
 		{"nameprefixes", 0, &ind, NAMEPREFIXES_ARG},
@@ -6391,6 +7106,10 @@ static int _process_switches(int *argcp, char ***argvp, const char *dev_dir)
 			_switches[BOUNDS_ARG]++;
 			_string_args[BOUNDS_ARG] = optarg;
 		}
+		if (ind == BUCKETS_ARG) {
+			_switches[BUCKETS_ARG]++;
+			_int_args[BUCKETS_ARG] = atoi(optarg);
+		}
 		if (ind == CLEAR_ARG)
 			_switches[CLEAR_ARG]++;
 		if (c == 'c' || c == 'C' || ind == COLS_ARG)
@@ -6399,6 +7118,8 @@ static int _process_switches(int *argcp, char ***argvp, const char *dev_dir)
 			_switches[FILEMAP_ARG]++;
 		if (c == 'f' || ind == FORCE_ARG)
 			_switches[FORCE_ARG]++;
+		if (ind == FOREGROUND_ARG)
+			_switches[FOREGROUND_ARG]++;
 		if (c == 'r' || ind == READ_ONLY)
 			_switches[READ_ONLY]++;
 		if (ind == HISTOGRAM_ARG)
@@ -6411,6 +7132,8 @@ static int _process_switches(int *argcp, char ***argvp, const char *dev_dir)
 			_switches[MAJOR_ARG]++;
 			_int_args[MAJOR_ARG] = atoi(optarg);
 		}
+		if (ind == MAP_ARG)
+			_switches[MAP_ARG]++;
 		if (ind == REGIONS_ARG) {
 			_switches[REGIONS_ARG]++;
 			_string_args[REGIONS_ARG] = optarg;
@@ -6647,7 +7370,8 @@ static int _process_switches(int *argcp, char ***argvp, const char *dev_dir)
 		_command = "stats";
 		(*argvp)++;
 		(*argcp)--;
-	} else if (_base_command == DMSTATS_CMD) {
+	} else if (_base_command == DMSTATS_CMD ||
+		   _base_command == DMFILEMAPD_CMD) {
 		_command = "stats";
 	} else if (*argcp) {
 		_command = (*argvp)[0];
@@ -6772,7 +7496,10 @@ unknown:
 	 * Extract subcommand?
 	 * dmsetup <command> <subcommand> [args...]
 	 */
-	if (cmd->has_subcommands) {
+	if (cmd->has_subcommands && _base_command == DMFILEMAPD_CMD)
+		/* dmfilemapd <file> is dmstats update_filemap in daemon mode */
+		subcommand = "update_filemap";
+	else if (cmd->has_subcommands) {
 		subcommand = argv[0];
 		argc--, argv++;
 	}
@@ -6833,6 +7560,8 @@ out:
 	if (_dtree)
 		dm_tree_free(_dtree);
 
+	_destroy_stats_samplers();
+
 	dm_free(_table);
 
 	if (_initial_timestamp)
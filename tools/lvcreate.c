@@ -1607,6 +1607,354 @@ out:
 	return ret;
 }
 
+/*
+ * lvcreate --manifest File VG [PV...]
+ *
+ * Creates every LV listed in File with a single metadata update.
+ * File uses the config file syntax with one section per LV:
+ *
+ *   data1 { size = "10g" stripes = 2 tags = [ "db" ] }
+ *   data2 { extents = 100 }
+ *   thin1 { size = "1t" thinpool = "pool" }
+ *
+ * A size given as a plain number is in megabytes, as with -L.
+ * Options given on the command line apply to every LV.
+ */
+struct manifest_params {
+	struct lvcreate_params lp; /* common to all LVs */
+	struct dm_config_tree *cft;
+	char **pvs;
+	uint32_t pv_count;
+};
+
+static int _read_manifest_size(struct volume_group *vg,
+			       const struct dm_config_node *cn,
+			       uint32_t *extents)
+{
+	const struct dm_config_value *v = cn->v;
+	const char *end;
+	uint64_t factor;
+	char unit_type;
+
+	if (v->type == DM_CFG_INT && v->v.i > 0)
+		factor = (uint64_t) v->v.i * 1024 * 1024;
+	else if (v->type != DM_CFG_STRING ||
+		 !(factor = dm_units_to_factor(v->v.str, &unit_type, 1, &end)) ||
+		 *end || (unit_type == 'h') || (unit_type == 'H'))
+		factor = 0;
+
+	if (factor < SECTOR_SIZE) {
+		log_error("Invalid size in manifest entry %s.", cn->parent->key);
+		return 0;
+	}
+
+	if (!(*extents = extents_from_size(vg->cmd, factor >> SECTOR_SHIFT,
+					   vg->extent_size)))
+		return_0;
+
+	return 1;
+}
+
+static int _read_manifest_lv(struct volume_group *vg,
+			     const struct dm_config_node *cn,
+			     struct lvcreate_params *lp)
+{
+	struct cmd_context *cmd = vg->cmd;
+	const struct dm_config_node *child;
+	const struct dm_config_value *v;
+	struct logical_volume *pool_lv;
+	const char *tag;
+
+	if (cn->v || !cn->key || !*cn->key) {
+		log_error("Manifest entry %s is not a section.", cn->key ? : "");
+		return 0;
+	}
+
+	lp->lv_name = cn->key;
+	if (!validate_name(lp->lv_name) || !apply_lvname_restrictions(lp->lv_name)) {
+		log_error("Logical volume name \"%s\" is invalid.", lp->lv_name);
+		return 0;
+	}
+
+	lp->extents = 0;
+	lp->virtual_extents = 0;
+	for (child = cn->child; child; child = child->sib) {
+		if (!child->v) {
+			log_error("Unexpected section %s in manifest entry %s.",
+				  child->key, cn->key);
+			return 0;
+		}
+
+		if (!strcmp(child->key, "size") || !strcmp(child->key, "extents")) {
+			if (lp->extents) {
+				log_error("Please specify either size or extents "
+					  "(not both) in manifest entry %s.", cn->key);
+				return 0;
+			}
+			if (child->key[0] == 's') {
+				if (!_read_manifest_size(vg, child, &lp->extents))
+					return_0;
+			} else if (child->v->type != DM_CFG_INT || child->v->v.i <= 0 ||
+				   child->v->v.i > UINT32_MAX) {
+				log_error("Invalid extents in manifest entry %s.", cn->key);
+				return 0;
+			} else
+				lp->extents = (uint32_t) child->v->v.i;
+		} else if (!strcmp(child->key, "stripes")) {
+			if (child->v->type != DM_CFG_INT || child->v->v.i < 1 ||
+			    child->v->v.i > MAX_STRIPES) {
+				log_error("Number of stripes in manifest entry %s must "
+					  "be between %d and %d.", cn->key, 1, MAX_STRIPES);
+				return 0;
+			}
+			lp->stripes = (uint32_t) child->v->v.i;
+		} else if (!strcmp(child->key, "thinpool")) {
+			if (child->v->type != DM_CFG_STRING) {
+				log_error("Invalid thinpool in manifest entry %s.", cn->key);
+				return 0;
+			}
+			lp->pool_name = child->v->v.str;
+		} else if (!strcmp(child->key, "tags")) {
+			for (v = child->v; v; v = v->next) {
+				if (v->type != DM_CFG_STRING || !validate_tag(v->v.str)) {
+					log_error("Invalid tag in manifest entry %s.", cn->key);
+					return 0;
+				}
+				if (!(tag = dm_pool_strdup(cmd->mem, v->v.str)) ||
+				    !str_list_add(cmd->mem, &lp->tags, tag)) {
+					log_error("Unable to allocate memory for tag %s.", v->v.str);
+					return 0;
+				}
+			}
+		} else {
+			log_error("Unknown setting %s in manifest entry %s.",
+				  child->key, cn->key);
+			return 0;
+		}
+	}
+
+	if (!lp->extents) {
+		log_error("Please specify either size or extents in manifest entry %s.",
+			  cn->key);
+		return 0;
+	}
+
+	if (lp->pool_name) {
+		if (lp->stripes > 1) {
+			log_error("Stripes are unsupported with thin volume %s.", cn->key);
+			return 0;
+		}
+		if (!(pool_lv = find_lv(vg, lp->pool_name)) || !lv_is_thin_pool(pool_lv)) {
+			log_error("Thin pool %s not found in Volume group %s.",
+				  lp->pool_name, vg->name);
+			return 0;
+		}
+		if (!(lp->segtype = get_segtype_from_string(cmd, SEG_TYPE_NAME_THIN)))
+			return_0;
+		lp->virtual_extents = lp->extents;
+		lp->extents = 0;
+	} else if (lp->stripes > 1) {
+		if (!lp->stripe_size)
+			lp->stripe_size = find_config_tree_int(cmd, metadata_stripesize_CFG, NULL) * 2;
+	} else
+		lp->stripe_size = 0;
+
+	return 1;
+}
+
+static int _lvcreate_manifest_single(struct cmd_context *cmd, const char *vg_name,
+				     struct volume_group *vg,
+				     struct processing_handle *handle)
+{
+	struct manifest_params *mp = (struct manifest_params *) handle->custom_handle;
+	const struct dm_config_node *cn;
+	struct lvcreate_params *lps;
+	struct dm_list *pvh = &vg->pvs;
+	struct dm_str_list *sl;
+	unsigned i, count = 0;
+
+	if (!_read_activation_params(cmd, vg, &mp->lp) ||
+	    !_check_zero_parameters(cmd, &mp->lp))
+		return_ECMD_FAILED;
+
+	if (mp->pv_count &&
+	    !(pvh = create_pv_list(cmd->mem, vg, mp->pv_count, mp->pvs, 1)))
+		return_ECMD_FAILED;
+
+	for (cn = mp->cft->root; cn; cn = cn->sib)
+		count++;
+
+	if (!(lps = dm_pool_zalloc(cmd->mem, count * sizeof(*lps)))) {
+		log_error("Failed to allocate manifest parameters.");
+		return ECMD_FAILED;
+	}
+
+	for (i = 0, cn = mp->cft->root; cn; i++, cn = cn->sib) {
+		lps[i] = mp->lp;
+		lps[i].pvh = pvh;
+		dm_list_init(&lps[i].tags);
+		dm_list_iterate_items(sl, &mp->lp.tags)
+			if (!str_list_add(cmd->mem, &lps[i].tags, sl->str)) {
+				log_error("Unable to allocate memory for tag %s.", sl->str);
+				return ECMD_FAILED;
+			}
+
+		if (!_read_manifest_lv(vg, cn, &lps[i]))
+			return_ECMD_FAILED;
+
+		if (is_lockd_type(vg->lock_type))
+			lps[i].needs_lockd_init = 1;
+	}
+
+	if (vg->lock_type && !strcmp(vg->lock_type, "sanlock") &&
+	    !handle_sanlock_lv(cmd, vg)) {
+		log_error("No space for sanlock lock, extend the internal lvmlock LV.");
+		return ECMD_FAILED;
+	}
+
+	log_verbose("Creating %u logical volumes in VG %s.", count, vg->name);
+
+	if (!lv_create_batch(vg, lps, count))
+		return_ECMD_FAILED;
+
+	return ECMD_PROCESSED;
+}
+
+static int _lvcreate_manifest(struct cmd_context *cmd, int argc, char **argv)
+{
+	struct processing_handle *handle = NULL;
+	struct manifest_params mp = {
+		.lp = {
+			.major = -1,
+			.minor = -1,
+		},
+	};
+	struct lvcreate_params *lp = &mp.lp;
+	struct arg_value_group_list *current_group;
+	const char *file, *vg_name, *tag;
+	int contiguous;
+	int ret;
+
+	if (arg_outside_list_is_set(cmd, "is unsupported with --manifest",
+				    activate_ARG,
+				    addtag_ARG,
+				    alloc_ARG,
+				    autobackup_ARG,
+				    available_ARG,
+				    contiguous_ARG,
+				    ignoreactivationskip_ARG,
+				    manifest_ARG,
+				    noudevsync_ARG,
+				    permission_ARG,
+				    readahead_ARG,
+				    setactivationskip_ARG,
+				    stripesize_ARG,
+				    test_ARG,
+				    wipesignatures_ARG,
+				    zero_ARG,
+				    -1))
+		return EINVALID_CMD_LINE;
+
+	if (!argc) {
+		log_error("Please provide a volume group name");
+		return EINVALID_CMD_LINE;
+	}
+
+	vg_name = skip_dev_dir(cmd, argv[0], NULL);
+	if (strchr(vg_name, '/') || !validate_name(vg_name)) {
+		log_error("Volume group name expected (no slash)");
+		return EINVALID_CMD_LINE;
+	}
+
+	dm_list_init(&lp->tags);
+	lp->vg_name = vg_name;
+	lp->target_attr = ~0;
+	lp->yes = arg_count(cmd, yes_ARG);
+	lp->force = (force_t) arg_count(cmd, force_ARG);
+	lp->permission = arg_uint_value(cmd, permission_ARG, LVM_READ | LVM_WRITE);
+
+	if (!(lp->segtype = get_segtype_from_string(cmd, SEG_TYPE_NAME_STRIPED)))
+		return_ECMD_FAILED;
+
+	/* Stripe size applies to the entries with more than one stripe */
+	lp->stripes = 1;
+	lp->stripe_size = arg_uint_value(cmd, stripesize_ARG, 0);
+	if (arg_is_set(cmd, stripesize_ARG) &&
+	    ((arg_sign_value(cmd, stripesize_ARG, SIGN_NONE) == SIGN_MINUS) ||
+	     (arg_uint64_value(cmd, stripesize_ARG, 0) > STRIPE_SIZE_LIMIT * 2) ||
+	     (lp->stripe_size < STRIPE_SIZE_MIN) || !is_power_of_2(lp->stripe_size))) {
+		log_error("Invalid stripe size %s.",
+			  display_size(cmd, (uint64_t) lp->stripe_size));
+		return EINVALID_CMD_LINE;
+	}
+
+	lp->zero = arg_int_value(cmd, zero_ARG, 1);
+	if (arg_is_set(cmd, wipesignatures_ARG))
+		lp->wipe_signatures = arg_int_value(cmd, wipesignatures_ARG, 1);
+	else if (find_config_tree_bool(cmd, allocation_wipe_signatures_when_zeroing_new_lvs_CFG, NULL))
+		lp->wipe_signatures = lp->zero;
+
+	contiguous = arg_int_value(cmd, contiguous_ARG, 0);
+	lp->alloc = contiguous ? ALLOC_CONTIGUOUS : ALLOC_INHERIT;
+	lp->alloc = (alloc_policy_t) arg_uint_value(cmd, alloc_ARG, lp->alloc);
+
+	if (contiguous && (lp->alloc != ALLOC_CONTIGUOUS)) {
+		log_error("Conflicting contiguous and alloc arguments.");
+		return EINVALID_CMD_LINE;
+	}
+
+	dm_list_iterate_items(current_group, &cmd->arg_value_groups) {
+		if (!grouped_arg_is_set(current_group->arg_values, addtag_ARG))
+			continue;
+
+		if (!(tag = grouped_arg_str_value(current_group->arg_values, addtag_ARG, NULL))) {
+			log_error("Failed to get tag.");
+			return EINVALID_CMD_LINE;
+		}
+
+		if (!str_list_add(cmd->mem, &lp->tags, tag)) {
+			log_error("Unable to allocate memory for tag %s.", tag);
+			return ECMD_FAILED;
+		}
+	}
+
+	mp.pvs = argv + 1;
+	mp.pv_count = argc - 1;
+
+	file = arg_str_value(cmd, manifest_ARG, NULL);
+	if (!(mp.cft = config_open(CONFIG_FILE_SPECIAL, file, 0)))
+		return_ECMD_FAILED;
+
+	if (!config_file_read(mp.cft)) {
+		log_error("Failed to read manifest %s.", file);
+		ret = ECMD_FAILED;
+		goto out;
+	}
+
+	if (!mp.cft->root) {
+		log_error("Manifest %s lists no logical volumes.", file);
+		ret = EINVALID_CMD_LINE;
+		goto out;
+	}
+
+	if (!(handle = init_processing_handle(cmd, NULL))) {
+		log_error("Failed to initialize processing handle.");
+		ret = ECMD_FAILED;
+		goto out;
+	}
+
+	handle->custom_handle = &mp;
+
+	ret = process_each_vg(cmd, 0, NULL, lp->vg_name, NULL, READ_FOR_UPDATE, 0, handle,
+			      &_lvcreate_manifest_single);
+
+	destroy_processing_handle(cmd, handle);
+out:
+	config_destroy(mp.cft);
+
+	return ret;
+}
+
 int lvcreate(struct cmd_context *cmd, int argc, char **argv)
 {
 	struct processing_handle *handle = NULL;
@@ -1618,6 +1966,9 @@ int lvcreate(struct cmd_context *cmd, int argc, char **argv)
 	struct lvcreate_cmdline_params lcp = { 0 };
 	int ret;
 
+	if (arg_is_set(cmd, manifest_ARG))
+		return _lvcreate_manifest(cmd, argc, argv);
+
 	if (!_lvcreate_params(cmd, argc, argv, &lp, &lcp)) {
 		stack;
 		return EINVALID_CMD_LINE;
@@ -76,6 +76,13 @@ void lvm2_log_level(void *handle, int level);
  */
 int lvm2_run(void *handle, const char *cmdline);
 
+/*
+ * Look up an integer setting such as "activation/thin_pool_autoextend_horizon"
+ * in the configuration loaded by the handle.
+ * Returns fail if the setting is not found.
+ */
+int lvm2_config_find_int(void *handle, const char *path, int fail);
+
 /* Release handle */
 void lvm2_exit(void *handle);
 
@@ -95,6 +95,13 @@ int lvm2_run(void *handle, const char *cmdline)
 	return ret;
 }
 
+int lvm2_config_find_int(void *handle, const char *path, int fail)
+{
+	struct cmd_context *cmd = (struct cmd_context *) handle;
+
+	return dm_config_tree_find_int(cmd->cft, path, fail);
+}
+
 void lvm2_disable_dmeventd_monitoring(void *handle) {
 	init_dmeventd_monitor(DMEVENTD_MONITOR_IGNORE);
 	init_ignore_suspended_devices(1);
@@ -1480,8 +1480,14 @@ int report_format_init(struct cmd_context *cmd)
 		if (!_config_report(cmd, &args, single_args))
 			goto_bad;
 
+		/*
+		 * Messages are logged while other reports in a JSON group stream
+		 * their rows, so the log report is output at the end instead.
+		 */
 		if (!(tmp_log_rh = report_init(NULL, single_args->options, single_args->keys, &single_args->report_type,
-						  args.separator, args.aligned, args.buffered, args.headings,
+						  args.separator, args.aligned,
+						  args.buffered || args.report_group_type == DM_REPORT_GROUP_JSON,
+						  args.headings,
 						  args.field_prefixes, args.quoted, args.columns_as_rows,
 						  single_args->selection, 1))) {
 			log_error("Failed to create log report.");
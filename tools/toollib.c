@@ -1879,6 +1879,29 @@ static int _select_matches(struct processing_handle *handle)
 	return handle->selection_handle->selected;
 }
 
+/*
+ * With global/metadata_read_ahead set, read the metadata of the next
+ * VGs on the list together when the previous batch has been processed.
+ * Each VG is still locked and read in turn; vg_read() only uses what
+ * was read ahead if it is still current.
+ */
+static void _read_ahead_vgs(struct cmd_context *cmd, struct dm_list *vgnameids,
+			    struct vgnameid_list *vgnl, unsigned *left)
+{
+	unsigned count;
+
+	if (*left) {
+		(*left)--;
+		return;
+	}
+
+	if (!(count = (unsigned) find_config_tree_int(cmd, global_metadata_read_ahead_CFG, NULL)))
+		return;
+
+	vg_read_ahead(cmd, vgnameids, vgnl, count);
+	*left = count - 1;
+}
+
 static int _process_vgnameid_list(struct cmd_context *cmd, uint32_t read_flags,
 				  struct dm_list *vgnameids_to_process,
 				  struct dm_list *arg_vgnames,
@@ -1901,6 +1924,7 @@ static int _process_vgnameid_list(struct cmd_context *cmd, uint32_t read_flags,
 	int process_all = 0;
 	int already_locked;
 	int do_report_ret_code = 1;
+	unsigned read_ahead_left = 0;
 
 	log_set_report_object_type(LOG_REPORT_OBJECT_TYPE_VG);
 
@@ -1936,6 +1960,8 @@ static int _process_vgnameid_list(struct cmd_context *cmd, uint32_t read_flags,
 
 		log_very_verbose("Processing VG %s %s", vg_name, uuid);
 
+		_read_ahead_vgs(cmd, vgnameids_to_process, vgnl, &read_ahead_left);
+
 		if (!lockd_vg(cmd, vg_name, NULL, 0, &lockd_state)) {
 			ret_max = ECMD_FAILED;
 			report_log_ret_code(ret_max);
@@ -2756,6 +2782,7 @@ static int _process_lv_vgnameid_list(struct cmd_context *cmd, uint32_t read_flag
 	int notfound;
 	int already_locked;
 	int do_report_ret_code = 1;
+	unsigned read_ahead_left = 0;
 
 	log_set_report_object_type(LOG_REPORT_OBJECT_TYPE_VG);
 
@@ -2809,6 +2836,8 @@ static int _process_lv_vgnameid_list(struct cmd_context *cmd, uint32_t read_flag
 
 		log_very_verbose("Processing VG %s %s", vg_name, vg_uuid ? uuid : "");
 
+		_read_ahead_vgs(cmd, vgnameids_to_process, vgnl, &read_ahead_left);
+
 		if (!lockd_vg(cmd, vg_name, NULL, 0, &lockd_state)) {
 			ret_max = ECMD_FAILED;
 			report_log_ret_code(ret_max);